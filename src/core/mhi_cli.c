@@ -0,0 +1,450 @@
+/**
+ * @file mhi_cli.c
+ * @brief Diagnostic command shell
+ */
+
+#include <stdlib.h>
+#include <string.h>
+
+#include "app_util_platform.h"
+
+#include "include/mhi_cli.h"
+
+/** @brief Command handler, argv[0] is the command word. */
+typedef bool (*cli_handler_t)(mhi_cli_t *p_cli, size_t argc, char **argv);
+
+/** @brief Command table entry. */
+typedef struct
+{
+    const char *p_name;
+    const char *p_args;
+    const char *p_help;
+    cli_handler_t handler;
+} cli_command_t;
+
+#define CLI_HANDLER_DECLARE(name, args, help) static bool cmd_##name(mhi_cli_t *p_cli, size_t argc, char **argv);
+MHI_CLI_COMMANDS(CLI_HANDLER_DECLARE)
+#undef CLI_HANDLER_DECLARE
+
+static const cli_command_t m_commands[] = {
+#define CLI_COMMAND_ENTRY(name, args, help) {#name, args, help, cmd_##name},
+    MHI_CLI_COMMANDS(CLI_COMMAND_ENTRY)
+#undef CLI_COMMAND_ENTRY
+};
+
+/* Field names for the cmd command, indexed by mhi_field_t */
+static const char *const m_field_names[MHI_FIELD_COUNT] = {
+#define CLI_FIELD_NAME(name, ...) #name,
+    MHI_FIELDS(CLI_FIELD_NAME)
+#undef CLI_FIELD_NAME
+};
+
+/* Opdata names, indexed by mhi_opdata_t */
+static const char *const m_opdata_names[MHI_OPDATA_COUNT] = {
+    [MHI_OPDATA_RETURN_AIR_TEMP] = "return air",
+    [MHI_OPDATA_OUTDOOR_TEMP] = "outdoor",
+    [MHI_OPDATA_HEAT_EXCH_TEMP] = "heat exchanger",
+    [MHI_OPDATA_CURRENT] = "current",
+    [MHI_OPDATA_COMP_FREQ] = "compressor",
+    [MHI_OPDATA_ENERGY] = "energy",
+};
+
+/* Frame validation results, indexed by mhi_frame_status_t */
+static const char *const m_status_names[] = {
+    [MHI_FRAME_OK] = "valid",
+    [MHI_FRAME_ERR_LENGTH] = "length error",
+    [MHI_FRAME_ERR_SIGNATURE] = "signature error",
+    [MHI_FRAME_ERR_CHECKSUM] = "checksum error",
+};
+
+/**
+ * @brief Print through the output callback.
+ */
+static void cli_print(const mhi_cli_t *p_cli, const char *p_fmt, ...)
+{
+    va_list args;
+
+    va_start(args, p_fmt);
+    p_cli->print(p_cli->p_context, p_fmt, &args);
+    va_end(args);
+}
+
+/**
+ * @brief Print the bytes of a frame in hex, after a label.
+ */
+static void frame_print(const mhi_cli_t *p_cli, const char *p_label, const uint8_t *p_data, size_t len)
+{
+    cli_print(p_cli, "%s", p_label);
+    for (size_t i = 0; i < len; i++)
+    {
+        cli_print(p_cli, " %02x", p_data[i]);
+    }
+    cli_print(p_cli, "\n");
+}
+
+/**
+ * @brief Parse an unsigned number in C notation.
+ * @return false when the argument is not a number
+ */
+static bool arg_uint(const char *p_arg, uint32_t *p_value)
+{
+    char *p_end;
+
+    *p_value = (uint32_t)strtoul(p_arg, &p_end, 0);
+    return p_end != p_arg && *p_end == '\0';
+}
+
+/**
+ * @brief Compare two words, ignoring case.
+ */
+static bool word_equal(const char *p_a, const char *p_b)
+{
+    for (; *p_a != '\0' && *p_b != '\0'; p_a++, p_b++)
+    {
+        char a = *p_a >= 'a' && *p_a <= 'z' ? (char)(*p_a - 'a' + 'A') : *p_a;
+        char b = *p_b >= 'a' && *p_b <= 'z' ? (char)(*p_b - 'a' + 'A') : *p_b;
+
+        if (a != b)
+        {
+            return false;
+        }
+    }
+
+    return *p_a == *p_b;
+}
+
+/**
+ * @brief Value of a hex digit, -1 for other characters.
+ */
+static int hex_digit(char c)
+{
+    if (c >= '0' && c <= '9')
+    {
+        return c - '0';
+    }
+    if (c >= 'a' && c <= 'f')
+    {
+        return c - 'a' + 10;
+    }
+    if (c >= 'A' && c <= 'F')
+    {
+        return c - 'A' + 10;
+    }
+
+    return -1;
+}
+
+static bool cmd_help(mhi_cli_t *p_cli, size_t argc, char **argv)
+{
+    (void)argc;
+    (void)argv;
+
+    for (size_t i = 0; i < sizeof(m_commands) / sizeof(m_commands[0]); i++)
+    {
+        cli_print(p_cli, "%s %s\n    %s\n", m_commands[i].p_name, m_commands[i].p_args, m_commands[i].p_help);
+    }
+
+    return true;
+}
+
+static bool cmd_unit(mhi_cli_t *p_cli, size_t argc, char **argv)
+{
+    uint32_t unit;
+
+    if (argc > 1)
+    {
+        if (!arg_uint(argv[1], &unit) || unit >= p_cli->unit_count)
+        {
+            cli_print(p_cli, "unit must be 0 to %u\n", p_cli->unit_count - 1);
+            return false;
+        }
+        p_cli->unit = (uint8_t)unit;
+    }
+
+    cli_print(p_cli, "unit %u of %u, endpoint %u, %s\n", p_cli->unit, p_cli->unit_count,
+              p_cli->p_units[p_cli->unit].endpoint, p_cli->p_units[p_cli->unit].available ? "available" : "offline");
+
+    return true;
+}
+
+static bool cmd_frames(mhi_cli_t *p_cli, size_t argc, char **argv)
+{
+    mhi_unit_t *p_unit = &p_cli->p_units[p_cli->unit];
+    mhi_link_t *p_link = &p_unit->link;
+    mhi_link_frame_t rx[MHI_LINK_RING_SIZE];
+    uint32_t head;
+    uint32_t count;
+
+    (void)argc;
+    (void)argv;
+
+    /* The ring keeps the last frames after they were processed; the interrupt may be writing
+     * the oldest slot */
+    CRITICAL_REGION_ENTER();
+    head = p_link->rx_head;
+    memcpy(rx, p_link->rx, sizeof(rx));
+    CRITICAL_REGION_EXIT();
+
+    count = head < MHI_LINK_RING_SIZE ? head : MHI_LINK_RING_SIZE;
+    for (uint32_t i = 0; i < count; i++)
+    {
+        const mhi_link_frame_t *p_frame = &rx[(head - 1 - i) & (MHI_LINK_RING_SIZE - 1)];
+
+        frame_print(p_cli, i == 0 ? "rx" : "  ", p_frame->data, p_frame->len);
+    }
+
+    /* The AC clocks as many bytes out as it sends */
+    frame_print(p_cli, "tx", p_link->tx[p_link->tx_active], count ? rx[(head - 1) & (MHI_LINK_RING_SIZE - 1)].len
+                                                                  : MHI_FRAME_SIZE_EXT);
+
+    return true;
+}
+
+static bool cmd_counters(mhi_cli_t *p_cli, size_t argc, char **argv)
+{
+    const mhi_unit_t *p_unit = &p_cli->p_units[p_cli->unit];
+    const mhi_link_stats_t *p_stats = &p_unit->link.stats;
+    const mhi_timing_t *p_timing = &p_unit->timing;
+    const mhi_cmd_t *p_cmd = &p_unit->cmd;
+
+    (void)argc;
+    (void)argv;
+
+    cli_print(p_cli, "link frames %u length %u signature %u checksum %u overruns %u resyncs %u missing %u\n",
+              p_stats->frames, p_stats->length_errors, p_stats->signature_errors, p_stats->checksum_errors,
+              p_stats->overruns, p_stats->resyncs, p_stats->missing);
+    cli_print(p_cli, "processed %u, room temperature suppressed %u\n", p_unit->frame_count,
+              p_unit->room_filter.suppressed);
+    cli_print(p_cli, "timing periods %u late %u restarts %u overruns %u\n", p_timing->period.samples,
+              p_timing->late, p_timing->restarts, p_timing->overruns);
+    cli_print(p_cli, "commands pending 0x%x active 0x%x applied %u failed %u retries %u latency max %u frames\n",
+              p_cmd->pending, p_cmd->active, p_cmd->stats.applied, p_cmd->stats.failed, p_cmd->stats.retries,
+              p_cmd->stats.latency_max);
+
+    return true;
+}
+
+static bool cmd_hist(mhi_cli_t *p_cli, size_t argc, char **argv)
+{
+    const mhi_timing_t *p_timing = &p_cli->p_units[p_cli->unit].timing;
+    const mhi_timing_hist_t *p_hist;
+
+    if (argc < 2)
+    {
+        p_hist = &p_timing->period;
+    }
+    else if (word_equal(argv[1], "period"))
+    {
+        p_hist = &p_timing->period;
+    }
+    else if (word_equal(argv[1], "xfer"))
+    {
+        p_hist = &p_timing->xfer;
+    }
+    else if (word_equal(argv[1], "gap"))
+    {
+        p_hist = &p_timing->gap;
+    }
+    else
+    {
+        cli_print(p_cli, "unknown histogram %s\n", argv[1]);
+        return false;
+    }
+
+    cli_print(p_cli, "samples %u min %u max %u mean %u stddev %u p1 %u p50 %u p99 %u us\n", p_hist->samples,
+              p_hist->min, p_hist->max, mhi_timing_hist_mean(p_hist), mhi_timing_hist_stddev(p_hist),
+              mhi_timing_hist_percentile(p_hist, 10), mhi_timing_hist_percentile(p_hist, 500),
+              mhi_timing_hist_percentile(p_hist, 990));
+    for (uint32_t bucket = 0; bucket < MHI_TIMING_BUCKETS; bucket++)
+    {
+        uint32_t high = bucket + 1 < MHI_TIMING_BUCKETS ? mhi_timing_bucket_low(bucket + 1) - 1 : MHI_TIMING_MAX_US;
+
+        if (p_hist->count[bucket] != 0)
+        {
+            cli_print(p_cli, "%7u - %7u us %5u\n", mhi_timing_bucket_low(bucket), high, p_hist->count[bucket]);
+        }
+    }
+
+    return true;
+}
+
+static bool cmd_opdata(mhi_cli_t *p_cli, size_t argc, char **argv)
+{
+    const mhi_unit_t *p_unit = &p_cli->p_units[p_cli->unit];
+    const mhi_opdata_poller_t *p_poller = &p_unit->opdata;
+    const mhi_opdata_error_t *p_error = &p_poller->error;
+
+    (void)argc;
+    (void)argv;
+
+    for (uint32_t i = 0; i < MHI_OPDATA_COUNT; i++)
+    {
+        if (p_poller->valid & (1UL << i))
+        {
+            cli_print(p_cli, "0x%02x %s: %u, %u frames ago\n", mhi_opdata_code((mhi_opdata_t)i), m_opdata_names[i],
+                      p_poller->value[i], p_unit->frame_count - p_poller->updated[i]);
+        }
+        else
+        {
+            cli_print(p_cli, "0x%02x %s: none\n", mhi_opdata_code((mhi_opdata_t)i), m_opdata_names[i]);
+        }
+    }
+
+    if (p_poller->error_state != MHI_OPDATA_ERROR_IDLE)
+    {
+        cli_print(p_cli, "error snapshot fetch running, %u frames to receive\n", p_poller->error_remaining);
+    }
+    if (p_error->code == 0)
+    {
+        return true;
+    }
+    cli_print(p_cli, "error %u snapshot, fetched in %u frames\n", p_error->code, p_error->frames);
+    for (uint32_t i = 0; i < MHI_OPDATA_COUNT; i++)
+    {
+        if (p_error->valid & (1UL << i))
+        {
+            cli_print(p_cli, "  %s: %u\n", m_opdata_names[i], p_error->value[i]);
+        }
+    }
+
+    return true;
+}
+
+static bool cmd_cmd(mhi_cli_t *p_cli, size_t argc, char **argv)
+{
+    uint32_t field = MHI_FIELD_COUNT;
+    uint32_t value;
+
+    if (argc != 3)
+    {
+        cli_print(p_cli, "usage: cmd field value\n");
+        return false;
+    }
+
+    for (uint32_t i = 0; i < MHI_FIELD_COUNT; i++)
+    {
+        if (word_equal(argv[1], m_field_names[i]))
+        {
+            field = i;
+        }
+    }
+    if ((field == MHI_FIELD_COUNT && !arg_uint(argv[1], &field)) || field >= MHI_FIELD_COUNT)
+    {
+        cli_print(p_cli, "unknown field %s\n", argv[1]);
+        return false;
+    }
+    if (!arg_uint(argv[2], &value) || value > UINT8_MAX ||
+        !mhi_unit_request(&p_cli->p_units[p_cli->unit], (mhi_field_t)field, (uint8_t)value))
+    {
+        cli_print(p_cli, "%s is read only or %s out of range\n", m_field_names[field], argv[2]);
+        return false;
+    }
+
+    cli_print(p_cli, "%s = %u sent with the next frame\n", m_field_names[field], value);
+
+    return true;
+}
+
+static bool cmd_rx(mhi_cli_t *p_cli, size_t argc, char **argv)
+{
+    mhi_unit_t *p_unit = &p_cli->p_units[p_cli->unit];
+    uint8_t frame[MHI_FRAME_SIZE_EXT];
+    size_t len = 0;
+    size_t digits = 0;
+    bool raw = argc > 1 && word_equal(argv[1], "raw");
+    mhi_frame_status_t status;
+
+    /* The bytes may be split over several arguments */
+    for (size_t i = raw ? 2 : 1; i < argc; i++)
+    {
+        for (const char *p_c = argv[i]; *p_c != '\0'; p_c++)
+        {
+            int digit = hex_digit(*p_c);
+
+            if (digit < 0 || len == sizeof(frame))
+            {
+                cli_print(p_cli, "a frame is up to %u bytes in hex\n", (unsigned)sizeof(frame));
+                return false;
+            }
+            frame[len] = (uint8_t)(digits % 2 ? (frame[len] << 4) | digit : digit);
+            len += digits++ % 2;
+        }
+    }
+    if (len == 0 || digits % 2)
+    {
+        cli_print(p_cli, "usage: rx [raw] hex\n");
+        return false;
+    }
+
+    if (!raw && (len == MHI_FRAME_SIZE || len == MHI_FRAME_SIZE_EXT))
+    {
+        mhi_frame_set_checksum(frame, len);
+    }
+
+    /* The SPIS interrupt is the other producer of the link */
+    CRITICAL_REGION_ENTER();
+    status = mhi_link_rx_push(&p_unit->link, frame, len, app_timer_cnt_get());
+    CRITICAL_REGION_EXIT();
+
+    cli_print(p_cli, "%u bytes injected, %s\n", (unsigned)len, m_status_names[status]);
+
+    return true;
+}
+
+void mhi_cli_init(mhi_cli_t *p_cli, mhi_unit_t *p_units, uint8_t unit_count, mhi_cli_print_t print,
+                  void *p_context)
+{
+    memset(p_cli, 0, sizeof(*p_cli));
+    p_cli->p_units = p_units;
+    p_cli->unit_count = unit_count;
+    p_cli->print = print;
+    p_cli->p_context = p_context;
+}
+
+bool mhi_cli_exec(mhi_cli_t *p_cli, size_t argc, char **argv)
+{
+    if (argc == 0)
+    {
+        return true;
+    }
+
+    for (size_t i = 0; i < sizeof(m_commands) / sizeof(m_commands[0]); i++)
+    {
+        if (strcmp(argv[0], m_commands[i].p_name) == 0)
+        {
+            return m_commands[i].handler(p_cli, argc, argv);
+        }
+    }
+
+    cli_print(p_cli, "unknown command %s, try help\n", argv[0]);
+
+    return false;
+}
+
+bool mhi_cli_exec_line(mhi_cli_t *p_cli, char *p_line)
+{
+    char *argv[MHI_CLI_ARGS_MAX];
+    size_t argc = 0;
+
+    while (*p_line != '\0')
+    {
+        if (*p_line == ' ' || *p_line == '\t' || *p_line == '\r' || *p_line == '\n')
+        {
+            *p_line++ = '\0';
+            continue;
+        }
+        if (argc == MHI_CLI_ARGS_MAX)
+        {
+            cli_print(p_cli, "more than %u arguments\n", MHI_CLI_ARGS_MAX);
+            return false;
+        }
+
+        argv[argc++] = p_line;
+        while (*p_line != '\0' && *p_line != ' ' && *p_line != '\t' && *p_line != '\r' && *p_line != '\n')
+        {
+            p_line++;
+        }
+    }
+
+    return mhi_cli_exec(p_cli, argc, argv);
+}
@@ -0,0 +1,157 @@
+/**
+ * @file mhi_cmd.c
+ * @brief Commands to the AC and TX frame construction
+ */
+
+#include <string.h>
+
+#include "include/mhi_cmd.h"
+#include "include/mhi_frame.h"
+
+/* Read only fields have no set bit, they are refused and never encoded */
+#define FIELD_RANGE(name, byte, mask, shift, offset, set_byte, set_bit, min, max)         \
+    case MHI_FIELD_##name:                                                                \
+        valid = (set_bit) != 0 && (uint32_t)(value - (min)) <= (uint32_t)((max) - (min)); \
+        break;
+
+#define FIELD_ENCODE(name, byte, mask, shift, offset, set_byte, set_bit, ...)                \
+    if ((set_bit) && (sent & MHI_FIELD_BIT(MHI_FIELD_##name)))                               \
+    {                                                                                        \
+        p_frame[byte] |= MHI_FIELD_PUT(p_cmd->value[MHI_FIELD_##name], mask, shift, offset); \
+        p_frame[set_byte] |= (set_bit);                                                      \
+    }
+
+void mhi_cmd_init(mhi_cmd_t *p_cmd)
+{
+    memset(p_cmd, 0, sizeof(*p_cmd));
+    p_cmd->room_temp = MHI_TX_ROOM_TEMP_NONE;
+}
+
+bool mhi_cmd_request(mhi_cmd_t *p_cmd, mhi_field_t field, uint8_t value)
+{
+    bool valid;
+
+    switch (field)
+    {
+        MHI_FIELDS(FIELD_RANGE)
+    default:
+        valid = false;
+        break;
+    }
+
+    if (!valid || (p_cmd->unsupported & MHI_FIELD_BIT(field)))
+    {
+        return false;
+    }
+
+    p_cmd->value[field] = value;
+    p_cmd->pending |= MHI_FIELD_BIT(field);
+    p_cmd->active |= MHI_FIELD_BIT(field);
+    p_cmd->track[field].asserted = true;
+    p_cmd->track[field].attempt = 1;
+    p_cmd->track[field].countdown = MHI_CMD_HOLD_FRAMES;
+    p_cmd->track[field].frames = 0;
+
+    return true;
+}
+
+uint32_t mhi_cmd_build(const mhi_cmd_t *p_cmd, uint8_t *p_frame, uint32_t frame_count)
+{
+    uint32_t sent = p_cmd->pending;
+
+    memset(p_frame, 0, MHI_FRAME_SIZE_EXT);
+    p_frame[MHI_SB0] = MHI_TX_SB0;
+    p_frame[MHI_SB1] = MHI_TX_SB1;
+    p_frame[MHI_SB2] = MHI_TX_SB2;
+    p_frame[MHI_DB3] = p_cmd->room_temp;
+
+    if ((frame_count / MHI_TX_DB14_TOGGLE_FRAMES) & 1)
+    {
+        p_frame[MHI_DB14] |= 0x04;
+    }
+
+    MHI_FIELDS(FIELD_ENCODE)
+
+    return sent;
+}
+
+uint32_t mhi_cmd_on_rx(mhi_cmd_t *p_cmd, const mhi_state_t *p_state, uint32_t *p_failed)
+{
+    uint32_t applied = 0;
+    uint32_t failed = 0;
+
+    for (uint32_t field = 0; p_cmd->active >> field; field++)
+    {
+        mhi_cmd_track_t *p_track = &p_cmd->track[field];
+        uint32_t bit = MHI_FIELD_BIT(field);
+
+        if (!(p_cmd->active & bit))
+        {
+            continue;
+        }
+
+        if (p_track->frames < UINT16_MAX)
+        {
+            p_track->frames++;
+        }
+
+        if (p_state->value[field] == p_cmd->value[field])
+        {
+            applied |= bit;
+            p_cmd->latency[field] = p_track->frames;
+            p_cmd->stats.applied++;
+            p_cmd->stats.latency_sum += p_track->frames;
+            if (p_track->frames > p_cmd->stats.latency_max)
+            {
+                p_cmd->stats.latency_max = p_track->frames;
+            }
+            continue;
+        }
+
+        if (--p_track->countdown)
+        {
+            continue;
+        }
+
+        if (!p_track->asserted)
+        {
+            /* Backoff over, send it again */
+            p_track->asserted = true;
+            p_track->attempt++;
+            p_track->countdown = MHI_CMD_HOLD_FRAMES;
+            p_cmd->pending |= bit;
+            p_cmd->stats.retries++;
+        }
+        else if (p_track->attempt > MHI_CMD_RETRIES)
+        {
+            failed |= bit;
+            p_cmd->stats.failed++;
+        }
+        else
+        {
+            p_track->asserted = false;
+            p_track->countdown = (uint16_t)(MHI_CMD_BACKOFF_FRAMES << (p_track->attempt - 1));
+            p_cmd->pending &= ~bit;
+        }
+    }
+
+    p_cmd->active &= ~(applied | failed);
+    p_cmd->pending &= ~(applied | failed);
+    *p_failed = failed;
+
+    return applied;
+}
+
+uint32_t mhi_cmd_cancel(mhi_cmd_t *p_cmd)
+{
+    uint32_t active = p_cmd->active;
+
+    for (uint32_t fields = active; fields; fields &= fields - 1)
+    {
+        p_cmd->stats.failed++;
+    }
+    p_cmd->active = 0;
+    p_cmd->pending = 0;
+
+    return active;
+}
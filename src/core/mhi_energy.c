@@ -0,0 +1,188 @@
+/**
+ * @file mhi_energy.c
+ * @brief Energy used by one MHI indoor unit, integrated from its current
+ */
+
+#include <string.h>
+
+#include "include/mhi_energy.h"
+
+#define U48_MAX 0xFFFFFFFFFFFFULL /* Largest saved total */
+
+static uint64_t get_u48(const uint8_t *p)
+{
+    uint64_t value = 0;
+
+    for (uint32_t i = 6; i-- > 0;)
+    {
+        value = (value << 8) | p[i];
+    }
+
+    return value;
+}
+
+static uint8_t *put_u48(uint8_t *p, uint64_t value)
+{
+    value = value > U48_MAX ? U48_MAX : value;
+    for (uint32_t i = 0; i < 6; i++)
+    {
+        p[i] = (uint8_t)(value >> (8 * i));
+    }
+
+    return p + 6;
+}
+
+void mhi_energy_init(mhi_energy_t *p_energy, uint16_t voltage)
+{
+    memset(p_energy, 0, sizeof(*p_energy));
+    p_energy->voltage = voltage;
+}
+
+bool mhi_energy_current(mhi_energy_t *p_energy, uint8_t current_raw, uint32_t ticks)
+{
+    uint64_t total = p_energy->total_wh;
+    uint32_t elapsed;
+
+    if (p_energy->sampled)
+    {
+        elapsed = app_timer_cnt_diff_compute(ticks, p_energy->sample_ticks);
+        if (elapsed <= APP_TIMER_TICKS(MHI_ENERGY_MAX_GAP_MS))
+        {
+            p_energy->frac += (uint64_t)(p_energy->current_raw + current_raw) * elapsed * MHI_ENERGY_CURRENT_NUM *
+                              p_energy->voltage;
+            total += p_energy->frac / MHI_ENERGY_FRAC_DEN;
+            p_energy->frac %= MHI_ENERGY_FRAC_DEN;
+            p_energy->save_ticks += elapsed;
+        }
+    }
+    p_energy->sampled = true;
+    p_energy->current_raw = current_raw;
+    p_energy->sample_ticks = ticks;
+
+    /* Between two counter steps the integration may not run ahead by more than a step */
+    if (p_energy->counter_known && total > p_energy->counter_wh + MHI_ENERGY_COUNTER_WH)
+    {
+        total = p_energy->counter_wh + MHI_ENERGY_COUNTER_WH;
+        total = total < p_energy->total_wh ? p_energy->total_wh : total;
+        p_energy->frac = 0;
+    }
+
+    if (total == p_energy->total_wh)
+    {
+        return false;
+    }
+    p_energy->total_wh = total;
+
+    return true;
+}
+
+bool mhi_energy_counter(mhi_energy_t *p_energy, uint16_t counter)
+{
+    uint16_t steps = (uint16_t)(counter - p_energy->counter);
+
+    if (p_energy->counter_known && steps == 0)
+    {
+        return false;
+    }
+    p_energy->counter = counter;
+
+    if (!p_energy->counter_known || steps > MHI_ENERGY_COUNTER_MAX_STEPS)
+    {
+        /* First reading, or the counter was reset: count on from the current total */
+        p_energy->counter_known = true;
+        p_energy->counter_wh = p_energy->total_wh;
+        return false;
+    }
+
+    p_energy->counter_wh += (uint64_t)steps * MHI_ENERGY_COUNTER_WH;
+    if (p_energy->total_wh >= p_energy->counter_wh)
+    {
+        return false;
+    }
+
+    /* The integration fell behind the counter */
+    p_energy->total_wh = p_energy->counter_wh;
+    p_energy->frac = 0;
+
+    return true;
+}
+
+void mhi_energy_restart(mhi_energy_t *p_energy)
+{
+    p_energy->sampled = false;
+}
+
+uint32_t mhi_energy_power(const mhi_energy_t *p_energy)
+{
+    if (!p_energy->sampled)
+    {
+        return 0;
+    }
+
+    return (uint32_t)p_energy->current_raw * MHI_ENERGY_CURRENT_NUM * p_energy->voltage / MHI_ENERGY_CURRENT_DEN;
+}
+
+bool mhi_energy_save_due(const mhi_energy_t *p_energy)
+{
+    if (p_energy->total_wh == p_energy->saved_wh || p_energy->save_ticks < APP_TIMER_TICKS(MHI_ENERGY_SAVE_MIN_MS))
+    {
+        return false;
+    }
+
+    return p_energy->total_wh - p_energy->saved_wh >= MHI_ENERGY_SAVE_WH ||
+           p_energy->save_ticks >= APP_TIMER_TICKS(MHI_ENERGY_SAVE_MAX_MS);
+}
+
+size_t mhi_energy_save(mhi_energy_t *const *pp_energy, uint8_t count, uint8_t *p_buf)
+{
+    uint8_t *p = p_buf;
+
+    *p++ = MHI_ENERGY_SAVE_VERSION;
+    *p++ = count;
+
+    for (uint32_t unit = 0; unit < count; unit++)
+    {
+        mhi_energy_t *p_energy = pp_energy[unit];
+
+        p = put_u48(p, p_energy->total_wh);
+        p = put_u48(p, p_energy->counter_wh);
+        *p++ = (uint8_t)p_energy->counter;
+        *p++ = (uint8_t)(p_energy->counter >> 8);
+        *p++ = p_energy->counter_known;
+        p_energy->saved_wh = p_energy->total_wh;
+        p_energy->save_ticks = 0;
+    }
+    while ((size_t)(p - p_buf) % MHI_ENERGY_SAVE_ALIGN != 0)
+    {
+        *p++ = 0;
+    }
+
+    return (size_t)(p - p_buf);
+}
+
+bool mhi_energy_load(mhi_energy_t *const *pp_energy, uint8_t count, const uint8_t *p_buf, size_t len)
+{
+    const uint8_t *p = p_buf + 2;
+
+    if (len < (size_t)(2 + count * MHI_ENERGY_RECORD_SIZE) || p_buf[0] != MHI_ENERGY_SAVE_VERSION ||
+        p_buf[1] != count)
+    {
+        return false;
+    }
+
+    for (uint32_t unit = 0; unit < count; unit++)
+    {
+        mhi_energy_t *p_energy = pp_energy[unit];
+
+        p_energy->total_wh = get_u48(&p[0]);
+        p_energy->counter_wh = get_u48(&p[6]);
+        p_energy->counter = (uint16_t)(p[12] | (p[13] << 8));
+        p_energy->counter_known = p[14] != 0;
+        p_energy->frac = 0;
+        p_energy->saved_wh = p_energy->total_wh;
+        p_energy->save_ticks = 0;
+        p += MHI_ENERGY_RECORD_SIZE;
+    }
+
+    return true;
+}
@@ -0,0 +1,89 @@
+/**
+ * @file mhi_filter.c
+ * @brief Noise filter for raw MHI sensor values
+ */
+
+#include <string.h>
+
+#include "include/mhi_filter.h"
+
+/**
+ * @brief Median of the samples in the window, by insertion sort of a copy.
+ */
+static uint8_t median(const mhi_filter_t *p_filter)
+{
+    uint8_t sorted[MHI_FILTER_WINDOW_MAX];
+
+    for (uint8_t i = 0; i < p_filter->window; i++)
+    {
+        uint8_t sample = p_filter->samples[i];
+        uint8_t j = i;
+
+        while (j > 0 && sorted[j - 1] > sample)
+        {
+            sorted[j] = sorted[j - 1];
+            j--;
+        }
+        sorted[j] = sample;
+    }
+
+    return sorted[p_filter->window / 2];
+}
+
+void mhi_filter_init(mhi_filter_t *p_filter, uint8_t window, uint8_t band)
+{
+    memset(p_filter, 0, sizeof(*p_filter));
+
+    if (window > MHI_FILTER_WINDOW_MAX)
+    {
+        window = MHI_FILTER_WINDOW_MAX;
+    }
+    else if (window == 0)
+    {
+        window = 1;
+    }
+    else if ((window & 1) == 0)
+    {
+        window--;
+    }
+    p_filter->window = window;
+    p_filter->band = band;
+}
+
+uint8_t mhi_filter_update(mhi_filter_t *p_filter, uint8_t sample)
+{
+    uint8_t value;
+
+    if (!p_filter->primed)
+    {
+        memset(p_filter->samples, sample, p_filter->window);
+        p_filter->primed = 1;
+        p_filter->input = sample;
+        p_filter->output = sample;
+        return sample;
+    }
+
+    /* Replacing a sample by an equal one leaves the median, and so the output, unchanged */
+    if (p_filter->samples[p_filter->index] == sample)
+    {
+        value = p_filter->output;
+    }
+    else
+    {
+        p_filter->samples[p_filter->index] = sample;
+        value = p_filter->window > 1 ? median(p_filter) : sample;
+    }
+    p_filter->index = (uint8_t)(p_filter->index + 1 == p_filter->window ? 0 : p_filter->index + 1);
+
+    if (value > p_filter->output + p_filter->band || value + p_filter->band < p_filter->output)
+    {
+        p_filter->output = value;
+    }
+    else if (sample != p_filter->input)
+    {
+        p_filter->suppressed++;
+    }
+    p_filter->input = sample;
+
+    return p_filter->output;
+}
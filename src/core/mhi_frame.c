@@ -0,0 +1,102 @@
+/**
+ * @file mhi_frame.c
+ * @brief MHI SPI frame validation
+ */
+
+#include "include/mhi_frame.h"
+#include "include/mhi_simd.h"
+
+/** @brief Mask of the data bytes (DB0-DB14 and DB15-DB26) within a frame. */
+#define DATA_BYTES_MASK                                                          \
+    ((((1ULL << (MHI_DB14 + 1)) - 1) & ~((1ULL << MHI_DB0) - 1)) |              \
+     (((1ULL << (MHI_DB26 + 1)) - 1) & ~((1ULL << MHI_DB15) - 1)))
+
+MHI_RAMFUNC uint16_t mhi_frame_sum(const uint8_t *p_data, size_t len)
+{
+    uint32_t sum = 0;
+    size_t i = 0;
+
+    for (; i + 4 <= len; i += 4)
+    {
+        sum = mhi_simd_sum4(mhi_simd_load(&p_data[i]), sum);
+    }
+    for (; i < len; i++)
+    {
+        sum += p_data[i];
+    }
+
+    return (uint16_t)sum;
+}
+
+MHI_RAMFUNC mhi_frame_status_t mhi_frame_validate(const uint8_t *p_frame, size_t len)
+{
+    uint16_t sum;
+
+    if (len < MHI_FRAME_SIZE)
+    {
+        return MHI_FRAME_ERR_LENGTH;
+    }
+
+    if ((p_frame[MHI_SB0] != MHI_RX_SB0 && p_frame[MHI_SB0] != MHI_RX_SB0_EXT) ||
+        p_frame[MHI_SB1] != MHI_RX_SB1 ||
+        p_frame[MHI_SB2] != MHI_RX_SB2)
+    {
+        return MHI_FRAME_ERR_SIGNATURE;
+    }
+
+    sum = mhi_frame_sum(p_frame, MHI_CBH);
+    if (p_frame[MHI_CBH] != (uint8_t)(sum >> 8) || p_frame[MHI_CBL] != (uint8_t)sum)
+    {
+        return MHI_FRAME_ERR_CHECKSUM;
+    }
+
+    if (p_frame[MHI_SB0] == MHI_RX_SB0_EXT)
+    {
+        if (len < MHI_FRAME_SIZE_EXT)
+        {
+            return MHI_FRAME_ERR_LENGTH;
+        }
+
+        sum += p_frame[MHI_CBH] + p_frame[MHI_CBL] + mhi_frame_sum(&p_frame[MHI_DB15], MHI_CBL2 - MHI_DB15);
+        if (p_frame[MHI_CBL2] != (uint8_t)sum)
+        {
+            return MHI_FRAME_ERR_CHECKSUM;
+        }
+    }
+
+    return MHI_FRAME_OK;
+}
+
+void mhi_frame_set_checksum(uint8_t *p_frame, size_t len)
+{
+    uint16_t sum = mhi_frame_sum(p_frame, MHI_CBH);
+
+    p_frame[MHI_CBH] = (uint8_t)(sum >> 8);
+    p_frame[MHI_CBL] = (uint8_t)sum;
+
+    if (len >= MHI_FRAME_SIZE_EXT)
+    {
+        sum += p_frame[MHI_CBH] + p_frame[MHI_CBL] + mhi_frame_sum(&p_frame[MHI_DB15], MHI_CBL2 - MHI_DB15);
+        p_frame[MHI_CBL2] = (uint8_t)sum;
+    }
+}
+
+uint64_t mhi_frame_diff(const uint8_t *p_old, const uint8_t *p_new, size_t len)
+{
+    uint64_t diff = 0;
+    size_t i = 0;
+
+    for (; i + 4 <= len; i += 4)
+    {
+        diff |= (uint64_t)mhi_simd_nonzero4(mhi_simd_load(&p_old[i]) ^ mhi_simd_load(&p_new[i])) << i;
+    }
+    for (; i < len; i++)
+    {
+        if (p_old[i] != p_new[i])
+        {
+            diff |= 1ULL << i;
+        }
+    }
+
+    return diff & DATA_BYTES_MASK;
+}
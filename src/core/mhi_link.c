@@ -0,0 +1,118 @@
+/**
+ * @file mhi_link.c
+ * @brief SPI link between the SPIS interrupt and the main loop
+ */
+
+#include <string.h>
+
+#include "include/mhi_link.h"
+
+#if (MHI_LINK_RING_SIZE & (MHI_LINK_RING_SIZE - 1)) != 0
+#error MHI_LINK_RING_SIZE must be a power of 2
+#endif
+
+/* Counters are read by the main loop while the interrupt updates them */
+#define STAT_INC(p_link, counter) ((void)__atomic_fetch_add(&(p_link)->stats.counter, 1, __ATOMIC_RELAXED))
+#define STAT_ADD(p_link, counter, n) ((void)__atomic_fetch_add(&(p_link)->stats.counter, (n), __ATOMIC_RELAXED))
+
+/**
+ * @brief Count the frames missing since the previous transfer.
+ */
+static void gap_check(mhi_link_t *p_link, uint32_t ticks)
+{
+    uint32_t interval = p_link->interval_ticks;
+    uint32_t gap = (ticks - p_link->last_xfer_ticks) & MHI_LINK_TICKS_MASK;
+
+    if (interval && p_link->timed && gap > interval + interval / 2)
+    {
+        STAT_ADD(p_link, missing, (gap + interval / 2) / interval - 1);
+    }
+
+    p_link->last_xfer_ticks = ticks;
+    p_link->timed = true;
+}
+
+void mhi_link_init(mhi_link_t *p_link)
+{
+    memset(p_link, 0, sizeof(*p_link));
+}
+
+MHI_RAMFUNC mhi_frame_status_t mhi_link_rx_push(mhi_link_t *p_link, const uint8_t *p_rx, size_t rx_len, uint32_t ticks)
+{
+    mhi_frame_status_t status = mhi_frame_validate(p_rx, rx_len);
+    uint32_t head = p_link->rx_head;
+    mhi_link_frame_t *p_frame;
+
+    gap_check(p_link, ticks);
+
+    switch (status)
+    {
+    case MHI_FRAME_OK:
+        break;
+    case MHI_FRAME_ERR_LENGTH:
+        STAT_INC(p_link, length_errors);
+        p_link->in_error = true;
+        return status;
+    case MHI_FRAME_ERR_SIGNATURE:
+        STAT_INC(p_link, signature_errors);
+        p_link->in_error = true;
+        return status;
+    default:
+        STAT_INC(p_link, checksum_errors);
+        p_link->in_error = true;
+        return status;
+    }
+
+    STAT_INC(p_link, frames);
+    if (p_link->in_error)
+    {
+        STAT_INC(p_link, resyncs);
+        p_link->in_error = false;
+    }
+
+    if (head - p_link->rx_tail >= MHI_LINK_RING_SIZE)
+    {
+        STAT_INC(p_link, overruns);
+        return status;
+    }
+
+    p_frame = &p_link->rx[head & (MHI_LINK_RING_SIZE - 1)];
+    p_frame->len = (uint8_t)(p_rx[MHI_SB0] == MHI_RX_SB0_EXT ? MHI_FRAME_SIZE_EXT : MHI_FRAME_SIZE);
+    memcpy(p_frame->data, p_rx, p_frame->len);
+    p_link->rx_head = head + 1;
+
+    return status;
+}
+
+MHI_RAMFUNC void mhi_link_tx_get(mhi_link_t *p_link, uint8_t *p_tx)
+{
+    memcpy(p_tx, p_link->tx[p_link->tx_active], MHI_FRAME_SIZE_EXT);
+    p_link->tx_taken = p_link->tx_taken + 1;
+}
+
+const mhi_link_frame_t *mhi_link_rx_peek(mhi_link_t *p_link)
+{
+    uint32_t tail = p_link->rx_tail;
+
+    if (tail == p_link->rx_head)
+    {
+        return NULL;
+    }
+
+    return &p_link->rx[tail & (MHI_LINK_RING_SIZE - 1)];
+}
+
+void mhi_link_rx_pop(mhi_link_t *p_link)
+{
+    p_link->rx_tail = p_link->rx_tail + 1;
+}
+
+uint8_t *mhi_link_tx_stage(mhi_link_t *p_link)
+{
+    return p_link->tx[p_link->tx_active ^ 1];
+}
+
+void mhi_link_tx_commit(mhi_link_t *p_link)
+{
+    p_link->tx_active ^= 1;
+}
@@ -0,0 +1,129 @@
+/**
+ * @file mhi_log.c
+ * @brief Binary log ring buffer
+ *
+ * Writers (thread and interrupt context) reserve and fill a complete frame inside a critical
+ * region, so frames never interleave. The single reader (the log transport in the main loop)
+ * claims contiguous blocks and releases them once sent, so the transport can DMA straight out
+ * of the ring.
+ */
+
+#include <stdbool.h>
+#include <string.h>
+
+#include "app_util_platform.h"
+
+#include "include/mhi_log.h"
+
+#if MHI_LOG_BINARY_ENABLED
+
+#if (MHI_LOG_BUFSIZE & (MHI_LOG_BUFSIZE - 1)) != 0
+#error MHI_LOG_BUFSIZE must be a power of 2
+#endif
+
+/* Section bounds, provided by the linker */
+extern const char __start_mhi_log_fmt[];
+
+static uint8_t m_ring[MHI_LOG_BUFSIZE];
+static volatile uint32_t m_head; /* Write index, free running */
+static volatile uint32_t m_tail; /* Read index, free running */
+static uint32_t m_dropped;       /* Frames dropped since boot */
+static uint32_t m_dropped_sent;  /* Dropped count last reported in the stream */
+
+/**
+ * @brief Copy bytes into the ring at the given free running index, wrapping when needed.
+ */
+static void ring_put(uint32_t index, const void *p_data, size_t len)
+{
+    uint32_t offset = index & (MHI_LOG_BUFSIZE - 1);
+    size_t first = MHI_LOG_BUFSIZE - offset;
+
+    if (first >= len)
+    {
+        memcpy(&m_ring[offset], p_data, len);
+    }
+    else
+    {
+        memcpy(&m_ring[offset], p_data, first);
+        memcpy(&m_ring[0], (const uint8_t *)p_data + first, len - first);
+    }
+}
+
+/**
+ * @brief Reserve and write a complete frame. Must be called within a critical region.
+ * @return false when the frame does not fit
+ */
+static bool frame_put(uint16_t id, const void *p_payload, uint8_t len)
+{
+    uint32_t head = m_head;
+    uint8_t header[MHI_LOG_HEADER_SIZE] = {MHI_LOG_SYNC, (uint8_t)id, (uint8_t)(id >> 8), len};
+
+    if (MHI_LOG_BUFSIZE - (head - m_tail) < (uint32_t)(MHI_LOG_HEADER_SIZE + len))
+    {
+        return false;
+    }
+
+    ring_put(head, header, sizeof(header));
+    ring_put(head + MHI_LOG_HEADER_SIZE, p_payload, len);
+    m_head = head + MHI_LOG_HEADER_SIZE + len;
+
+    return true;
+}
+
+/**
+ * @brief Write a frame, preceded by a dropped-frames report when frames were lost since the
+ * last report.
+ */
+static void frame_write(const char *p_fmt, const void *p_payload, uint8_t len)
+{
+    uint16_t id = (uint16_t)(p_fmt - __start_mhi_log_fmt);
+
+    CRITICAL_REGION_ENTER();
+    if (m_dropped != m_dropped_sent)
+    {
+        uint32_t dropped = m_dropped;
+        if (frame_put(MHI_LOG_ID_DROPPED, &dropped, sizeof(dropped)))
+        {
+            m_dropped_sent = dropped;
+        }
+    }
+    if (!frame_put(id, p_payload, len))
+    {
+        m_dropped++;
+    }
+    CRITICAL_REGION_EXIT();
+}
+
+void mhi_log_write(const char *p_fmt, const uint32_t *p_args, uint8_t nargs)
+{
+    frame_write(p_fmt, p_args, (uint8_t)(nargs * sizeof(uint32_t)));
+}
+
+void mhi_log_write_raw(const char *p_fmt, const void *p_data, size_t len)
+{
+    frame_write(p_fmt, p_data, (uint8_t)(len > MHI_LOG_MAX_PAYLOAD ? MHI_LOG_MAX_PAYLOAD : len));
+}
+
+size_t mhi_log_claim(const uint8_t **pp_data)
+{
+    uint32_t tail = m_tail;
+    uint32_t used = m_head - tail;
+    uint32_t offset = tail & (MHI_LOG_BUFSIZE - 1);
+    uint32_t contiguous = MHI_LOG_BUFSIZE - offset;
+
+    *pp_data = &m_ring[offset];
+
+    return used < contiguous ? used : contiguous;
+}
+
+void mhi_log_release(size_t len)
+{
+    m_tail += len;
+}
+
+uint32_t mhi_log_dropped(void)
+{
+    return m_dropped;
+}
+
+#endif /* MHI_LOG_BINARY_ENABLED */
@@ -0,0 +1,192 @@
+/**
+ * @file mhi_opdata.c
+ * @brief MHI operating data polling
+ */
+
+#include <string.h>
+
+#include "include/mhi_frame.h"
+#include "include/mhi_opdata.h"
+
+#define OPDATA_REQUEST 0x80      /* DB6 bit requesting opdata */
+#define ERROR_CODE 0x45          /* Opdata code of the error snapshot */
+#define ERROR_NUMBER 0x11        /* DB10 of the error number answer */
+#define ERROR_COUNT 0x12         /* DB10 of the snapshot frame count answer */
+#define ERROR_EXTRA_FRAMES 4     /* Snapshot frames sent beyond the announced count */
+
+/* MHI opdata codes, indexed by mhi_opdata_t */
+static const uint8_t m_codes[MHI_OPDATA_COUNT] = {
+    [MHI_OPDATA_RETURN_AIR_TEMP] = 0x80,
+    [MHI_OPDATA_OUTDOOR_TEMP] = 0x11,
+    [MHI_OPDATA_HEAT_EXCH_TEMP] = 0x81,
+    [MHI_OPDATA_CURRENT] = 0x90,
+    [MHI_OPDATA_COMP_FREQ] = 0x1F,
+    [MHI_OPDATA_ENERGY] = 0x94,
+};
+
+void mhi_opdata_init(mhi_opdata_poller_t *p_poller)
+{
+    memset(p_poller, 0, sizeof(*p_poller));
+    p_poller->hold = MHI_OPDATA_HOLD_FRAMES;
+}
+
+void mhi_opdata_build(const mhi_opdata_poller_t *p_poller, uint8_t *p_frame)
+{
+    p_frame[MHI_DB6] |= OPDATA_REQUEST;
+    p_frame[MHI_DB9] = p_poller->error_slot ? ERROR_CODE : m_codes[p_poller->index];
+}
+
+/**
+ * @brief Opdata of an opdata code, MHI_OPDATA_COUNT for unknown codes.
+ */
+static mhi_opdata_t opdata_find(uint8_t code)
+{
+    for (uint32_t opdata = 0; opdata < MHI_OPDATA_COUNT; opdata++)
+    {
+        if (m_codes[opdata] == code)
+        {
+            return (mhi_opdata_t)opdata;
+        }
+    }
+
+    return MHI_OPDATA_COUNT;
+}
+
+/**
+ * @brief Value of an opdata answer.
+ */
+static uint32_t opdata_value(mhi_opdata_t opdata, const uint8_t *p_frame)
+{
+    uint32_t value = p_frame[MHI_DB10];
+
+    if (opdata == MHI_OPDATA_ENERGY)
+    {
+        value |= (uint32_t)p_frame[MHI_DB11] << 8;
+    }
+
+    return value;
+}
+
+/**
+ * @brief Finish the error snapshot fetch.
+ */
+static void error_done(mhi_opdata_poller_t *p_poller, uint32_t frame_count)
+{
+    uint32_t frames = frame_count - p_poller->error_start;
+
+    p_poller->error.frames = frames > UINT16_MAX ? UINT16_MAX : (uint16_t)frames;
+    p_poller->error_state = MHI_OPDATA_ERROR_IDLE;
+    p_poller->error_slot = false;
+    p_poller->error_fetched = true;
+}
+
+/**
+ * @brief Process a frame of the error snapshot fetch.
+ * @param answers_error The frame answers the error snapshot request
+ * @return true when the frame belongs to the snapshot and holds no regular answer
+ */
+static bool error_on_rx(mhi_opdata_poller_t *p_poller, const uint8_t *p_frame, uint32_t frame_count,
+                        bool answers_error)
+{
+    bool consumed = false;
+    bool done = frame_count - p_poller->error_start >= MHI_OPDATA_ERROR_TIMEOUT_FRAMES;
+    mhi_opdata_t opdata;
+
+    if (p_poller->error_state == MHI_OPDATA_ERROR_RECEIVING)
+    {
+        /* A regular answer still in flight from before the snapshot is not part of it */
+        if (answers_error)
+        {
+            opdata = opdata_find(p_frame[MHI_DB9]);
+            if (opdata != MHI_OPDATA_COUNT)
+            {
+                p_poller->error.value[opdata] = opdata_value(opdata, p_frame);
+                p_poller->error.valid |= 1UL << opdata;
+            }
+            done |= --p_poller->error_remaining == 0;
+            consumed = true;
+        }
+    }
+    else if (p_frame[MHI_DB9] == ERROR_CODE)
+    {
+        if (p_frame[MHI_DB10] == ERROR_NUMBER)
+        {
+            p_poller->error.code = p_frame[MHI_DB11];
+        }
+        else if (p_frame[MHI_DB10] == ERROR_COUNT)
+        {
+            /* Only the frames answering the error request count, the regular polling goes on */
+            p_poller->error_remaining = (uint8_t)(p_frame[MHI_DB11] + ERROR_EXTRA_FRAMES);
+            p_poller->error_state = MHI_OPDATA_ERROR_RECEIVING;
+        }
+        consumed = true;
+    }
+
+    /* Not every unit keeps a snapshot, on timeout publish what there is */
+    if (done)
+    {
+        error_done(p_poller, frame_count);
+    }
+
+    return consumed;
+}
+
+mhi_opdata_t mhi_opdata_on_rx(mhi_opdata_poller_t *p_poller, const uint8_t *p_frame, uint32_t frame_count)
+{
+    /* The frame answers the request of the TX frame sent before the one it came with */
+    bool answers_error = (p_poller->error_sent & 0x02) != 0;
+    mhi_opdata_t opdata;
+
+    p_poller->error_sent = (uint8_t)(p_poller->error_sent << 1 | p_poller->error_slot);
+
+    if (--p_poller->hold == 0)
+    {
+        p_poller->hold = MHI_OPDATA_HOLD_FRAMES;
+
+        /* The error request takes the slot after every regular one while a fetch runs */
+        if (p_poller->error_state != MHI_OPDATA_ERROR_IDLE && !p_poller->error_slot)
+        {
+            p_poller->error_slot = true;
+        }
+        else
+        {
+            p_poller->error_slot = false;
+            p_poller->index = (p_poller->index + 1) % MHI_OPDATA_COUNT;
+        }
+    }
+
+    if (p_poller->error_state != MHI_OPDATA_ERROR_IDLE &&
+        error_on_rx(p_poller, p_frame, frame_count, answers_error))
+    {
+        return MHI_OPDATA_COUNT;
+    }
+
+    opdata = opdata_find(p_frame[MHI_DB9]);
+    if (opdata == MHI_OPDATA_COUNT)
+    {
+        return MHI_OPDATA_COUNT;
+    }
+
+    p_poller->value[opdata] = opdata_value(opdata, p_frame);
+    p_poller->updated[opdata] = frame_count;
+    p_poller->valid |= 1UL << opdata;
+
+    return opdata;
+}
+
+void mhi_opdata_error_fetch(mhi_opdata_poller_t *p_poller, uint32_t frame_count)
+{
+    if (p_poller->error_state != MHI_OPDATA_ERROR_IDLE)
+    {
+        return;
+    }
+
+    memset(&p_poller->error, 0, sizeof(p_poller->error));
+    p_poller->error_state = MHI_OPDATA_ERROR_REQUESTING;
+    p_poller->error_start = frame_count;
+}
+
+uint8_t mhi_opdata_code(mhi_opdata_t opdata)
+{
+    return m_codes[opdata];
+}
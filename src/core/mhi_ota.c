@@ -0,0 +1,297 @@
+/**
+ * @file mhi_ota.c
+ * @brief Zigbee OTA Upgrade image pipeline
+ */
+
+#include <string.h>
+
+#include "include/mhi_log.h"
+#include "include/mhi_ota.h"
+
+#define HEADER_LENGTH_OFFSET 6
+#define MANUFACTURER_OFFSET 10
+#define IMAGE_TYPE_OFFSET 12
+#define FILE_VERSION_OFFSET 14
+#define FILE_SIZE_OFFSET 52
+#define READ_BACK_SIZE 64 /* Bytes read back at once during verification */
+
+/* CRC-32 lookup table, one nibble at a time */
+static const uint32_t m_crc_table[16] = {
+    0x00000000, 0x1DB71064, 0x3B6E20C8, 0x26D930AC, 0x76DC4190, 0x6B6B51F4, 0x4DB26158, 0x5005713C,
+    0xEDB88320, 0xF00F9344, 0xD6D6A3E8, 0xCB61B38C, 0x9B64C2B0, 0x86D3D2D4, 0xA00AE278, 0xBDBDF21C,
+};
+
+static uint16_t get_u16(const uint8_t *p)
+{
+    return (uint16_t)(p[0] | (p[1] << 8));
+}
+
+static uint32_t get_u32(const uint8_t *p)
+{
+    return (uint32_t)p[0] | ((uint32_t)p[1] << 8) | ((uint32_t)p[2] << 16) | ((uint32_t)p[3] << 24);
+}
+
+static mhi_ota_status_t fail(mhi_ota_t *p_ota, mhi_ota_status_t status)
+{
+    if (p_ota->status == MHI_OTA_OK)
+    {
+        MHI_LOG_WARNING("OTA failed at offset %d: %d", p_ota->file_offset, status);
+        p_ota->status = status;
+    }
+
+    return status;
+}
+
+uint32_t mhi_ota_crc32(uint32_t crc, const uint8_t *p_data, uint32_t len)
+{
+    crc = ~crc;
+    for (uint32_t i = 0; i < len; i++)
+    {
+        crc ^= p_data[i];
+        crc = (crc >> 4) ^ m_crc_table[crc & 0x0F];
+        crc = (crc >> 4) ^ m_crc_table[crc & 0x0F];
+    }
+
+    return ~crc;
+}
+
+/**
+ * @brief Write the chunk to the slot, erasing pages as they are entered.
+ */
+static mhi_ota_status_t chunk_flush(mhi_ota_t *p_ota)
+{
+    const mhi_ota_flash_t *p_flash = p_ota->p_flash;
+    uint32_t len = (p_ota->chunk_len + 3) & ~3UL;
+
+    if (p_ota->chunk_len == 0)
+    {
+        return MHI_OTA_OK;
+    }
+
+    memset(&p_ota->chunk[p_ota->chunk_len], 0xFF, len - p_ota->chunk_len);
+
+    if (p_ota->written % p_flash->page_size == 0 && !p_flash->p_erase(p_ota->written))
+    {
+        return fail(p_ota, MHI_OTA_ERR_FLASH);
+    }
+    if (!p_flash->p_write(p_ota->written, p_ota->chunk, len))
+    {
+        return fail(p_ota, MHI_OTA_ERR_FLASH);
+    }
+
+    p_ota->written += p_ota->chunk_len;
+    p_ota->chunk_len = 0;
+
+    return MHI_OTA_OK;
+}
+
+/**
+ * @brief Parse the collected OTA header.
+ */
+static mhi_ota_status_t header_parse(mhi_ota_t *p_ota)
+{
+    uint16_t header_len = get_u16(&p_ota->field[HEADER_LENGTH_OFFSET]);
+
+    if (get_u32(p_ota->field) != MHI_OTA_FILE_ID || header_len < MHI_OTA_HEADER_SIZE)
+    {
+        return fail(p_ota, MHI_OTA_ERR_HEADER);
+    }
+
+    p_ota->header.manufacturer = get_u16(&p_ota->field[MANUFACTURER_OFFSET]);
+    p_ota->header.image_type = get_u16(&p_ota->field[IMAGE_TYPE_OFFSET]);
+    p_ota->header.file_version = get_u32(&p_ota->field[FILE_VERSION_OFFSET]);
+    if (get_u32(&p_ota->field[FILE_SIZE_OFFSET]) != p_ota->header.file_size)
+    {
+        return fail(p_ota, MHI_OTA_ERR_SIZE);
+    }
+
+    p_ota->header_done = true;
+    p_ota->skip = header_len - MHI_OTA_HEADER_SIZE;
+
+    return MHI_OTA_OK;
+}
+
+/**
+ * @brief Start a sub-element from its collected header.
+ */
+static mhi_ota_status_t element_start(mhi_ota_t *p_ota)
+{
+    p_ota->element_tag = get_u16(p_ota->field);
+    p_ota->element_left = get_u32(&p_ota->field[2]);
+
+    switch (p_ota->element_tag)
+    {
+    case MHI_OTA_TAG_UPGRADE_IMAGE:
+        if (p_ota->image_size != 0 || p_ota->element_left > p_ota->p_flash->slot_size)
+        {
+            return fail(p_ota, MHI_OTA_ERR_SIZE);
+        }
+        p_ota->image_size = p_ota->element_left;
+        break;
+    case MHI_OTA_TAG_CRC:
+        if (p_ota->element_left != sizeof(uint32_t))
+        {
+            return fail(p_ota, MHI_OTA_ERR_HEADER);
+        }
+        break;
+    default:
+        /* Unknown sub-elements are skipped */
+        p_ota->skip = p_ota->element_left;
+        p_ota->element_left = 0;
+        break;
+    }
+
+    return MHI_OTA_OK;
+}
+
+/**
+ * @brief Consume sub-element data.
+ * @return Number of bytes consumed
+ */
+static uint32_t element_data(mhi_ota_t *p_ota, const uint8_t *p_data, uint32_t len)
+{
+    uint32_t take = len < p_ota->element_left ? len : p_ota->element_left;
+
+    if (p_ota->element_tag == MHI_OTA_TAG_UPGRADE_IMAGE)
+    {
+        uint32_t room = MHI_OTA_WRITE_SIZE - p_ota->chunk_len;
+
+        take = take < room ? take : room;
+        memcpy(&p_ota->chunk[p_ota->chunk_len], p_data, take);
+        p_ota->chunk_len += take;
+        p_ota->image_crc = mhi_ota_crc32(p_ota->image_crc, p_data, take);
+
+        if (p_ota->chunk_len == MHI_OTA_WRITE_SIZE || take == p_ota->element_left)
+        {
+            (void)chunk_flush(p_ota);
+        }
+    }
+    else
+    {
+        memcpy(&p_ota->field[p_ota->field_len], p_data, take);
+        p_ota->field_len += take;
+        if (take == p_ota->element_left)
+        {
+            p_ota->expected_crc = get_u32(p_ota->field);
+            p_ota->has_crc = true;
+            p_ota->field_len = 0;
+        }
+    }
+
+    p_ota->element_left -= take;
+
+    return take;
+}
+
+mhi_ota_status_t mhi_ota_start(mhi_ota_t *p_ota, const mhi_ota_flash_t *p_flash, uint32_t file_size)
+{
+    memset(p_ota, 0, sizeof(*p_ota));
+    p_ota->p_flash = p_flash;
+    p_ota->header.file_size = file_size;
+    p_ota->started = true;
+
+    if (file_size < MHI_OTA_HEADER_SIZE || file_size > p_flash->slot_size + MHI_OTA_HEADER_SIZE + 1024)
+    {
+        return fail(p_ota, MHI_OTA_ERR_SIZE);
+    }
+
+    MHI_LOG_INFO("OTA start, %d bytes", file_size);
+
+    return MHI_OTA_OK;
+}
+
+mhi_ota_status_t mhi_ota_block(mhi_ota_t *p_ota, uint32_t file_offset, const uint8_t *p_data, uint32_t len)
+{
+    if (!p_ota->started || p_ota->status != MHI_OTA_OK)
+    {
+        return MHI_OTA_ERR_STATE;
+    }
+    if (file_offset != p_ota->file_offset)
+    {
+        /* Not fatal, the client requests the block again */
+        return MHI_OTA_ERR_OFFSET;
+    }
+    if (file_offset + len > p_ota->header.file_size)
+    {
+        return fail(p_ota, MHI_OTA_ERR_SIZE);
+    }
+
+    p_ota->file_offset += len;
+
+    while (len > 0 && p_ota->status == MHI_OTA_OK)
+    {
+        uint32_t take;
+
+        if (p_ota->skip)
+        {
+            take = len < p_ota->skip ? len : p_ota->skip;
+            p_ota->skip -= take;
+        }
+        else if (p_ota->element_left)
+        {
+            take = element_data(p_ota, p_data, len);
+        }
+        else
+        {
+            /* Collect the OTA header, or the header of the next sub-element */
+            uint32_t need = p_ota->header_done ? MHI_OTA_ELEMENT_HEADER_SIZE : MHI_OTA_HEADER_SIZE;
+
+            take = need - p_ota->field_len;
+            take = len < take ? len : take;
+            memcpy(&p_ota->field[p_ota->field_len], p_data, take);
+            p_ota->field_len += take;
+
+            if (p_ota->field_len == need)
+            {
+                p_ota->field_len = 0;
+                (void)(p_ota->header_done ? element_start(p_ota) : header_parse(p_ota));
+            }
+        }
+
+        p_data += take;
+        len -= take;
+    }
+
+    return p_ota->status;
+}
+
+mhi_ota_status_t mhi_ota_verify(mhi_ota_t *p_ota)
+{
+    uint8_t buf[READ_BACK_SIZE];
+    uint32_t crc = 0;
+
+    if (!p_ota->started || p_ota->status != MHI_OTA_OK)
+    {
+        return MHI_OTA_ERR_STATE;
+    }
+    if (p_ota->file_offset != p_ota->header.file_size || p_ota->element_left || p_ota->skip ||
+        p_ota->image_size == 0 || p_ota->written != p_ota->image_size)
+    {
+        return fail(p_ota, MHI_OTA_ERR_SIZE);
+    }
+
+    for (uint32_t offset = 0; offset < p_ota->image_size; offset += sizeof(buf))
+    {
+        uint32_t len = p_ota->image_size - offset < sizeof(buf) ? p_ota->image_size - offset : sizeof(buf);
+
+        if (!p_ota->p_flash->p_read(offset, buf, len))
+        {
+            return fail(p_ota, MHI_OTA_ERR_FLASH);
+        }
+        crc = mhi_ota_crc32(crc, buf, len);
+    }
+
+    if (crc != p_ota->image_crc || (p_ota->has_crc && crc != p_ota->expected_crc))
+    {
+        return fail(p_ota, MHI_OTA_ERR_CRC);
+    }
+
+    MHI_LOG_INFO("OTA image verified, %d bytes", p_ota->image_size);
+
+    return MHI_OTA_OK;
+}
+
+void mhi_ota_abort(mhi_ota_t *p_ota)
+{
+    p_ota->started = false;
+}
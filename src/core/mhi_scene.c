@@ -0,0 +1,427 @@
+/**
+ * @file mhi_scene.c
+ * @brief Scenes of one MHI indoor unit: table, ZCL Scenes commands and NVRAM layout
+ */
+
+#include <string.h>
+
+#include "include/mhi_log.h"
+#include "include/mhi_scene.h"
+#include "include/mhi_zcl.h"
+
+#define SCENE_CAPACITY_UNKNOWN 0xFF /* Get Scene Membership capacity when it cannot be told */
+
+/* Bits of a field value, from its mask */
+#define MASK_WIDTH(mask) \
+    ((mask) > 0x3F ? 7 : (mask) > 0x1F ? 6 : (mask) > 0x0F ? 5 : (mask) > 0x07 ? 4 : (mask) > 0x03 ? 3 : (mask) > 0x01 ? 2 : 1)
+
+/* Writable fields are packed in table order, read only fields take no bits */
+#define SCENE_FIELD(name, byte, mask, shift, offset, set_byte, set_bit, min, max) \
+    {MHI_FIELD_##name, (set_bit) ? MASK_WIDTH(mask) : 0, offset, min, max},
+#define SCENE_FIELD_BITS(name, byte, mask, shift, offset, set_byte, set_bit, ...) +((set_bit) ? MASK_WIDTH(mask) : 0)
+
+typedef char scene_bits_check_t[(0 MHI_FIELDS(SCENE_FIELD_BITS)) <= MHI_SCENE_PACKED_SIZE * 8 ? 1 : -1];
+
+static const struct
+{
+    uint8_t field;
+    uint8_t width;
+    uint8_t offset;
+    uint8_t min;
+    uint8_t max;
+} m_fields[] = {MHI_FIELDS(SCENE_FIELD)};
+
+static uint16_t get_u16(const uint8_t *p)
+{
+    return (uint16_t)(p[0] | (p[1] << 8));
+}
+
+static uint8_t *put_u16(uint8_t *p, uint16_t value)
+{
+    p[0] = (uint8_t)value;
+    p[1] = (uint8_t)(value >> 8);
+
+    return p + 2;
+}
+
+void mhi_scene_table_init(mhi_scene_table_t *p_table)
+{
+    memset(p_table, 0, sizeof(*p_table));
+}
+
+void mhi_scene_pack(const mhi_state_t *p_state, uint8_t *p_packed)
+{
+    uint32_t bits = 0;
+    uint32_t pos = 0;
+
+    for (uint32_t i = 0; i < MHI_FIELD_COUNT; i++)
+    {
+        uint32_t value = (uint8_t)(p_state->value[m_fields[i].field] - m_fields[i].offset);
+
+        bits |= (value & ((1UL << m_fields[i].width) - 1)) << pos;
+        pos += m_fields[i].width;
+    }
+
+    for (uint32_t i = 0; i < MHI_SCENE_PACKED_SIZE; i++)
+    {
+        p_packed[i] = (uint8_t)(bits >> (8 * i));
+    }
+}
+
+void mhi_scene_unpack(const uint8_t *p_packed, mhi_state_t *p_state)
+{
+    uint32_t bits = 0;
+
+    for (uint32_t i = 0; i < MHI_SCENE_PACKED_SIZE; i++)
+    {
+        bits |= (uint32_t)p_packed[i] << (8 * i);
+    }
+
+    memset(p_state, 0, sizeof(*p_state));
+    for (uint32_t i = 0; i < MHI_FIELD_COUNT; i++)
+    {
+        if (m_fields[i].width)
+        {
+            uint8_t value = (uint8_t)((bits & ((1UL << m_fields[i].width) - 1)) + m_fields[i].offset);
+
+            /* A field the AC did not report (0, like the left/right vanes of standard frames)
+             * packs to a value above its range */
+            p_state->value[m_fields[i].field] = value <= m_fields[i].max ? value : 0;
+            bits >>= m_fields[i].width;
+        }
+    }
+}
+
+mhi_scene_t *mhi_scene_find(mhi_scene_table_t *p_table, uint16_t group_id, uint8_t scene_id)
+{
+    for (uint32_t i = 0; i < p_table->count; i++)
+    {
+        if (p_table->scene[i].group_id == group_id && p_table->scene[i].scene_id == scene_id)
+        {
+            return &p_table->scene[i];
+        }
+    }
+
+    return NULL;
+}
+
+bool mhi_scene_store(mhi_scene_table_t *p_table, uint16_t group_id, uint8_t scene_id, const mhi_state_t *p_state)
+{
+    mhi_scene_t *p_scene = mhi_scene_find(p_table, group_id, scene_id);
+
+    if (p_scene == NULL)
+    {
+        if (p_table->count >= MHI_SCENE_MAX)
+        {
+            return false;
+        }
+        p_scene = &p_table->scene[p_table->count++];
+        p_scene->group_id = group_id;
+        p_scene->scene_id = scene_id;
+    }
+
+    mhi_scene_pack(p_state, p_scene->packed);
+    p_table->dirty = true;
+
+    return true;
+}
+
+/**
+ * @brief Remove the scene at the given index, the last scene takes its place.
+ */
+static void scene_remove_at(mhi_scene_table_t *p_table, uint32_t index)
+{
+    p_table->scene[index] = p_table->scene[--p_table->count];
+    p_table->dirty = true;
+}
+
+void mhi_scene_remove_group(mhi_scene_table_t *p_table, uint16_t group_id)
+{
+    bool all = group_id == MHI_SCENE_GROUP_ALL;
+
+    for (uint32_t i = p_table->count; i-- > 0;)
+    {
+        if (p_table->scene[i].group_id == group_id || (all && p_table->scene[i].group_id != 0))
+        {
+            scene_remove_at(p_table, i);
+        }
+    }
+    if (p_table->current_group == group_id || (all && p_table->current_group != 0))
+    {
+        p_table->valid = false;
+    }
+}
+
+uint32_t mhi_scene_recall(const mhi_scene_t *p_scene, const mhi_state_t *p_state, mhi_cmd_t *p_cmd)
+{
+    uint32_t requested = 0;
+    mhi_state_t scene;
+
+    mhi_scene_unpack(p_scene->packed, &scene);
+
+    for (uint32_t i = 0; i < MHI_FIELD_COUNT; i++)
+    {
+        uint8_t field = m_fields[i].field;
+        uint8_t value = scene.value[field];
+
+        if (m_fields[i].width && value != p_state->value[field] &&
+            value >= m_fields[i].min && value <= m_fields[i].max &&
+            mhi_cmd_request(p_cmd, (mhi_field_t)field, value))
+        {
+            requested |= MHI_FIELD_BIT(field);
+        }
+    }
+
+    return requested;
+}
+
+/**
+ * @brief Start a response with its status, group and, unless it is a Remove All Scenes
+ * response, scene.
+ */
+static void resp_init(mhi_scene_resp_t *p_resp, zb_uint8_t status, const uint8_t *p_req, bool with_scene)
+{
+    p_resp->status = status;
+    p_resp->specific = true;
+    p_resp->data[0] = status;
+    memcpy(&p_resp->data[1], p_req, with_scene ? 3 : 2);
+    p_resp->len = with_scene ? 4 : 3;
+}
+
+bool mhi_scene_command(mhi_scene_table_t *p_table, const mhi_state_t *p_state, mhi_cmd_t *p_cmd, zb_uint8_t cmd_id,
+                       const uint8_t *p_req, size_t req_len, bool in_group, mhi_scene_resp_t *p_resp)
+{
+    /* Every Scenes command starts with the group, all but Remove All Scenes and Get Scene
+     * Membership with the scene next */
+    bool with_scene = cmd_id != ZB_ZCL_CMD_SCENES_REMOVE_ALL_SCENES && cmd_id != ZB_ZCL_CMD_SCENES_GET_SCENE_MEMBERSHIP;
+    uint16_t group_id;
+    uint8_t scene_id;
+    mhi_scene_t *p_scene;
+    mhi_state_t state;
+
+    if (cmd_id > ZB_ZCL_CMD_SCENES_GET_SCENE_MEMBERSHIP)
+    {
+        return false;
+    }
+
+    memset(p_resp, 0, sizeof(*p_resp));
+    if (req_len < (with_scene ? 3U : 2U))
+    {
+        p_resp->status = ZB_ZCL_STATUS_MALFORMED_CMD;
+        return true;
+    }
+    group_id = get_u16(p_req);
+    scene_id = with_scene ? p_req[2] : 0;
+    p_scene = mhi_scene_find(p_table, group_id, scene_id);
+
+    switch (cmd_id)
+    {
+    case ZB_ZCL_CMD_SCENES_ADD_SCENE:
+        /* Transition time and name come before the extension field sets */
+        state = *p_state;
+        if (!in_group || req_len < 6 || 6U + p_req[5] > req_len ||
+            !mhi_zcl_scene_ext_parse(&state, &p_req[6 + p_req[5]], req_len - 6 - p_req[5]))
+        {
+            resp_init(p_resp, ZB_ZCL_STATUS_INVALID_FIELD, p_req, true);
+        }
+        else if (!mhi_scene_store(p_table, group_id, scene_id, &state))
+        {
+            resp_init(p_resp, ZB_ZCL_STATUS_INSUFF_SPACE, p_req, true);
+        }
+        else
+        {
+            resp_init(p_resp, ZB_ZCL_STATUS_SUCCESS, p_req, true);
+        }
+        break;
+
+    case ZB_ZCL_CMD_SCENES_VIEW_SCENE:
+        if (!in_group || p_scene == NULL)
+        {
+            resp_init(p_resp, in_group ? ZB_ZCL_STATUS_NOT_FOUND : ZB_ZCL_STATUS_INVALID_FIELD, p_req, true);
+            break;
+        }
+        resp_init(p_resp, ZB_ZCL_STATUS_SUCCESS, p_req, true);
+        /* No transition time, empty name */
+        p_resp->data[p_resp->len++] = 0;
+        p_resp->data[p_resp->len++] = 0;
+        p_resp->data[p_resp->len++] = 0;
+        mhi_scene_unpack(p_scene->packed, &state);
+        p_resp->len += mhi_zcl_scene_ext_build(&state, &p_resp->data[p_resp->len]);
+        break;
+
+    case ZB_ZCL_CMD_SCENES_REMOVE_SCENE:
+        if (!in_group || p_scene == NULL)
+        {
+            resp_init(p_resp, in_group ? ZB_ZCL_STATUS_NOT_FOUND : ZB_ZCL_STATUS_INVALID_FIELD, p_req, true);
+            break;
+        }
+        scene_remove_at(p_table, (uint32_t)(p_scene - p_table->scene));
+        if (p_table->current_group == group_id && p_table->current_scene == scene_id)
+        {
+            p_table->valid = false;
+        }
+        resp_init(p_resp, ZB_ZCL_STATUS_SUCCESS, p_req, true);
+        break;
+
+    case ZB_ZCL_CMD_SCENES_REMOVE_ALL_SCENES:
+        if (!in_group)
+        {
+            resp_init(p_resp, ZB_ZCL_STATUS_INVALID_FIELD, p_req, false);
+            break;
+        }
+        mhi_scene_remove_group(p_table, group_id);
+        resp_init(p_resp, ZB_ZCL_STATUS_SUCCESS, p_req, false);
+        break;
+
+    case ZB_ZCL_CMD_SCENES_STORE_SCENE:
+        if (!in_group)
+        {
+            resp_init(p_resp, ZB_ZCL_STATUS_INVALID_FIELD, p_req, true);
+        }
+        else if (!mhi_scene_store(p_table, group_id, scene_id, p_state))
+        {
+            resp_init(p_resp, ZB_ZCL_STATUS_INSUFF_SPACE, p_req, true);
+        }
+        else
+        {
+            p_table->current_group = group_id;
+            p_table->current_scene = scene_id;
+            p_table->valid = true;
+            resp_init(p_resp, ZB_ZCL_STATUS_SUCCESS, p_req, true);
+        }
+        break;
+
+    case ZB_ZCL_CMD_SCENES_RECALL_SCENE:
+        /* Answered with a default response */
+        if (!in_group || p_scene == NULL)
+        {
+            p_resp->status = in_group ? ZB_ZCL_STATUS_NOT_FOUND : ZB_ZCL_STATUS_INVALID_FIELD;
+            break;
+        }
+        MHI_LOG_INFO("Recall scene %d of group 0x%04x", scene_id, group_id);
+        (void)mhi_scene_recall(p_scene, p_state, p_cmd);
+        p_table->current_group = group_id;
+        p_table->current_scene = scene_id;
+        p_table->valid = true;
+        p_resp->status = ZB_ZCL_STATUS_SUCCESS;
+        break;
+
+    default: /* ZB_ZCL_CMD_SCENES_GET_SCENE_MEMBERSHIP */
+    {
+        uint8_t capacity = MHI_SCENE_MAX - p_table->count;
+
+        p_resp->status = in_group ? ZB_ZCL_STATUS_SUCCESS : ZB_ZCL_STATUS_INVALID_FIELD;
+        p_resp->specific = true;
+        p_resp->data[0] = p_resp->status;
+        p_resp->data[1] = capacity < SCENE_CAPACITY_UNKNOWN ? capacity : SCENE_CAPACITY_UNKNOWN - 1;
+        (void)put_u16(&p_resp->data[2], group_id);
+        p_resp->len = 4;
+        if (in_group)
+        {
+            uint8_t *p_count = &p_resp->data[p_resp->len++];
+
+            *p_count = 0;
+            for (uint32_t i = 0; i < p_table->count; i++)
+            {
+                if (p_table->scene[i].group_id == group_id)
+                {
+                    p_resp->data[p_resp->len++] = p_table->scene[i].scene_id;
+                    (*p_count)++;
+                }
+            }
+        }
+        break;
+    }
+    }
+
+    return true;
+}
+
+size_t mhi_scene_save_size(mhi_scene_table_t *const *pp_tables, uint8_t count)
+{
+    size_t len = 2;
+
+    for (uint32_t unit = 0; unit < count; unit++)
+    {
+        len += 1 + pp_tables[unit]->count * (size_t)MHI_SCENE_RECORD_SIZE;
+    }
+
+    return (len + MHI_SCENE_SAVE_ALIGN - 1) / MHI_SCENE_SAVE_ALIGN * MHI_SCENE_SAVE_ALIGN;
+}
+
+size_t mhi_scene_save(mhi_scene_table_t *const *pp_tables, uint8_t count, uint8_t *p_buf)
+{
+    uint8_t *p = p_buf;
+
+    *p++ = MHI_SCENE_SAVE_VERSION;
+    *p++ = count;
+
+    for (uint32_t unit = 0; unit < count; unit++)
+    {
+        mhi_scene_table_t *p_table = pp_tables[unit];
+
+        *p++ = p_table->count;
+        for (uint32_t i = 0; i < p_table->count; i++)
+        {
+            p = put_u16(p, p_table->scene[i].group_id);
+            *p++ = p_table->scene[i].scene_id;
+            memcpy(p, p_table->scene[i].packed, MHI_SCENE_PACKED_SIZE);
+            p += MHI_SCENE_PACKED_SIZE;
+        }
+        p_table->dirty = false;
+    }
+    while ((size_t)(p - p_buf) % MHI_SCENE_SAVE_ALIGN != 0)
+    {
+        *p++ = 0;
+    }
+
+    return (size_t)(p - p_buf);
+}
+
+bool mhi_scene_load(mhi_scene_table_t *const *pp_tables, uint8_t count, const uint8_t *p_buf, size_t len)
+{
+    const uint8_t *p_end = p_buf + len;
+    const uint8_t *p = p_buf;
+
+    for (uint32_t unit = 0; unit < count; unit++)
+    {
+        mhi_scene_table_init(pp_tables[unit]);
+    }
+
+    if (len < 2 || p[0] != MHI_SCENE_SAVE_VERSION || p[1] != count)
+    {
+        return false;
+    }
+    p += 2;
+
+    for (uint32_t unit = 0; unit < count; unit++)
+    {
+        mhi_scene_table_t *p_table = pp_tables[unit];
+
+        if (p >= p_end || *p > MHI_SCENE_MAX || (size_t)(p_end - p - 1) < *p * (size_t)MHI_SCENE_RECORD_SIZE)
+        {
+            break;
+        }
+        p_table->count = *p++;
+        for (uint32_t i = 0; i < p_table->count; i++)
+        {
+            p_table->scene[i].group_id = get_u16(p);
+            p_table->scene[i].scene_id = p[2];
+            memcpy(p_table->scene[i].packed, &p[3], MHI_SCENE_PACKED_SIZE);
+            p += MHI_SCENE_RECORD_SIZE;
+        }
+
+        /* Only the padding may follow the last table */
+        if (unit + 1 == count && (size_t)(p_end - p) < MHI_SCENE_SAVE_ALIGN)
+        {
+            return true;
+        }
+    }
+
+    for (uint32_t unit = 0; unit < count; unit++)
+    {
+        mhi_scene_table_init(pp_tables[unit]);
+    }
+
+    return false;
+}
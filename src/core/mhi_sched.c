@@ -0,0 +1,171 @@
+/**
+ * @file mhi_sched.c
+ * @brief Background work in the idle gaps between the SPI frames
+ */
+
+#include <string.h>
+
+#include "include/mhi_sched.h"
+
+#define PERIOD_MIN_Q4 (APP_TIMER_TICKS(MHI_SCHED_PERIOD_MIN_MS) << 4)
+#define PERIOD_MAX_Q4 (APP_TIMER_TICKS(MHI_SCHED_PERIOD_MAX_MS) << 4)
+
+void mhi_sched_init(mhi_sched_t *p_sched, uint8_t units)
+{
+    memset(p_sched, 0, sizeof(*p_sched));
+    p_sched->unit_count = units < MHI_SCHED_UNITS_MAX ? units : MHI_SCHED_UNITS_MAX;
+
+    for (uint32_t i = 0; i < MHI_SCHED_UNITS_MAX; i++)
+    {
+        p_sched->unit[i].xfer_ticks = MHI_SCHED_US_TO_TICKS(MHI_SCHED_XFER_US);
+    }
+}
+
+MHI_RAMFUNC void mhi_sched_on_xfer(mhi_sched_t *p_sched, uint8_t unit, uint32_t ticks)
+{
+    mhi_sched_cadence_t *p_cadence;
+    uint32_t period;
+    uint32_t interval;
+
+    if (unit >= p_sched->unit_count)
+    {
+        return;
+    }
+    p_cadence = &p_sched->unit[unit];
+    period = p_cadence->period_q4;
+
+    if (p_cadence->xfers != 0)
+    {
+        interval = app_timer_cnt_diff_compute(ticks, p_cadence->last_ticks) << 4;
+
+        if (period != 0 && interval >= period - period / 4 && interval <= period + period / 4)
+        {
+            /* Follow the clock of the AC */
+            period = (uint32_t)((int32_t)period + ((int32_t)interval - (int32_t)period) / 8);
+        }
+        else if (interval >= PERIOD_MIN_Q4 && interval <= PERIOD_MAX_Q4 && (period == 0 || interval < period))
+        {
+            /* First interval, or the first one spanned a missed frame */
+            period = interval;
+        }
+        p_cadence->period_q4 = period;
+    }
+
+    p_cadence->last_ticks = ticks;
+    p_cadence->xfers = p_cadence->xfers + 1;
+}
+
+void mhi_sched_xfer_set(mhi_sched_t *p_sched, uint8_t unit, uint32_t xfer_us)
+{
+    if (unit < p_sched->unit_count)
+    {
+        p_sched->unit[unit].xfer_ticks = MHI_SCHED_US_TO_TICKS(xfer_us ? xfer_us : MHI_SCHED_XFER_US);
+    }
+}
+
+bool mhi_sched_submit(mhi_sched_t *p_sched, mhi_sched_step_t p_step, void *p_context, uint32_t step_us)
+{
+    mhi_sched_job_t *p_job;
+
+    for (uint32_t i = 0; i < p_sched->job_count; i++)
+    {
+        if (p_sched->jobs[i].p_step == p_step && p_sched->jobs[i].p_context == p_context)
+        {
+            return true;
+        }
+    }
+    if (p_sched->job_count == MHI_SCHED_JOBS_MAX)
+    {
+        return false;
+    }
+
+    p_job = &p_sched->jobs[p_sched->job_count++];
+    p_job->p_step = p_step;
+    p_job->p_context = p_context;
+    p_job->step_ticks = MHI_SCHED_US_TO_TICKS(step_us);
+
+    return true;
+}
+
+void mhi_sched_cancel(mhi_sched_t *p_sched, mhi_sched_step_t p_step, void *p_context)
+{
+    for (uint32_t i = 0; i < p_sched->job_count; i++)
+    {
+        if (p_sched->jobs[i].p_step == p_step && p_sched->jobs[i].p_context == p_context)
+        {
+            p_sched->job_count--;
+            memmove(&p_sched->jobs[i], &p_sched->jobs[i + 1], (p_sched->job_count - i) * sizeof(p_sched->jobs[0]));
+            return;
+        }
+    }
+}
+
+uint32_t mhi_sched_budget(const mhi_sched_t *p_sched, uint32_t now_ticks)
+{
+    uint32_t budget = UINT32_MAX;
+    uint32_t guard = MHI_SCHED_US_TO_TICKS(MHI_SCHED_GUARD_US);
+
+    for (uint32_t i = 0; i < p_sched->unit_count; i++)
+    {
+        const mhi_sched_cadence_t *p_cadence = &p_sched->unit[i];
+        uint32_t period = p_cadence->period_q4 >> 4;
+        uint32_t since;
+        uint32_t until_xfer;
+
+        if (period == 0)
+        {
+            continue;
+        }
+        since = app_timer_cnt_diff_compute(now_ticks, p_cadence->last_ticks);
+        if (since > MHI_SCHED_STALE_PERIODS * period)
+        {
+            continue;
+        }
+
+        /* Missed frames keep the cadence, the next transfer ends a whole number of periods on */
+        until_xfer = period - since % period;
+        if (until_xfer <= p_cadence->xfer_ticks + guard)
+        {
+            return 0;
+        }
+        if (until_xfer - p_cadence->xfer_ticks - guard < budget)
+        {
+            budget = until_xfer - p_cadence->xfer_ticks - guard;
+        }
+    }
+
+    return budget;
+}
+
+void mhi_sched_run(mhi_sched_t *p_sched)
+{
+    uint32_t start = app_timer_cnt_get();
+    uint32_t slice = APP_TIMER_TICKS(MHI_SCHED_SLICE_MS);
+    bool ran = true;
+
+    while (ran)
+    {
+        ran = false;
+
+        for (uint32_t i = 0; i < p_sched->job_count; i++)
+        {
+            mhi_sched_job_t job = p_sched->jobs[i];
+            uint32_t now = app_timer_cnt_get();
+            uint32_t elapsed = app_timer_cnt_diff_compute(now, start);
+
+            /* Within the gap, and without keeping the main loop from the Zigbee stack */
+            if (mhi_sched_budget(p_sched, now) < job.step_ticks || elapsed + job.step_ticks > slice)
+            {
+                continue;
+            }
+
+            p_sched->steps++;
+            ran = true;
+            if (job.p_step(job.p_context))
+            {
+                mhi_sched_cancel(p_sched, job.p_step, job.p_context);
+                i--;
+            }
+        }
+    }
+}
@@ -0,0 +1,34 @@
+/**
+ * @file mhi_state.c
+ * @brief Decoding of the AC state from RX frames
+ */
+
+#include "include/mhi_frame.h"
+#include "include/mhi_state.h"
+
+/* The byte test is constant, it only costs a length compare for the extended fields */
+#define FIELD_DECODE(name, byte, mask, shift, offset, ...)                                      \
+    p_state->value[MHI_FIELD_##name] = ((byte) <= MHI_DB14 || len >= MHI_FRAME_SIZE_EXT)         \
+                                           ? MHI_FIELD_GET(p_frame, byte, mask, shift, offset) \
+                                           : 0;
+
+void mhi_state_decode(const uint8_t *p_frame, size_t len, mhi_state_t *p_state)
+{
+    MHI_FIELDS(FIELD_DECODE)
+}
+
+uint32_t mhi_state_diff(const mhi_state_t *p_old, const mhi_state_t *p_new)
+{
+    uint32_t changed = 0;
+
+    /* Values are all one byte wide, a loop over the table compiles smaller than an unrolled compare */
+    for (uint32_t field = 0; field < MHI_FIELD_COUNT; field++)
+    {
+        if (p_old->value[field] != p_new->value[field])
+        {
+            changed |= MHI_FIELD_BIT(field);
+        }
+    }
+
+    return changed;
+}
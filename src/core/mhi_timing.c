@@ -0,0 +1,253 @@
+/**
+ * @file mhi_timing.c
+ * @brief Timing of the SPI frames of the AC: period, transfer duration and gap
+ */
+
+#include <string.h>
+
+#include "include/mhi_log.h"
+#include "include/mhi_timing.h"
+
+#if (MHI_TIMING_RING_SIZE & (MHI_TIMING_RING_SIZE - 1)) != 0
+#error MHI_TIMING_RING_SIZE must be a power of 2
+#endif
+
+#if MHI_TIMING_BUCKETS % MHI_TIMING_SUB != 0
+#error MHI_TIMING_BUCKETS must be a multiple of MHI_TIMING_SUB
+#endif
+
+/**
+ * @brief Halve all counts and sums of a histogram, keeping its shape, mean and deviation.
+ */
+static void hist_halve(mhi_timing_hist_t *p_hist)
+{
+    for (uint32_t i = 0; i < MHI_TIMING_BUCKETS; i++)
+    {
+        p_hist->count[i] /= 2;
+    }
+    p_hist->samples /= 2;
+    p_hist->sum /= 2;
+    p_hist->sum_sq /= 2;
+}
+
+/**
+ * @brief Integer square root.
+ */
+static uint32_t isqrt(uint64_t value)
+{
+    uint64_t root = 0;
+    uint64_t bit = 1ULL << 62;
+
+    while (bit > value)
+    {
+        bit >>= 2;
+    }
+    while (bit != 0)
+    {
+        if (value >= root + bit)
+        {
+            value -= root + bit;
+            root = (root >> 1) + bit;
+        }
+        else
+        {
+            root >>= 1;
+        }
+        bit >>= 2;
+    }
+
+    return (uint32_t)root;
+}
+
+void mhi_timing_init(mhi_timing_t *p_timing)
+{
+    memset(p_timing, 0, sizeof(*p_timing));
+}
+
+MHI_RAMFUNC void mhi_timing_capture(mhi_timing_t *p_timing, uint32_t start_us, uint32_t end_us)
+{
+    uint32_t head = p_timing->head;
+    mhi_timing_capture_t *p_capture;
+
+    if (head - p_timing->tail >= MHI_TIMING_RING_SIZE)
+    {
+        (void)__atomic_fetch_add(&p_timing->overruns, 1, __ATOMIC_RELAXED);
+        return;
+    }
+
+    p_capture = &p_timing->ring[head & (MHI_TIMING_RING_SIZE - 1)];
+    p_capture->start_us = start_us;
+    p_capture->end_us = end_us;
+    p_timing->head = head + 1;
+}
+
+void mhi_timing_process(mhi_timing_t *p_timing)
+{
+    while (p_timing->tail != p_timing->head)
+    {
+        mhi_timing_capture_t capture = p_timing->ring[p_timing->tail & (MHI_TIMING_RING_SIZE - 1)];
+        uint32_t xfer = capture.end_us - capture.start_us;
+
+        p_timing->tail = p_timing->tail + 1;
+
+        if (xfer > MHI_TIMING_MAX_US)
+        {
+            /* The start capture belongs to the next transfer already */
+            p_timing->late++;
+            p_timing->timed = false;
+            continue;
+        }
+
+        if (p_timing->timed)
+        {
+            uint32_t period = capture.start_us - p_timing->last.start_us;
+            uint32_t gap = capture.start_us - p_timing->last.end_us;
+
+            if (period > MHI_TIMING_MAX_US)
+            {
+                p_timing->restarts++;
+            }
+            else
+            {
+                mhi_timing_hist_add(&p_timing->period, period);
+                if (gap <= period)
+                {
+                    mhi_timing_hist_add(&p_timing->gap, gap);
+                }
+            }
+        }
+        mhi_timing_hist_add(&p_timing->xfer, xfer);
+
+        p_timing->last = capture;
+        p_timing->timed = true;
+    }
+}
+
+void mhi_timing_log(const mhi_timing_t *p_timing, uint8_t unit)
+{
+    MHI_LOG_INFO("Unit %u frame period %u us, jitter %u us, p1 %u us, p99 %u us", unit,
+                 mhi_timing_hist_mean(&p_timing->period), mhi_timing_hist_stddev(&p_timing->period),
+                 mhi_timing_hist_percentile(&p_timing->period, 10),
+                 mhi_timing_hist_percentile(&p_timing->period, 990));
+    MHI_LOG_INFO("Unit %u transfer %u to %u us, gap min %u us, late %u", unit, p_timing->xfer.min,
+                 p_timing->xfer.max, p_timing->gap.min, p_timing->late);
+}
+
+void mhi_timing_hist_add(mhi_timing_hist_t *p_hist, uint32_t value_us)
+{
+    uint32_t bucket = mhi_timing_bucket(value_us);
+    int64_t delta;
+
+    if (p_hist->samples == 0)
+    {
+        p_hist->origin = value_us;
+        p_hist->min = value_us;
+        p_hist->max = value_us;
+    }
+    if (p_hist->count[bucket] == UINT16_MAX)
+    {
+        hist_halve(p_hist);
+    }
+
+    p_hist->count[bucket]++;
+    p_hist->samples++;
+    p_hist->min = value_us < p_hist->min ? value_us : p_hist->min;
+    p_hist->max = value_us > p_hist->max ? value_us : p_hist->max;
+
+    delta = (int64_t)value_us - p_hist->origin;
+    p_hist->sum += delta;
+    p_hist->sum_sq += (uint64_t)(delta * delta);
+}
+
+uint32_t mhi_timing_bucket(uint32_t value_us)
+{
+    uint32_t msb;
+    uint32_t bucket;
+
+    if (value_us < MHI_TIMING_SUB)
+    {
+        return value_us;
+    }
+
+    /* Power of two, then the next MHI_TIMING_SUB_BITS bits */
+    msb = 31 - (uint32_t)__builtin_clz(value_us);
+    bucket = (msb - MHI_TIMING_SUB_BITS + 1) * MHI_TIMING_SUB +
+             ((value_us >> (msb - MHI_TIMING_SUB_BITS)) & (MHI_TIMING_SUB - 1));
+
+    return bucket < MHI_TIMING_BUCKETS ? bucket : MHI_TIMING_BUCKETS - 1;
+}
+
+uint32_t mhi_timing_bucket_low(uint32_t bucket)
+{
+    if (bucket < MHI_TIMING_SUB)
+    {
+        return bucket;
+    }
+
+    return (MHI_TIMING_SUB + bucket % MHI_TIMING_SUB) << (bucket / MHI_TIMING_SUB - 1);
+}
+
+uint32_t mhi_timing_hist_mean(const mhi_timing_hist_t *p_hist)
+{
+    if (p_hist->samples == 0)
+    {
+        return 0;
+    }
+
+    return (uint32_t)(p_hist->origin + p_hist->sum / (int64_t)p_hist->samples);
+}
+
+uint32_t mhi_timing_hist_stddev(const mhi_timing_hist_t *p_hist)
+{
+    int64_t mean;
+    uint64_t mean_sq;
+
+    if (p_hist->samples == 0)
+    {
+        return 0;
+    }
+
+    /* Around the origin the mean is small, so is its rounding error */
+    mean = p_hist->sum / (int64_t)p_hist->samples;
+    mean_sq = p_hist->sum_sq / p_hist->samples;
+    if (mean_sq <= (uint64_t)(mean * mean))
+    {
+        return 0;
+    }
+
+    return isqrt(mean_sq - (uint64_t)(mean * mean));
+}
+
+uint32_t mhi_timing_hist_percentile(const mhi_timing_hist_t *p_hist, uint32_t permille)
+{
+    uint64_t total = 0;
+    uint64_t target;
+    uint64_t seen = 0;
+    uint32_t bucket;
+    uint32_t high;
+
+    for (bucket = 0; bucket < MHI_TIMING_BUCKETS; bucket++)
+    {
+        total += p_hist->count[bucket];
+    }
+    if (total == 0)
+    {
+        return 0;
+    }
+
+    target = (total * permille + 999) / 1000;
+    target = target ? target : 1;
+    for (bucket = 0; bucket < MHI_TIMING_BUCKETS - 1; bucket++)
+    {
+        seen += p_hist->count[bucket];
+        if (seen >= target)
+        {
+            break;
+        }
+    }
+
+    high = bucket + 1 < MHI_TIMING_BUCKETS ? mhi_timing_bucket_low(bucket + 1) - 1 : MHI_TIMING_MAX_US;
+    high = high > p_hist->max ? p_hist->max : high;
+
+    return high < p_hist->min ? p_hist->min : high;
+}
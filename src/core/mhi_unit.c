@@ -0,0 +1,354 @@
+/**
+ * @file mhi_unit.c
+ * @brief One MHI indoor unit: SPI link, decoding, commands and ZCL mapping
+ */
+
+#include <string.h>
+
+#include "app_timer.h"
+
+#include "include/mhi_log.h"
+#include "include/mhi_temp.h"
+#include "include/mhi_unit.h"
+#include "include/mhi_zcl.h"
+
+/**
+ * @brief Build and publish the next TX frame.
+ */
+static void tx_stage(mhi_unit_t *p_unit)
+{
+    uint8_t *p_frame = mhi_link_tx_stage(&p_unit->link);
+
+    (void)mhi_cmd_build(&p_unit->cmd, p_frame, p_unit->frame_count);
+    mhi_opdata_build(&p_unit->opdata, p_frame);
+    mhi_frame_set_checksum(p_frame, MHI_FRAME_SIZE_EXT);
+    mhi_link_tx_commit(&p_unit->link);
+}
+
+/**
+ * @brief Process one received frame.
+ * @return Mask of the fields that changed
+ */
+static uint32_t frame_process(mhi_unit_t *p_unit, const mhi_link_frame_t *p_frame)
+{
+    mhi_state_t state;
+    uint32_t changed = 0;
+    uint32_t failed;
+    uint8_t room_temp;
+    uint8_t current;
+
+    /* A unit sending standard frames has no left/right vanes or 3D auto to write */
+    p_unit->cmd.unsupported = p_frame->len < MHI_FRAME_SIZE_EXT ? MHI_FIELDS_EXT : 0;
+
+    if (!p_unit->synced || mhi_frame_diff(p_unit->last_frame, p_frame->data, p_frame->len))
+    {
+        MHI_LOG_HEXDUMP_DEBUG(p_frame->data, p_frame->len);
+        memcpy(p_unit->last_frame, p_frame->data, p_frame->len);
+
+        /* The room temperature goes through the filter below */
+        mhi_state_decode(p_frame->data, p_frame->len, &state);
+        p_unit->room_temp_raw = state.value[MHI_FIELD_ROOM_TEMP];
+        state.value[MHI_FIELD_ROOM_TEMP] = p_unit->state.value[MHI_FIELD_ROOM_TEMP];
+        changed = p_unit->synced ? mhi_state_diff(&p_unit->state, &state) : MHI_FIELDS_ALL;
+        p_unit->state = state;
+        p_unit->synced = true;
+
+        if ((changed & MHI_FIELD_BIT(MHI_FIELD_ERROR_CODE)) && state.value[MHI_FIELD_ERROR_CODE])
+        {
+            mhi_opdata_error_fetch(&p_unit->opdata, p_unit->frame_count);
+        }
+    }
+
+    /* The median needs a sample every frame, also when the frame did not change */
+    room_temp = mhi_filter_update(&p_unit->room_filter, p_unit->room_temp_raw);
+    if (room_temp != p_unit->state.value[MHI_FIELD_ROOM_TEMP])
+    {
+        p_unit->state.value[MHI_FIELD_ROOM_TEMP] = room_temp;
+        changed |= MHI_FIELD_BIT(MHI_FIELD_ROOM_TEMP);
+    }
+
+    p_unit->cmd_applied |= mhi_cmd_on_rx(&p_unit->cmd, &p_unit->state, &failed);
+    p_unit->cmd_failed |= failed;
+
+    switch (mhi_opdata_on_rx(&p_unit->opdata, p_frame->data, p_unit->frame_count))
+    {
+    case MHI_OPDATA_CURRENT:
+        current = (uint8_t)p_unit->opdata.value[MHI_OPDATA_CURRENT];
+        p_unit->energy_changed |= !p_unit->energy.sampled || current != p_unit->energy.current_raw;
+        p_unit->energy_changed |= mhi_energy_current(&p_unit->energy, current, app_timer_cnt_get());
+        break;
+    case MHI_OPDATA_ENERGY:
+        p_unit->energy_changed |=
+            mhi_energy_counter(&p_unit->energy, (uint16_t)p_unit->opdata.value[MHI_OPDATA_ENERGY]);
+        break;
+    default:
+        break;
+    }
+    p_unit->frame_count++;
+    p_unit->remote_frames++;
+
+    return changed;
+}
+
+/**
+ * @brief Watchdog timer handler, counts the periods without valid frames. Timer context.
+ */
+static void watchdog_handler(void *p_context)
+{
+    mhi_unit_t *p_unit = p_context;
+    uint32_t frames = p_unit->link.stats.frames;
+
+    if (frames != p_unit->watchdog_frames)
+    {
+        p_unit->watchdog_frames = frames;
+        p_unit->watchdog_idle = 0;
+    }
+    else if (p_unit->watchdog_idle < MHI_WATCHDOG_CHECKS)
+    {
+        p_unit->watchdog_idle++;
+    }
+}
+
+/**
+ * @brief Mark the unit unavailable once the watchdog saw no valid frames for the timeout.
+ */
+static void watchdog_check(mhi_unit_t *p_unit)
+{
+    /* A frame counted after the last period means the AC is back, whatever the idle count says */
+    if (!p_unit->available || p_unit->watchdog_idle < MHI_WATCHDOG_CHECKS ||
+        p_unit->link.stats.frames != p_unit->watchdog_frames)
+    {
+        return;
+    }
+
+    MHI_LOG_WARNING("No frames from the AC, unavailable");
+    p_unit->available = false;
+
+    /* Start over with the first frame: full republish and a fresh room temperature median */
+    p_unit->synced = false;
+    mhi_filter_init(&p_unit->room_filter, p_unit->room_filter.window, p_unit->room_filter.band);
+    p_unit->cmd_failed = mhi_cmd_cancel(&p_unit->cmd);
+    p_unit->resync_fields = 0;
+    mhi_energy_restart(&p_unit->energy);
+
+    mhi_zcl_publish_available(p_unit->endpoint, false);
+    mhi_zcl_publish_energy(p_unit->endpoint, &p_unit->energy);
+}
+
+/**
+ * @brief Invalidate the current scene once the AC state no longer matches it.
+ */
+static void scene_check(mhi_unit_t *p_unit)
+{
+    mhi_scene_table_t *p_table = &p_unit->scenes;
+    const mhi_scene_t *p_scene;
+    uint8_t packed[MHI_SCENE_PACKED_SIZE];
+
+    if (!p_unit->scene_check || p_unit->cmd.active)
+    {
+        return;
+    }
+    p_unit->scene_check = false;
+
+    p_scene = mhi_scene_find(p_table, p_table->current_group, p_table->current_scene);
+    mhi_scene_pack(&p_unit->state, packed);
+    if (p_table->valid && (p_scene == NULL || memcmp(packed, p_scene->packed, sizeof(packed)) != 0))
+    {
+        p_table->valid = false;
+        mhi_zcl_publish_scenes(p_unit->endpoint, p_table);
+    }
+}
+
+/**
+ * @brief Fall back to the AC sensor once the remote room temperature is older than the timeout.
+ */
+static void remote_check(mhi_unit_t *p_unit)
+{
+    if (!p_unit->remote_active || p_unit->remote_frames < p_unit->remote_timeout_frames)
+    {
+        return;
+    }
+
+    MHI_LOG_WARNING("No remote room temperature, using the AC sensor");
+    p_unit->remote_active = false;
+    p_unit->cmd.room_temp = MHI_TX_ROOM_TEMP_NONE;
+    mhi_zcl_publish_remote_temp(p_unit->endpoint, false);
+}
+
+void mhi_unit_init(mhi_unit_t *p_unit, zb_uint8_t endpoint)
+{
+    memset(p_unit, 0, sizeof(*p_unit));
+    p_unit->endpoint = endpoint;
+
+    mhi_link_init(&p_unit->link);
+    mhi_timing_init(&p_unit->timing);
+    p_unit->link.interval_ticks = APP_TIMER_TICKS(MHI_LINK_FRAME_INTERVAL_MS);
+    mhi_cmd_init(&p_unit->cmd);
+    mhi_opdata_init(&p_unit->opdata);
+    mhi_filter_init(&p_unit->room_filter, MHI_ROOM_TEMP_FILTER_WINDOW, MHI_ROOM_TEMP_FILTER_BAND);
+    mhi_scene_table_init(&p_unit->scenes);
+    mhi_energy_init(&p_unit->energy, MHI_ENERGY_VOLTAGE);
+
+    p_unit->watchdog_id = &p_unit->watchdog_timer;
+    (void)app_timer_create(&p_unit->watchdog_id, APP_TIMER_MODE_REPEATED, watchdog_handler);
+    mhi_unit_offline_timeout_set(p_unit, MHI_OFFLINE_TIMEOUT_MS);
+    mhi_unit_remote_timeout_set(p_unit, MHI_REMOTE_TEMP_TIMEOUT_MS);
+
+    tx_stage(p_unit);
+}
+
+MHI_RAMFUNC void mhi_unit_on_xfer_done(mhi_unit_t *p_unit, const uint8_t *p_rx, size_t rx_len, uint32_t ticks,
+                                       uint8_t *p_tx)
+{
+    (void)mhi_link_rx_push(&p_unit->link, p_rx, rx_len, ticks);
+    mhi_link_tx_get(&p_unit->link, p_tx);
+}
+
+uint32_t mhi_unit_process(mhi_unit_t *p_unit)
+{
+    const mhi_link_frame_t *p_frame;
+    uint32_t changed = 0;
+    bool processed = false;
+
+    p_unit->cmd_applied = 0;
+    p_unit->cmd_failed = 0;
+
+    mhi_timing_process(&p_unit->timing);
+
+    while ((p_frame = mhi_link_rx_peek(&p_unit->link)) != NULL)
+    {
+        changed |= frame_process(p_unit, p_frame);
+        mhi_link_rx_pop(&p_unit->link);
+        processed = true;
+    }
+
+    if (!processed)
+    {
+        watchdog_check(p_unit);
+        return 0;
+    }
+
+    if (!p_unit->available)
+    {
+        MHI_LOG_INFO("AC available");
+        p_unit->available = true;
+        mhi_zcl_publish_available(p_unit->endpoint, true);
+    }
+
+    /* Writes that the AC did not apply have left their value in the ZCL attributes, put
+     * back the actual state once the command is done. */
+    changed |= p_unit->resync_fields | p_unit->cmd_applied | p_unit->cmd_failed;
+    p_unit->resync_fields = 0;
+
+    if (changed)
+    {
+        mhi_zcl_publish(p_unit->endpoint, &p_unit->state, changed, p_unit->temp_offset);
+    }
+
+    if (p_unit->opdata.error_fetched)
+    {
+        MHI_LOG_INFO("AC error %d snapshot fetched in %d frames", p_unit->opdata.error.code, p_unit->opdata.error.frames);
+        mhi_zcl_publish_error(p_unit->endpoint, &p_unit->opdata.error);
+        p_unit->opdata.error_fetched = false;
+    }
+
+    if (p_unit->energy_changed)
+    {
+        mhi_zcl_publish_energy(p_unit->endpoint, &p_unit->energy);
+        p_unit->energy_changed = false;
+    }
+
+    p_unit->scene_check |= p_unit->scenes.valid && (changed & MHI_FIELDS_WRITABLE);
+    scene_check(p_unit);
+    remote_check(p_unit);
+    tx_stage(p_unit);
+
+    return changed;
+}
+
+bool mhi_unit_request(mhi_unit_t *p_unit, mhi_field_t field, uint8_t value)
+{
+    if (!mhi_cmd_request(&p_unit->cmd, field, value))
+    {
+        return false;
+    }
+
+    tx_stage(p_unit);
+
+    return true;
+}
+
+void mhi_unit_offline_timeout_set(mhi_unit_t *p_unit, uint32_t timeout_ms)
+{
+    (void)app_timer_stop(p_unit->watchdog_id);
+    p_unit->watchdog_idle = 0;
+    (void)app_timer_start(p_unit->watchdog_id, APP_TIMER_TICKS(timeout_ms / MHI_WATCHDOG_CHECKS), p_unit);
+}
+
+void mhi_unit_calibrate(mhi_unit_t *p_unit, int16_t offset)
+{
+    p_unit->temp_offset = offset;
+    p_unit->resync_fields |= MHI_FIELD_BIT(MHI_FIELD_ROOM_TEMP);
+}
+
+void mhi_unit_remote_temp(mhi_unit_t *p_unit, int16_t temperature)
+{
+    if (temperature == ZB_ZCL_TEMP_MEASUREMENT_VALUE_UNKNOWN)
+    {
+        return;
+    }
+
+    p_unit->cmd.room_temp = mhi_temp_room_raw(temperature);
+    p_unit->remote_frames = 0;
+    if (!p_unit->remote_active)
+    {
+        MHI_LOG_INFO("Using the remote room temperature");
+        p_unit->remote_active = true;
+        mhi_zcl_publish_remote_temp(p_unit->endpoint, true);
+    }
+
+    tx_stage(p_unit);
+}
+
+void mhi_unit_remote_timeout_set(mhi_unit_t *p_unit, uint32_t timeout_ms)
+{
+    p_unit->remote_timeout_frames = timeout_ms / MHI_LINK_FRAME_INTERVAL_MS;
+}
+
+bool mhi_unit_zcl_write(mhi_unit_t *p_unit, zb_uint16_t cluster_id, zb_uint16_t attr_id, uint32_t value)
+{
+    if (cluster_id == ZB_ZCL_CLUSTER_ID_THERMOSTAT && attr_id == ZB_ZCL_ATTR_THERMOSTAT_LOCAL_TEMPERATURE_CALIBRATION_ID)
+    {
+        /* Calibration is in 0.1 degrees */
+        mhi_unit_calibrate(p_unit, (int16_t)((zb_int8_t)value * 10));
+        return true;
+    }
+
+    if (!mhi_zcl_write(&p_unit->cmd, cluster_id, attr_id, value))
+    {
+        return false;
+    }
+
+    tx_stage(p_unit);
+
+    return true;
+}
+
+bool mhi_unit_scene_command(mhi_unit_t *p_unit, zb_uint8_t cmd_id, const uint8_t *p_req, size_t req_len,
+                            bool in_group, mhi_scene_resp_t *p_resp)
+{
+    if (!mhi_scene_command(&p_unit->scenes, &p_unit->state, &p_unit->cmd, cmd_id, p_req, req_len, in_group, p_resp))
+    {
+        return false;
+    }
+
+    if (cmd_id == ZB_ZCL_CMD_SCENES_RECALL_SCENE && p_resp->status == ZB_ZCL_STATUS_SUCCESS)
+    {
+        /* A scene that needs no command is valid right away, the others once they are applied */
+        p_unit->scene_check = true;
+        tx_stage(p_unit);
+    }
+    mhi_zcl_publish_scenes(p_unit->endpoint, &p_unit->scenes);
+
+    return true;
+}
@@ -0,0 +1,486 @@
+/**
+ * @file mhi_zcl.c
+ * @brief Mapping between the MHI AC state and the ZCL attributes of the MHI endpoint
+ */
+
+#include "include/mhi_log.h"
+#include "include/mhi_temp.h"
+#include "include/mhi_zcl.h"
+
+#define SETPOINT_SCALE 50 /* Raw setpoint (0.5 degrees) to hundredths of degrees, for writes */
+
+#ifndef ARRAY_SIZE
+#define ARRAY_SIZE(arr) (sizeof(arr) / sizeof((arr)[0]))
+#endif
+
+/* Thermostat system mode per MHI mode */
+static const zb_uint8_t m_system_modes[] = {
+    [MHI_MODE_AUTO] = ZB_ZCL_THERMOSTAT_SYSTEM_MODE_AUTO,
+    [MHI_MODE_DRY] = ZB_ZCL_THERMOSTAT_SYSTEM_MODE_DRY,
+    [MHI_MODE_COOL] = ZB_ZCL_THERMOSTAT_SYSTEM_MODE_COOL,
+    [MHI_MODE_FAN] = ZB_ZCL_THERMOSTAT_SYSTEM_MODE_FAN_ONLY,
+    [MHI_MODE_HEAT] = ZB_ZCL_THERMOSTAT_SYSTEM_MODE_HEAT,
+};
+
+/* Fan Control fan mode per MHI fan speed */
+static const zb_uint8_t m_fan_modes[] = {
+    [1] = ZB_ZCL_FAN_CONTROL_FAN_MODE_LOW,
+    [2] = ZB_ZCL_FAN_CONTROL_FAN_MODE_MEDIUM,
+    [3] = ZB_ZCL_FAN_CONTROL_FAN_MODE_HIGH,
+    [4] = ZB_ZCL_FAN_CONTROL_FAN_MODE_ON,
+};
+
+/* Fan Control manufacturer specific attribute per vane field, a position write also stops the swing */
+static const struct
+{
+    zb_uint16_t attr_id;
+    uint8_t field;
+    uint8_t swing; /* Swing field of the same vanes, MHI_FIELD_COUNT for none */
+    uint8_t max;   /* Highest value, for scene extension fields */
+} m_vane_attrs[] = {
+    {MHI_ATTR_FAN_VANE_ID, MHI_FIELD_VANE, MHI_FIELD_VANE_SWING, MHI_VANE_MAX},
+    {MHI_ATTR_FAN_VANE_SWING_ID, MHI_FIELD_VANE_SWING, MHI_FIELD_COUNT, 1},
+    {MHI_ATTR_FAN_VANE_LR_ID, MHI_FIELD_VANE_LR, MHI_FIELD_VANE_LR_SWING, MHI_VANE_LR_MAX},
+    {MHI_ATTR_FAN_VANE_LR_SWING_ID, MHI_FIELD_VANE_LR_SWING, MHI_FIELD_COUNT, 1},
+    {MHI_ATTR_FAN_VANE_3D_AUTO_ID, MHI_FIELD_VANE_3D_AUTO, MHI_FIELD_COUNT, 1},
+};
+
+/**
+ * @brief Set a ZCL attribute of the given endpoint.
+ */
+static void set_attribute(zb_uint8_t endpoint, zb_uint16_t cluster_id, zb_uint16_t attr_id, void *p_value)
+{
+    ZB_ZCL_SET_ATTRIBUTE(
+        endpoint,
+        cluster_id,
+        ZB_ZCL_CLUSTER_SERVER_ROLE,
+        attr_id,
+        (zb_uint8_t *)p_value,
+        ZB_FALSE);
+}
+
+void mhi_zcl_publish(zb_uint8_t endpoint, const mhi_state_t *p_state, uint32_t fields, zb_int16_t temp_offset)
+{
+    if (fields & (MHI_FIELD_BIT(MHI_FIELD_POWER) | MHI_FIELD_BIT(MHI_FIELD_MODE)))
+    {
+        zb_bool_t on_off = p_state->value[MHI_FIELD_POWER] ? ZB_TRUE : ZB_FALSE;
+        zb_uint8_t mode = p_state->value[MHI_FIELD_MODE];
+        zb_uint8_t system_mode = ZB_ZCL_THERMOSTAT_SYSTEM_MODE_OFF;
+
+        if (on_off && mode < ARRAY_SIZE(m_system_modes))
+        {
+            system_mode = m_system_modes[mode];
+        }
+
+        set_attribute(endpoint, ZB_ZCL_CLUSTER_ID_ON_OFF, ZB_ZCL_ATTR_ON_OFF_ON_OFF_ID, &on_off);
+        set_attribute(endpoint, ZB_ZCL_CLUSTER_ID_THERMOSTAT, ZB_ZCL_ATTR_THERMOSTAT_SYSTEM_MODE_ID, &system_mode);
+    }
+
+    if (fields & MHI_FIELD_BIT(MHI_FIELD_FAN))
+    {
+        zb_uint8_t fan = p_state->value[MHI_FIELD_FAN];
+        zb_uint8_t fan_mode = fan < ARRAY_SIZE(m_fan_modes) ? m_fan_modes[fan] : ZB_ZCL_FAN_CONTROL_FAN_MODE_AUTO;
+
+        set_attribute(endpoint, ZB_ZCL_CLUSTER_ID_FAN_CONTROL, ZB_ZCL_ATTR_FAN_CONTROL_FAN_MODE_ID, &fan_mode);
+    }
+
+    if (fields & MHI_FIELD_BIT(MHI_FIELD_SETPOINT))
+    {
+        zb_int16_t setpoint = mhi_temp_convert(MHI_TEMP_SETPOINT, p_state->value[MHI_FIELD_SETPOINT], 0);
+
+        set_attribute(endpoint, ZB_ZCL_CLUSTER_ID_THERMOSTAT, ZB_ZCL_ATTR_THERMOSTAT_OCCUPIED_COOLING_SETPOINT_ID, &setpoint);
+        set_attribute(endpoint, ZB_ZCL_CLUSTER_ID_THERMOSTAT, ZB_ZCL_ATTR_THERMOSTAT_OCCUPIED_HEATING_SETPOINT_ID, &setpoint);
+    }
+
+    for (uint32_t i = 0; i < ARRAY_SIZE(m_vane_attrs); i++)
+    {
+        if (fields & MHI_FIELD_BIT(m_vane_attrs[i].field))
+        {
+            zb_uint8_t vane = p_state->value[m_vane_attrs[i].field];
+
+            set_attribute(endpoint, ZB_ZCL_CLUSTER_ID_FAN_CONTROL, m_vane_attrs[i].attr_id, &vane);
+        }
+    }
+
+    if (fields & MHI_FIELD_BIT(MHI_FIELD_ROOM_TEMP))
+    {
+        zb_int16_t temperature = mhi_temp_convert(MHI_TEMP_ROOM, p_state->value[MHI_FIELD_ROOM_TEMP], temp_offset);
+
+        set_attribute(endpoint, ZB_ZCL_CLUSTER_ID_TEMP_MEASUREMENT, ZB_ZCL_ATTR_TEMP_MEASUREMENT_VALUE_ID, &temperature);
+        set_attribute(endpoint, ZB_ZCL_CLUSTER_ID_THERMOSTAT, ZB_ZCL_ATTR_THERMOSTAT_LOCAL_TEMPERATURE_ID, &temperature);
+    }
+
+    if ((fields & MHI_FIELD_BIT(MHI_FIELD_ERROR_CODE)) && p_state->value[MHI_FIELD_ERROR_CODE])
+    {
+        MHI_LOG_WARNING("AC error code %d", p_state->value[MHI_FIELD_ERROR_CODE]);
+    }
+}
+
+void mhi_zcl_publish_available(zb_uint8_t endpoint, bool available)
+{
+    zb_bool_t value = available ? ZB_TRUE : ZB_FALSE;
+
+    set_attribute(endpoint, ZB_ZCL_CLUSTER_ID_DIAGNOSTICS, MHI_ATTR_DIAG_AVAILABLE_ID, &value);
+
+    if (!available)
+    {
+        zb_int16_t temperature = ZB_ZCL_TEMP_MEASUREMENT_VALUE_UNKNOWN;
+
+        set_attribute(endpoint, ZB_ZCL_CLUSTER_ID_TEMP_MEASUREMENT, ZB_ZCL_ATTR_TEMP_MEASUREMENT_VALUE_ID, &temperature);
+        set_attribute(endpoint, ZB_ZCL_CLUSTER_ID_THERMOSTAT, ZB_ZCL_ATTR_THERMOSTAT_LOCAL_TEMPERATURE_ID, &temperature);
+    }
+}
+
+/**
+ * @brief Set an error snapshot temperature attribute.
+ */
+static void set_error_temp(zb_uint8_t endpoint, zb_uint16_t attr_id, const mhi_opdata_error_t *p_error,
+                           mhi_opdata_t opdata, mhi_temp_table_t table)
+{
+    zb_int16_t temperature = ZB_ZCL_TEMP_MEASUREMENT_VALUE_UNKNOWN;
+
+    if (p_error->valid & (1UL << opdata))
+    {
+        temperature = mhi_temp_convert(table, (uint8_t)p_error->value[opdata], 0);
+    }
+
+    set_attribute(endpoint, ZB_ZCL_CLUSTER_ID_DIAGNOSTICS, attr_id, &temperature);
+}
+
+/**
+ * @brief Set an error snapshot raw attribute.
+ */
+static void set_error_raw(zb_uint8_t endpoint, zb_uint16_t attr_id, const mhi_opdata_error_t *p_error,
+                          mhi_opdata_t opdata)
+{
+    zb_uint16_t value = MHI_ATTR_DIAG_ERROR_RAW_NONE;
+
+    if (p_error->valid & (1UL << opdata))
+    {
+        value = (zb_uint16_t)p_error->value[opdata];
+    }
+
+    set_attribute(endpoint, ZB_ZCL_CLUSTER_ID_DIAGNOSTICS, attr_id, &value);
+}
+
+void mhi_zcl_publish_error(zb_uint8_t endpoint, const mhi_opdata_error_t *p_error)
+{
+    zb_uint8_t code = p_error->code;
+    zb_uint16_t frames = p_error->frames;
+
+    set_attribute(endpoint, ZB_ZCL_CLUSTER_ID_DIAGNOSTICS, MHI_ATTR_DIAG_ERROR_CODE_ID, &code);
+    set_error_temp(endpoint, MHI_ATTR_DIAG_ERROR_RETURN_AIR_ID, p_error, MHI_OPDATA_RETURN_AIR_TEMP, MHI_TEMP_RETURN_AIR);
+    set_error_temp(endpoint, MHI_ATTR_DIAG_ERROR_OUTDOOR_ID, p_error, MHI_OPDATA_OUTDOOR_TEMP, MHI_TEMP_OUTDOOR);
+    set_error_temp(endpoint, MHI_ATTR_DIAG_ERROR_HEAT_EXCH_ID, p_error, MHI_OPDATA_HEAT_EXCH_TEMP, MHI_TEMP_HEAT_EXCH);
+    set_error_raw(endpoint, MHI_ATTR_DIAG_ERROR_CURRENT_ID, p_error, MHI_OPDATA_CURRENT);
+    set_error_raw(endpoint, MHI_ATTR_DIAG_ERROR_COMP_FREQ_ID, p_error, MHI_OPDATA_COMP_FREQ);
+    set_attribute(endpoint, ZB_ZCL_CLUSTER_ID_DIAGNOSTICS, MHI_ATTR_DIAG_ERROR_FETCH_ID, &frames);
+}
+
+void mhi_zcl_publish_remote_temp(zb_uint8_t endpoint, bool active)
+{
+    zb_bool_t value = active ? ZB_TRUE : ZB_FALSE;
+
+    set_attribute(endpoint, ZB_ZCL_CLUSTER_ID_DIAGNOSTICS, MHI_ATTR_DIAG_REMOTE_TEMP_ID, &value);
+}
+
+void mhi_zcl_publish_energy(zb_uint8_t endpoint, const mhi_energy_t *p_energy)
+{
+    zb_uint48_t summation = {(zb_uint32_t)p_energy->total_wh, (zb_uint16_t)(p_energy->total_wh >> 32)};
+    uint32_t power = mhi_energy_power(p_energy);
+    zb_int24_t demand = {(zb_uint16_t)power, (zb_int8_t)(power >> 16)};
+
+    set_attribute(endpoint, ZB_ZCL_CLUSTER_ID_METERING, ZB_ZCL_ATTR_METERING_CURRENT_SUMMATION_DELIVERED_ID, &summation);
+    set_attribute(endpoint, ZB_ZCL_CLUSTER_ID_METERING, ZB_ZCL_ATTR_METERING_INSTANTANEOUS_DEMAND_ID, &demand);
+}
+
+void mhi_zcl_publish_scenes(zb_uint8_t endpoint, const mhi_scene_table_t *p_table)
+{
+    zb_uint8_t count = p_table->count;
+    zb_uint8_t scene = p_table->current_scene;
+    zb_uint16_t group = p_table->current_group;
+    zb_bool_t valid = p_table->valid ? ZB_TRUE : ZB_FALSE;
+
+    set_attribute(endpoint, ZB_ZCL_CLUSTER_ID_SCENES, ZB_ZCL_ATTR_SCENES_SCENE_COUNT_ID, &count);
+    set_attribute(endpoint, ZB_ZCL_CLUSTER_ID_SCENES, ZB_ZCL_ATTR_SCENES_CURRENT_SCENE_ID, &scene);
+    set_attribute(endpoint, ZB_ZCL_CLUSTER_ID_SCENES, ZB_ZCL_ATTR_SCENES_CURRENT_GROUP_ID, &group);
+    set_attribute(endpoint, ZB_ZCL_CLUSTER_ID_SCENES, ZB_ZCL_ATTR_SCENES_SCENE_VALID_ID, &valid);
+}
+
+/**
+ * @brief Translate a Thermostat system mode write.
+ */
+static bool write_system_mode(mhi_cmd_t *p_cmd, uint32_t system_mode)
+{
+    if (system_mode == ZB_ZCL_THERMOSTAT_SYSTEM_MODE_OFF)
+    {
+        return mhi_cmd_request(p_cmd, MHI_FIELD_POWER, 0);
+    }
+
+    for (uint8_t mode = 0; mode < ARRAY_SIZE(m_system_modes); mode++)
+    {
+        if (m_system_modes[mode] == system_mode)
+        {
+            return mhi_cmd_request(p_cmd, MHI_FIELD_MODE, mode) &&
+                   mhi_cmd_request(p_cmd, MHI_FIELD_POWER, 1);
+        }
+    }
+
+    return false;
+}
+
+/**
+ * @brief Translate a Fan Control fan mode write.
+ */
+static bool write_fan_mode(mhi_cmd_t *p_cmd, uint32_t fan_mode)
+{
+    if (fan_mode == ZB_ZCL_FAN_CONTROL_FAN_MODE_OFF)
+    {
+        return mhi_cmd_request(p_cmd, MHI_FIELD_POWER, 0);
+    }
+
+    for (uint8_t fan = MHI_FAN_MIN; fan <= MHI_FAN_MAX; fan++)
+    {
+        if (m_fan_modes[fan] == fan_mode)
+        {
+            return mhi_cmd_request(p_cmd, MHI_FIELD_FAN, fan);
+        }
+    }
+
+    return false;
+}
+
+/**
+ * @brief Translate a Fan Control vane attribute write.
+ * @return false when the attribute is not a vane attribute or the value is out of range
+ */
+static bool write_vane(mhi_cmd_t *p_cmd, zb_uint16_t attr_id, uint32_t value)
+{
+    for (uint32_t i = 0; i < ARRAY_SIZE(m_vane_attrs); i++)
+    {
+        if (m_vane_attrs[i].attr_id == attr_id)
+        {
+            return value <= UINT8_MAX &&
+                   mhi_cmd_request(p_cmd, (mhi_field_t)m_vane_attrs[i].field, (uint8_t)value) &&
+                   (m_vane_attrs[i].swing == MHI_FIELD_COUNT ||
+                    mhi_cmd_request(p_cmd, (mhi_field_t)m_vane_attrs[i].swing, 0));
+        }
+    }
+
+    return false;
+}
+
+bool mhi_zcl_write(mhi_cmd_t *p_cmd, zb_uint16_t cluster_id, zb_uint16_t attr_id, uint32_t value)
+{
+    switch (cluster_id)
+    {
+    case ZB_ZCL_CLUSTER_ID_ON_OFF:
+        if (attr_id == ZB_ZCL_ATTR_ON_OFF_ON_OFF_ID)
+        {
+            return mhi_cmd_request(p_cmd, MHI_FIELD_POWER, value ? 1 : 0);
+        }
+        break;
+
+    case ZB_ZCL_CLUSTER_ID_THERMOSTAT:
+        if (attr_id == ZB_ZCL_ATTR_THERMOSTAT_SYSTEM_MODE_ID)
+        {
+            return write_system_mode(p_cmd, value);
+        }
+        if (attr_id == ZB_ZCL_ATTR_THERMOSTAT_OCCUPIED_COOLING_SETPOINT_ID ||
+            attr_id == ZB_ZCL_ATTR_THERMOSTAT_OCCUPIED_HEATING_SETPOINT_ID)
+        {
+            zb_int16_t setpoint = (zb_int16_t)value;
+
+            return setpoint > 0 &&
+                   mhi_cmd_request(p_cmd, MHI_FIELD_SETPOINT, (uint8_t)((setpoint + SETPOINT_SCALE / 2) / SETPOINT_SCALE));
+        }
+        break;
+
+    case ZB_ZCL_CLUSTER_ID_FAN_CONTROL:
+        if (attr_id == ZB_ZCL_ATTR_FAN_CONTROL_FAN_MODE_ID)
+        {
+            return write_fan_mode(p_cmd, value);
+        }
+        return write_vane(p_cmd, attr_id, value);
+
+    default:
+        break;
+    }
+
+    MHI_LOG_INFO("Unhandled cluster (%d) attribute (%d)", cluster_id, attr_id);
+
+    return false;
+}
+
+/**
+ * @brief Apply a Thermostat extension field set: occupied cooling and heating setpoints and
+ * system mode, the heating setpoint is taken in heat mode.
+ */
+static bool scene_ext_thermostat(mhi_state_t *p_state, const uint8_t *p_data, size_t len)
+{
+    size_t setpoint_pos = 0;
+
+    if (len >= 5)
+    {
+        uint8_t system_mode = p_data[4];
+        uint8_t mode = 0;
+
+        while (mode < ARRAY_SIZE(m_system_modes) && m_system_modes[mode] != system_mode)
+        {
+            mode++;
+        }
+        if (system_mode == ZB_ZCL_THERMOSTAT_SYSTEM_MODE_OFF)
+        {
+            p_state->value[MHI_FIELD_POWER] = 0;
+        }
+        else if (mode < ARRAY_SIZE(m_system_modes))
+        {
+            p_state->value[MHI_FIELD_MODE] = mode;
+            p_state->value[MHI_FIELD_POWER] = 1;
+        }
+        else
+        {
+            return false;
+        }
+    }
+
+    if (len >= 4 && p_state->value[MHI_FIELD_MODE] == MHI_MODE_HEAT)
+    {
+        setpoint_pos = 2;
+    }
+    if (len >= setpoint_pos + 2)
+    {
+        zb_int16_t setpoint = (zb_int16_t)(p_data[setpoint_pos] | (p_data[setpoint_pos + 1] << 8));
+        int32_t raw = (setpoint + SETPOINT_SCALE / 2) / SETPOINT_SCALE;
+
+        if (setpoint <= 0 || raw < MHI_SETPOINT_MIN || raw > MHI_SETPOINT_MAX)
+        {
+            return false;
+        }
+        p_state->value[MHI_FIELD_SETPOINT] = (uint8_t)raw;
+    }
+
+    return true;
+}
+
+/**
+ * @brief Apply a Fan Control extension field set: fan mode, then the vane attributes.
+ */
+static bool scene_ext_fan(mhi_state_t *p_state, const uint8_t *p_data, size_t len)
+{
+    if (len >= 1 && p_data[0] == ZB_ZCL_FAN_CONTROL_FAN_MODE_OFF)
+    {
+        p_state->value[MHI_FIELD_POWER] = 0;
+    }
+    else if (len >= 1)
+    {
+        uint8_t fan = MHI_FAN_MIN;
+
+        while (fan <= MHI_FAN_MAX && m_fan_modes[fan] != p_data[0])
+        {
+            fan++;
+        }
+        if (fan > MHI_FAN_MAX)
+        {
+            return false;
+        }
+        p_state->value[MHI_FIELD_FAN] = fan;
+    }
+
+    for (uint32_t i = 0; i < ARRAY_SIZE(m_vane_attrs) && i + 1 < len; i++)
+    {
+        if (p_data[i + 1] > m_vane_attrs[i].max)
+        {
+            return false;
+        }
+        p_state->value[m_vane_attrs[i].field] = p_data[i + 1];
+    }
+
+    return true;
+}
+
+bool mhi_zcl_scene_ext_parse(mhi_state_t *p_state, const uint8_t *p_data, size_t len)
+{
+    while (len > 0)
+    {
+        zb_uint16_t cluster_id;
+        size_t set_len;
+        bool valid = true;
+
+        if (len < 3 || (size_t)p_data[2] + 3 > len)
+        {
+            return false;
+        }
+        cluster_id = (zb_uint16_t)(p_data[0] | (p_data[1] << 8));
+        set_len = p_data[2];
+
+        switch (cluster_id)
+        {
+        case ZB_ZCL_CLUSTER_ID_ON_OFF:
+            if (set_len >= 1)
+            {
+                p_state->value[MHI_FIELD_POWER] = p_data[3] ? 1 : 0;
+            }
+            break;
+        case ZB_ZCL_CLUSTER_ID_THERMOSTAT:
+            valid = scene_ext_thermostat(p_state, &p_data[3], set_len);
+            break;
+        case ZB_ZCL_CLUSTER_ID_FAN_CONTROL:
+            valid = scene_ext_fan(p_state, &p_data[3], set_len);
+            break;
+        default:
+            /* Sets of other clusters do not concern the AC */
+            break;
+        }
+
+        if (!valid)
+        {
+            return false;
+        }
+        p_data += 3 + set_len;
+        len -= 3 + set_len;
+    }
+
+    return true;
+}
+
+/**
+ * @brief Start an extension field set.
+ */
+static uint8_t *scene_ext_start(uint8_t *p, zb_uint16_t cluster_id, uint8_t len)
+{
+    p[0] = (uint8_t)cluster_id;
+    p[1] = (uint8_t)(cluster_id >> 8);
+    p[2] = len;
+
+    return p + 3;
+}
+
+size_t mhi_zcl_scene_ext_build(const mhi_state_t *p_state, uint8_t *p_buf)
+{
+    uint8_t mode = p_state->value[MHI_FIELD_MODE];
+    uint8_t fan = p_state->value[MHI_FIELD_FAN];
+    zb_int16_t setpoint = mhi_temp_convert(MHI_TEMP_SETPOINT, p_state->value[MHI_FIELD_SETPOINT], 0);
+    uint8_t *p = p_buf;
+
+    p = scene_ext_start(p, ZB_ZCL_CLUSTER_ID_ON_OFF, 1);
+    *p++ = p_state->value[MHI_FIELD_POWER];
+
+    p = scene_ext_start(p, ZB_ZCL_CLUSTER_ID_THERMOSTAT, 5);
+    for (uint32_t i = 0; i < 2; i++)
+    {
+        *p++ = (uint8_t)setpoint;
+        *p++ = (uint8_t)((uint16_t)setpoint >> 8);
+    }
+    *p++ = p_state->value[MHI_FIELD_POWER] && mode < ARRAY_SIZE(m_system_modes) ? m_system_modes[mode]
+                                                                                : ZB_ZCL_THERMOSTAT_SYSTEM_MODE_OFF;
+
+    p = scene_ext_start(p, ZB_ZCL_CLUSTER_ID_FAN_CONTROL, 1 + ARRAY_SIZE(m_vane_attrs));
+    *p++ = fan < ARRAY_SIZE(m_fan_modes) && m_fan_modes[fan] ? m_fan_modes[fan] : ZB_ZCL_FAN_CONTROL_FAN_MODE_AUTO;
+    for (uint32_t i = 0; i < ARRAY_SIZE(m_vane_attrs); i++)
+    {
+        *p++ = p_state->value[m_vane_attrs[i].field];
+    }
+
+    return (size_t)(p - p_buf);
+}
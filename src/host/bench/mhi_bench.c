@@ -0,0 +1,911 @@
+/**
+ * @file mhi_bench.c
+ * @brief Benchmarks of the MHI protocol pipeline
+ *
+ * Every stage of the pipeline is measured in isolation over the frames of a capture file, and
+ * the whole pipeline end to end by replaying the capture through mhi_unit. The OTA stage
+ * pushes an image through the OTA pipeline with the stand-in server, a "frame" is one image
+ * block there, and the temperature stage converts every code of every temperature table, a "frame"
+ * is one conversion. Before measuring, the temperature tables are checked against their
+ * reference formulas for all 256 codes, and the word-parallel checksum and change detection
+ * kernels against byte-wise references, which are then measured next to them. The capture is also replayed once without and once with
+ * the room temperature filter, to report the room temperature reports per hour each would
+ * cause. Finally an OTA download with periodic NVRAM saves runs against the simulated frame
+ * timing of a unit, once with every flash operation done at once and once with the erases and
+ * saves left to mhi_sched, to count the frames lost while the flash stalls the CPU, and once
+ * more at once with the SPIS re-arming itself. A transfer the SPIS ignored leaves the AC
+ * without an answer; with the scheduler and with re-arming none may be ignored. Re-arming does
+ * not save frames: those overwritten before the main loop read them are lost all the same and
+ * reported as such next to the ignored ones. With the scheduler none may be lost. The results
+ * are printed as JSON: nanoseconds per frame and the number of heap allocations done while
+ * measuring, which must be zero. The stages are measured round robin and the best of BENCH_RUNS
+ * runs is kept, so the noise of a shared machine does not end up in one stage. Code size per
+ * stage is added by tools/bench_report.py, which also compares the results against
+ * bench/baseline.json.
+ *
+ *   mhi_bench capture.txt [output.json]
+ */
+
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "zboss_api.h"
+
+#include "capture.h"
+#include "include/mhi_cmd.h"
+#include "include/mhi_frame.h"
+#include "include/mhi_opdata.h"
+#include "include/mhi_sched.h"
+#include "include/mhi_state.h"
+#include "include/mhi_temp.h"
+#include "include/mhi_unit.h"
+#include "include/mhi_zcl.h"
+#include "mhi_sim.h"
+#include "ota_sim.h"
+#include "temp_check.h"
+
+#define BENCH_MAX_FRAMES 4096   /**< Maximum number of frames in the capture. */
+#define BENCH_RUNS 20           /**< Runs per stage, the best one is reported. */
+#define BENCH_RUN_NS 10000000LL /**< Minimum duration of a run. */
+#define BENCH_ENDPOINT 1        /**< Endpoint used for the ZCL stages. */
+#define BENCH_OTA_IMAGE_SIZE 0x10000 /**< Image size of the OTA stage. */
+#define BENCH_OTA_BLOCK_SIZE 64      /**< Block size of the OTA stage, same as MHI_OTA_BLOCK_SIZE. */
+#define BENCH_KERNEL_CHECKS 200000   /**< Random buffers the frame kernels are checked with. */
+#define BENCH_SCHED_JITTER_US 1000   /**< CSN jitter of the simulated unit. */
+#define BENCH_SCHED_START_MS 1000    /**< Frames before the download starts. */
+#define BENCH_SCHED_LOOP_US 1000     /**< Idle main loop iteration. */
+#define BENCH_SCHED_BLOCK_MS 50      /**< Interval between two OTA blocks. */
+#define BENCH_SCHED_NVRAM_MS 5000    /**< Interval between two NVRAM saves. */
+#define BENCH_SCHED_NVRAM_US 3000    /**< Duration of an NVRAM save. */
+#define BENCH_SCHED_WORD_US 41       /**< Flash word write time, tWRITE of the nRF52840. */
+#define BENCH_SCHED_ERASE_US 85000   /**< Flash page erase time, tERASEPAGE. */
+#define BENCH_SCHED_ERASE_STEP_US 10000 /**< Partial erase, same as MHI_OTA_NRF_ERASE_STEP_MS. */
+
+/** @brief Benchmark stage. */
+typedef struct
+{
+    const char *p_name;        /**< Name in the results. */
+    void (*p_setup)(void);     /**< Called before each run, not measured. */
+    uint32_t (*p_pass)(void);  /**< Processes all frames once. */
+    size_t (*p_units)(void);   /**< Number of frames processed by a pass. */
+} bench_stage_t;
+
+static uint8_t m_frames[BENCH_MAX_FRAMES][MHI_FRAME_SIZE_EXT];
+static uint8_t m_lens[BENCH_MAX_FRAMES];
+static mhi_state_t m_states[BENCH_MAX_FRAMES];
+static size_t m_frame_count;
+
+static mhi_cmd_t m_cmd;
+static mhi_opdata_poller_t m_poller;
+static mhi_unit_t m_unit;
+static uint8_t m_tx_buf[MHI_FRAME_SIZE_EXT];
+static ota_sim_t m_ota_sim;
+static mhi_ota_t m_ota;
+
+static volatile uint32_t m_sink; /* Keeps the results of the passes alive */
+
+/* Heap allocation counting, the binary is linked with --wrap for these functions */
+static bool m_counting;
+static uint32_t m_allocs;
+
+void *__real_malloc(size_t size);
+void *__real_calloc(size_t count, size_t size);
+void *__real_realloc(void *p_ptr, size_t size);
+
+void *__wrap_malloc(size_t size)
+{
+    m_allocs += m_counting;
+    return __real_malloc(size);
+}
+
+void *__wrap_calloc(size_t count, size_t size)
+{
+    m_allocs += m_counting;
+    return __real_calloc(count, size);
+}
+
+void *__wrap_realloc(void *p_ptr, size_t size)
+{
+    m_allocs += m_counting;
+    return __real_realloc(p_ptr, size);
+}
+
+static long long now_ns(void)
+{
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+
+    return (long long)ts.tv_sec * 1000000000LL + ts.tv_nsec;
+}
+
+static void setup_none(void)
+{
+}
+
+static size_t units_frames(void)
+{
+    return m_frame_count;
+}
+
+static uint32_t pass_validate(void)
+{
+    uint32_t result = 0;
+
+    for (size_t i = 0; i < m_frame_count; i++)
+    {
+        result += mhi_frame_validate(m_frames[i], m_lens[i]);
+    }
+
+    return result;
+}
+
+static uint32_t pass_decode(void)
+{
+    mhi_state_t state;
+    uint32_t result = 0;
+
+    for (size_t i = 0; i < m_frame_count; i++)
+    {
+        mhi_state_decode(m_frames[i], m_lens[i], &state);
+        result += state.value[MHI_FIELD_ROOM_TEMP];
+    }
+
+    return result;
+}
+
+static uint32_t pass_diff(void)
+{
+    uint32_t result = 0;
+
+    for (size_t i = 1; i < m_frame_count; i++)
+    {
+        if (mhi_frame_diff(m_frames[i - 1], m_frames[i], m_lens[i]))
+        {
+            result += mhi_state_diff(&m_states[i - 1], &m_states[i]);
+        }
+    }
+
+    return result;
+}
+
+static void setup_tx_build(void)
+{
+    mhi_cmd_init(&m_cmd);
+    mhi_opdata_init(&m_poller);
+    (void)mhi_cmd_request(&m_cmd, MHI_FIELD_POWER, 1);
+    (void)mhi_cmd_request(&m_cmd, MHI_FIELD_SETPOINT, 44);
+}
+
+static uint32_t pass_tx_build(void)
+{
+    uint8_t frame[MHI_FRAME_SIZE_EXT];
+    uint32_t result = 0;
+
+    for (size_t i = 0; i < m_frame_count; i++)
+    {
+        result += mhi_cmd_build(&m_cmd, frame, (uint32_t)i);
+        mhi_opdata_build(&m_poller, frame);
+        mhi_frame_set_checksum(frame, MHI_FRAME_SIZE_EXT);
+        result += frame[MHI_CBL];
+    }
+
+    return result;
+}
+
+static void setup_opdata(void)
+{
+    mhi_opdata_init(&m_poller);
+}
+
+static uint32_t pass_opdata(void)
+{
+    uint32_t result = 0;
+
+    for (size_t i = 0; i < m_frame_count; i++)
+    {
+        result += mhi_opdata_on_rx(&m_poller, m_frames[i], (uint32_t)i);
+    }
+
+    return result;
+}
+
+static uint32_t pass_zcl(void)
+{
+    for (size_t i = 0; i < m_frame_count; i++)
+    {
+        mhi_zcl_publish(BENCH_ENDPOINT, &m_states[i], MHI_FIELDS_ALL, 0);
+    }
+
+    return 0;
+}
+
+static uint32_t pass_temp(void)
+{
+    uint32_t result = 0;
+
+    for (uint32_t table = 0; table < MHI_TEMP_TABLE_COUNT; table++)
+    {
+        for (uint32_t raw = 0; raw < 256; raw++)
+        {
+            result += (uint16_t)mhi_temp_convert((mhi_temp_table_t)table, (uint8_t)raw, 0);
+        }
+    }
+
+    return result;
+}
+
+static size_t units_temp(void)
+{
+    return MHI_TEMP_TABLE_COUNT * 256;
+}
+
+static void setup_e2e(void)
+{
+    mhi_unit_init(&m_unit, BENCH_ENDPOINT);
+    mhi_link_tx_get(&m_unit.link, m_tx_buf);
+}
+
+static uint32_t pass_e2e(void)
+{
+    uint32_t result = 0;
+
+    for (size_t i = 0; i < m_frame_count; i++)
+    {
+        mhi_unit_on_xfer_done(&m_unit, m_frames[i], m_lens[i], app_timer_cnt_get(), m_tx_buf);
+        result += mhi_unit_process(&m_unit);
+    }
+
+    return result;
+}
+
+static void setup_ota(void)
+{
+    static uint8_t image[BENCH_OTA_IMAGE_SIZE];
+
+    for (size_t i = 0; i < sizeof(image); i++)
+    {
+        image[i] = (uint8_t)(i * 31 + (i >> 8));
+    }
+
+    m_ota_sim.block_size = BENCH_OTA_BLOCK_SIZE;
+    (void)ota_sim_file_build(&m_ota_sim, image, sizeof(image), 1, true);
+}
+
+static uint32_t pass_ota(void)
+{
+    return ota_sim_transfer(&m_ota_sim, &m_ota);
+}
+
+static size_t units_ota(void)
+{
+    return (m_ota_sim.file_size + BENCH_OTA_BLOCK_SIZE - 1) / BENCH_OTA_BLOCK_SIZE;
+}
+
+static const bench_stage_t m_stages[] = {
+    {"validate", setup_none, pass_validate, units_frames},
+    {"decode", setup_none, pass_decode, units_frames},
+    {"diff", setup_none, pass_diff, units_frames},
+    {"tx_build", setup_tx_build, pass_tx_build, units_frames},
+    {"opdata", setup_opdata, pass_opdata, units_frames},
+    {"zcl", setup_none, pass_zcl, units_frames},
+    {"temp", setup_none, pass_temp, units_temp},
+    {"e2e", setup_e2e, pass_e2e, units_frames},
+    {"ota", setup_ota, pass_ota, units_ota},
+};
+
+#define STAGE_COUNT (sizeof(m_stages) / sizeof(m_stages[0]))
+
+/**
+ * @brief Byte-wise reference of mhi_frame_sum.
+ */
+static uint16_t sum_reference(const uint8_t *p_data, size_t len)
+{
+    uint16_t sum = 0;
+
+    for (size_t i = 0; i < len; i++)
+    {
+        sum += p_data[i];
+    }
+
+    return sum;
+}
+
+/**
+ * @brief Byte-wise reference of mhi_frame_diff.
+ */
+static uint64_t diff_reference(const uint8_t *p_old, const uint8_t *p_new, size_t len)
+{
+    uint64_t diff = 0;
+
+    for (size_t i = 0; i < len; i++)
+    {
+        if (p_old[i] != p_new[i] && ((i >= MHI_DB0 && i <= MHI_DB14) || (i >= MHI_DB15 && i <= MHI_DB26)))
+        {
+            diff |= 1ULL << i;
+        }
+    }
+
+    return diff;
+}
+
+static uint32_t pass_sum(void)
+{
+    uint32_t result = 0;
+
+    for (size_t i = 0; i < m_frame_count; i++)
+    {
+        result += mhi_frame_sum(m_frames[i], m_lens[i]);
+    }
+
+    return result;
+}
+
+static uint32_t pass_sum_reference(void)
+{
+    uint32_t result = 0;
+
+    for (size_t i = 0; i < m_frame_count; i++)
+    {
+        result += sum_reference(m_frames[i], m_lens[i]);
+    }
+
+    return result;
+}
+
+static uint32_t pass_frame_diff(void)
+{
+    uint32_t result = 0;
+
+    for (size_t i = 1; i < m_frame_count; i++)
+    {
+        result += (uint32_t)mhi_frame_diff(m_frames[i - 1], m_frames[i], m_lens[i]);
+    }
+
+    return result;
+}
+
+static uint32_t pass_frame_diff_reference(void)
+{
+    uint32_t result = 0;
+
+    for (size_t i = 1; i < m_frame_count; i++)
+    {
+        result += (uint32_t)diff_reference(m_frames[i - 1], m_frames[i], m_lens[i]);
+    }
+
+    return result;
+}
+
+/* Frame kernels and their byte-wise references, measured side by side */
+static const bench_stage_t m_kernels[][2] = {
+    {{"checksum", setup_none, pass_sum, units_frames}, {"checksum", setup_none, pass_sum_reference, units_frames}},
+    {{"frame_diff", setup_none, pass_frame_diff, units_frames},
+     {"frame_diff", setup_none, pass_frame_diff_reference, units_frames}},
+};
+
+#define KERNEL_COUNT (sizeof(m_kernels) / sizeof(m_kernels[0]))
+
+/**
+ * @brief Measure stages round robin, one run of every stage after the other, so that a slow
+ * phase of the machine spreads over all stages instead of spoiling every run of one of them.
+ * @param p_stages Stages
+ * @param count Number of stages
+ * @param p_ns Set to the best time per frame of every stage in nanoseconds
+ * @param p_allocs Set to the number of allocations of every stage during the measurement
+ */
+static void stages_measure(const bench_stage_t *p_stages, size_t count, double *p_ns, uint32_t *p_allocs)
+{
+    for (int run = 0; run < BENCH_RUNS; run++)
+    {
+        for (size_t i = 0; i < count; i++)
+        {
+            const bench_stage_t *p_stage = &p_stages[i];
+            long long start;
+            long long elapsed;
+            uint64_t passes = 0;
+            double ns;
+
+            p_stage->p_setup();
+
+            m_allocs = 0;
+            m_counting = true;
+            start = now_ns();
+            do
+            {
+                m_sink += p_stage->p_pass();
+                passes++;
+                elapsed = now_ns() - start;
+            } while (elapsed < BENCH_RUN_NS);
+            m_counting = false;
+
+            ns = (double)elapsed / (double)(passes * p_stage->p_units());
+            if (run == 0 || ns < p_ns[i])
+            {
+                p_ns[i] = ns;
+            }
+            p_allocs[i] = (run == 0 ? 0 : p_allocs[i]) + m_allocs;
+        }
+    }
+}
+
+/**
+ * @brief Check the frame kernels against their byte-wise references, on every span of the
+ * capture frames and on random buffers at every alignment.
+ * @return Number of mismatches
+ */
+static uint32_t kernel_check(void)
+{
+    static uint8_t old_buf[MHI_FRAME_SIZE_EXT + 3];
+    static uint8_t new_buf[MHI_FRAME_SIZE_EXT + 3];
+    uint32_t errors = 0;
+    uint32_t seed = 1;
+
+    for (size_t i = 0; i < m_frame_count; i++)
+    {
+        for (size_t start = 0; start < m_lens[i]; start++)
+        {
+            for (size_t len = 0; start + len <= m_lens[i]; len++)
+            {
+                errors += mhi_frame_sum(&m_frames[i][start], len) != sum_reference(&m_frames[i][start], len);
+            }
+        }
+        if (i > 0)
+        {
+            errors += mhi_frame_diff(m_frames[i - 1], m_frames[i], m_lens[i]) !=
+                      diff_reference(m_frames[i - 1], m_frames[i], m_lens[i]);
+        }
+    }
+
+    for (uint32_t check = 0; check < BENCH_KERNEL_CHECKS; check++)
+    {
+        size_t offset = check % 4;
+        size_t len = (check / 4) % (MHI_FRAME_SIZE_EXT + 1);
+
+        for (size_t i = 0; i < sizeof(old_buf); i++)
+        {
+            /* xorshift32, with runs of equal bytes and of all byte values */
+            seed ^= seed << 13;
+            seed ^= seed >> 17;
+            seed ^= seed << 5;
+            old_buf[i] = (uint8_t)seed;
+            new_buf[i] = (seed >> 8) % 3 ? old_buf[i] : (uint8_t)(seed >> 16);
+        }
+        if (mhi_frame_sum(&old_buf[offset], len) != sum_reference(&old_buf[offset], len) ||
+            mhi_frame_diff(&old_buf[offset], &new_buf[offset], len) !=
+                diff_reference(&old_buf[offset], &new_buf[offset], len))
+        {
+            errors++;
+        }
+    }
+
+    if (errors)
+    {
+        fprintf(stderr, "frame kernels differ from their reference %u times\n", errors);
+    }
+
+    return errors;
+}
+
+/** @brief How the flash work and the SPIS re-arming are done. */
+typedef enum
+{
+    SCHED_SIM_AT_ONCE,   /**< Flash work at once, the SPIS interrupt re-arms. */
+    SCHED_SIM_SCHEDULED, /**< Flash work in the gaps with mhi_sched, the SPIS interrupt re-arms. */
+    SCHED_SIM_REARM,     /**< Flash work at once, the SPIS re-arms through PPI (mhi_spis_nrf.h). */
+    SCHED_SIM_MODES
+} sched_sim_mode_t;
+
+/** @brief Frame timing of a unit against the flash work of the main loop, in microseconds. */
+typedef struct
+{
+    uint64_t now_us;       /**< Simulated time. */
+    uint64_t csn_us;       /**< Next CSN fall. */
+    uint64_t end_us;       /**< End of the running transfer. */
+    uint64_t isr_us;       /**< When the pending SPIS interrupt runs. */
+    uint32_t frame;        /**< Index of the next frame. */
+    uint32_t seed;         /**< Jitter generator. */
+    bool armed;            /**< The SPIS buffers are set for the next frame. */
+    bool transferring;     /**< A transfer is running. */
+    bool isr_pending;      /**< A transfer ended, its interrupt has not run. */
+    bool rearm;            /**< The SPIS re-arms itself when a transfer ends. */
+    bool unread;           /**< The main loop has not read the last frame, with rearm. */
+    uint32_t frames;       /**< Frames received. */
+    uint32_t missed;       /**< Frames lost, CSN fell before the buffers were set. */
+    uint32_t overwritten;  /**< Frames received but overwritten before the main loop read them. */
+    uint32_t stall_max_us; /**< Longest flash stall. */
+    uint32_t erased;       /**< Slot offset below which the pages are erased. */
+    uint32_t erase_end;    /**< Slot offset up to which the erase job erases. */
+    uint32_t erase_pulses; /**< Partial erases of the page at erased. */
+    uint32_t late_erases;  /**< Pages erased when the download entered them. */
+} sched_sim_t;
+
+static sched_sim_t m_sim;
+static mhi_sched_t m_sched;
+
+static uint64_t sim_ticks(uint64_t us)
+{
+    return us * APP_TIMER_CLOCK_FREQ / 1000000;
+}
+
+/**
+ * @brief Next CSN fall of the simulated unit.
+ */
+static uint64_t sim_csn(void)
+{
+    m_sim.seed ^= m_sim.seed << 13;
+    m_sim.seed ^= m_sim.seed >> 17;
+    m_sim.seed ^= m_sim.seed << 5;
+
+    return (uint64_t)(m_sim.frame + 1) * MHI_SIM_FRAME_MS * 1000 + m_sim.seed % (2 * BENCH_SCHED_JITTER_US + 1) -
+           BENCH_SCHED_JITTER_US;
+}
+
+/**
+ * @brief Let time pass, running the SPIS events on the way.
+ * @param us Time to pass
+ * @param stalled The flash stalls the CPU: the SPIS interrupt waits until the time has passed
+ */
+static void sim_run(uint32_t us, bool stalled)
+{
+    uint64_t target = m_sim.now_us + us;
+
+    for (;;)
+    {
+        uint64_t end = m_sim.transferring ? m_sim.end_us : UINT64_MAX;
+        uint64_t isr = m_sim.isr_pending ? m_sim.isr_us : UINT64_MAX;
+
+        if (isr <= target && isr <= end && isr <= m_sim.csn_us)
+        {
+            /* XFER_DONE: the buffers are set for the next frame */
+            mhi_sched_on_xfer(&m_sched, 0, (uint32_t)sim_ticks(isr));
+            m_sim.isr_pending = false;
+            m_sim.armed = true;
+        }
+        else if (end <= target && end <= m_sim.csn_us)
+        {
+            m_sim.transferring = false;
+            m_sim.frames++;
+            if (m_sim.rearm)
+            {
+                m_sim.overwritten += m_sim.unread;
+                m_sim.unread = true;
+                m_sim.armed = true;
+            }
+            else
+            {
+                m_sim.isr_pending = true;
+                m_sim.isr_us = stalled ? target : end;
+            }
+        }
+        else if (m_sim.csn_us <= target)
+        {
+            if (m_sim.armed)
+            {
+                m_sim.transferring = true;
+                m_sim.end_us = m_sim.csn_us + MHI_FRAME_SIZE * MHI_SIM_BYTE_US;
+                m_sim.armed = false;
+            }
+            else
+            {
+                m_sim.missed++;
+            }
+            m_sim.frame++;
+            m_sim.csn_us = sim_csn();
+        }
+        else
+        {
+            break;
+        }
+    }
+
+    if (stalled && us > m_sim.stall_max_us)
+    {
+        m_sim.stall_max_us = us;
+    }
+    app_timer_shim_advance((uint32_t)(sim_ticks(target) - sim_ticks(m_sim.now_us)));
+    m_sim.now_us = target;
+}
+
+/**
+ * @brief Erase a page of the slot, nothing to do when the erase job got there first.
+ */
+static bool sim_erase(uint32_t offset)
+{
+    if (offset < m_sim.erased)
+    {
+        return true;
+    }
+
+    m_sim.late_erases++;
+    sim_run(BENCH_SCHED_ERASE_US, true);
+    if (offset == m_sim.erased)
+    {
+        m_sim.erased += OTA_SIM_PAGE_SIZE;
+        m_sim.erase_pulses = 0;
+    }
+
+    return ota_sim_flash()->p_erase(offset);
+}
+
+static bool sim_write(uint32_t offset, const void *p_data, uint32_t len)
+{
+    sim_run((len + 3) / 4 * BENCH_SCHED_WORD_US, true);
+
+    return ota_sim_flash()->p_write(offset, p_data, len);
+}
+
+static bool sim_read(uint32_t offset, void *p_data, uint32_t len)
+{
+    return ota_sim_flash()->p_read(offset, p_data, len);
+}
+
+/**
+ * @brief Partial erase of the next slot page, the erase job of mhi_ota_nrf.
+ */
+static bool sim_erase_step(void *p_context)
+{
+    (void)p_context;
+
+    if (m_sim.erased >= m_sim.erase_end)
+    {
+        return true;
+    }
+
+    sim_run(BENCH_SCHED_ERASE_STEP_US, true);
+    if (++m_sim.erase_pulses == (BENCH_SCHED_ERASE_US + BENCH_SCHED_ERASE_STEP_US - 1) / BENCH_SCHED_ERASE_STEP_US)
+    {
+        (void)ota_sim_flash()->p_erase(m_sim.erased);
+        m_sim.erased += OTA_SIM_PAGE_SIZE;
+        m_sim.erase_pulses = 0;
+    }
+
+    return m_sim.erased >= m_sim.erase_end;
+}
+
+/**
+ * @brief NVRAM dataset save.
+ */
+static bool sim_nvram_step(void *p_context)
+{
+    (void)p_context;
+    sim_run(BENCH_SCHED_NVRAM_US, true);
+
+    return true;
+}
+
+/**
+ * @brief Download the OTA file of the OTA stage while the unit sends frames, saving the NVRAM
+ * every BENCH_SCHED_NVRAM_MS.
+ * @param mode Flash work and SPIS re-arming
+ * @return Status of the OTA pipeline after verification
+ */
+static mhi_ota_status_t sched_sim(sched_sim_mode_t mode)
+{
+    bool scheduled = mode == SCHED_SIM_SCHEDULED;
+    static const mhi_ota_flash_t flash = {
+        .page_size = OTA_SIM_PAGE_SIZE,
+        .slot_size = OTA_SIM_SLOT_SIZE,
+        .p_erase = sim_erase,
+        .p_write = sim_write,
+        .p_read = sim_read,
+    };
+    mhi_ota_status_t status;
+    uint64_t block_us;
+    uint64_t nvram_us;
+
+    setup_ota();
+    memset(&m_sim, 0, sizeof(m_sim));
+    m_sim.seed = 1;
+    m_sim.armed = true;
+    m_sim.rearm = mode == SCHED_SIM_REARM;
+    m_sim.csn_us = sim_csn();
+    (void)app_timer_init();
+    mhi_sched_init(&m_sched, 1);
+    mhi_sched_xfer_set(&m_sched, 0, MHI_FRAME_SIZE * MHI_SIM_BYTE_US);
+
+    while (m_sim.now_us < BENCH_SCHED_START_MS * 1000)
+    {
+        m_sim.unread = false;
+        sim_run(BENCH_SCHED_LOOP_US, false);
+    }
+    status = mhi_ota_start(&m_ota, &flash, m_ota_sim.file_size);
+    if (scheduled)
+    {
+        m_sim.erase_end = (m_ota_sim.file_size + OTA_SIM_PAGE_SIZE - 1) & ~(OTA_SIM_PAGE_SIZE - 1UL);
+        (void)mhi_sched_submit(&m_sched, sim_erase_step, NULL, BENCH_SCHED_ERASE_STEP_US + 500);
+    }
+
+    block_us = m_sim.now_us;
+    nvram_us = m_sim.now_us + BENCH_SCHED_NVRAM_MS * 1000;
+    while (status == MHI_OTA_OK && m_ota.file_offset < m_ota_sim.file_size)
+    {
+        m_sim.unread = false;
+        if (m_sim.now_us >= block_us)
+        {
+            uint32_t offset = m_ota.file_offset;
+            uint32_t len = m_ota_sim.file_size - offset;
+
+            len = len < BENCH_OTA_BLOCK_SIZE ? len : BENCH_OTA_BLOCK_SIZE;
+            status = mhi_ota_block(&m_ota, offset, &m_ota_sim.file[offset], len);
+            block_us += BENCH_SCHED_BLOCK_MS * 1000;
+        }
+        if (m_sim.now_us >= nvram_us)
+        {
+            if (!scheduled || !mhi_sched_submit(&m_sched, sim_nvram_step, NULL, BENCH_SCHED_NVRAM_US))
+            {
+                (void)sim_nvram_step(NULL);
+            }
+            nvram_us += BENCH_SCHED_NVRAM_MS * 1000;
+        }
+        if (scheduled)
+        {
+            mhi_sched_run(&m_sched);
+        }
+        sim_run(BENCH_SCHED_LOOP_US, false);
+    }
+
+    return status == MHI_OTA_OK ? mhi_ota_verify(&m_ota) : status;
+}
+
+/**
+ * @brief Replay the capture through a unit and count the room temperature reports.
+ * @param window Median window of the room temperature filter
+ * @param band Hysteresis band of the room temperature filter
+ * @param p_suppressed Set to the updates suppressed by the filter
+ * @return Room temperature reports per hour, at one frame per MHI_SIM_FRAME_MS
+ */
+static double reports_per_hour(uint8_t window, uint8_t band, uint32_t *p_suppressed)
+{
+    uint32_t reports = 0;
+
+    mhi_unit_init(&m_unit, BENCH_ENDPOINT);
+    mhi_filter_init(&m_unit.room_filter, window, band);
+    mhi_link_tx_get(&m_unit.link, m_tx_buf);
+
+    for (size_t i = 0; i < m_frame_count; i++)
+    {
+        mhi_unit_on_xfer_done(&m_unit, m_frames[i], m_lens[i], app_timer_cnt_get(), m_tx_buf);
+        if (mhi_unit_process(&m_unit) & MHI_FIELD_BIT(MHI_FIELD_ROOM_TEMP))
+        {
+            reports++;
+        }
+    }
+    *p_suppressed = m_unit.room_filter.suppressed;
+
+    return reports * 3600000.0 / ((double)m_frame_count * MHI_SIM_FRAME_MS);
+}
+
+/**
+ * @brief Register the attributes set by mhi_zcl_publish.
+ */
+static void attrs_register(void)
+{
+    zb_shim_attr_register(BENCH_ENDPOINT, ZB_ZCL_CLUSTER_ID_ON_OFF, ZB_ZCL_ATTR_ON_OFF_ON_OFF_ID, 1);
+    zb_shim_attr_register(BENCH_ENDPOINT, ZB_ZCL_CLUSTER_ID_FAN_CONTROL, ZB_ZCL_ATTR_FAN_CONTROL_FAN_MODE_ID, 1);
+    zb_shim_attr_register(BENCH_ENDPOINT, ZB_ZCL_CLUSTER_ID_TEMP_MEASUREMENT, ZB_ZCL_ATTR_TEMP_MEASUREMENT_VALUE_ID, 2);
+    zb_shim_attr_register(BENCH_ENDPOINT, ZB_ZCL_CLUSTER_ID_THERMOSTAT, ZB_ZCL_ATTR_THERMOSTAT_LOCAL_TEMPERATURE_ID, 2);
+    zb_shim_attr_register(BENCH_ENDPOINT, ZB_ZCL_CLUSTER_ID_THERMOSTAT, ZB_ZCL_ATTR_THERMOSTAT_OCCUPIED_COOLING_SETPOINT_ID, 2);
+    zb_shim_attr_register(BENCH_ENDPOINT, ZB_ZCL_CLUSTER_ID_THERMOSTAT, ZB_ZCL_ATTR_THERMOSTAT_OCCUPIED_HEATING_SETPOINT_ID, 2);
+    zb_shim_attr_register(BENCH_ENDPOINT, ZB_ZCL_CLUSTER_ID_THERMOSTAT, ZB_ZCL_ATTR_THERMOSTAT_SYSTEM_MODE_ID, 1);
+}
+
+int main(int argc, char *argv[])
+{
+    FILE *p_file;
+    FILE *p_out = stdout;
+    uint32_t total_allocs = 0;
+    uint32_t suppressed;
+    double unfiltered;
+    double filtered;
+    double stage_ns[STAGE_COUNT];
+    uint32_t stage_allocs[STAGE_COUNT];
+    double kernel_ns[KERNEL_COUNT][2];
+    uint32_t kernel_allocs[KERNEL_COUNT][2];
+    size_t len;
+
+    if (argc < 2)
+    {
+        fprintf(stderr, "usage: %s capture.txt [output.json]\n", argv[0]);
+        return 1;
+    }
+
+    p_file = fopen(argv[1], "r");
+    if (p_file == NULL)
+    {
+        perror(argv[1]);
+        return 1;
+    }
+    while (m_frame_count < BENCH_MAX_FRAMES && (len = capture_read(p_file, m_frames[m_frame_count])) > 0)
+    {
+        m_lens[m_frame_count] = (uint8_t)len;
+        mhi_state_decode(m_frames[m_frame_count], len, &m_states[m_frame_count]);
+        m_frame_count++;
+    }
+    fclose(p_file);
+
+    if (m_frame_count < 2)
+    {
+        fprintf(stderr, "%s: not enough frames\n", argv[1]);
+        return 1;
+    }
+
+    if (argc > 2)
+    {
+        p_out = fopen(argv[2], "w");
+        if (p_out == NULL)
+        {
+            perror(argv[2]);
+            return 1;
+        }
+    }
+
+    if (temp_check() || kernel_check())
+    {
+        return 1;
+    }
+
+    attrs_register();
+
+    stages_measure(m_stages, STAGE_COUNT, stage_ns, stage_allocs);
+    stages_measure(&m_kernels[0][0], 2 * KERNEL_COUNT, &kernel_ns[0][0], &kernel_allocs[0][0]);
+
+    fprintf(p_out, "{\n  \"frames\": %zu,\n  \"stages\": {\n", m_frame_count);
+    for (size_t i = 0; i < STAGE_COUNT; i++)
+    {
+        total_allocs += stage_allocs[i];
+        fprintf(p_out, "    \"%s\": {\"ns_per_frame\": %.2f, \"allocs\": %u}%s\n", m_stages[i].p_name, stage_ns[i],
+                stage_allocs[i], i + 1 < STAGE_COUNT ? "," : "");
+    }
+    fprintf(p_out, "  },\n  \"kernels\": {\n");
+    for (size_t i = 0; i < KERNEL_COUNT; i++)
+    {
+        fprintf(p_out, "    \"%s\": {\"ns_per_frame\": %.2f, \"reference_ns_per_frame\": %.2f}%s\n",
+                m_kernels[i][0].p_name, kernel_ns[i][0], kernel_ns[i][1], i + 1 < KERNEL_COUNT ? "," : "");
+    }
+    fprintf(p_out, "  },\n");
+
+    unfiltered = reports_per_hour(1, 0, &suppressed);
+    filtered = reports_per_hour(MHI_ROOM_TEMP_FILTER_WINDOW, MHI_ROOM_TEMP_FILTER_BAND, &suppressed);
+    fprintf(p_out, "  \"reports\": {\"room_temp_per_hour\": {\"unfiltered\": %.0f, \"filtered\": %.0f}, \"suppressed\": %u},\n",
+            unfiltered, filtered, suppressed);
+
+    fprintf(p_out, "  \"sched\": {\n");
+    for (sched_sim_mode_t mode = 0; mode < SCHED_SIM_MODES; mode++)
+    {
+        static const char *const p_names[SCHED_SIM_MODES] = {"unscheduled", "scheduled", "rearm"};
+
+        if (sched_sim(mode) != MHI_OTA_OK)
+        {
+            fprintf(stderr, "OTA download against the frames failed\n");
+            return 1;
+        }
+        fprintf(p_out,
+                "    \"%s\": {\"frames\": %u, \"missed\": %u, \"overwritten\": %u, \"stall_max_us\": %u, "
+                "\"late_erases\": %u, \"steps\": %u}%s\n",
+                p_names[mode], m_sim.frames, m_sim.missed, m_sim.overwritten, m_sim.stall_max_us, m_sim.late_erases,
+                m_sched.steps, mode + 1 < SCHED_SIM_MODES ? "," : "");
+        if (mode != SCHED_SIM_AT_ONCE && m_sim.missed)
+        {
+            fprintf(stderr, "transfers left without an answer %s: %u\n", p_names[mode], m_sim.missed);
+            return 1;
+        }
+    }
+    fprintf(p_out, "  }\n}\n");
+
+    if (p_out != stdout)
+    {
+        fclose(p_out);
+    }
+
+    if (total_allocs)
+    {
+        fprintf(stderr, "heap allocations in the pipeline: %u\n", total_allocs);
+        return 1;
+    }
+
+    return 0;
+}
@@ -0,0 +1,52 @@
+/**
+ * @file capture.c
+ * @brief Capture files of RX frames
+ */
+
+#include <ctype.h>
+#include <stdlib.h>
+
+#include "capture.h"
+#include "include/mhi_frame.h"
+
+size_t capture_read(FILE *p_file, uint8_t *p_rx)
+{
+    char line[256];
+
+    while (fgets(line, sizeof(line), p_file) != NULL)
+    {
+        size_t len = 0;
+        char *p = line;
+
+        while (*p != '\0' && *p != '#' && len < MHI_FRAME_SIZE_EXT)
+        {
+            if (isxdigit((unsigned char)p[0]) && isxdigit((unsigned char)p[1]))
+            {
+                char byte[3] = {p[0], p[1], '\0'};
+
+                p_rx[len++] = (uint8_t)strtoul(byte, NULL, 16);
+                p += 2;
+            }
+            else
+            {
+                p++;
+            }
+        }
+
+        if (len > 0)
+        {
+            return len;
+        }
+    }
+
+    return 0;
+}
+
+void capture_write(FILE *p_file, const uint8_t *p_rx, size_t len)
+{
+    for (size_t i = 0; i < len; i++)
+    {
+        fprintf(p_file, i ? " %02x" : "%02x", p_rx[i]);
+    }
+    fprintf(p_file, "\n");
+}
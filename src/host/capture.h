@@ -0,0 +1,26 @@
+/**
+ * @file capture.h
+ * @brief Capture files of RX frames: one frame per line in hex, '#' starts a comment
+ */
+
+#ifndef HOST_CAPTURE_H
+#define HOST_CAPTURE_H 1
+
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+
+/**
+ * @brief Read the next frame from a capture file.
+ * @param p_file Capture file
+ * @param p_rx Buffer for the frame, MHI_FRAME_SIZE_EXT bytes
+ * @return Frame length, 0 at the end of the file
+ */
+size_t capture_read(FILE *p_file, uint8_t *p_rx);
+
+/**
+ * @brief Write a frame to a capture file.
+ */
+void capture_write(FILE *p_file, const uint8_t *p_rx, size_t len);
+
+#endif /* HOST_CAPTURE_H */
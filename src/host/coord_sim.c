@@ -0,0 +1,557 @@
+/**
+ * @file coord_sim.c
+ * @brief Stand-in Zigbee coordinator for the host build, end-to-end command throughput
+ */
+
+#include <string.h>
+
+#include "app_timer.h"
+
+#include "coord_sim.h"
+#include "include/mhi_unit.h"
+#include "include/mhi_zcl.h"
+#include "mhi_sim.h"
+
+#define COORD_SIM_ENDPOINT 1       /* MHI_ENDPOINT */
+#define COORD_SIM_WARMUP_MS 1000   /* Before the first write, the unit is available by then */
+#define COORD_SIM_SETTLE_MS 5000   /* After the last write, for the commands still active */
+#define COORD_SIM_QUEUE_SIZE 4096  /* Messages in flight per direction */
+#define COORD_SIM_REPORTING_MAX 16 /* Attributes with reporting configured */
+#define COORD_SIM_STEP_US 1000     /* Main loop period */
+#define COORD_SIM_WRITE_NONE 0xFF  /* Field not waiting for a write */
+
+#ifndef ARRAY_SIZE
+#define ARRAY_SIZE(arr) (sizeof(arr) / sizeof((arr)[0]))
+#endif
+
+/** @brief ZCL message on the transport. */
+typedef enum
+{
+    MSG_WRITE,
+    MSG_WRITE_RESP,
+    MSG_READ,
+    MSG_READ_RESP,
+    MSG_CONFIGURE,
+    MSG_CONFIGURE_RESP,
+    MSG_REPORT,
+} msg_type_t;
+
+typedef struct
+{
+    uint64_t due_us;        /* Delivery time */
+    uint64_t sent_us;       /* Time the coordinator sent the request */
+    uint8_t type;           /* msg_type_t */
+    zb_uint8_t status;      /* ZCL status of a response */
+    zb_uint16_t cluster_id;
+    zb_uint16_t attr_id;
+    int32_t value;          /* Written, read or reported value */
+    uint16_t min_s;         /* Minimum reporting interval */
+    uint16_t max_s;         /* Maximum reporting interval, 0 for none */
+    uint32_t change;        /* Reportable change, 0 for any */
+} msg_t;
+
+/** @brief One direction of the transport, delivered in order. */
+typedef struct
+{
+    msg_t msg[COORD_SIM_QUEUE_SIZE];
+    uint32_t head;
+    uint32_t tail;
+} queue_t;
+
+/** @brief Reporting of an attribute on the device. */
+typedef struct
+{
+    zb_uint16_t cluster_id;
+    zb_uint16_t attr_id;
+    uint16_t min_s;
+    uint16_t max_s;
+    uint32_t change;
+    bool reported; /* A report was sent since the configuration */
+    int32_t last;  /* Value of the last report */
+    uint64_t last_us;
+} reporting_t;
+
+/** @brief Write whose fields have not all reached a MOSI frame yet. */
+typedef struct
+{
+    uint64_t sent_us; /* Time the coordinator sent it */
+    uint32_t fields;  /* Fields still waiting for a MOSI frame, 0 for a free entry */
+} write_t;
+
+/* Writes sent in turn when none are given, each changes the AC state */
+static const coord_sim_write_t m_default_writes[] = {
+    {ZB_ZCL_CLUSTER_ID_ON_OFF, ZB_ZCL_ATTR_ON_OFF_ON_OFF_ID, 1},
+    {ZB_ZCL_CLUSTER_ID_THERMOSTAT, ZB_ZCL_ATTR_THERMOSTAT_OCCUPIED_COOLING_SETPOINT_ID, 2200},
+    {ZB_ZCL_CLUSTER_ID_FAN_CONTROL, ZB_ZCL_ATTR_FAN_CONTROL_FAN_MODE_ID, ZB_ZCL_FAN_CONTROL_FAN_MODE_LOW},
+    {ZB_ZCL_CLUSTER_ID_THERMOSTAT, ZB_ZCL_ATTR_THERMOSTAT_SYSTEM_MODE_ID, ZB_ZCL_THERMOSTAT_SYSTEM_MODE_COOL},
+    {ZB_ZCL_CLUSTER_ID_THERMOSTAT, ZB_ZCL_ATTR_THERMOSTAT_OCCUPIED_COOLING_SETPOINT_ID, 2400},
+    {ZB_ZCL_CLUSTER_ID_FAN_CONTROL, ZB_ZCL_ATTR_FAN_CONTROL_FAN_MODE_ID, ZB_ZCL_FAN_CONTROL_FAN_MODE_HIGH},
+    {ZB_ZCL_CLUSTER_ID_THERMOSTAT, ZB_ZCL_ATTR_THERMOSTAT_SYSTEM_MODE_ID, ZB_ZCL_THERMOSTAT_SYSTEM_MODE_HEAT},
+};
+
+/* Reporting a hub configures when binding: intervals in seconds, changes in attribute units */
+static const struct
+{
+    zb_uint16_t cluster_id;
+    zb_uint16_t attr_id;
+    uint16_t min_s;
+    uint16_t max_s;
+    uint32_t change;
+} m_hub_reporting[] = {
+    {ZB_ZCL_CLUSTER_ID_ON_OFF, ZB_ZCL_ATTR_ON_OFF_ON_OFF_ID, 0, 3600, 0},
+    {ZB_ZCL_CLUSTER_ID_THERMOSTAT, ZB_ZCL_ATTR_THERMOSTAT_SYSTEM_MODE_ID, 0, 3600, 0},
+    {ZB_ZCL_CLUSTER_ID_THERMOSTAT, ZB_ZCL_ATTR_THERMOSTAT_OCCUPIED_COOLING_SETPOINT_ID, 0, 3600, 10},
+    {ZB_ZCL_CLUSTER_ID_THERMOSTAT, ZB_ZCL_ATTR_THERMOSTAT_OCCUPIED_HEATING_SETPOINT_ID, 0, 3600, 10},
+    {ZB_ZCL_CLUSTER_ID_THERMOSTAT, ZB_ZCL_ATTR_THERMOSTAT_LOCAL_TEMPERATURE_ID, 10, 3600, 10},
+    {ZB_ZCL_CLUSTER_ID_FAN_CONTROL, ZB_ZCL_ATTR_FAN_CONTROL_FAN_MODE_ID, 0, 3600, 0},
+    {ZB_ZCL_CLUSTER_ID_TEMP_MEASUREMENT, ZB_ZCL_ATTR_TEMP_MEASUREMENT_VALUE_ID, 10, 300, 10},
+    {ZB_ZCL_CLUSTER_ID_METERING, ZB_ZCL_ATTR_METERING_CURRENT_SUMMATION_DELIVERED_ID, 10, 3600, 1},
+};
+
+static mhi_unit_t m_unit;
+static mhi_sim_t m_sim;
+static uint8_t m_tx[MHI_FRAME_SIZE_EXT];
+static queue_t m_to_device;
+static queue_t m_to_coord;
+static reporting_t m_reporting[COORD_SIM_REPORTING_MAX];
+static uint32_t m_reporting_count;
+static uint64_t m_now_us;
+static uint64_t m_delay_us;
+static write_t m_write[MHI_FIELD_COUNT];        /* Writes waiting for MOSI, each holds at least one field */
+static uint8_t m_write_of[MHI_FIELD_COUNT];     /* Write each field waits for, COORD_SIM_WRITE_NONE for none */
+static uint8_t m_write_value[MHI_FIELD_COUNT];  /* Its value, in raw MHI encoding */
+static uint64_t m_latency_sum;
+static uint32_t m_seed;                         /* Send time noise */
+static coord_sim_result_t *m_p_result;
+
+/**
+ * @brief Put a message on the transport, delivered after the one-way delay.
+ */
+static void send(queue_t *p_queue, msg_t *p_msg)
+{
+    if (p_queue->head - p_queue->tail >= COORD_SIM_QUEUE_SIZE)
+    {
+        return;
+    }
+
+    p_msg->due_us = m_now_us + m_delay_us;
+    p_queue->msg[p_queue->head++ % COORD_SIM_QUEUE_SIZE] = *p_msg;
+}
+
+/**
+ * @brief Take the next message that is due.
+ */
+static bool receive(queue_t *p_queue, msg_t *p_msg)
+{
+    if (p_queue->tail == p_queue->head || p_queue->msg[p_queue->tail % COORD_SIM_QUEUE_SIZE].due_us > m_now_us)
+    {
+        return false;
+    }
+
+    *p_msg = p_queue->msg[p_queue->tail++ % COORD_SIM_QUEUE_SIZE];
+    return true;
+}
+
+/**
+ * @brief Count the attribute changes on the device.
+ */
+static void attr_hook(zb_uint8_t ep, zb_uint16_t cluster_id, zb_uint16_t attr_id,
+                      const zb_uint8_t *value, size_t size, bool changed)
+{
+    (void)ep;
+    (void)cluster_id;
+    (void)attr_id;
+    (void)value;
+    (void)size;
+
+    if (changed)
+    {
+        m_p_result->changes++;
+    }
+}
+
+/**
+ * @brief Handle a Write Attributes on the device: store the value, then hand it to the unit
+ * like the device callback of main.c. Starts the latency of the write when it changes a field.
+ */
+static zb_uint8_t device_write(const msg_t *p_msg)
+{
+    zb_uint8_t value[4] = {(zb_uint8_t)p_msg->value, (zb_uint8_t)(p_msg->value >> 8),
+                           (zb_uint8_t)(p_msg->value >> 16), (zb_uint8_t)(p_msg->value >> 24)};
+    uint32_t pending = m_unit.cmd.pending;
+    uint8_t requested[MHI_FIELD_COUNT];
+    uint32_t fields = 0;
+    uint32_t slot = 0;
+    zb_uint8_t status;
+
+    memcpy(requested, m_unit.cmd.value, sizeof(requested));
+
+    status = ZB_ZCL_SET_ATTRIBUTE(COORD_SIM_ENDPOINT, p_msg->cluster_id, ZB_ZCL_CLUSTER_SERVER_ROLE, p_msg->attr_id,
+                                  value, ZB_FALSE);
+    if (status != ZB_ZCL_STATUS_SUCCESS)
+    {
+        return status;
+    }
+    if (!mhi_unit_zcl_write(&m_unit, p_msg->cluster_id, p_msg->attr_id, (uint32_t)p_msg->value))
+    {
+        return ZB_ZCL_STATUS_INVALID_VALUE;
+    }
+
+    for (uint32_t field = 0; field < MHI_FIELD_COUNT; field++)
+    {
+        if (!(m_unit.cmd.pending & MHI_FIELD_BIT(field)) ||
+            ((pending & MHI_FIELD_BIT(field)) && requested[field] == m_unit.cmd.value[field]))
+        {
+            /* Not written, or riding along with the same value */
+            continue;
+        }
+        if (m_write_of[field] != COORD_SIM_WRITE_NONE)
+        {
+            write_t *p_prev = &m_write[m_write_of[field]];
+
+            p_prev->fields &= ~MHI_FIELD_BIT(field);
+            if (p_prev->fields == 0)
+            {
+                m_p_result->superseded++;
+            }
+        }
+        fields |= MHI_FIELD_BIT(field);
+    }
+    if (fields == 0)
+    {
+        return ZB_ZCL_STATUS_SUCCESS;
+    }
+
+    /* Every write in use holds a field this one does not, so an entry is free */
+    while (m_write[slot].fields != 0)
+    {
+        slot++;
+    }
+    m_write[slot].sent_us = p_msg->sent_us;
+    m_write[slot].fields = fields;
+    for (uint32_t field = 0; field < MHI_FIELD_COUNT; field++)
+    {
+        if (fields & MHI_FIELD_BIT(field))
+        {
+            m_write_of[field] = (uint8_t)slot;
+            m_write_value[field] = m_unit.cmd.value[field];
+        }
+    }
+
+    return ZB_ZCL_STATUS_SUCCESS;
+}
+
+/**
+ * @brief Configure the reporting of an attribute on the device.
+ */
+static zb_uint8_t device_configure(const msg_t *p_msg)
+{
+    reporting_t *p_reporting = NULL;
+    int32_t value;
+
+    if (!zb_shim_attr_get(COORD_SIM_ENDPOINT, p_msg->cluster_id, p_msg->attr_id, &value))
+    {
+        return ZB_ZCL_STATUS_UNSUP_ATTRIB;
+    }
+
+    for (uint32_t i = 0; i < m_reporting_count && p_reporting == NULL; i++)
+    {
+        if (m_reporting[i].cluster_id == p_msg->cluster_id && m_reporting[i].attr_id == p_msg->attr_id)
+        {
+            p_reporting = &m_reporting[i];
+        }
+    }
+    if (p_reporting == NULL)
+    {
+        if (m_reporting_count == COORD_SIM_REPORTING_MAX)
+        {
+            return ZB_ZCL_STATUS_INSUFF_SPACE;
+        }
+        p_reporting = &m_reporting[m_reporting_count++];
+    }
+
+    memset(p_reporting, 0, sizeof(*p_reporting));
+    p_reporting->cluster_id = p_msg->cluster_id;
+    p_reporting->attr_id = p_msg->attr_id;
+    p_reporting->min_s = p_msg->min_s;
+    p_reporting->max_s = p_msg->max_s;
+    p_reporting->change = p_msg->change;
+
+    return ZB_ZCL_STATUS_SUCCESS;
+}
+
+/**
+ * @brief Answer the requests that reached the device.
+ */
+static void device_receive(void)
+{
+    msg_t msg;
+
+    while (receive(&m_to_device, &msg))
+    {
+        switch (msg.type)
+        {
+        case MSG_WRITE:
+            msg.status = device_write(&msg);
+            msg.type = MSG_WRITE_RESP;
+            break;
+        case MSG_READ:
+            msg.status = zb_shim_attr_get(COORD_SIM_ENDPOINT, msg.cluster_id, msg.attr_id, &msg.value)
+                             ? ZB_ZCL_STATUS_SUCCESS
+                             : ZB_ZCL_STATUS_UNSUP_ATTRIB;
+            msg.type = MSG_READ_RESP;
+            break;
+        case MSG_CONFIGURE:
+            msg.status = device_configure(&msg);
+            msg.type = MSG_CONFIGURE_RESP;
+            break;
+        default:
+            continue;
+        }
+        send(&m_to_coord, &msg);
+    }
+}
+
+/**
+ * @brief Send the reports that are due, like the reporting of ZBOSS.
+ */
+static void device_report(void)
+{
+    for (uint32_t i = 0; i < m_reporting_count; i++)
+    {
+        reporting_t *p_reporting = &m_reporting[i];
+        uint64_t since_us = m_now_us - p_reporting->last_us;
+        int64_t delta;
+        int32_t value;
+        msg_t msg;
+
+        (void)zb_shim_attr_get(COORD_SIM_ENDPOINT, p_reporting->cluster_id, p_reporting->attr_id, &value);
+        delta = (int64_t)value - p_reporting->last;
+        delta = delta < 0 ? -delta : delta;
+
+        if (p_reporting->reported &&
+            (delta == 0 || delta < p_reporting->change || since_us < p_reporting->min_s * 1000000ULL) &&
+            (p_reporting->max_s == 0 || since_us < p_reporting->max_s * 1000000ULL))
+        {
+            continue;
+        }
+
+        p_reporting->reported = true;
+        p_reporting->last = value;
+        p_reporting->last_us = m_now_us;
+
+        memset(&msg, 0, sizeof(msg));
+        msg.type = MSG_REPORT;
+        msg.cluster_id = p_reporting->cluster_id;
+        msg.attr_id = p_reporting->attr_id;
+        msg.value = value;
+        send(&m_to_coord, &msg);
+    }
+}
+
+/**
+ * @brief Send time of the n-th request at a rate: on the rate grid, late by up to a frame so
+ * the requests do not keep one phase against the frames.
+ */
+static uint64_t request_us(uint32_t n, uint32_t rate)
+{
+    m_seed = m_seed * 1103515245 + 12345;
+
+    return COORD_SIM_WARMUP_MS * 1000ULL + n * 1000000ULL / rate + (m_seed >> 8) % (MHI_SIM_FRAME_MS * 1000);
+}
+
+/**
+ * @brief Send a request from the coordinator.
+ */
+static void coord_send(uint8_t type, zb_uint16_t cluster_id, zb_uint16_t attr_id, int32_t value)
+{
+    msg_t msg;
+
+    memset(&msg, 0, sizeof(msg));
+    msg.type = type;
+    msg.sent_us = m_now_us;
+    msg.cluster_id = cluster_id;
+    msg.attr_id = attr_id;
+    msg.value = value;
+    send(&m_to_device, &msg);
+}
+
+/**
+ * @brief Take the responses and reports that reached the coordinator.
+ */
+static void coord_receive(coord_sim_result_t *p_result)
+{
+    msg_t msg;
+
+    while (receive(&m_to_coord, &msg))
+    {
+        switch (msg.type)
+        {
+        case MSG_WRITE_RESP:
+            p_result->rejected += msg.status != ZB_ZCL_STATUS_SUCCESS;
+            break;
+        case MSG_READ_RESP:
+            p_result->read_errors += msg.status != ZB_ZCL_STATUS_SUCCESS;
+            break;
+        case MSG_CONFIGURE_RESP:
+            p_result->configured += msg.status == ZB_ZCL_STATUS_SUCCESS;
+            break;
+        case MSG_REPORT:
+            if (p_result->reports < COORD_SIM_REPORTS_MAX)
+            {
+                coord_sim_report_t *p_report = &p_result->report[p_result->reports];
+
+                p_report->time_ms = (uint32_t)(m_now_us / 1000);
+                p_report->cluster_id = msg.cluster_id;
+                p_report->attr_id = msg.attr_id;
+                p_report->value = msg.value;
+            }
+            p_result->reports++;
+            break;
+        default:
+            break;
+        }
+    }
+}
+
+/**
+ * @brief Take a field off the write it waits for when the MOSI frame carries its value with
+ * the set bit. The latency of the write ends with its last field.
+ */
+static void mosi_check(mhi_field_t field, uint8_t value, coord_sim_result_t *p_result)
+{
+    write_t *p_write;
+    uint64_t latency_us;
+
+    if (m_write_of[field] == COORD_SIM_WRITE_NONE || m_write_value[field] != value)
+    {
+        return;
+    }
+
+    p_write = &m_write[m_write_of[field]];
+    m_write_of[field] = COORD_SIM_WRITE_NONE;
+    p_write->fields &= ~MHI_FIELD_BIT(field);
+    if (p_write->fields != 0)
+    {
+        return;
+    }
+
+    latency_us = m_now_us - p_write->sent_us;
+    m_latency_sum += latency_us;
+    p_result->latency_count++;
+    if (latency_us > p_result->latency_max_us)
+    {
+        p_result->latency_max_us = (uint32_t)latency_us;
+    }
+}
+
+#define FIELD_MOSI_CHECK(name, byte, mask, shift, offset, set_byte, set_bit, ...)              \
+    if ((set_bit) && (p_tx[set_byte] & (set_bit)))                                             \
+    {                                                                                          \
+        mosi_check(MHI_FIELD_##name, MHI_FIELD_GET(p_tx, byte, mask, shift, offset), p_result); \
+    }
+
+/**
+ * @brief Check the fields of a MOSI frame.
+ */
+static void mosi_frame(const uint8_t *p_tx, coord_sim_result_t *p_result)
+{
+    MHI_FIELDS(FIELD_MOSI_CHECK)
+}
+
+void coord_sim_run(const coord_sim_config_t *p_config, coord_sim_result_t *p_result)
+{
+    const coord_sim_write_t *p_writes = p_config->write_count ? p_config->writes : m_default_writes;
+    uint32_t write_count = p_config->write_count ? p_config->write_count : ARRAY_SIZE(m_default_writes);
+    uint64_t end_us = (COORD_SIM_WARMUP_MS + (uint64_t)p_config->duration_ms) * 1000;
+    uint64_t stop_us = end_us + COORD_SIM_SETTLE_MS * 1000ULL;
+    uint64_t write_us;
+    uint64_t read_us;
+    uint32_t ticks = 0;
+    uint8_t rx_buf[MHI_FRAME_SIZE_EXT];
+
+    memset(p_result, 0, sizeof(*p_result));
+    memset(&m_to_device, 0, sizeof(m_to_device));
+    memset(&m_to_coord, 0, sizeof(m_to_coord));
+    m_reporting_count = 0;
+    m_now_us = 0;
+    m_delay_us = p_config->delay_ms * 1000ULL;
+    m_latency_sum = 0;
+    m_p_result = p_result;
+    m_seed = p_config->seed;
+    write_us = p_config->write_rate ? request_us(0, p_config->write_rate) : UINT64_MAX;
+    read_us = p_config->read_rate ? request_us(0, p_config->read_rate) : UINT64_MAX;
+    memset(m_write, 0, sizeof(m_write));
+    memset(m_write_of, COORD_SIM_WRITE_NONE, sizeof(m_write_of));
+
+    (void)app_timer_init();
+    zb_shim_attr_hook_set(attr_hook);
+    mhi_unit_init(&m_unit, COORD_SIM_ENDPOINT);
+    mhi_link_tx_get(&m_unit.link, m_tx);
+    mhi_sim_init(&m_sim, p_config->seed);
+
+    for (uint32_t i = 0; i < ARRAY_SIZE(m_hub_reporting); i++)
+    {
+        msg_t msg;
+
+        memset(&msg, 0, sizeof(msg));
+        msg.type = MSG_CONFIGURE;
+        msg.cluster_id = m_hub_reporting[i].cluster_id;
+        msg.attr_id = m_hub_reporting[i].attr_id;
+        msg.min_s = m_hub_reporting[i].min_s;
+        msg.max_s = m_hub_reporting[i].max_s;
+        msg.change = m_hub_reporting[i].change;
+        send(&m_to_device, &msg);
+    }
+
+    for (m_now_us = 0; m_now_us < stop_us; m_now_us += COORD_SIM_STEP_US)
+    {
+        /* Requests at their rate, from the end of the warmup on */
+        while (write_us <= m_now_us && write_us < end_us)
+        {
+            const coord_sim_write_t *p_write = &p_writes[p_result->writes++ % write_count];
+
+            coord_send(MSG_WRITE, p_write->cluster_id, p_write->attr_id, (int32_t)p_write->value);
+            write_us = request_us(p_result->writes, p_config->write_rate);
+        }
+        while (read_us <= m_now_us && read_us < end_us)
+        {
+            const coord_sim_write_t *p_read = &p_writes[p_result->reads++ % write_count];
+
+            coord_send(MSG_READ, p_read->cluster_id, p_read->attr_id, 0);
+            read_us = request_us(p_result->reads, p_config->read_rate);
+        }
+
+        device_receive();
+
+        /* What the SPIS interrupt does on the device */
+        if (m_now_us % (MHI_SIM_FRAME_MS * 1000) == 0)
+        {
+            size_t len;
+
+            mosi_frame(m_tx, p_result);
+            len = mhi_sim_xfer(&m_sim, m_tx, rx_buf);
+            if (len != 0)
+            {
+                mhi_unit_on_xfer_done(&m_unit, rx_buf, len, app_timer_cnt_get(), m_tx);
+            }
+        }
+
+        /* The main loop */
+        (void)mhi_unit_process(&m_unit);
+        device_report();
+        coord_receive(p_result);
+
+        /* app_timer ticks are not a whole number of microseconds, follow the simulated time */
+        app_timer_shim_advance(APP_TIMER_TICKS((m_now_us + COORD_SIM_STEP_US) / 1000) - ticks);
+        ticks = APP_TIMER_TICKS((m_now_us + COORD_SIM_STEP_US) / 1000);
+    }
+
+    p_result->applied = m_unit.cmd.stats.applied;
+    p_result->failed = m_unit.cmd.stats.failed;
+    if (p_result->latency_count != 0)
+    {
+        p_result->latency_mean_us = (uint32_t)(m_latency_sum / p_result->latency_count);
+    }
+    zb_shim_attr_hook_set(NULL);
+}
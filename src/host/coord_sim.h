@@ -0,0 +1,90 @@
+/**
+ * @file coord_sim.h
+ * @brief Stand-in Zigbee coordinator for the host build, end-to-end command throughput
+ *
+ * The coordinator talks to the unit through an in-process transport: two queues of ZCL
+ * messages, each delivered after the configured one-way delay. On the device side of the
+ * transport a small stand-in for the ZCL layer of ZBOSS handles what the coordinator sends:
+ * a Write Attributes updates the attribute store and is passed to mhi_unit_zcl_write like the
+ * device callback of main.c does, a Read Attributes is answered from the store, a Configure
+ * Reporting arms the reporting of an attribute. Configured attributes are reported when they
+ * changed by at least their reportable change and the minimum interval has passed since their
+ * last report, or when the maximum interval has passed.
+ *
+ * The coordinator configures the reporting a typical Zigbee hub sets up when binding, then
+ * sends writes and reads at the configured rates while the unit runs against the simulated
+ * AC, with the main loop passing every millisecond. Every report that reaches the coordinator
+ * is recorded. The latency of a write runs from the coordinator sending it to the first MOSI
+ * frame that carries the value of its last field with the set bit; a field written again
+ * before that is taken off the earlier write, which is superseded once it has no field left,
+ * the AC only ever sees the last value.
+ */
+
+#ifndef HOST_COORD_SIM_H
+#define HOST_COORD_SIM_H 1
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#include "zboss_api.h"
+
+#define COORD_SIM_WRITES_MAX 32    /**< Writes the coordinator cycles through. */
+#define COORD_SIM_REPORTS_MAX 4096 /**< Reports recorded, later ones are only counted. */
+
+/** @brief Attribute write of the coordinator script. */
+typedef struct
+{
+    zb_uint16_t cluster_id;
+    zb_uint16_t attr_id;
+    uint32_t value;
+} coord_sim_write_t;
+
+/** @brief Traffic of a simulation. */
+typedef struct
+{
+    uint32_t duration_ms;      /**< Simulated time after the reporting is configured. */
+    uint32_t write_rate;       /**< Writes per second, at most 1000. */
+    uint32_t read_rate;        /**< Reads per second, at most 1000. */
+    uint32_t delay_ms;         /**< One-way delay of the transport. */
+    uint32_t seed;             /**< Seed of the simulated AC. */
+    coord_sim_write_t writes[COORD_SIM_WRITES_MAX]; /**< Writes sent in turn, a default script when none. */
+    uint32_t write_count;      /**< Writes in the script. */
+} coord_sim_config_t;
+
+/** @brief Report received by the coordinator. */
+typedef struct
+{
+    uint32_t time_ms;
+    zb_uint16_t cluster_id;
+    zb_uint16_t attr_id;
+    int32_t value;
+} coord_sim_report_t;
+
+/** @brief Outcome of a simulation. */
+typedef struct
+{
+    uint32_t writes;          /**< Writes sent. */
+    uint32_t rejected;        /**< Writes answered with an error. */
+    uint32_t superseded;      /**< Accepted writes whose fields were all overwritten before they reached the AC. */
+    uint32_t reads;           /**< Reads sent. */
+    uint32_t read_errors;     /**< Reads answered with an error. */
+    uint32_t configured;      /**< Attributes whose reporting was configured. */
+    uint32_t applied;         /**< Field commands confirmed by the AC, a write can carry several. */
+    uint32_t failed;          /**< Field commands given up. */
+    uint32_t latency_count;   /**< Writes whose fields all reached a MOSI frame. */
+    uint32_t latency_mean_us; /**< Mean time from a write to the MOSI frame of its last field. */
+    uint32_t latency_max_us;  /**< Longest time from a write to the MOSI frame of its last field. */
+    uint32_t changes;         /**< Attribute value changes on the device. */
+    uint32_t reports;         /**< Reports received. */
+    coord_sim_report_t report[COORD_SIM_REPORTS_MAX]; /**< The first reports received. */
+} coord_sim_result_t;
+
+/**
+ * @brief Run the coordinator against a unit and a simulated AC. The attributes of the endpoint
+ * must be registered in the attribute store, the attribute hook is taken over.
+ * @param p_config Traffic
+ * @param p_result Outcome
+ */
+void coord_sim_run(const coord_sim_config_t *p_config, coord_sim_result_t *p_result);
+
+#endif /* HOST_COORD_SIM_H */
@@ -0,0 +1,146 @@
+/**
+ * @file group_sim.c
+ * @brief One command to many devices, unicast versus groupcast, for the host build
+ */
+
+#include <string.h>
+
+#include "app_timer.h"
+
+#include "group_sim.h"
+#include "include/mhi_unit.h"
+#include "mhi_sim.h"
+
+#define GROUP_SIM_ENDPOINT 1    /* MHI_ENDPOINT */
+#define GROUP_SIM_WARMUP 10     /* Frames before the command, the units are available by then */
+#define GROUP_SIM_SETTLE 250    /* Frames after the last delivery before giving up on a device */
+
+#define US_PER_BYTE 32          /* 250 kbit/s */
+#define PHY_BYTES 6             /* Preamble, SFD and length */
+#define MAC_DATA_BYTES 11       /* Frame control, sequence, PAN, short addresses and FCS */
+#define MAC_ACK_BYTES 5         /* Frame control, sequence and FCS */
+#define NWK_BYTES 26            /* Header, security auxiliary header and MIC */
+#define APS_UNICAST_BYTES 8     /* Frame control, endpoints, cluster, profile and counter */
+#define APS_GROUP_BYTES 9       /* Frame control, group, cluster, profile, source endpoint and counter */
+#define APS_ACK_BYTES 8         /* Frame control, endpoints, cluster, profile and counter */
+#define ZCL_HEADER_BYTES 3      /* Frame control, sequence and command */
+#define ZCL_WRITE_BYTES 5       /* One Write Attributes record: identifier, type and value */
+
+static mhi_unit_t m_units[GROUP_SIM_UNITS_MAX];
+static mhi_sim_t m_sims[GROUP_SIM_UNITS_MAX];
+static uint8_t m_tx[GROUP_SIM_UNITS_MAX][MHI_FRAME_SIZE_EXT];
+
+/**
+ * @brief Airtime of a frame, in microseconds.
+ */
+static uint32_t airtime(uint32_t bytes)
+{
+    return (PHY_BYTES + bytes) * US_PER_BYTE;
+}
+
+void group_sim_run(const group_sim_config_t *p_config, bool groupcast, group_sim_result_t *p_result)
+{
+    /* On/Off goes as a command without payload, everything else as a Write Attributes */
+    uint32_t zcl = ZCL_HEADER_BYTES + (p_config->cluster_id == ZB_ZCL_CLUSTER_ID_ON_OFF ? 0 : ZCL_WRITE_BYTES);
+    uint32_t data_us = airtime(MAC_DATA_BYTES + NWK_BYTES + (groupcast ? APS_GROUP_BYTES : APS_UNICAST_BYTES) + zcl);
+    uint32_t mac_ack_us = airtime(MAC_ACK_BYTES);
+    uint32_t aps_ack_us = airtime(MAC_DATA_BYTES + NWK_BYTES + APS_ACK_BYTES);
+    uint32_t units = p_config->units < GROUP_SIM_UNITS_MAX ? p_config->units : GROUP_SIM_UNITS_MAX;
+    uint32_t delivered_ms[GROUP_SIM_UNITS_MAX];
+    bool delivered[GROUP_SIM_UNITS_MAX] = {false};
+    bool done[GROUP_SIM_UNITS_MAX] = {false};
+    uint32_t last_ms = 0;
+    uint32_t pending = units;
+    uint64_t latency_sum = 0;
+    uint8_t rx_buf[MHI_FRAME_SIZE_EXT];
+
+    memset(p_result, 0, sizeof(*p_result));
+
+    if (groupcast)
+    {
+        /* No MAC acknowledgement for broadcasts, the retransmissions stand in for it */
+        p_result->frames = p_config->broadcast_tx;
+        p_result->airtime_us = p_config->broadcast_tx * data_us;
+    }
+    else
+    {
+        /* Data, MAC ack, APS ack from the device, MAC ack from the coordinator */
+        p_result->frames = units * 4;
+        p_result->airtime_us = units * (data_us + mac_ack_us + aps_ack_us + mac_ack_us);
+    }
+
+    for (uint32_t i = 0; i < units; i++)
+    {
+        delivered_ms[i] = (groupcast ? 0 : i * p_config->gap_ms) + data_us / 1000;
+        last_ms = delivered_ms[i] > last_ms ? delivered_ms[i] : last_ms;
+    }
+
+    (void)app_timer_init();
+    for (uint32_t i = 0; i < units; i++)
+    {
+        mhi_unit_init(&m_units[i], GROUP_SIM_ENDPOINT);
+        mhi_link_tx_get(&m_units[i].link, m_tx[i]);
+        mhi_sim_init(&m_sims[i], p_config->seed + i);
+    }
+
+    for (uint32_t frame = 0; pending && frame < GROUP_SIM_WARMUP + last_ms / MHI_SIM_FRAME_MS + GROUP_SIM_SETTLE; frame++)
+    {
+        /* Time since the first transmission of the command, at this transfer */
+        int32_t now_ms = ((int32_t)frame - GROUP_SIM_WARMUP) * MHI_SIM_FRAME_MS;
+
+        for (uint32_t i = 0; i < units; i++)
+        {
+            size_t len;
+
+            if (done[i])
+            {
+                continue;
+            }
+
+            /* Every device applies the command through its own coalescing path */
+            if (!delivered[i] && now_ms >= (int32_t)delivered_ms[i])
+            {
+                delivered[i] = true;
+                if (!mhi_unit_zcl_write(&m_units[i], p_config->cluster_id, p_config->attr_id, p_config->value))
+                {
+                    done[i] = true;
+                    p_result->failed++;
+                    pending--;
+                    continue;
+                }
+            }
+
+            len = mhi_sim_xfer(&m_sims[i], m_tx[i], rx_buf);
+            if (len != 0)
+            {
+                mhi_unit_on_xfer_done(&m_units[i], rx_buf, len, app_timer_cnt_get(), m_tx[i]);
+            }
+            (void)mhi_unit_process(&m_units[i]);
+
+            if (delivered[i] && (m_units[i].cmd_failed || !m_units[i].cmd.active))
+            {
+                done[i] = true;
+                pending--;
+                if (m_units[i].cmd_failed)
+                {
+                    p_result->failed++;
+                    continue;
+                }
+                latency_sum += (uint32_t)now_ms;
+                if ((uint32_t)now_ms > p_result->latency_max_ms)
+                {
+                    p_result->latency_max_ms = (uint32_t)now_ms;
+                }
+            }
+        }
+
+        app_timer_shim_advance(APP_TIMER_TICKS(MHI_SIM_FRAME_MS));
+    }
+
+    /* Devices still waiting for their AC at the end gave up on the command */
+    p_result->failed += pending;
+    if (units > p_result->failed)
+    {
+        p_result->latency_mean_ms = (uint32_t)(latency_sum / (units - p_result->failed));
+    }
+}
@@ -0,0 +1,56 @@
+/**
+ * @file group_sim.h
+ * @brief One command to many devices, unicast versus groupcast, for the host build
+ *
+ * Every device runs its own mhi_unit against its own simulated AC, so the command goes
+ * through the same coalescing and tracking path as on a single device. The coordinator either
+ * sends one unicast per device, paced by its host stack and each answered by an APS
+ * acknowledgement, or a single groupcast that is broadcast with its retransmissions.
+ *
+ * The devices are end devices with their receiver always on, children of the coordinator, so
+ * both reach them directly and a groupcast, sent to the rx-on-when-idle broadcast address,
+ * reaches all of them with its first transmission. The airtime counts the frames of the
+ * command at 250 kbit/s, including the MAC and APS acknowledgements.
+ */
+
+#ifndef HOST_GROUP_SIM_H
+#define HOST_GROUP_SIM_H 1
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#include "zboss_api.h"
+
+#define GROUP_SIM_UNITS_MAX 48 /**< Devices in one simulation. */
+
+/** @brief Network and command of a simulation. */
+typedef struct
+{
+    uint32_t units;         /**< Devices, at most GROUP_SIM_UNITS_MAX. */
+    uint32_t gap_ms;        /**< Time between two unicasts of the coordinator. */
+    uint32_t broadcast_tx;  /**< Transmissions of a broadcast, the first one included. */
+    uint32_t seed;          /**< Seed of the simulated ACs. */
+    zb_uint16_t cluster_id; /**< Cluster of the command. */
+    zb_uint16_t attr_id;    /**< Attribute the command writes. */
+    uint32_t value;         /**< Value written. */
+} group_sim_config_t;
+
+/** @brief Outcome of a simulation. */
+typedef struct
+{
+    uint32_t frames;          /**< Frames of the command on the air. */
+    uint32_t airtime_us;      /**< Time these frames occupy the channel. */
+    uint32_t latency_mean_ms; /**< Mean time from the first transmission until the AC applied the command. */
+    uint32_t latency_max_ms;  /**< Time until the last AC applied the command. */
+    uint32_t failed;          /**< Devices on which the command was rejected or given up. */
+} group_sim_result_t;
+
+/**
+ * @brief Deliver the command to all devices and run them until every AC is done with it.
+ * @param p_config Network and command
+ * @param groupcast Send one groupcast instead of a unicast per device
+ * @param p_result Outcome
+ */
+void group_sim_run(const group_sim_config_t *p_config, bool groupcast, group_sim_result_t *p_result);
+
+#endif /* HOST_GROUP_SIM_H */
@@ -0,0 +1,926 @@
+/**
+ * @file host_main.c
+ * @brief Host build of the MHI application core
+ *
+ * Runs the portable core (src/core) on a workstation, against the ZBOSS and nRF SDK stand-ins in
+ * shim/. The SPI transfers come either from a simulated AC unit or from a capture file with one
+ * RX frame per line in hex ('#' starts a comment). Every attribute change is printed on stdout.
+ *
+ *   mhi_host [-n frames] [-s seed] [-j jitter] [-d delay] [-x] [-v] [-r capture] [-o capture]
+ *            [-e corrupt] [-D drop] [-O frame:frames] [-T timeout] [-H hold] [-i ignore]
+ *            [-E frame:error] [-f window:band] [-w cluster:attr=value@frame]...
+ *            [-t temperature@frame]... [-m timeout] [-S command:group:scene@frame]...
+ *            [-I current]
+ *
+ * -t stands in for the reports of a bound remote temperature sensor. -S sends a Scenes command
+ * (0 Add, 1 View, 2 Remove, 3 Remove All, 4 Store, 5 Recall, 6 Get Scene Membership) and
+ * prints its response; the scene tables are saved and loaded back after every change, like
+ * the NVRAM dataset of the device across a reset. -I sets the current opdata of the simulated
+ * AC, its energy counter steps with it; the energy total is saved and loaded back whenever a
+ * save is due.
+ *
+ * With -u, the given firmware image (or Zigbee OTA upgrade file) is pushed through the OTA
+ * pipeline by the stand-in OTA server instead.
+ *
+ *   mhi_host -u image.bin [-b block size] [-B block delay ms] [-R round trip ms]
+ *
+ * With -g, the first -w write is sent to the given number of devices, once as a unicast per
+ * device and once as a groupcast, and the airtime and latency of both are compared.
+ *
+ *   mhi_host -g devices [-G unicast gap ms] [-w cluster:attr=value@frame]
+ *
+ * With -C, a stand-in coordinator configures the reporting of the endpoint, then writes and
+ * reads attributes at the given rates for the given number of seconds, through an in-process
+ * transport with the given one-way delay. The -w writes are sent in turn (their frames are
+ * ignored), by default a script that changes the AC state with every write. The handled
+ * field commands per second, the latency from a write to the MOSI frame of its last field and
+ * the reports per attribute change are printed, with every report when -p is given.
+ *
+ *   mhi_host -C seconds [-W writes/s] [-Q reads/s] [-L delay ms] [-p] [-w cluster:attr=value@frame]...
+ *
+ * With -c, the diagnostic commands of mhi_cli.h are read from stdin instead of running the
+ * given number of frames: "run frames" runs the simulation or replay on, the other commands
+ * look into the unit or drive it like on the log UART of the device. The usual summary is
+ * printed at the end of the input or on "quit".
+ */
+
+#include <getopt.h>
+#include <stdarg.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include "app_timer.h"
+#include "nrf_log.h"
+#include "zboss_api.h"
+
+#include "capture.h"
+#include "coord_sim.h"
+#include "group_sim.h"
+#include "include/mhi_cli.h"
+#include "include/mhi_unit.h"
+#include "include/mhi_zcl.h"
+#include "mhi_sim.h"
+#include "ota_sim.h"
+#include "temp_check.h"
+
+#define HOST_ENDPOINT 1   /**< Endpoint of the unit, same as MHI_ENDPOINT. */
+#define HOST_MAX_WRITES 32 /**< Maximum number of -w options. */
+#define HOST_MAX_REPORTS 32 /**< Maximum number of -t options. */
+#define HOST_MAX_SCENE_CMDS 32 /**< Maximum number of -S options. */
+#define HOST_CLI_LINE_SIZE 256 /**< Longest command line read with -c. */
+
+/** @brief Attribute write scheduled from the command line. */
+typedef struct
+{
+    uint32_t frame;
+    zb_uint16_t cluster_id;
+    zb_uint16_t attr_id;
+    uint32_t value;
+} host_write_t;
+
+/** @brief Remote sensor temperature report scheduled from the command line. */
+typedef struct
+{
+    uint32_t frame;
+    int16_t temperature;
+} host_report_t;
+
+/** @brief Scenes command scheduled from the command line. */
+typedef struct
+{
+    uint32_t frame;
+    zb_uint8_t cmd_id;
+    uint16_t group_id;
+    uint8_t scene_id;
+} host_scene_cmd_t;
+
+/** @brief Attribute declared on the endpoint, mirroring the attribute lists of main.c. */
+typedef struct
+{
+    zb_uint16_t cluster_id;
+    zb_uint16_t attr_id;
+    size_t size;
+} host_attr_t;
+
+static const host_attr_t m_attrs[] = {
+    {ZB_ZCL_CLUSTER_ID_SCENES, ZB_ZCL_ATTR_SCENES_SCENE_COUNT_ID, 1},
+    {ZB_ZCL_CLUSTER_ID_SCENES, ZB_ZCL_ATTR_SCENES_CURRENT_SCENE_ID, 1},
+    {ZB_ZCL_CLUSTER_ID_SCENES, ZB_ZCL_ATTR_SCENES_CURRENT_GROUP_ID, 2},
+    {ZB_ZCL_CLUSTER_ID_SCENES, ZB_ZCL_ATTR_SCENES_SCENE_VALID_ID, 1},
+    {ZB_ZCL_CLUSTER_ID_ON_OFF, ZB_ZCL_ATTR_ON_OFF_ON_OFF_ID, 1},
+    {ZB_ZCL_CLUSTER_ID_FAN_CONTROL, ZB_ZCL_ATTR_FAN_CONTROL_FAN_MODE_ID, 1},
+    {ZB_ZCL_CLUSTER_ID_FAN_CONTROL, MHI_ATTR_FAN_VANE_ID, 1},
+    {ZB_ZCL_CLUSTER_ID_FAN_CONTROL, MHI_ATTR_FAN_VANE_SWING_ID, 1},
+    {ZB_ZCL_CLUSTER_ID_FAN_CONTROL, MHI_ATTR_FAN_VANE_LR_ID, 1},
+    {ZB_ZCL_CLUSTER_ID_FAN_CONTROL, MHI_ATTR_FAN_VANE_LR_SWING_ID, 1},
+    {ZB_ZCL_CLUSTER_ID_FAN_CONTROL, MHI_ATTR_FAN_VANE_3D_AUTO_ID, 1},
+    {ZB_ZCL_CLUSTER_ID_TEMP_MEASUREMENT, ZB_ZCL_ATTR_TEMP_MEASUREMENT_VALUE_ID, 2},
+    {ZB_ZCL_CLUSTER_ID_THERMOSTAT, ZB_ZCL_ATTR_THERMOSTAT_LOCAL_TEMPERATURE_ID, 2},
+    {ZB_ZCL_CLUSTER_ID_THERMOSTAT, ZB_ZCL_ATTR_THERMOSTAT_LOCAL_TEMPERATURE_CALIBRATION_ID, 1},
+    {ZB_ZCL_CLUSTER_ID_THERMOSTAT, ZB_ZCL_ATTR_THERMOSTAT_OCCUPIED_COOLING_SETPOINT_ID, 2},
+    {ZB_ZCL_CLUSTER_ID_THERMOSTAT, ZB_ZCL_ATTR_THERMOSTAT_OCCUPIED_HEATING_SETPOINT_ID, 2},
+    {ZB_ZCL_CLUSTER_ID_THERMOSTAT, ZB_ZCL_ATTR_THERMOSTAT_CONTROL_SEQUENCE_OF_OPERATION_ID, 1},
+    {ZB_ZCL_CLUSTER_ID_THERMOSTAT, ZB_ZCL_ATTR_THERMOSTAT_SYSTEM_MODE_ID, 1},
+    {ZB_ZCL_CLUSTER_ID_DIAGNOSTICS, MHI_ATTR_DIAG_AVAILABLE_ID, 1},
+    {ZB_ZCL_CLUSTER_ID_DIAGNOSTICS, MHI_ATTR_DIAG_ERROR_CODE_ID, 1},
+    {ZB_ZCL_CLUSTER_ID_DIAGNOSTICS, MHI_ATTR_DIAG_ERROR_RETURN_AIR_ID, 2},
+    {ZB_ZCL_CLUSTER_ID_DIAGNOSTICS, MHI_ATTR_DIAG_ERROR_OUTDOOR_ID, 2},
+    {ZB_ZCL_CLUSTER_ID_DIAGNOSTICS, MHI_ATTR_DIAG_ERROR_HEAT_EXCH_ID, 2},
+    {ZB_ZCL_CLUSTER_ID_DIAGNOSTICS, MHI_ATTR_DIAG_ERROR_CURRENT_ID, 2},
+    {ZB_ZCL_CLUSTER_ID_DIAGNOSTICS, MHI_ATTR_DIAG_ERROR_COMP_FREQ_ID, 2},
+    {ZB_ZCL_CLUSTER_ID_DIAGNOSTICS, MHI_ATTR_DIAG_ERROR_FETCH_ID, 2},
+    {ZB_ZCL_CLUSTER_ID_DIAGNOSTICS, MHI_ATTR_DIAG_REMOTE_TEMP_ID, 1},
+    {ZB_ZCL_CLUSTER_ID_METERING, ZB_ZCL_ATTR_METERING_CURRENT_SUMMATION_DELIVERED_ID, 6},
+    {ZB_ZCL_CLUSTER_ID_METERING, ZB_ZCL_ATTR_METERING_INSTANTANEOUS_DEMAND_ID, 3},
+};
+
+static mhi_unit_t m_unit;
+static mhi_sim_t m_sim;
+static ota_sim_t m_ota_sim;
+static mhi_ota_t m_ota;
+static host_write_t m_writes[HOST_MAX_WRITES];
+static size_t m_write_count;
+static host_report_t m_reports[HOST_MAX_REPORTS];
+static size_t m_report_count;
+static host_scene_cmd_t m_scene_cmds[HOST_MAX_SCENE_CMDS];
+static size_t m_scene_cmd_count;
+static uint32_t m_frame;
+static coord_sim_result_t m_coord_result;
+static mhi_cli_t m_cli;
+
+/**
+ * @brief Print attribute changes.
+ */
+static void attr_hook(zb_uint8_t ep, zb_uint16_t cluster_id, zb_uint16_t attr_id,
+                      const zb_uint8_t *value, size_t size, bool changed)
+{
+    int64_t printed = size == 2 ? (int16_t)(value[0] | (value[1] << 8)) : value[0];
+
+    /* Wider attributes are the unsigned Metering ones */
+    for (size_t i = size; size > 2 && i-- > 0;)
+    {
+        printed = i + 1 == size ? value[i] : (printed << 8) | value[i];
+    }
+
+    if (changed)
+    {
+        printf("%6u ep %u cluster 0x%04x attr 0x%04x = %lld\n", m_frame, ep, cluster_id, attr_id, (long long)printed);
+    }
+}
+
+/**
+ * @brief Parse a -w option: cluster:attr=value@frame, numbers in C notation.
+ */
+static bool write_parse(const char *p_arg, host_write_t *p_write)
+{
+    char *p_end;
+
+    p_write->cluster_id = (zb_uint16_t)strtoul(p_arg, &p_end, 0);
+    if (*p_end != ':')
+    {
+        return false;
+    }
+    p_write->attr_id = (zb_uint16_t)strtoul(p_end + 1, &p_end, 0);
+    if (*p_end != '=')
+    {
+        return false;
+    }
+    p_write->value = (uint32_t)strtol(p_end + 1, &p_end, 0);
+    if (*p_end != '@')
+    {
+        return false;
+    }
+    p_write->frame = (uint32_t)strtoul(p_end + 1, &p_end, 0);
+
+    return *p_end == '\0';
+}
+
+/**
+ * @brief Apply the writes scheduled for the current frame.
+ *
+ * Like ZBOSS, the attribute is updated before the application is told about the write.
+ */
+static void writes_apply(void)
+{
+    for (size_t i = 0; i < m_write_count; i++)
+    {
+        zb_uint8_t value[4] = {(zb_uint8_t)m_writes[i].value, (zb_uint8_t)(m_writes[i].value >> 8),
+                               (zb_uint8_t)(m_writes[i].value >> 16), (zb_uint8_t)(m_writes[i].value >> 24)};
+
+        if (m_writes[i].frame != m_frame)
+        {
+            continue;
+        }
+
+        (void)ZB_ZCL_SET_ATTRIBUTE(HOST_ENDPOINT, m_writes[i].cluster_id, ZB_ZCL_CLUSTER_SERVER_ROLE,
+                                   m_writes[i].attr_id, value, ZB_FALSE);
+        printf("%6u write cluster 0x%04x attr 0x%04x = %d%s\n", m_frame, m_writes[i].cluster_id,
+               m_writes[i].attr_id, (int)m_writes[i].value,
+               mhi_unit_zcl_write(&m_unit, m_writes[i].cluster_id, m_writes[i].attr_id, m_writes[i].value) ? "" : " rejected");
+    }
+}
+
+/**
+ * @brief Hand the remote temperature reports scheduled for the current frame to the unit.
+ */
+static void reports_apply(void)
+{
+    for (size_t i = 0; i < m_report_count; i++)
+    {
+        if (m_reports[i].frame == m_frame)
+        {
+            printf("%6u remote temperature %d\n", m_frame, m_reports[i].temperature);
+            mhi_unit_remote_temp(&m_unit, m_reports[i].temperature);
+        }
+    }
+}
+
+/**
+ * @brief Send the Scenes commands scheduled for the current frame, save and reload the scene
+ * table when it changed.
+ */
+static void scene_cmds_apply(void)
+{
+    for (size_t i = 0; i < m_scene_cmd_count; i++)
+    {
+        const host_scene_cmd_t *p_scene_cmd = &m_scene_cmds[i];
+        uint8_t req[6] = {(uint8_t)p_scene_cmd->group_id, (uint8_t)(p_scene_cmd->group_id >> 8)};
+        size_t req_len = 2;
+        mhi_scene_resp_t resp;
+
+        if (p_scene_cmd->frame != m_frame)
+        {
+            continue;
+        }
+
+        if (p_scene_cmd->cmd_id != ZB_ZCL_CMD_SCENES_REMOVE_ALL_SCENES &&
+            p_scene_cmd->cmd_id != ZB_ZCL_CMD_SCENES_GET_SCENE_MEMBERSHIP)
+        {
+            req[req_len++] = p_scene_cmd->scene_id;
+        }
+        if (p_scene_cmd->cmd_id == ZB_ZCL_CMD_SCENES_ADD_SCENE)
+        {
+            /* No transition time, empty name and no extension field sets: the current state */
+            req_len += 3;
+        }
+
+        if (!mhi_unit_scene_command(&m_unit, p_scene_cmd->cmd_id, req, req_len, true, &resp))
+        {
+            printf("%6u scenes command %u unsupported\n", m_frame, p_scene_cmd->cmd_id);
+            continue;
+        }
+        printf("%6u scenes command %u group 0x%04x scene %u status 0x%02x", m_frame, p_scene_cmd->cmd_id,
+               p_scene_cmd->group_id, p_scene_cmd->scene_id, resp.status);
+        for (size_t j = 0; resp.specific && j < resp.len; j++)
+        {
+            printf("%s%02x", j ? " " : " response ", resp.data[j]);
+        }
+        printf("\n");
+
+        if (m_unit.scenes.dirty)
+        {
+            static uint8_t saved[MHI_SCENE_SAVE_SIZE(1)];
+            static mhi_scene_table_t loaded;
+            mhi_scene_table_t *p_table = &m_unit.scenes;
+            mhi_scene_table_t *p_loaded = &loaded;
+            size_t len = mhi_scene_save(&p_table, 1, saved);
+            bool same = mhi_scene_load(&p_loaded, 1, saved, len) && loaded.count == p_table->count &&
+                        memcmp(loaded.scene, p_table->scene, loaded.count * sizeof(loaded.scene[0])) == 0;
+
+            printf("%6u scenes saved, %u bytes%s\n", m_frame, (unsigned)len, same ? "" : ", reload differs");
+        }
+    }
+}
+
+/**
+ * @brief Save the energy total like the NVRAM dataset of the device, and load it back.
+ */
+static void energy_save(void)
+{
+    static uint8_t saved[MHI_ENERGY_SAVE_SIZE(1)];
+    mhi_energy_t *p_energy = &m_unit.energy;
+    mhi_energy_t loaded;
+    mhi_energy_t *p_loaded = &loaded;
+    size_t len = mhi_energy_save(&p_energy, 1, saved);
+    bool same;
+
+    mhi_energy_init(&loaded, p_energy->voltage);
+    same = mhi_energy_load(&p_loaded, 1, saved, len) && loaded.total_wh == p_energy->total_wh &&
+           loaded.counter_wh == p_energy->counter_wh && loaded.counter == p_energy->counter &&
+           loaded.counter_known == p_energy->counter_known;
+
+    printf("%6u energy saved, %llu Wh, %u bytes%s\n", m_frame, (unsigned long long)p_energy->total_wh, (unsigned)len,
+           same ? "" : ", reload differs");
+}
+
+/**
+ * @brief Push a firmware image through the OTA pipeline.
+ * @return Exit code
+ */
+static int ota_run(const char *p_path)
+{
+    static uint8_t image[OTA_SIM_SLOT_SIZE + 1];
+    FILE *p_file = fopen(p_path, "rb");
+    size_t image_size;
+    mhi_ota_status_t status;
+
+    if (p_file == NULL)
+    {
+        perror(p_path);
+        return 1;
+    }
+    image_size = fread(image, 1, sizeof(image), p_file);
+    fclose(p_file);
+
+    if (image_size >= 4 && image[0] == 0x1E && image[1] == 0xF1 && image[2] == 0xEE && image[3] == 0x0B)
+    {
+        /* Already an upgrade file, e.g. from tools/mhi_ota_image.py */
+        memcpy(m_ota_sim.file, image, image_size);
+        m_ota_sim.file_size = (uint32_t)image_size;
+    }
+    else if (!ota_sim_file_build(&m_ota_sim, image, (uint32_t)image_size, 0x01000001, true))
+    {
+        fprintf(stderr, "%s: image too large\n", p_path);
+        return 1;
+    }
+
+    status = ota_sim_transfer(&m_ota_sim, &m_ota);
+    printf("ota file %u bytes, image %u bytes, block %u, %u requests, %.1f s, status %d\n",
+           m_ota_sim.file_size, m_ota.image_size, m_ota_sim.block_size, m_ota_sim.requests,
+           m_ota_sim.elapsed_ms / 1000.0, status);
+
+    return status == MHI_OTA_OK ? 0 : 1;
+}
+
+/**
+ * @brief Check the fetched error snapshot against the one the simulated AC stored, the live
+ * opdata has moved away from it since.
+ * @return false when a snapshot value is not the stored one
+ */
+static bool error_snapshot_check(void)
+{
+    const mhi_opdata_error_t *p_error = &m_unit.opdata.error;
+    bool ok = true;
+
+    if (m_sim.last_error == 0 || p_error->code != m_sim.last_error)
+    {
+        return true;
+    }
+
+    for (uint32_t opdata = 0; opdata < MHI_OPDATA_COUNT; opdata++)
+    {
+        if ((p_error->valid & (1UL << opdata)) && p_error->value[opdata] != m_sim.error_opdata[opdata])
+        {
+            fprintf(stderr, "error snapshot opdata %u: %u, stored %u\n", opdata, p_error->value[opdata],
+                    m_sim.error_opdata[opdata]);
+            ok = false;
+        }
+    }
+
+    return ok;
+}
+
+/**
+ * @brief Print the commands that completed in the last mhi_unit_process.
+ */
+static void commands_print(void)
+{
+    for (uint32_t field = 0; field < MHI_FIELD_COUNT; field++)
+    {
+        if (m_unit.cmd_applied & MHI_FIELD_BIT(field))
+        {
+            printf("%6u command field %u applied after %u frames\n", m_frame, field, m_unit.cmd.latency[field]);
+        }
+        if (m_unit.cmd_failed & MHI_FIELD_BIT(field))
+        {
+            printf("%6u command field %u failed\n", m_frame, field);
+        }
+    }
+}
+
+/**
+ * @brief Send one command to many devices as unicasts and as a groupcast, print both.
+ */
+static int group_run(group_sim_config_t *p_config)
+{
+    group_sim_result_t unicast;
+    group_sim_result_t groupcast;
+
+    if (p_config->units == 0 || p_config->units > GROUP_SIM_UNITS_MAX)
+    {
+        fprintf(stderr, "devices must be 1 to %u\n", GROUP_SIM_UNITS_MAX);
+        return 1;
+    }
+    if (m_write_count != 0)
+    {
+        p_config->cluster_id = m_writes[0].cluster_id;
+        p_config->attr_id = m_writes[0].attr_id;
+        p_config->value = m_writes[0].value;
+    }
+
+    group_sim_run(p_config, false, &unicast);
+    group_sim_run(p_config, true, &groupcast);
+
+    printf("%u devices, cluster 0x%04x attr 0x%04x = %u\n", p_config->units, p_config->cluster_id,
+           p_config->attr_id, p_config->value);
+    printf("unicast   frames %3u airtime %6.1f ms latency mean %5u ms max %5u ms failed %u\n", unicast.frames,
+           unicast.airtime_us / 1000.0, unicast.latency_mean_ms, unicast.latency_max_ms, unicast.failed);
+    printf("groupcast frames %3u airtime %6.1f ms latency mean %5u ms max %5u ms failed %u\n", groupcast.frames,
+           groupcast.airtime_us / 1000.0, groupcast.latency_mean_ms, groupcast.latency_max_ms, groupcast.failed);
+
+    return unicast.failed || groupcast.failed ? 1 : 0;
+}
+
+/**
+ * @brief Run the stand-in coordinator against the unit, print the end-to-end numbers.
+ */
+static int coord_run(coord_sim_config_t *p_config, bool print_reports)
+{
+    coord_sim_result_t *p_result = &m_coord_result;
+    double seconds = p_config->duration_ms / 1000.0;
+
+    for (size_t i = 0; i < m_write_count && i < COORD_SIM_WRITES_MAX; i++)
+    {
+        p_config->writes[i].cluster_id = m_writes[i].cluster_id;
+        p_config->writes[i].attr_id = m_writes[i].attr_id;
+        p_config->writes[i].value = m_writes[i].value;
+        p_config->write_count++;
+    }
+
+    coord_sim_run(p_config, p_result);
+
+    for (uint32_t i = 0; print_reports && i < p_result->reports && i < COORD_SIM_REPORTS_MAX; i++)
+    {
+        printf("%8u ms report cluster 0x%04x attr 0x%04x = %d\n", p_result->report[i].time_ms,
+               p_result->report[i].cluster_id, p_result->report[i].attr_id, p_result->report[i].value);
+    }
+    printf("coordinator %.0f s, %u writes/s, %u reads/s, delay %u ms, reporting configured on %u attributes\n", seconds,
+           p_config->write_rate, p_config->read_rate, p_config->delay_ms, p_result->configured);
+    printf("writes %u rejected %u superseded %u, AC field commands applied %u (%.2f/s) failed %u\n",
+           p_result->writes, p_result->rejected, p_result->superseded, p_result->applied, p_result->applied / seconds,
+           p_result->failed);
+    printf("write to MOSI frame of its last field latency mean %.1f ms max %.1f ms over %u writes\n",
+           p_result->latency_mean_us / 1000.0, p_result->latency_max_us / 1000.0, p_result->latency_count);
+    printf("reads %u errors %u, reports %u for %u attribute changes (%.2f per change)\n", p_result->reads,
+           p_result->read_errors, p_result->reports, p_result->changes,
+           p_result->changes ? (double)p_result->reports / p_result->changes : 0.0);
+
+    return p_result->rejected || p_result->read_errors || p_result->failed ? 1 : 0;
+}
+
+/**
+ * @brief Run one frame: the scheduled writes, reports and Scenes commands, the transfer and
+ * the main loop processing.
+ * @return false at the end of the replay
+ */
+static bool frame_run(FILE *p_replay, FILE *p_record, uint8_t *p_tx, uint8_t *p_rx)
+{
+    size_t len;
+
+    writes_apply();
+    reports_apply();
+    scene_cmds_apply();
+
+    if (p_replay != NULL)
+    {
+        len = capture_read(p_replay, p_rx);
+        if (len == 0)
+        {
+            return false;
+        }
+    }
+    else
+    {
+        len = mhi_sim_xfer(&m_sim, p_tx, p_rx);
+    }
+
+    /* A dropped transfer never raises the SPIS interrupt, only time passes */
+    if (len != 0)
+    {
+        if (p_record != NULL)
+        {
+            capture_write(p_record, p_rx, len);
+        }
+
+        /* What the SPIS interrupt does on the device, a replay has no timestamps */
+        if (p_replay == NULL)
+        {
+            mhi_timing_capture(&m_unit.timing, m_sim.start_us, m_sim.end_us);
+        }
+        mhi_unit_on_xfer_done(&m_unit, p_rx, len, app_timer_cnt_get(), p_tx);
+    }
+
+    (void)mhi_unit_process(&m_unit);
+    commands_print();
+    if (mhi_energy_save_due(&m_unit.energy))
+    {
+        energy_save();
+    }
+    app_timer_shim_advance(APP_TIMER_TICKS(MHI_SIM_FRAME_MS));
+
+    return true;
+}
+
+/**
+ * @brief Diagnostic shell output, on stdout.
+ */
+static void cli_print(void *p_context, const char *p_fmt, va_list *p_args)
+{
+    (void)p_context;
+    vprintf(p_fmt, *p_args);
+}
+
+/**
+ * @brief Run the diagnostic commands read from stdin, with "run frames" for the frames in
+ * between, until the end of the input or "quit".
+ * @return false when a command failed
+ */
+static bool cli_run(FILE *p_replay, FILE *p_record, uint8_t *p_tx, uint8_t *p_rx)
+{
+    char line[HOST_CLI_LINE_SIZE];
+    bool interactive = isatty(STDIN_FILENO);
+    bool ok = true;
+    bool more = true;
+
+    mhi_cli_init(&m_cli, &m_unit, 1, cli_print, NULL);
+
+    while (true)
+    {
+        char word[8];
+        unsigned count = 1;
+        int words;
+
+        if (interactive)
+        {
+            printf("mhi> ");
+            fflush(stdout);
+        }
+        if (fgets(line, sizeof(line), stdin) == NULL)
+        {
+            break;
+        }
+
+        words = sscanf(line, "%7s %u", word, &count);
+        if (words >= 1 && strcmp(word, "quit") == 0)
+        {
+            break;
+        }
+        if (words >= 1 && strcmp(word, "run") == 0)
+        {
+            for (unsigned i = 0; i < count && more; i++)
+            {
+                more = frame_run(p_replay, p_record, p_tx, p_rx);
+                m_frame += more;
+            }
+            printf("frame %u%s\n", m_frame, more ? "" : ", end of replay");
+            continue;
+        }
+
+        ok &= mhi_cli_exec_line(&m_cli, line);
+        if (words >= 1 && strcmp(word, "help") == 0)
+        {
+            printf("run [frames]\n    Run the simulation or replay for some frames (default 1)\nquit\n    Stop\n");
+        }
+    }
+
+    return ok;
+}
+
+static void usage(const char *p_name)
+{
+    fprintf(stderr,
+            "usage: %s [-n frames] [-s seed] [-j jitter] [-d delay] [-x] [-v] [-r capture] [-o capture]\n"
+            "          [-e corrupt] [-D drop] [-O frame:frames] [-T timeout] [-H hold] [-i ignore]\n"
+            "          [-E frame:error] [-f window:band] [-w cluster:attr=value@frame]...\n"
+            "          [-t temperature@frame]... [-m timeout] [-S command:group:scene@frame]...\n"
+            "          [-I current] [-J jitter] [-c]\n"
+            "       %s -u image.bin [-b block size] [-B block delay ms] [-R round trip ms]\n"
+            "       %s -g devices [-G unicast gap ms] [-w cluster:attr=value@frame]\n"
+            "       %s -C seconds [-W writes/s] [-Q reads/s] [-L delay ms] [-p] [-w cluster:attr=value@frame]...\n"
+            "  -n  number of frames to simulate (default 250)\n"
+            "  -s  seed of the simulated room temperature noise\n"
+            "  -j  room temperature noise amplitude, raw units (default 0)\n"
+            "  -d  frames before the simulated AC applies a command (default 3)\n"
+            "  -x  simulate extended frames\n"
+            "  -e  frames sent with a wrong checksum, per 1000 (default 0)\n"
+            "  -D  transfers dropped by the simulated AC, per 1000 (default 0)\n"
+            "  -O  the simulated AC stops sending at the given frame, for the given number of frames\n"
+            "  -T  time without valid frames before the AC is unavailable, in ms (default %u)\n"
+            "  -H  frames the simulated AC needs a set bit in before it takes a command (default 1)\n"
+            "  -i  commands missed by the simulated AC, per 1000 (default 0)\n"
+            "  -E  the simulated AC raises the given error number at the given frame, the fetched\n"
+            "      snapshot is checked against the one it stored\n"
+            "  -v  verbose, repeat for debug logging\n"
+            "  -r  replay RX frames from a capture file instead of simulating\n"
+            "  -o  record the RX frames to a capture file\n"
+            "  -f  room temperature median window and hysteresis band (default 5:1, 1:0 disables)\n"
+            "  -w  write an attribute at the given frame\n"
+            "  -t  remote sensor reports the given temperature (0.01 degrees) at the given frame\n"
+            "  -m  time without remote temperature before the AC sensor is used, in ms (default %lu)\n"
+            "  -S  send a Scenes command (0 add, 4 store, 5 recall...) at the given frame\n"
+            "  -I  current opdata of the simulated AC, raw steps of 14/51 A (default 12)\n"
+            "  -J  CSN of the simulated AC falls up to this many us early or late (default 0)\n"
+            "  -c  read diagnostic commands from stdin, \"run frames\" runs the frames in between\n"
+            "  -u  push a firmware image or OTA upgrade file through the OTA pipeline\n"
+            "  -b  OTA block size (default 64)\n"
+            "  -B  minimum delay between OTA block requests in ms (default 0)\n"
+            "  -R  round trip time of an OTA block request in ms (default 50)\n"
+            "  -g  compare unicast and groupcast delivery of the first -w write (default On) to devices\n"
+            "  -G  time between two unicasts of the coordinator in ms (default 50)\n"
+            "  -C  run the stand-in coordinator for the given number of seconds\n"
+            "  -W  attribute writes of the coordinator per second (default 5)\n"
+            "  -Q  attribute reads of the coordinator per second (default 2)\n"
+            "  -L  one-way delay between the coordinator and the device in ms (default 10)\n"
+            "  -p  print every report the coordinator receives\n",
+            p_name, p_name, p_name, p_name, MHI_OFFLINE_TIMEOUT_MS, (unsigned long)MHI_REMOTE_TEMP_TIMEOUT_MS);
+}
+
+int main(int argc, char *argv[])
+{
+    uint8_t tx_buf[MHI_FRAME_SIZE_EXT];
+    uint8_t rx_buf[MHI_FRAME_SIZE_EXT];
+    uint32_t frames = 250;
+    uint32_t seed = 1;
+    FILE *p_replay = NULL;
+    FILE *p_record = NULL;
+    const char *p_ota_image = NULL;
+    group_sim_config_t group = {
+        .gap_ms = 50,
+        .broadcast_tx = 3,
+        .cluster_id = ZB_ZCL_CLUSTER_ID_ON_OFF,
+        .attr_id = ZB_ZCL_ATTR_ON_OFF_ON_OFF_ID,
+        .value = 1,
+    };
+    static coord_sim_config_t coord = {
+        .write_rate = 5,
+        .read_rate = 2,
+        .delay_ms = 10,
+    };
+    bool print_reports = false;
+    bool cli = false;
+    bool cli_ok = true;
+    unsigned filter_window = MHI_ROOM_TEMP_FILTER_WINDOW;
+    unsigned filter_band = MHI_ROOM_TEMP_FILTER_BAND;
+    uint32_t offline_timeout = MHI_OFFLINE_TIMEOUT_MS;
+    uint32_t remote_timeout = MHI_REMOTE_TEMP_TIMEOUT_MS;
+    unsigned error;
+    int temperature;
+    unsigned scene_cmd;
+    int scene_group;
+    unsigned scene_id;
+    int opt;
+
+    /* Self-check: the temperature tables match their formulas for every code */
+    if (temp_check())
+    {
+        return 1;
+    }
+
+    mhi_sim_init(&m_sim, seed);
+    m_ota_sim.block_size = 64;
+    m_ota_sim.rtt_ms = 50;
+
+    while ((opt = getopt(argc, argv, "n:s:j:d:xe:D:O:T:H:i:E:vr:o:f:w:t:m:S:I:J:cu:b:B:R:g:G:C:W:Q:L:ph")) != -1)
+    {
+        switch (opt)
+        {
+        case 'n':
+            frames = (uint32_t)strtoul(optarg, NULL, 0);
+            break;
+        case 's':
+            seed = (uint32_t)strtoul(optarg, NULL, 0);
+            break;
+        case 'j':
+            m_sim.room_jitter = (uint8_t)strtoul(optarg, NULL, 0);
+            break;
+        case 'd':
+            m_sim.apply_delay = (uint32_t)strtoul(optarg, NULL, 0);
+            break;
+        case 'x':
+            m_sim.extended = true;
+            break;
+        case 'e':
+            m_sim.corrupt_permille = (uint16_t)strtoul(optarg, NULL, 0);
+            break;
+        case 'D':
+            m_sim.drop_permille = (uint16_t)strtoul(optarg, NULL, 0);
+            break;
+        case 'O':
+            if (sscanf(optarg, "%u:%u", &m_sim.silent_start, &m_sim.silent_frames) != 2)
+            {
+                fprintf(stderr, "invalid offline period: %s\n", optarg);
+                return 1;
+            }
+            break;
+        case 'T':
+            offline_timeout = (uint32_t)strtoul(optarg, NULL, 0);
+            break;
+        case 'H':
+            m_sim.hold_frames = (uint8_t)strtoul(optarg, NULL, 0);
+            break;
+        case 'i':
+            m_sim.ignore_permille = (uint16_t)strtoul(optarg, NULL, 0);
+            break;
+        case 'E':
+            if (sscanf(optarg, "%u:%u", &m_sim.error_at, &error) != 2 || error == 0 || error > UINT8_MAX)
+            {
+                fprintf(stderr, "invalid error: %s\n", optarg);
+                return 1;
+            }
+            m_sim.error_raise = (uint8_t)error;
+            break;
+        case 'v':
+            nrf_log_shim_level++;
+            break;
+        case 'r':
+            p_replay = fopen(optarg, "r");
+            if (p_replay == NULL)
+            {
+                perror(optarg);
+                return 1;
+            }
+            break;
+        case 'o':
+            p_record = fopen(optarg, "w");
+            if (p_record == NULL)
+            {
+                perror(optarg);
+                return 1;
+            }
+            break;
+        case 'f':
+            if (sscanf(optarg, "%u:%u", &filter_window, &filter_band) != 2 || filter_window == 0 ||
+                filter_window > MHI_FILTER_WINDOW_MAX || filter_band > UINT8_MAX)
+            {
+                fprintf(stderr, "invalid filter: %s\n", optarg);
+                return 1;
+            }
+            break;
+        case 'w':
+            if (m_write_count >= HOST_MAX_WRITES || !write_parse(optarg, &m_writes[m_write_count]))
+            {
+                fprintf(stderr, "invalid write: %s\n", optarg);
+                return 1;
+            }
+            m_write_count++;
+            break;
+        case 't':
+            if (m_report_count >= HOST_MAX_REPORTS ||
+                sscanf(optarg, "%d@%u", &temperature, &m_reports[m_report_count].frame) != 2 ||
+                temperature < INT16_MIN || temperature > INT16_MAX)
+            {
+                fprintf(stderr, "invalid remote temperature: %s\n", optarg);
+                return 1;
+            }
+            m_reports[m_report_count++].temperature = (int16_t)temperature;
+            break;
+        case 'm':
+            remote_timeout = (uint32_t)strtoul(optarg, NULL, 0);
+            break;
+        case 'S':
+            if (m_scene_cmd_count >= HOST_MAX_SCENE_CMDS ||
+                sscanf(optarg, "%u:%i:%u@%u", &scene_cmd, &scene_group, &scene_id,
+                       &m_scene_cmds[m_scene_cmd_count].frame) != 4 ||
+                scene_cmd > UINT8_MAX || scene_group < 0 || scene_group > UINT16_MAX || scene_id > UINT8_MAX)
+            {
+                fprintf(stderr, "invalid scenes command: %s\n", optarg);
+                return 1;
+            }
+            m_scene_cmds[m_scene_cmd_count].cmd_id = (zb_uint8_t)scene_cmd;
+            m_scene_cmds[m_scene_cmd_count].group_id = (uint16_t)scene_group;
+            m_scene_cmds[m_scene_cmd_count++].scene_id = (uint8_t)scene_id;
+            break;
+        case 'I':
+            m_sim.opdata[MHI_OPDATA_CURRENT] = (uint8_t)strtoul(optarg, NULL, 0);
+            break;
+        case 'J':
+            m_sim.csn_jitter_us = (uint16_t)strtoul(optarg, NULL, 0);
+            break;
+        case 'c':
+            cli = true;
+            break;
+        case 'u':
+            p_ota_image = optarg;
+            break;
+        case 'b':
+            m_ota_sim.block_size = (uint32_t)strtoul(optarg, NULL, 0);
+            break;
+        case 'B':
+            m_ota_sim.block_delay_ms = (uint32_t)strtoul(optarg, NULL, 0);
+            break;
+        case 'R':
+            m_ota_sim.rtt_ms = (uint32_t)strtoul(optarg, NULL, 0);
+            break;
+        case 'g':
+            group.units = (uint32_t)strtoul(optarg, NULL, 0);
+            if (group.units == 0)
+            {
+                fprintf(stderr, "invalid devices: %s\n", optarg);
+                return 1;
+            }
+            break;
+        case 'G':
+            group.gap_ms = (uint32_t)strtoul(optarg, NULL, 0);
+            break;
+        case 'C':
+            coord.duration_ms = (uint32_t)strtoul(optarg, NULL, 0) * 1000;
+            if (coord.duration_ms == 0)
+            {
+                fprintf(stderr, "invalid coordinator time: %s\n", optarg);
+                return 1;
+            }
+            break;
+        case 'W':
+            coord.write_rate = (uint32_t)strtoul(optarg, NULL, 0);
+            break;
+        case 'Q':
+            coord.read_rate = (uint32_t)strtoul(optarg, NULL, 0);
+            break;
+        case 'L':
+            coord.delay_ms = (uint32_t)strtoul(optarg, NULL, 0);
+            break;
+        case 'p':
+            print_reports = true;
+            break;
+        default:
+            usage(argv[0]);
+            return opt == 'h' ? 0 : 1;
+        }
+    }
+    m_sim.seed = seed ? seed : 1;
+
+    if (p_ota_image != NULL)
+    {
+        return ota_run(p_ota_image);
+    }
+    if (group.units != 0)
+    {
+        group.seed = seed;
+        return group_run(&group);
+    }
+
+    (void)app_timer_init();
+    for (size_t i = 0; i < sizeof(m_attrs) / sizeof(m_attrs[0]); i++)
+    {
+        zb_shim_attr_register(HOST_ENDPOINT, m_attrs[i].cluster_id, m_attrs[i].attr_id, m_attrs[i].size);
+    }
+    if (coord.duration_ms != 0)
+    {
+        coord.seed = seed;
+        return coord_run(&coord, print_reports);
+    }
+    zb_shim_attr_hook_set(attr_hook);
+
+    mhi_unit_init(&m_unit, HOST_ENDPOINT);
+    mhi_filter_init(&m_unit.room_filter, (uint8_t)filter_window, (uint8_t)filter_band);
+    mhi_unit_offline_timeout_set(&m_unit, offline_timeout);
+    mhi_unit_remote_timeout_set(&m_unit, remote_timeout);
+    mhi_link_tx_get(&m_unit.link, tx_buf);
+
+    if (cli)
+    {
+        cli_ok = cli_run(p_replay, p_record, tx_buf, rx_buf);
+    }
+    for (m_frame = cli ? m_frame : 0; !cli && (p_replay != NULL || m_frame < frames); m_frame++)
+    {
+        if (!frame_run(p_replay, p_record, tx_buf, rx_buf))
+        {
+            break;
+        }
+    }
+
+    printf("frames %u ok %u length %u signature %u checksum %u overruns %u resyncs %u missing %u",
+           m_frame, m_unit.link.stats.frames, m_unit.link.stats.length_errors,
+           m_unit.link.stats.signature_errors, m_unit.link.stats.checksum_errors, m_unit.link.stats.overruns,
+           m_unit.link.stats.resyncs, m_unit.link.stats.missing);
+    if (p_replay == NULL)
+    {
+        printf(" commands %u", m_sim.commands);
+    }
+    printf(" applied %u failed %u retries %u latency max %u", m_unit.cmd.stats.applied, m_unit.cmd.stats.failed,
+           m_unit.cmd.stats.retries, m_unit.cmd.stats.latency_max);
+    printf(" room temperature suppressed %u energy %llu Wh\n", m_unit.room_filter.suppressed,
+           (unsigned long long)m_unit.energy.total_wh);
+    if (p_replay == NULL)
+    {
+        const mhi_timing_t *p_timing = &m_unit.timing;
+
+        printf("frame period %u us jitter %u us p1 %u us p99 %u us, transfer %u to %u us, gap min %u us, late %u\n",
+               mhi_timing_hist_mean(&p_timing->period), mhi_timing_hist_stddev(&p_timing->period),
+               mhi_timing_hist_percentile(&p_timing->period, 10), mhi_timing_hist_percentile(&p_timing->period, 990),
+               p_timing->xfer.min, p_timing->xfer.max, p_timing->gap.min, p_timing->late);
+    }
+
+    if (p_replay != NULL)
+    {
+        fclose(p_replay);
+    }
+    if (p_record != NULL)
+    {
+        fclose(p_record);
+    }
+
+    return cli_ok && (p_replay != NULL || error_snapshot_check()) ? 0 : 1;
+}
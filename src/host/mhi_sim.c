@@ -0,0 +1,261 @@
+/**
+ * @file mhi_sim.c
+ * @brief Simulated MHI indoor unit for the host build
+ */
+
+#include <string.h>
+
+#include "mhi_sim.h"
+
+/**
+ * @brief Next value of the noise generator (xorshift32).
+ */
+static uint32_t noise(mhi_sim_t *p_sim)
+{
+    uint32_t x = p_sim->seed;
+
+    x ^= x << 13;
+    x ^= x >> 17;
+    x ^= x << 5;
+    p_sim->seed = x;
+
+    return x;
+}
+
+/* Error snapshot answer: number, frame count, then the snapshot opdata */
+#define ERROR_CODE 0x45
+#define ERROR_NUMBER 0x11
+#define ERROR_COUNT 0x12
+#define ERROR_EXTRA_FRAMES 4
+#define ERROR_MODE_CODE 0x02     /* Snapshot opdata the unit does not poll */
+#define ERROR_SETPOINT_CODE 0x05
+#define ERROR_FRAMES (2 + MHI_OPDATA_COUNT) /* Snapshot frames, ERROR_EXTRA_FRAMES more than announced */
+
+/* Energy counter step, in units of energy_acc */
+#define ENERGY_STEP ((uint64_t)MHI_ENERGY_COUNTER_WH * 3600 * 1000 * MHI_ENERGY_CURRENT_DEN)
+
+/* Command frame bytes are kept from DB0 on */
+#define FIELD_APPLY(name, byte, mask, shift, offset, set_byte, set_bit, ...)                           \
+    if ((set_bit) && (p_db[(set_byte) - MHI_DB0] & (set_bit)) &&                                       \
+        ((byte) <= MHI_DB14 || p_sim->extended))                                                       \
+    {                                                                                                  \
+        p_sim->state.value[MHI_FIELD_##name] = MHI_FIELD_GET(p_db, (byte) - MHI_DB0, mask, shift, offset); \
+    }
+
+#define FIELD_SET_BIT(name, byte, mask, shift, offset, set_byte, set_bit, ...) \
+    || ((set_bit) && (p_tx[set_byte] & (set_bit)))
+
+#define FIELD_RX_ENCODE(name, byte, mask, shift, offset, ...) \
+    p_rx[byte] |= MHI_FIELD_PUT(p_sim->state.value[MHI_FIELD_##name], mask, shift, offset);
+
+/**
+ * @brief Apply the set fields of a received command.
+ */
+static void command_apply(mhi_sim_t *p_sim, const uint8_t *p_db)
+{
+    MHI_FIELDS(FIELD_APPLY)
+
+    p_sim->commands++;
+}
+
+/**
+ * @brief Take a TX frame from the unit.
+ */
+static void tx_consume(mhi_sim_t *p_sim, const uint8_t *p_tx)
+{
+    if (p_tx[MHI_SB0] != MHI_TX_SB0 || p_tx[MHI_SB1] != MHI_TX_SB1 || p_tx[MHI_SB2] != MHI_TX_SB2)
+    {
+        return;
+    }
+
+    p_sim->room_remote = p_tx[MHI_DB3];
+    p_sim->opdata_code = (p_tx[MHI_DB6] & 0x80) ? p_tx[MHI_DB9] : 0;
+    if (p_sim->opdata_code == ERROR_CODE && p_sim->error_step == 0)
+    {
+        p_sim->error_step = 1;
+    }
+
+    if (!(0 MHI_FIELDS(FIELD_SET_BIT)))
+    {
+        p_sim->held = 0;
+        return;
+    }
+    if (p_sim->held < UINT8_MAX)
+    {
+        p_sim->held++;
+    }
+    if (p_sim->held < p_sim->hold_frames ||
+        (p_sim->ignore_permille && noise(p_sim) % 1000 < p_sim->ignore_permille))
+    {
+        return;
+    }
+
+    if (p_sim->queue_head - p_sim->queue_tail < MHI_SIM_QUEUE_SIZE)
+    {
+        uint32_t index = p_sim->queue_head++ % MHI_SIM_QUEUE_SIZE;
+
+        p_sim->queue[index].due = p_sim->frame_count + p_sim->apply_delay;
+        memcpy(p_sim->queue[index].db, &p_tx[MHI_DB0], sizeof(p_sim->queue[index].db));
+    }
+}
+
+void mhi_sim_init(mhi_sim_t *p_sim, uint32_t seed)
+{
+    memset(p_sim, 0, sizeof(*p_sim));
+
+    p_sim->state.value[MHI_FIELD_POWER] = 0;
+    p_sim->state.value[MHI_FIELD_MODE] = MHI_MODE_COOL;
+    p_sim->state.value[MHI_FIELD_FAN] = 2;
+    p_sim->state.value[MHI_FIELD_SETPOINT] = 44;
+    p_sim->state.value[MHI_FIELD_VANE] = MHI_VANE_MIN;
+    p_sim->state.value[MHI_FIELD_VANE_LR] = 4;
+    p_sim->state.value[MHI_FIELD_ROOM_TEMP] = MHI_ROOM_TEMP_OFFSET + 4 * 21;
+    p_sim->room_remote = MHI_TX_ROOM_TEMP_NONE;
+    p_sim->apply_delay = 3;
+    p_sim->seed = seed ? seed : 1;
+
+    p_sim->opdata[MHI_OPDATA_RETURN_AIR_TEMP] = 0x9A;
+    p_sim->opdata[MHI_OPDATA_OUTDOOR_TEMP] = 0x5C;
+    p_sim->opdata[MHI_OPDATA_HEAT_EXCH_TEMP] = 0x80;
+    p_sim->opdata[MHI_OPDATA_CURRENT] = 0x0C;
+    p_sim->opdata[MHI_OPDATA_COMP_FREQ] = 0x00;
+    p_sim->opdata[MHI_OPDATA_ENERGY] = 0x0123;
+}
+
+/**
+ * @brief Put the next frame of the error snapshot answer in DB9-DB11.
+ */
+static void error_answer(mhi_sim_t *p_sim, uint8_t *p_rx)
+{
+    uint32_t step = p_sim->error_step++;
+
+    p_rx[MHI_DB9] = ERROR_CODE;
+    if (step == 1)
+    {
+        p_rx[MHI_DB10] = ERROR_NUMBER;
+        p_rx[MHI_DB11] = p_sim->last_error;
+        return;
+    }
+    if (step == 2)
+    {
+        p_rx[MHI_DB10] = ERROR_COUNT;
+        p_rx[MHI_DB11] = ERROR_FRAMES - ERROR_EXTRA_FRAMES;
+        return;
+    }
+
+    step -= 3;
+    if (step == 0)
+    {
+        p_rx[MHI_DB9] = ERROR_MODE_CODE;
+        p_rx[MHI_DB10] = p_sim->state.value[MHI_FIELD_MODE];
+    }
+    else if (step == 1)
+    {
+        p_rx[MHI_DB9] = ERROR_SETPOINT_CODE;
+        p_rx[MHI_DB10] = p_sim->state.value[MHI_FIELD_SETPOINT];
+    }
+    else
+    {
+        p_rx[MHI_DB9] = mhi_opdata_code((mhi_opdata_t)(step - 2));
+        p_rx[MHI_DB10] = (uint8_t)p_sim->error_opdata[step - 2];
+        p_rx[MHI_DB11] = (uint8_t)(p_sim->error_opdata[step - 2] >> 8);
+    }
+    if (step + 1 == ERROR_FRAMES)
+    {
+        p_sim->error_step = 0;
+    }
+}
+
+size_t mhi_sim_xfer(mhi_sim_t *p_sim, const uint8_t *p_tx, uint8_t *p_rx)
+{
+    size_t len = p_sim->extended ? MHI_FRAME_SIZE_EXT : MHI_FRAME_SIZE;
+    uint8_t room_temp = p_sim->state.value[MHI_FIELD_ROOM_TEMP];
+
+    while (p_sim->queue_tail != p_sim->queue_head &&
+           (int32_t)(p_sim->frame_count - p_sim->queue[p_sim->queue_tail % MHI_SIM_QUEUE_SIZE].due) >= 0)
+    {
+        command_apply(p_sim, p_sim->queue[p_sim->queue_tail++ % MHI_SIM_QUEUE_SIZE].db);
+    }
+
+    /* The energy counter steps with the current, at the nominal voltage */
+    p_sim->energy_acc += (uint64_t)p_sim->opdata[MHI_OPDATA_CURRENT] * MHI_SIM_FRAME_MS * MHI_ENERGY_CURRENT_NUM *
+                         MHI_ENERGY_VOLTAGE;
+    if (p_sim->energy_acc >= ENERGY_STEP)
+    {
+        p_sim->energy_acc -= ENERGY_STEP;
+        p_sim->opdata[MHI_OPDATA_ENERGY]++;
+    }
+
+    if (p_sim->error_raise && p_sim->frame_count == p_sim->error_at)
+    {
+        p_sim->state.value[MHI_FIELD_ERROR_CODE] = p_sim->error_raise;
+        p_sim->last_error = p_sim->error_raise;
+        memcpy(p_sim->error_opdata, p_sim->opdata, sizeof(p_sim->error_opdata));
+
+        /* The unit stops, its live opdata moves away from the snapshot */
+        p_sim->opdata[MHI_OPDATA_RETURN_AIR_TEMP] += 4;
+        p_sim->opdata[MHI_OPDATA_OUTDOOR_TEMP] += 3;
+        p_sim->opdata[MHI_OPDATA_HEAT_EXCH_TEMP] += 6;
+        p_sim->opdata[MHI_OPDATA_CURRENT] = 0;
+    }
+
+    if (p_sim->room_remote != MHI_TX_ROOM_TEMP_NONE)
+    {
+        room_temp = p_sim->room_remote;
+    }
+    else if (p_sim->room_jitter)
+    {
+        room_temp += (uint8_t)(noise(p_sim) % (2U * p_sim->room_jitter + 1)) - p_sim->room_jitter;
+    }
+
+    memset(p_rx, 0, MHI_FRAME_SIZE_EXT);
+    p_rx[MHI_SB0] = p_sim->extended ? MHI_RX_SB0_EXT : MHI_RX_SB0;
+    p_rx[MHI_SB1] = MHI_RX_SB1;
+    p_rx[MHI_SB2] = MHI_RX_SB2;
+    MHI_FIELDS(FIELD_RX_ENCODE)
+    p_rx[MHI_DB3] = room_temp;
+
+    for (uint32_t opdata = 0; opdata < MHI_OPDATA_COUNT && p_sim->opdata_code; opdata++)
+    {
+        if (mhi_opdata_code((mhi_opdata_t)opdata) == p_sim->opdata_code)
+        {
+            p_rx[MHI_DB9] = p_sim->opdata_code;
+            p_rx[MHI_DB10] = (uint8_t)p_sim->opdata[opdata];
+            p_rx[MHI_DB11] = (uint8_t)(p_sim->opdata[opdata] >> 8);
+        }
+    }
+
+    /* The snapshot goes on only while the error request is held, other requests get their answer */
+    if (p_sim->error_step && p_sim->opdata_code == ERROR_CODE)
+    {
+        error_answer(p_sim, p_rx);
+    }
+
+    mhi_frame_set_checksum(p_rx, len);
+
+    if (p_sim->frame_count - p_sim->silent_start < p_sim->silent_frames ||
+        (p_sim->drop_permille && noise(p_sim) % 1000 < p_sim->drop_permille))
+    {
+        p_sim->frame_count++;
+        return 0;
+    }
+    if (p_sim->corrupt_permille && noise(p_sim) % 1000 < p_sim->corrupt_permille)
+    {
+        p_rx[MHI_CBL] ^= 0x01;
+    }
+
+    if (p_tx != NULL)
+    {
+        tx_consume(p_sim, p_tx);
+    }
+
+    p_sim->start_us = p_sim->frame_count * (MHI_SIM_FRAME_MS * 1000U);
+    if (p_sim->csn_jitter_us)
+    {
+        p_sim->start_us += noise(p_sim) % (2U * p_sim->csn_jitter_us + 1) - p_sim->csn_jitter_us;
+    }
+    p_sim->end_us = p_sim->start_us + (uint32_t)len * MHI_SIM_BYTE_US;
+    p_sim->frame_count++;
+
+    return len;
+}
@@ -0,0 +1,92 @@
+/**
+ * @file mhi_sim.h
+ * @brief Simulated MHI indoor unit for the host build
+ *
+ * The simulator plays the AC side of the SPI link: every transfer it produces an RX frame
+ * from its state and consumes the TX frame of the unit. Commands are applied after a
+ * configurable number of frames, opdata requests are answered, and the room temperature
+ * jitters around its base value like a real sensor. Like some real units, the simulator can
+ * require the set bits in several consecutive frames, or miss commands. An error raised at a
+ * given frame stores an opdata snapshot, then the live opdata moves away from it. The snapshot
+ * is answered frame by frame while the error snapshot request is held, other requests
+ * interrupt it with their regular answer. The energy counter opdata steps with the current
+ * opdata, at the nominal voltage.
+ * Without extended frames the simulator ignores the fields that are only in extended frames,
+ * like a unit with the standard protocol. A room temperature in the TX frames replaces the one
+ * of the simulated sensor. Every transfer is timestamped like the hardware captures of the
+ * device: CSN falls every MHI_SIM_FRAME_MS, give or take a random jitter, and the transfer
+ * takes MHI_SIM_BYTE_US per byte.
+ */
+
+#ifndef HOST_MHI_SIM_H
+#define HOST_MHI_SIM_H 1
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#include "include/mhi_cmd.h"
+#include "include/mhi_frame.h"
+#include "include/mhi_energy.h"
+#include "include/mhi_opdata.h"
+#include "include/mhi_state.h"
+
+#define MHI_SIM_FRAME_MS 40    /**< Time between two frames of a real unit. */
+#define MHI_SIM_QUEUE_SIZE 16  /**< Commands waiting to be applied. */
+#define MHI_SIM_BYTE_US 256    /**< Time of a byte on the SPI link, the AC clocks at 31.25 kHz. */
+
+/** @brief Simulator context. */
+typedef struct
+{
+    mhi_state_t state;                         /**< AC state, room temperature is the base value. */
+    bool extended;                             /**< Send extended (33 byte) frames. */
+    uint32_t apply_delay;                      /**< Frames between receiving and applying a command. */
+    uint8_t room_jitter;                       /**< Room temperature noise amplitude, raw units. */
+    uint8_t room_remote;                       /**< Room temperature of the last TX frame, MHI_TX_ROOM_TEMP_NONE for none. */
+    uint16_t corrupt_permille;                 /**< Frames sent with a wrong checksum, per 1000. */
+    uint16_t drop_permille;                    /**< Transfers that do not happen, per 1000. */
+    uint16_t csn_jitter_us;                    /**< CSN falls up to this early or late. */
+    uint32_t start_us;                         /**< CSN fall of the last transfer, 1 MHz. */
+    uint32_t end_us;                           /**< End of the last transfer, 1 MHz. */
+    uint32_t silent_start;                     /**< First frame of a period without transfers. */
+    uint32_t silent_frames;                    /**< Length of that period in frames, 0 for none. */
+    uint8_t hold_frames;                       /**< Consecutive frames with set bits before a command is taken. */
+    uint16_t ignore_permille;                  /**< Commands missed, per 1000. */
+    uint8_t held;                              /**< Consecutive frames with set bits so far. */
+    uint32_t error_at;                         /**< Frame at which error_raise is raised. */
+    uint8_t error_raise;                       /**< Error number to raise, 0 for none. */
+    uint8_t last_error;                        /**< Error number of the stored snapshot. */
+    uint16_t error_opdata[MHI_OPDATA_COUNT];   /**< Opdata snapshot of the last error. */
+    uint8_t error_step;                        /**< Frame of the snapshot answer being sent, 0 when idle. */
+    uint16_t opdata[MHI_OPDATA_COUNT];         /**< Opdata values returned on request. */
+    uint64_t energy_acc;                       /**< Energy since the last energy counter step, 1/(3600 * 1000 * 51) Wh. */
+    uint32_t frame_count;                      /**< Transfers done. */
+    uint32_t commands;                         /**< Commands applied. */
+    uint32_t seed;                             /**< Noise generator state. */
+    uint8_t opdata_code;                       /**< Last requested opdata code, 0 for none. */
+    uint32_t queue_head;                       /**< Command queue write index. */
+    uint32_t queue_tail;                       /**< Command queue read index. */
+    struct
+    {
+        uint32_t due;  /**< Frame count at which the command is applied. */
+        uint8_t db[MHI_DB26 - MHI_DB0 + 1]; /**< DB0-DB26 of the TX frame. */
+    } queue[MHI_SIM_QUEUE_SIZE];
+} mhi_sim_t;
+
+/**
+ * @brief Initialize the simulator with a plausible idle unit.
+ * @param p_sim Simulator
+ * @param seed Seed of the room temperature noise
+ */
+void mhi_sim_init(mhi_sim_t *p_sim, uint32_t seed);
+
+/**
+ * @brief Do one SPI transfer.
+ * @param p_sim Simulator
+ * @param p_tx TX frame from the unit (MHI_FRAME_SIZE_EXT bytes), NULL when idle
+ * @param p_rx Buffer for the RX frame, MHI_FRAME_SIZE_EXT bytes
+ * @return Length of the RX frame, 0 when the transfer was dropped
+ */
+size_t mhi_sim_xfer(mhi_sim_t *p_sim, const uint8_t *p_tx, uint8_t *p_rx);
+
+#endif /* HOST_MHI_SIM_H */
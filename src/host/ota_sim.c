@@ -0,0 +1,163 @@
+/**
+ * @file ota_sim.c
+ * @brief Stand-in OTA Upgrade server and flash slot for the host build
+ */
+
+#include <string.h>
+
+#include "ota_sim.h"
+
+#define HEADER_VERSION 0x0100
+#define STACK_PRO 0x0002
+#define MANUFACTURER 0x1234 /* MHI_MANUF_CODE */
+#define IMAGE_TYPE 0x0001   /* MHI_OTA_IMAGE_TYPE */
+
+static uint8_t m_slot[OTA_SIM_SLOT_SIZE];
+
+static bool slot_erase(uint32_t offset);
+static bool slot_write(uint32_t offset, const void *p_data, uint32_t len);
+static bool slot_read(uint32_t offset, void *p_data, uint32_t len);
+
+static const mhi_ota_flash_t m_flash = {
+    .page_size = OTA_SIM_PAGE_SIZE,
+    .slot_size = OTA_SIM_SLOT_SIZE,
+    .p_erase = slot_erase,
+    .p_write = slot_write,
+    .p_read = slot_read,
+};
+
+static bool slot_erase(uint32_t offset)
+{
+    if (offset % OTA_SIM_PAGE_SIZE || offset >= OTA_SIM_SLOT_SIZE)
+    {
+        return false;
+    }
+
+    memset(&m_slot[offset], 0xFF, OTA_SIM_PAGE_SIZE);
+
+    return true;
+}
+
+static bool slot_write(uint32_t offset, const void *p_data, uint32_t len)
+{
+    const uint8_t *p_bytes = p_data;
+
+    if (offset % 4 || len % 4 || offset + len > OTA_SIM_SLOT_SIZE)
+    {
+        return false;
+    }
+
+    for (uint32_t i = 0; i < len; i++)
+    {
+        /* NOR flash: programming can only clear bits */
+        if ((m_slot[offset + i] & p_bytes[i]) != p_bytes[i])
+        {
+            return false;
+        }
+        m_slot[offset + i] = p_bytes[i];
+    }
+
+    return true;
+}
+
+static bool slot_read(uint32_t offset, void *p_data, uint32_t len)
+{
+    if (offset + len > OTA_SIM_SLOT_SIZE)
+    {
+        return false;
+    }
+
+    memcpy(p_data, &m_slot[offset], len);
+
+    return true;
+}
+
+static uint8_t *put_u16(uint8_t *p, uint16_t value)
+{
+    p[0] = (uint8_t)value;
+    p[1] = (uint8_t)(value >> 8);
+
+    return p + 2;
+}
+
+static uint8_t *put_u32(uint8_t *p, uint32_t value)
+{
+    p = put_u16(p, (uint16_t)value);
+
+    return put_u16(p, (uint16_t)(value >> 16));
+}
+
+bool ota_sim_file_build(ota_sim_t *p_sim, const uint8_t *p_image, uint32_t image_size,
+                        uint32_t file_version, bool with_crc)
+{
+    uint32_t file_size = MHI_OTA_HEADER_SIZE + MHI_OTA_ELEMENT_HEADER_SIZE + image_size +
+                         (with_crc ? MHI_OTA_ELEMENT_HEADER_SIZE + 4 : 0);
+    uint8_t *p = p_sim->file;
+
+    if (file_size > sizeof(p_sim->file))
+    {
+        return false;
+    }
+
+    memset(p_sim->file, 0, MHI_OTA_HEADER_SIZE);
+    p = put_u32(p, MHI_OTA_FILE_ID);
+    p = put_u16(p, HEADER_VERSION);
+    p = put_u16(p, MHI_OTA_HEADER_SIZE);
+    p = put_u16(p, 0);
+    p = put_u16(p, MANUFACTURER);
+    p = put_u16(p, IMAGE_TYPE);
+    p = put_u32(p, file_version);
+    p = put_u16(p, STACK_PRO);
+    memcpy(p, "mhi-ac-control", sizeof("mhi-ac-control") - 1);
+    p += 32;
+    p = put_u32(p, file_size);
+
+    p = put_u16(p, MHI_OTA_TAG_UPGRADE_IMAGE);
+    p = put_u32(p, image_size);
+    memcpy(p, p_image, image_size);
+    p += image_size;
+
+    if (with_crc)
+    {
+        p = put_u16(p, MHI_OTA_TAG_CRC);
+        p = put_u32(p, 4);
+        p = put_u32(p, mhi_ota_crc32(0, p_image, image_size));
+    }
+
+    p_sim->file_size = file_size;
+
+    return true;
+}
+
+mhi_ota_status_t ota_sim_transfer(ota_sim_t *p_sim, mhi_ota_t *p_ota)
+{
+    mhi_ota_status_t status = mhi_ota_start(p_ota, &m_flash, p_sim->file_size);
+
+    p_sim->requests = 0;
+    p_sim->elapsed_ms = 0;
+
+    /* The client requests the block at its current offset until the file is complete */
+    while (status == MHI_OTA_OK && p_ota->file_offset < p_sim->file_size)
+    {
+        uint32_t offset = p_ota->file_offset;
+        uint32_t len = p_sim->file_size - offset;
+
+        len = len < p_sim->block_size ? len : p_sim->block_size;
+        status = mhi_ota_block(p_ota, offset, &p_sim->file[offset], len);
+
+        p_sim->requests++;
+        p_sim->elapsed_ms += p_sim->rtt_ms > p_sim->block_delay_ms ? p_sim->rtt_ms : p_sim->block_delay_ms;
+    }
+
+    return status == MHI_OTA_OK ? mhi_ota_verify(p_ota) : status;
+}
+
+const mhi_ota_flash_t *ota_sim_flash(void)
+{
+    return &m_flash;
+}
+
+const uint8_t *ota_sim_slot(void)
+{
+    return m_slot;
+}
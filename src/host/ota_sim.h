@@ -0,0 +1,64 @@
+/**
+ * @file ota_sim.h
+ * @brief Stand-in OTA Upgrade server and flash slot for the host build
+ *
+ * The server wraps a firmware image into a Zigbee OTA upgrade file and serves it to the
+ * mhi_ota pipeline in blocks of the configured size, the way the OTA Upgrade client of the
+ * device would receive them. Transfer time is simulated from a per-request round trip time
+ * and the minimum block request delay. The flash slot lives in RAM and behaves like NOR flash:
+ * writes can only clear bits, so missing erases are caught.
+ */
+
+#ifndef HOST_OTA_SIM_H
+#define HOST_OTA_SIM_H 1
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#include "include/mhi_ota.h"
+
+#define OTA_SIM_PAGE_SIZE 4096     /**< Flash page size of the nRF52840. */
+#define OTA_SIM_SLOT_SIZE 0x62000  /**< Same as the OTA_SLOT region of the linker script. */
+#define OTA_SIM_FILE_MAX (OTA_SIM_SLOT_SIZE + 256) /**< Largest upgrade file. */
+
+/** @brief Server context. */
+typedef struct
+{
+    uint8_t file[OTA_SIM_FILE_MAX]; /**< Upgrade file. */
+    uint32_t file_size;             /**< Size of the upgrade file. */
+    uint32_t block_size;            /**< Block size requested by the client. */
+    uint32_t block_delay_ms;        /**< Minimum delay between block requests. */
+    uint32_t rtt_ms;                /**< Round trip time of one block request. */
+    uint32_t requests;              /**< Block requests served. */
+    uint64_t elapsed_ms;            /**< Simulated transfer time. */
+} ota_sim_t;
+
+/**
+ * @brief Build an upgrade file from a firmware image.
+ * @param p_sim Server
+ * @param p_image Firmware image
+ * @param image_size Size of the image
+ * @param file_version File version in the OTA header
+ * @param with_crc Add the MHI_OTA_TAG_CRC sub-element
+ * @return false when the image does not fit
+ */
+bool ota_sim_file_build(ota_sim_t *p_sim, const uint8_t *p_image, uint32_t image_size,
+                        uint32_t file_version, bool with_crc);
+
+/**
+ * @brief Transfer the file to the pipeline and verify it.
+ * @return Status of the pipeline
+ */
+mhi_ota_status_t ota_sim_transfer(ota_sim_t *p_sim, mhi_ota_t *p_ota);
+
+/**
+ * @brief Flash operations on the RAM slot.
+ */
+const mhi_ota_flash_t *ota_sim_flash(void);
+
+/**
+ * @brief Content of the RAM slot.
+ */
+const uint8_t *ota_sim_slot(void);
+
+#endif /* HOST_OTA_SIM_H */
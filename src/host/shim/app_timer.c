@@ -0,0 +1,123 @@
+/**
+ * @file app_timer.c
+ * @brief Host stand-in for app_timer
+ */
+
+#include <stddef.h>
+
+#include "app_timer.h"
+
+#define SHIM_MAX_TIMERS 64 /* One watchdog per device of the group simulation, and spare */
+#define COUNTER_MASK 0x00FFFFFF
+
+static uint64_t m_now;
+static app_timer_t *m_timers[SHIM_MAX_TIMERS];
+static size_t m_timer_count;
+
+ret_code_t app_timer_init(void)
+{
+    m_now = 0;
+    m_timer_count = 0;
+
+    return NRF_SUCCESS;
+}
+
+ret_code_t app_timer_create(app_timer_id_t const *p_timer_id, app_timer_mode_t mode, app_timer_timeout_handler_t timeout_handler)
+{
+    app_timer_t *p_timer = *p_timer_id;
+    bool known = false;
+
+    if (timeout_handler == NULL)
+    {
+        return NRF_ERROR_INVALID_PARAM;
+    }
+
+    /* Creating a timer again only replaces its handler and mode, like app_timer */
+    for (size_t i = 0; i < m_timer_count; i++)
+    {
+        known = known || m_timers[i] == p_timer;
+    }
+    if (!known)
+    {
+        if (m_timer_count >= SHIM_MAX_TIMERS)
+        {
+            return NRF_ERROR_INVALID_STATE;
+        }
+        m_timers[m_timer_count++] = p_timer;
+    }
+
+    p_timer->handler = timeout_handler;
+    p_timer->mode = mode;
+    p_timer->active = false;
+
+    return NRF_SUCCESS;
+}
+
+ret_code_t app_timer_start(app_timer_id_t timer_id, uint32_t timeout_ticks, void *p_context)
+{
+    if (timer_id->handler == NULL || timeout_ticks < APP_TIMER_MIN_TIMEOUT_TICKS)
+    {
+        return NRF_ERROR_INVALID_PARAM;
+    }
+
+    timer_id->expires = m_now + timeout_ticks;
+    timer_id->period = timeout_ticks;
+    timer_id->p_context = p_context;
+    timer_id->active = true;
+
+    return NRF_SUCCESS;
+}
+
+ret_code_t app_timer_stop(app_timer_id_t timer_id)
+{
+    timer_id->active = false;
+
+    return NRF_SUCCESS;
+}
+
+uint32_t app_timer_cnt_get(void)
+{
+    return (uint32_t)m_now & COUNTER_MASK;
+}
+
+uint32_t app_timer_cnt_diff_compute(uint32_t ticks_to, uint32_t ticks_from)
+{
+    return (ticks_to - ticks_from) & COUNTER_MASK;
+}
+
+void app_timer_shim_advance(uint32_t ticks)
+{
+    uint64_t end = m_now + ticks;
+
+    for (;;)
+    {
+        app_timer_t *p_next = NULL;
+
+        for (size_t i = 0; i < m_timer_count; i++)
+        {
+            if (m_timers[i]->active && m_timers[i]->expires <= end &&
+                (p_next == NULL || m_timers[i]->expires < p_next->expires))
+            {
+                p_next = m_timers[i];
+            }
+        }
+
+        if (p_next == NULL)
+        {
+            break;
+        }
+
+        m_now = p_next->expires;
+        if (p_next->mode == APP_TIMER_MODE_REPEATED)
+        {
+            p_next->expires += p_next->period;
+        }
+        else
+        {
+            p_next->active = false;
+        }
+        p_next->handler(p_next->p_context);
+    }
+
+    m_now = end;
+}
@@ -0,0 +1,62 @@
+/**
+ * @file app_timer.h
+ * @brief Host stand-in for app_timer
+ *
+ * Time does not pass by itself: the host application advances it with app_timer_shim_advance,
+ * which fires the expired timers in order. The counter wraps at 24 bits like the RTC.
+ */
+
+#ifndef HOST_SHIM_APP_TIMER_H
+#define HOST_SHIM_APP_TIMER_H 1
+
+#include <stdbool.h>
+#include <stdint.h>
+
+typedef uint32_t ret_code_t;
+
+#define NRF_SUCCESS 0
+#define NRF_ERROR_INVALID_PARAM 7
+#define NRF_ERROR_INVALID_STATE 8
+
+#define APP_TIMER_CLOCK_FREQ 32768
+#define APP_TIMER_MIN_TIMEOUT_TICKS 5
+#define APP_TIMER_TICKS(MS) ((uint32_t)(((uint64_t)(MS) * APP_TIMER_CLOCK_FREQ) / 1000))
+
+typedef void (*app_timer_timeout_handler_t)(void *p_context);
+
+typedef enum
+{
+    APP_TIMER_MODE_SINGLE_SHOT,
+    APP_TIMER_MODE_REPEATED
+} app_timer_mode_t;
+
+typedef struct
+{
+    app_timer_timeout_handler_t handler;
+    app_timer_mode_t mode;
+    bool active;
+    uint64_t expires;
+    uint32_t period;
+    void *p_context;
+} app_timer_t;
+
+typedef app_timer_t *app_timer_id_t;
+
+#define APP_TIMER_DEF(timer_id)       \
+    static app_timer_t timer_id##_data; \
+    static const app_timer_id_t timer_id = &timer_id##_data
+
+ret_code_t app_timer_init(void);
+ret_code_t app_timer_create(app_timer_id_t const *p_timer_id, app_timer_mode_t mode, app_timer_timeout_handler_t timeout_handler);
+ret_code_t app_timer_start(app_timer_id_t timer_id, uint32_t timeout_ticks, void *p_context);
+ret_code_t app_timer_stop(app_timer_id_t timer_id);
+uint32_t app_timer_cnt_get(void);
+uint32_t app_timer_cnt_diff_compute(uint32_t ticks_to, uint32_t ticks_from);
+
+/**
+ * @brief Advance the host time, firing all timers that expire on the way.
+ * @param ticks Number of ticks to advance
+ */
+void app_timer_shim_advance(uint32_t ticks);
+
+#endif /* HOST_SHIM_APP_TIMER_H */
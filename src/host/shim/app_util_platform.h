@@ -0,0 +1,36 @@
+/**
+ * @file app_util_platform.h
+ * @brief Host stand-in for the nRF SDK platform utilities
+ *
+ * The host build is single threaded: "interrupts" are plain function calls from the main
+ * loop, so critical regions do not need to do anything.
+ */
+
+#ifndef HOST_SHIM_APP_UTIL_PLATFORM_H
+#define HOST_SHIM_APP_UTIL_PLATFORM_H 1
+
+#include <stdint.h>
+
+#define CRITICAL_REGION_ENTER() \
+    {                           \
+        do                      \
+        {                       \
+        } while (0)
+#define CRITICAL_REGION_EXIT() \
+    }
+
+#define UNUSED_VARIABLE(X) ((void)(X))
+#define UNUSED_PARAMETER(X) UNUSED_VARIABLE(X)
+#define UNUSED_RETURN_VALUE(X) UNUSED_VARIABLE(X)
+
+#ifndef MIN
+#define MIN(a, b) ((a) < (b) ? (a) : (b))
+#endif
+#ifndef MAX
+#define MAX(a, b) ((a) < (b) ? (b) : (a))
+#endif
+#ifndef ARRAY_SIZE
+#define ARRAY_SIZE(arr) (sizeof(arr) / sizeof((arr)[0]))
+#endif
+
+#endif /* HOST_SHIM_APP_UTIL_PLATFORM_H */
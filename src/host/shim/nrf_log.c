@@ -0,0 +1,22 @@
+/**
+ * @file nrf_log.c
+ * @brief Host stand-in for nrf_log
+ */
+
+#include <stdint.h>
+
+#include "nrf_log.h"
+
+int nrf_log_shim_level = 2;
+
+void nrf_log_shim_hexdump(const char *p_level, const void *p_data, size_t len)
+{
+    const uint8_t *p_bytes = p_data;
+
+    fprintf(stderr, "<%s>", p_level);
+    for (size_t i = 0; i < len; i++)
+    {
+        fprintf(stderr, " %02x", p_bytes[i]);
+    }
+    fprintf(stderr, "\n");
+}
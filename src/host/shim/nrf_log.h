@@ -0,0 +1,50 @@
+/**
+ * @file nrf_log.h
+ * @brief Host stand-in for nrf_log, printing to stderr
+ */
+
+#ifndef HOST_SHIM_NRF_LOG_H
+#define HOST_SHIM_NRF_LOG_H 1
+
+#include <stddef.h>
+#include <stdio.h>
+
+extern int nrf_log_shim_level; /**< 0 off, 1 error, 2 warning, 3 info, 4 debug. */
+
+/**
+ * @brief Print a hexdump to stderr.
+ */
+void nrf_log_shim_hexdump(const char *p_level, const void *p_data, size_t len);
+
+#define NRF_LOG_SHIM_(level, name, fmt, ...)                          \
+    do                                                                \
+    {                                                                 \
+        if (nrf_log_shim_level >= (level))                            \
+        {                                                             \
+            fprintf(stderr, "<" name "> " fmt "\n", ##__VA_ARGS__);   \
+        }                                                             \
+    } while (0)
+
+#define NRF_LOG_ERROR(...) NRF_LOG_SHIM_(1, "error", __VA_ARGS__)
+#define NRF_LOG_WARNING(...) NRF_LOG_SHIM_(2, "warning", __VA_ARGS__)
+#define NRF_LOG_INFO(...) NRF_LOG_SHIM_(3, "info", __VA_ARGS__)
+#define NRF_LOG_DEBUG(...) NRF_LOG_SHIM_(4, "debug", __VA_ARGS__)
+
+#define NRF_LOG_HEXDUMP_INFO(p_data, len)              \
+    do                                                 \
+    {                                                  \
+        if (nrf_log_shim_level >= 3)                   \
+        {                                              \
+            nrf_log_shim_hexdump("info", p_data, len); \
+        }                                              \
+    } while (0)
+#define NRF_LOG_HEXDUMP_DEBUG(p_data, len)              \
+    do                                                  \
+    {                                                   \
+        if (nrf_log_shim_level >= 4)                    \
+        {                                               \
+            nrf_log_shim_hexdump("debug", p_data, len); \
+        }                                               \
+    } while (0)
+
+#endif /* HOST_SHIM_NRF_LOG_H */
@@ -0,0 +1,115 @@
+/**
+ * @file zb_shim.c
+ * @brief Host stand-in for the ZBOSS attribute store
+ */
+
+#include <string.h>
+
+#include "zboss_api.h"
+
+#define SHIM_MAX_ATTRS 64
+
+typedef struct
+{
+    zb_uint8_t ep;
+    zb_uint16_t cluster_id;
+    zb_uint16_t attr_id;
+    uint8_t size;
+    uint8_t data[8];
+} shim_attr_t;
+
+static shim_attr_t m_attrs[SHIM_MAX_ATTRS];
+static size_t m_attr_count;
+static zb_shim_attr_hook_t m_hook;
+
+static shim_attr_t *attr_find(zb_uint8_t ep, zb_uint16_t cluster_id, zb_uint16_t attr_id)
+{
+    for (size_t i = 0; i < m_attr_count; i++)
+    {
+        if (m_attrs[i].ep == ep && m_attrs[i].cluster_id == cluster_id && m_attrs[i].attr_id == attr_id)
+        {
+            return &m_attrs[i];
+        }
+    }
+
+    return NULL;
+}
+
+zb_uint8_t zb_zcl_set_attr_val(zb_uint8_t ep, zb_uint16_t cluster_id, zb_uint8_t cluster_role,
+                               zb_uint16_t attr_id, zb_uint8_t *value, zb_bool_t check_access)
+{
+    shim_attr_t *p_attr = attr_find(ep, cluster_id, attr_id);
+    bool changed;
+
+    (void)cluster_role;
+    (void)check_access;
+
+    if (p_attr == NULL)
+    {
+        return ZB_ZCL_STATUS_UNSUP_ATTRIB;
+    }
+
+    changed = memcmp(p_attr->data, value, p_attr->size) != 0;
+    memcpy(p_attr->data, value, p_attr->size);
+
+    if (m_hook != NULL)
+    {
+        m_hook(ep, cluster_id, attr_id, p_attr->data, p_attr->size, changed);
+    }
+
+    return ZB_ZCL_STATUS_SUCCESS;
+}
+
+void zb_shim_attr_register(zb_uint8_t ep, zb_uint16_t cluster_id, zb_uint16_t attr_id, size_t size)
+{
+    shim_attr_t *p_attr = attr_find(ep, cluster_id, attr_id);
+
+    if (p_attr == NULL && m_attr_count < SHIM_MAX_ATTRS)
+    {
+        p_attr = &m_attrs[m_attr_count++];
+    }
+    if (p_attr != NULL)
+    {
+        memset(p_attr, 0, sizeof(*p_attr));
+        p_attr->ep = ep;
+        p_attr->cluster_id = cluster_id;
+        p_attr->attr_id = attr_id;
+        p_attr->size = (uint8_t)(size > sizeof(p_attr->data) ? sizeof(p_attr->data) : size);
+    }
+}
+
+bool zb_shim_attr_get(zb_uint8_t ep, zb_uint16_t cluster_id, zb_uint16_t attr_id, int32_t *p_value)
+{
+    shim_attr_t *p_attr = attr_find(ep, cluster_id, attr_id);
+
+    if (p_attr == NULL)
+    {
+        return false;
+    }
+
+    switch (p_attr->size)
+    {
+    case 1:
+        *p_value = (int8_t)p_attr->data[0];
+        break;
+    case 2:
+        *p_value = (int16_t)(p_attr->data[0] | (p_attr->data[1] << 8));
+        break;
+    default:
+        memcpy(p_value, p_attr->data, sizeof(*p_value));
+        break;
+    }
+
+    return true;
+}
+
+void zb_shim_attr_hook_set(zb_shim_attr_hook_t hook)
+{
+    m_hook = hook;
+}
+
+void zb_shim_reset(void)
+{
+    m_attr_count = 0;
+    m_hook = NULL;
+}
@@ -0,0 +1,154 @@
+/**
+ * @file zboss_api.h
+ * @brief Host stand-in for the parts of the ZBOSS API used by the application core
+ *
+ * Attributes live in a small in-memory store. The host application registers the attributes
+ * of its endpoints (mirroring the declarations in main.c) and can install a hook to observe
+ * every ZB_ZCL_SET_ATTRIBUTE call.
+ */
+
+#ifndef HOST_SHIM_ZBOSS_API_H
+#define HOST_SHIM_ZBOSS_API_H 1
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+typedef uint8_t zb_uint8_t;
+typedef int8_t zb_int8_t;
+typedef uint16_t zb_uint16_t;
+typedef int16_t zb_int16_t;
+typedef uint32_t zb_uint32_t;
+typedef int32_t zb_int32_t;
+typedef uint8_t zb_bool_t;
+typedef int32_t zb_ret_t;
+typedef void zb_void_t;
+
+/* Packed like the ZBOSS types, the attribute store copies their bytes */
+typedef struct __attribute__((packed))
+{
+    zb_uint16_t low;
+    zb_int8_t high;
+} zb_int24_t;
+
+typedef struct __attribute__((packed))
+{
+    zb_uint32_t low;
+    zb_uint16_t high;
+} zb_uint48_t;
+
+#define ZB_FALSE 0
+#define ZB_TRUE 1
+#define RET_OK 0
+#define RET_ERROR (-1)
+
+/* Cluster roles */
+#define ZB_ZCL_CLUSTER_SERVER_ROLE 0x01
+#define ZB_ZCL_CLUSTER_CLIENT_ROLE 0x02
+
+/* ZCL status */
+#define ZB_ZCL_STATUS_SUCCESS 0x00
+#define ZB_ZCL_STATUS_FAIL 0x01
+#define ZB_ZCL_STATUS_MALFORMED_CMD 0x80
+#define ZB_ZCL_STATUS_INVALID_FIELD 0x85
+#define ZB_ZCL_STATUS_UNSUP_ATTRIB 0x86
+#define ZB_ZCL_STATUS_INVALID_VALUE 0x87
+#define ZB_ZCL_STATUS_INSUFF_SPACE 0x89
+#define ZB_ZCL_STATUS_NOT_FOUND 0x8B
+
+/* Clusters */
+#define ZB_ZCL_CLUSTER_ID_BASIC 0x0000
+#define ZB_ZCL_CLUSTER_ID_IDENTIFY 0x0003
+#define ZB_ZCL_CLUSTER_ID_SCENES 0x0005
+#define ZB_ZCL_CLUSTER_ID_ON_OFF 0x0006
+#define ZB_ZCL_CLUSTER_ID_THERMOSTAT 0x0201
+#define ZB_ZCL_CLUSTER_ID_FAN_CONTROL 0x0202
+#define ZB_ZCL_CLUSTER_ID_TEMP_MEASUREMENT 0x0402
+#define ZB_ZCL_CLUSTER_ID_METERING 0x0702
+#define ZB_ZCL_CLUSTER_ID_DIAGNOSTICS 0x0B05
+
+/* Scenes cluster */
+#define ZB_ZCL_ATTR_SCENES_SCENE_COUNT_ID 0x0000
+#define ZB_ZCL_ATTR_SCENES_CURRENT_SCENE_ID 0x0001
+#define ZB_ZCL_ATTR_SCENES_CURRENT_GROUP_ID 0x0002
+#define ZB_ZCL_ATTR_SCENES_SCENE_VALID_ID 0x0003
+#define ZB_ZCL_CMD_SCENES_ADD_SCENE 0x00
+#define ZB_ZCL_CMD_SCENES_VIEW_SCENE 0x01
+#define ZB_ZCL_CMD_SCENES_REMOVE_SCENE 0x02
+#define ZB_ZCL_CMD_SCENES_REMOVE_ALL_SCENES 0x03
+#define ZB_ZCL_CMD_SCENES_STORE_SCENE 0x04
+#define ZB_ZCL_CMD_SCENES_RECALL_SCENE 0x05
+#define ZB_ZCL_CMD_SCENES_GET_SCENE_MEMBERSHIP 0x06
+
+/* On/Off cluster */
+#define ZB_ZCL_ATTR_ON_OFF_ON_OFF_ID 0x0000
+
+/* Thermostat cluster */
+#define ZB_ZCL_ATTR_THERMOSTAT_LOCAL_TEMPERATURE_ID 0x0000
+#define ZB_ZCL_ATTR_THERMOSTAT_LOCAL_TEMPERATURE_CALIBRATION_ID 0x0010
+#define ZB_ZCL_ATTR_THERMOSTAT_OCCUPIED_COOLING_SETPOINT_ID 0x0011
+#define ZB_ZCL_ATTR_THERMOSTAT_OCCUPIED_HEATING_SETPOINT_ID 0x0012
+#define ZB_ZCL_ATTR_THERMOSTAT_CONTROL_SEQUENCE_OF_OPERATION_ID 0x001B
+#define ZB_ZCL_ATTR_THERMOSTAT_SYSTEM_MODE_ID 0x001C
+#define ZB_ZCL_THERMOSTAT_SYSTEM_MODE_OFF 0x00
+#define ZB_ZCL_THERMOSTAT_SYSTEM_MODE_AUTO 0x01
+#define ZB_ZCL_THERMOSTAT_SYSTEM_MODE_COOL 0x03
+#define ZB_ZCL_THERMOSTAT_SYSTEM_MODE_HEAT 0x04
+#define ZB_ZCL_THERMOSTAT_SYSTEM_MODE_FAN_ONLY 0x07
+#define ZB_ZCL_THERMOSTAT_SYSTEM_MODE_DRY 0x08
+
+/* Fan Control cluster */
+#define ZB_ZCL_ATTR_FAN_CONTROL_FAN_MODE_ID 0x0000
+#define ZB_ZCL_FAN_CONTROL_FAN_MODE_OFF 0x00
+#define ZB_ZCL_FAN_CONTROL_FAN_MODE_LOW 0x01
+#define ZB_ZCL_FAN_CONTROL_FAN_MODE_MEDIUM 0x02
+#define ZB_ZCL_FAN_CONTROL_FAN_MODE_HIGH 0x03
+#define ZB_ZCL_FAN_CONTROL_FAN_MODE_ON 0x04
+#define ZB_ZCL_FAN_CONTROL_FAN_MODE_AUTO 0x05
+
+/* Temperature Measurement cluster */
+#define ZB_ZCL_ATTR_TEMP_MEASUREMENT_VALUE_ID 0x0000
+#define ZB_ZCL_TEMP_MEASUREMENT_VALUE_UNKNOWN ((zb_int16_t)0x8000)
+
+/* Metering cluster */
+#define ZB_ZCL_ATTR_METERING_CURRENT_SUMMATION_DELIVERED_ID 0x0000
+#define ZB_ZCL_ATTR_METERING_INSTANTANEOUS_DEMAND_ID 0x0400
+
+/**
+ * @brief Set an attribute in the host attribute store.
+ * @return ZB_ZCL_STATUS_SUCCESS, or ZB_ZCL_STATUS_UNSUP_ATTRIB for unregistered attributes
+ */
+zb_uint8_t zb_zcl_set_attr_val(zb_uint8_t ep, zb_uint16_t cluster_id, zb_uint8_t cluster_role,
+                               zb_uint16_t attr_id, zb_uint8_t *value, zb_bool_t check_access);
+
+#define ZB_ZCL_SET_ATTRIBUTE(ep, cluster_id, cluster_role, attr_id, value_ptr, check_access) \
+    zb_zcl_set_attr_val(ep, cluster_id, cluster_role, attr_id, value_ptr, check_access)
+
+/* Host shim control API */
+
+/** @brief Hook called for every attribute set, with whether the value changed. */
+typedef void (*zb_shim_attr_hook_t)(zb_uint8_t ep, zb_uint16_t cluster_id, zb_uint16_t attr_id,
+                                    const zb_uint8_t *value, size_t size, bool changed);
+
+/**
+ * @brief Register an attribute of the given size (in bytes, at most 8).
+ */
+void zb_shim_attr_register(zb_uint8_t ep, zb_uint16_t cluster_id, zb_uint16_t attr_id, size_t size);
+
+/**
+ * @brief Read an attribute as a signed value.
+ * @return false when the attribute is not registered
+ */
+bool zb_shim_attr_get(zb_uint8_t ep, zb_uint16_t cluster_id, zb_uint16_t attr_id, int32_t *p_value);
+
+/**
+ * @brief Install the attribute hook, NULL to remove it.
+ */
+void zb_shim_attr_hook_set(zb_shim_attr_hook_t hook);
+
+/**
+ * @brief Remove all registered attributes.
+ */
+void zb_shim_reset(void);
+
+#endif /* HOST_SHIM_ZBOSS_API_H */
@@ -0,0 +1,70 @@
+/**
+ * @file temp_check.c
+ * @brief Check of the temperature tables against their reference formulas
+ */
+
+#include <stdio.h>
+
+#include "include/mhi_temp.h"
+#include "temp_check.h"
+
+/**
+ * @brief Reference conversion of a raw temperature, in degrees Celsius.
+ */
+static double temp_reference(mhi_temp_table_t table, uint8_t raw)
+{
+    /* Outdoor temperature knots, raw value and degrees */
+    static const double outdoor[][2] = {{0, -35.0}, {16, -33.06}, {64, -17.34}, {192, 24.58}, {240, 40.3}, {255, 43.0}};
+    size_t i;
+
+    switch (table)
+    {
+    case MHI_TEMP_ROOM:
+        return (raw - 61) * 0.25;
+    case MHI_TEMP_SETPOINT:
+        return raw * 0.5;
+    case MHI_TEMP_RETURN_AIR:
+        return raw * 0.25 - 15;
+    case MHI_TEMP_HEAT_EXCH:
+        return raw * 0.327 - 11.4;
+    case MHI_TEMP_OUTDOOR:
+        for (i = 1; i + 1 < sizeof(outdoor) / sizeof(outdoor[0]) && raw >= outdoor[i][0]; i++)
+        {
+        }
+        return outdoor[i - 1][1] + (raw - outdoor[i - 1][0]) * (outdoor[i][1] - outdoor[i - 1][1]) /
+                                       (outdoor[i][0] - outdoor[i - 1][0]);
+    default:
+        return 0;
+    }
+}
+
+uint32_t temp_check(void)
+{
+    uint32_t errors = 0;
+
+    for (uint32_t table = 0; table < MHI_TEMP_TABLE_COUNT; table++)
+    {
+        for (uint32_t raw = 0; raw < 256; raw++)
+        {
+            double expected = temp_reference((mhi_temp_table_t)table, (uint8_t)raw) * 100;
+            int16_t value = mhi_temp_convert((mhi_temp_table_t)table, (uint8_t)raw, 0);
+
+            /* Tables round to the nearest hundredth, allow for ties going either way */
+            if (value < expected - 0.51 || value > expected + 0.51 ||
+                mhi_temp_convert((mhi_temp_table_t)table, (uint8_t)raw, -150) != value - 150)
+            {
+                fprintf(stderr, "temperature table %u code %u: %d, expected %.2f\n", table, raw, value, expected);
+                errors++;
+            }
+        }
+    }
+
+    if (mhi_temp_convert(MHI_TEMP_ROOM, 0, MHI_TEMP_MIN) != MHI_TEMP_MIN ||
+        mhi_temp_convert(MHI_TEMP_SETPOINT, 255, MHI_TEMP_MAX) != MHI_TEMP_MAX)
+    {
+        fprintf(stderr, "temperature calibration does not saturate\n");
+        errors++;
+    }
+
+    return errors;
+}
@@ -0,0 +1,22 @@
+/**
+ * @file temp_check.h
+ * @brief Check of the temperature tables against their reference formulas
+ *
+ * The tables of mhi_temp are generated at compile time from integer approximations of the
+ * MHI encodings. Every code of every table is compared with the encoding computed in floating
+ * point, so a wrong knot or rounding fails mhi_host and mhi_bench before they run.
+ */
+
+#ifndef HOST_TEMP_CHECK_H
+#define HOST_TEMP_CHECK_H 1
+
+#include <stdint.h>
+
+/**
+ * @brief Check all codes of the temperature tables against their reference, and the
+ * calibration offset and its saturation. Mismatches are printed on stderr.
+ * @return Number of mismatches
+ */
+uint32_t temp_check(void);
+
+#endif /* HOST_TEMP_CHECK_H */
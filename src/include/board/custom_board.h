@@ -44,11 +44,25 @@ extern "C"
 #define BSP_BUTTON_1 BUTTON_2
 
 #define TX_PIN_NUMBER 17
+/* Log UART RX, only used by the diagnostic CLI (MHI_CLI_ENABLED) */
+#define RX_PIN_NUMBER 20
 #define HWFC false
 
 #define APP_SPIS_SCK_PIN 29
 #define APP_SPIS_MOSI_PIN 30
 #define APP_SPIS_MISO_PIN 31
+#define APP_SPIS_CSN_PIN 28
+
+/* Second and third indoor unit, used with MHI_UNIT_COUNT > 1 */
+#define APP_SPIS_UNIT1_SCK_PIN 2
+#define APP_SPIS_UNIT1_MOSI_PIN 3
+#define APP_SPIS_UNIT1_MISO_PIN 4
+#define APP_SPIS_UNIT1_CSN_PIN 5
+
+#define APP_SPIS_UNIT2_SCK_PIN 11
+#define APP_SPIS_UNIT2_MOSI_PIN 12
+#define APP_SPIS_UNIT2_MISO_PIN 14
+#define APP_SPIS_UNIT2_CSN_PIN 15
 
 #ifdef __cplusplus
 }
@@ -0,0 +1,90 @@
+/**
+ * @file mhi_cli.h
+ * @brief Diagnostic command shell
+ *
+ * A few commands to look into a running unit and to drive it by hand: dump the last received
+ * frames and the next TX frame, the link, timing and command counters, a frame timing
+ * histogram and the opdata cache, send a command to the AC or inject a frame as if the AC sent
+ * it. The commands run in the main loop, called by the platform with the arguments of one
+ * command line; the SPIS interrupt only ever sees their effect on the link. On the device the
+ * lines come from nrf_cli on the log UART, on the host from stdin.
+ *
+ * The output goes through a printf-like callback, so each platform prints it its own way.
+ */
+
+#ifndef PROJECT_MHI_CLI_H
+#define PROJECT_MHI_CLI_H 1
+
+#include <stdarg.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#include "mhi_unit.h"
+
+#ifndef MHI_CLI_ENABLED
+#define MHI_CLI_ENABLED 0 /**< Set to 1 to serve the commands on the log UART of the device. */
+#endif
+
+#define MHI_CLI_ARGS_MAX 40 /**< Arguments of a line split by mhi_cli_exec_line, a frame in bytes fits. */
+
+/**
+ * @brief Command table, X(name, arguments, help). The name is the command word.
+ */
+#define MHI_CLI_COMMANDS(X)                                                                        \
+    X(help, "", "List the commands")                                                               \
+    X(unit, "[index]", "Show or select the unit the other commands act on")                        \
+    X(frames, "", "Dump the last received frames, newest first, and the next TX frame")            \
+    X(counters, "", "Dump the link, frame timing and command counters")                            \
+    X(hist, "[period|xfer|gap]", "Dump a frame timing histogram, the period by default")           \
+    X(opdata, "", "Dump the opdata cache and the last error snapshot")                             \
+    X(cmd, "field value", "Send a command to the AC, field by name or number, raw MHI value")      \
+    X(rx, "[raw] hex", "Inject a received frame, with its checksum filled in unless raw is given")
+
+/**
+ * @brief Output callback.
+ * @param p_context Context given to mhi_cli_init
+ * @param p_fmt printf format, only d, u, x, s and c conversions with width and zero padding
+ * @param p_args Arguments
+ */
+typedef void (*mhi_cli_print_t)(void *p_context, const char *p_fmt, va_list *p_args);
+
+/** @brief Shell state. */
+typedef struct
+{
+    mhi_unit_t *p_units;   /**< Units the commands act on. */
+    uint8_t unit_count;    /**< Number of units. */
+    uint8_t unit;          /**< Selected unit. */
+    mhi_cli_print_t print; /**< Output. */
+    void *p_context;       /**< Context of the output. */
+} mhi_cli_t;
+
+/**
+ * @brief Initialize the shell, the first unit is selected.
+ * @param p_cli Shell
+ * @param p_units Units
+ * @param unit_count Number of units
+ * @param print Output callback
+ * @param p_context Context passed to the output callback
+ */
+void mhi_cli_init(mhi_cli_t *p_cli, mhi_unit_t *p_units, uint8_t unit_count, mhi_cli_print_t print,
+                  void *p_context);
+
+/**
+ * @brief Run a command. Main loop.
+ * @param p_cli Shell
+ * @param argc Number of arguments, the command word included
+ * @param argv Arguments, argv[0] is the command word
+ * @return false when the command is unknown or its arguments are invalid, an error is printed
+ */
+bool mhi_cli_exec(mhi_cli_t *p_cli, size_t argc, char **argv);
+
+/**
+ * @brief Split a command line on blanks and run it. Main loop.
+ * @param p_cli Shell
+ * @param p_line Line, modified
+ * @return false when the command failed, true as well for an empty line
+ */
+bool mhi_cli_exec_line(mhi_cli_t *p_cli, char *p_line);
+
+#endif /* PROJECT_MHI_CLI_H */
@@ -0,0 +1,118 @@
+/**
+ * @file mhi_cmd.h
+ * @brief Commands to the AC and TX frame construction
+ *
+ * The AC only applies a field from the TX frame when the set bit of that field is present.
+ * Requests made between two frames are coalesced: all pending fields are sent together, with
+ * the last requested value per field.
+ *
+ * Every command is tracked until the RX frames show the requested value. The set bit is held
+ * for MHI_CMD_HOLD_FRAMES frames, some units only take it when it is present in several
+ * frames. Without confirmation the command pauses and is sent again, up to MHI_CMD_RETRIES
+ * times with a backoff that doubles every time, before it is given up.
+ *
+ * A room temperature can be supplied in DB3 of every TX frame, the AC then uses it instead of
+ * its own sensor.
+ */
+
+#ifndef PROJECT_MHI_CMD_H
+#define PROJECT_MHI_CMD_H 1
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#include "mhi_state.h"
+
+#define MHI_TX_DB14_TOGGLE_FRAMES 48 /**< DB14 bit 2 is toggled every this many frames. */
+#define MHI_TX_ROOM_TEMP_NONE 0xFF   /**< DB3 value when no room temperature is supplied. */
+
+#ifndef MHI_CMD_HOLD_FRAMES
+#define MHI_CMD_HOLD_FRAMES 8 /**< Frames the set bit is held per attempt. */
+#endif
+#ifndef MHI_CMD_RETRIES
+#define MHI_CMD_RETRIES 3 /**< Attempts after the first one. */
+#endif
+#ifndef MHI_CMD_BACKOFF_FRAMES
+#define MHI_CMD_BACKOFF_FRAMES 4 /**< Pause after the first attempt, doubled after each retry. */
+#endif
+
+/* The longest backoff, after the last retry but one, must fit the countdown of mhi_cmd_track_t */
+#if MHI_CMD_HOLD_FRAMES > 0xFFFF || (MHI_CMD_RETRIES > 0 && (MHI_CMD_BACKOFF_FRAMES << (MHI_CMD_RETRIES - 1)) > 0xFFFF)
+#error MHI_CMD_HOLD_FRAMES or MHI_CMD_BACKOFF_FRAMES << (MHI_CMD_RETRIES - 1) does not fit in 16 bits
+#endif
+/* The countdown is decremented before it is tested, a hold or backoff of 0 frames would wrap it */
+#if MHI_CMD_HOLD_FRAMES < 1 || MHI_CMD_BACKOFF_FRAMES < 1
+#error MHI_CMD_HOLD_FRAMES and MHI_CMD_BACKOFF_FRAMES must be at least 1
+#endif
+
+/** @brief Tracking of the command of one field. */
+typedef struct
+{
+    bool asserted;      /**< The set bit is sent, otherwise in backoff. */
+    uint8_t attempt;    /**< Attempts made, the current one included. */
+    uint16_t countdown; /**< Frames left in the current hold or backoff. */
+    uint16_t frames;    /**< Frames received since the request. */
+} mhi_cmd_track_t;
+
+/** @brief Command statistics. */
+typedef struct
+{
+    uint32_t applied;     /**< Commands confirmed by the AC. */
+    uint32_t failed;      /**< Commands given up. */
+    uint32_t retries;     /**< Attempts after the first one. */
+    uint32_t latency_sum; /**< Sum of the latencies of the applied commands, in frames. */
+    uint16_t latency_max; /**< Highest latency of an applied command, in frames. */
+} mhi_cmd_stats_t;
+
+/** @brief Command state. */
+typedef struct
+{
+    uint32_t pending;                    /**< Fields (MHI_FIELD_BIT) to send with the next frame. */
+    uint32_t active;                     /**< Fields with a command that is not confirmed yet. */
+    uint8_t value[MHI_FIELD_COUNT];      /**< Requested values, in raw MHI encoding. */
+    mhi_cmd_track_t track[MHI_FIELD_COUNT];
+    uint16_t latency[MHI_FIELD_COUNT];   /**< Frames from request to confirmation of the last applied command. */
+    uint8_t room_temp;                   /**< Room temperature sent in DB3, MHI_TX_ROOM_TEMP_NONE for the AC sensor. */
+    uint32_t unsupported;                /**< Fields the AC does not carry, refused by mhi_cmd_request. */
+    mhi_cmd_stats_t stats;
+} mhi_cmd_t;
+
+/**
+ * @brief Initialize the command state.
+ */
+void mhi_cmd_init(mhi_cmd_t *p_cmd);
+
+/**
+ * @brief Request a new value for a field.
+ * @param p_cmd Command state
+ * @param field Field to set, must be writable
+ * @param value New value, in raw MHI encoding
+ * @return false when the field is read only, not carried by the AC or the value out of range
+ */
+bool mhi_cmd_request(mhi_cmd_t *p_cmd, mhi_field_t field, uint8_t value);
+
+/**
+ * @brief Build the next TX frame, without checksum.
+ * @param p_cmd Command state
+ * @param p_frame TX frame of MHI_FRAME_SIZE_EXT bytes
+ * @param frame_count Number of frames received so far
+ * @return Mask of the fields included in the frame
+ */
+uint32_t mhi_cmd_build(const mhi_cmd_t *p_cmd, uint8_t *p_frame, uint32_t frame_count);
+
+/**
+ * @brief Check the active commands against a received frame and advance their retries.
+ * @param p_cmd Command state
+ * @param p_state AC state decoded from the frame
+ * @param p_failed Set to the fields whose command was given up
+ * @return Fields whose command the AC applied
+ */
+uint32_t mhi_cmd_on_rx(mhi_cmd_t *p_cmd, const mhi_state_t *p_state, uint32_t *p_failed);
+
+/**
+ * @brief Give up all active commands.
+ * @return Fields whose command was active
+ */
+uint32_t mhi_cmd_cancel(mhi_cmd_t *p_cmd);
+
+#endif /* PROJECT_MHI_CMD_H */
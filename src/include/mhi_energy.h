@@ -0,0 +1,148 @@
+/**
+ * @file mhi_energy.h
+ * @brief Energy used by one MHI indoor unit, integrated from its current
+ *
+ * The AC answers the current opdata in steps of 14/51 A. Every answer is a sample,
+ * timestamped with the app_timer counter when it is processed; the energy between two samples
+ * is the trapezoid of their currents times the nominal voltage. The integration runs in 64-bit
+ * fixed point: whole Wh in total_wh, the rest in frac, in units of 1/MHI_ENERGY_FRAC_DEN Wh, so
+ * no sample is rounded away. Samples further apart than MHI_ENERGY_MAX_GAP_MS, for instance
+ * around an offline period, are not integrated.
+ *
+ * Some units also answer a 16-bit energy counter in steps of MHI_ENERGY_COUNTER_WH. It is exact
+ * but coarse, so the integration fills in between its steps: each step sets the total to at
+ * least the energy the counter accounts for, and between steps the integrated total may run
+ * at most one step ahead. The counter wraps at 16 bits; a jump of more than
+ * MHI_ENERGY_COUNTER_MAX_STEPS steps, a counter reset or a replaced board, starts counting
+ * over from the current total. The total never decreases.
+ *
+ * The totals of all units are saved as one block: version, number of units, then per unit
+ * MHI_ENERGY_RECORD_SIZE bytes (total and counter anchor in Wh, 48-bit little endian, the
+ * counter, little endian, and whether it is known), padded with zeros to a multiple of
+ * MHI_ENERGY_SAVE_ALIGN bytes. A save is due once the total grew by MHI_ENERGY_SAVE_WH, or
+ * changed at all for MHI_ENERGY_SAVE_MAX_MS, but no sooner than MHI_ENERGY_SAVE_MIN_MS after
+ * the last one, which bounds the flash wear.
+ */
+
+#ifndef PROJECT_MHI_ENERGY_H
+#define PROJECT_MHI_ENERGY_H 1
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#include "app_timer.h"
+
+#ifndef MHI_ENERGY_VOLTAGE
+#define MHI_ENERGY_VOLTAGE 230 /**< Nominal mains voltage, in V. */
+#endif
+#ifndef MHI_ENERGY_MAX_GAP_MS
+#define MHI_ENERGY_MAX_GAP_MS 10000 /**< Longest time between two integrated current samples. */
+#endif
+#ifndef MHI_ENERGY_COUNTER_MAX_STEPS
+#define MHI_ENERGY_COUNTER_MAX_STEPS 400 /**< Largest energy counter step taken as energy used. */
+#endif
+#ifndef MHI_ENERGY_SAVE_WH
+#define MHI_ENERGY_SAVE_WH 100 /**< Energy after which the total is saved. */
+#endif
+#ifndef MHI_ENERGY_SAVE_MIN_MS
+#define MHI_ENERGY_SAVE_MIN_MS (10UL * 60 * 1000) /**< Shortest time between two saves. */
+#endif
+#ifndef MHI_ENERGY_SAVE_MAX_MS
+#define MHI_ENERGY_SAVE_MAX_MS (60UL * 60 * 1000) /**< Longest time a changed total is not saved. */
+#endif
+
+#define MHI_ENERGY_CURRENT_NUM 14    /**< Current of a raw step, numerator, in A. */
+#define MHI_ENERGY_CURRENT_DEN 51    /**< Current of a raw step, denominator. */
+#define MHI_ENERGY_COUNTER_WH 250    /**< Energy of an energy counter step. */
+#define MHI_ENERGY_RECORD_SIZE 15    /**< Bytes of the saved total of a unit. */
+#define MHI_ENERGY_SAVE_VERSION 1    /**< Version of the saved layout. */
+#define MHI_ENERGY_SAVE_ALIGN 4      /**< The saved layout is padded to a multiple of these bytes. */
+
+/** @brief Fractions of a Wh in mhi_energy_t frac: a raw current step over one app_timer tick,
+ * halved for the trapezoid, is MHI_ENERGY_CURRENT_NUM * voltage of them. */
+#define MHI_ENERGY_FRAC_DEN (2ULL * MHI_ENERGY_CURRENT_DEN * 3600 * APP_TIMER_TICKS(1000))
+
+/** @brief Bytes needed to save the totals of the given number of units. */
+#define MHI_ENERGY_SAVE_SIZE(units)                                                      \
+    ((2 + (units) * MHI_ENERGY_RECORD_SIZE + MHI_ENERGY_SAVE_ALIGN - 1) / MHI_ENERGY_SAVE_ALIGN * \
+     MHI_ENERGY_SAVE_ALIGN)
+
+/** @brief Energy accumulator of a unit. */
+typedef struct
+{
+    uint16_t voltage;         /**< Nominal voltage, in V. */
+    uint64_t total_wh;        /**< Energy used, whole Wh. */
+    uint64_t frac;            /**< Energy used beyond total_wh, in 1/MHI_ENERGY_FRAC_DEN Wh. */
+    bool sampled;             /**< current_raw and sample_ticks hold the last sample. */
+    uint8_t current_raw;      /**< Current of the last sample, raw. */
+    uint32_t sample_ticks;    /**< app_timer counter at the last sample. */
+    bool counter_known;       /**< counter holds the last energy counter of the AC. */
+    uint16_t counter;         /**< Last energy counter of the AC, raw. */
+    uint64_t counter_wh;      /**< Total at the last counter step, plus the steps since. */
+    uint64_t saved_wh;        /**< Total at the last save. */
+    uint32_t save_ticks;      /**< Time integrated since the last save, in app_timer ticks. */
+} mhi_energy_t;
+
+/**
+ * @brief Initialize an accumulator with a zero total.
+ * @param p_energy Accumulator
+ * @param voltage Nominal voltage, in V
+ */
+void mhi_energy_init(mhi_energy_t *p_energy, uint16_t voltage);
+
+/**
+ * @brief Integrate up to a current sample.
+ * @param p_energy Accumulator
+ * @param current_raw Current opdata of the AC, raw
+ * @param ticks app_timer counter at the sample
+ * @return true when total_wh changed
+ */
+bool mhi_energy_current(mhi_energy_t *p_energy, uint8_t current_raw, uint32_t ticks);
+
+/**
+ * @brief Reconcile the total with the energy counter of the AC.
+ * @param p_energy Accumulator
+ * @param counter Energy counter opdata of the AC, raw
+ * @return true when total_wh changed
+ */
+bool mhi_energy_counter(mhi_energy_t *p_energy, uint16_t counter);
+
+/**
+ * @brief Forget the last current sample, the next one starts a new integration. Call it when
+ * the samples stop, as the app_timer counter wraps.
+ */
+void mhi_energy_restart(mhi_energy_t *p_energy);
+
+/**
+ * @brief Power of the last current sample.
+ * @return Power in W, 0 without sample
+ */
+uint32_t mhi_energy_power(const mhi_energy_t *p_energy);
+
+/**
+ * @brief Whether the total should be saved now.
+ */
+bool mhi_energy_save_due(const mhi_energy_t *p_energy);
+
+/**
+ * @brief Save the totals of units and restart their save intervals.
+ * @param pp_energy Accumulators, one per unit
+ * @param count Number of accumulators
+ * @param p_buf Buffer of at least MHI_ENERGY_SAVE_SIZE(count) bytes
+ * @return Bytes written
+ */
+size_t mhi_energy_save(mhi_energy_t *const *pp_energy, uint8_t count, uint8_t *p_buf);
+
+/**
+ * @brief Load saved totals into initialized accumulators.
+ * @param pp_energy Accumulators, one per unit
+ * @param count Number of accumulators
+ * @param p_buf Saved totals
+ * @param len Bytes saved
+ * @return false when the saved layout is of another version or number of units, or truncated;
+ * the accumulators are then left alone
+ */
+bool mhi_energy_load(mhi_energy_t *const *pp_energy, uint8_t count, const uint8_t *p_buf, size_t len);
+
+#endif /* PROJECT_MHI_ENERGY_H */
@@ -0,0 +1,47 @@
+/**
+ * @file mhi_filter.h
+ * @brief Noise filter for raw MHI sensor values
+ *
+ * A moving median over the last frames removes single-frame spikes, and a hysteresis band
+ * around the output keeps a sensor sitting on the boundary between two codes from flipping
+ * the output back and forth. The output only follows the median once it moved more than the
+ * band away, so a window of 1 and a band of 0 pass the input through unchanged.
+ */
+
+#ifndef PROJECT_MHI_FILTER_H
+#define PROJECT_MHI_FILTER_H 1
+
+#include <stdint.h>
+
+#define MHI_FILTER_WINDOW_MAX 9 /**< Largest median window. */
+
+/** @brief Filter state. */
+typedef struct
+{
+    uint8_t samples[MHI_FILTER_WINDOW_MAX]; /**< Last samples, circular. */
+    uint8_t window;                         /**< Median window, odd. */
+    uint8_t band;                           /**< Hysteresis band, in raw units. */
+    uint8_t index;                          /**< Next sample slot. */
+    uint8_t primed;                         /**< The window holds valid samples. */
+    uint8_t input;                          /**< Last input. */
+    uint8_t output;                         /**< Current output. */
+    uint32_t suppressed;                    /**< Input changes that did not change the output. */
+} mhi_filter_t;
+
+/**
+ * @brief Initialize a filter.
+ * @param p_filter Filter
+ * @param window Median window, rounded down to an odd value and limited to MHI_FILTER_WINDOW_MAX
+ * @param band Hysteresis band in raw units
+ */
+void mhi_filter_init(mhi_filter_t *p_filter, uint8_t window, uint8_t band);
+
+/**
+ * @brief Add a sample. The first sample fills the whole window.
+ * @param p_filter Filter
+ * @param sample Raw sample
+ * @return Filtered value
+ */
+uint8_t mhi_filter_update(mhi_filter_t *p_filter, uint8_t sample);
+
+#endif /* PROJECT_MHI_FILTER_H */
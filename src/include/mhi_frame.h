@@ -0,0 +1,110 @@
+/**
+ * @file mhi_frame.h
+ * @brief MHI SPI frame layout and validation
+ *
+ * The AC is the SPI master and clocks a frame every ~40 ms. We receive the AC state on MOSI
+ * (the RX frame) and answer with our commands on MISO (the TX frame). A frame consists of
+ * three signature bytes (SB0-SB2), fifteen data bytes (DB0-DB14) and a 16-bit checksum
+ * (CBH/CBL) over all preceding bytes. Units with the extended protocol append DB15-DB26 and
+ * an 8-bit checksum (CBL2) over everything before it.
+ */
+
+#ifndef PROJECT_MHI_FRAME_H
+#define PROJECT_MHI_FRAME_H 1
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include "mhi_ramfunc.h"
+
+#define MHI_FRAME_SIZE 20     /**< Standard frame size. */
+#define MHI_FRAME_SIZE_EXT 33 /**< Extended frame size. */
+
+/** @brief Byte offsets within a frame. */
+enum
+{
+    MHI_SB0 = 0,
+    MHI_SB1,
+    MHI_SB2,
+    MHI_DB0,
+    MHI_DB1,
+    MHI_DB2,
+    MHI_DB3,
+    MHI_DB4,
+    MHI_DB5,
+    MHI_DB6,
+    MHI_DB7,
+    MHI_DB8,
+    MHI_DB9,
+    MHI_DB10,
+    MHI_DB11,
+    MHI_DB12,
+    MHI_DB13,
+    MHI_DB14,
+    MHI_CBH,
+    MHI_CBL,
+    MHI_DB15,
+    MHI_DB16,
+    MHI_DB17,
+    MHI_DB18,
+    MHI_DB19,
+    MHI_DB20,
+    MHI_DB21,
+    MHI_DB22,
+    MHI_DB23,
+    MHI_DB24,
+    MHI_DB25,
+    MHI_DB26,
+    MHI_CBL2,
+};
+
+#define MHI_RX_SB0 0x6C     /**< RX signature byte 0, standard frame. */
+#define MHI_RX_SB0_EXT 0x6D /**< RX signature byte 0, extended frame. */
+#define MHI_RX_SB1 0x80     /**< RX signature byte 1. */
+#define MHI_RX_SB2 0x04     /**< RX signature byte 2. */
+#define MHI_TX_SB0 0xA9     /**< TX signature byte 0. */
+#define MHI_TX_SB1 0x00     /**< TX signature byte 1. */
+#define MHI_TX_SB2 0x07     /**< TX signature byte 2. */
+
+/** @brief Frame validation result. */
+typedef enum
+{
+    MHI_FRAME_OK,
+    MHI_FRAME_ERR_LENGTH,
+    MHI_FRAME_ERR_SIGNATURE,
+    MHI_FRAME_ERR_CHECKSUM,
+} mhi_frame_status_t;
+
+/**
+ * @brief Sum of the given bytes, as used by the frame checksums, four bytes per step.
+ * @param p_data Start of the data
+ * @param len Number of bytes
+ */
+MHI_RAMFUNC uint16_t mhi_frame_sum(const uint8_t *p_data, size_t len);
+
+/**
+ * @brief Validate a received frame.
+ * @param p_frame Frame data
+ * @param len Number of bytes received
+ * @return MHI_FRAME_OK for a valid standard or extended frame
+ */
+MHI_RAMFUNC mhi_frame_status_t mhi_frame_validate(const uint8_t *p_frame, size_t len);
+
+/**
+ * @brief Fill in the checksum bytes of a frame.
+ * @param p_frame Frame data
+ * @param len MHI_FRAME_SIZE or MHI_FRAME_SIZE_EXT
+ */
+void mhi_frame_set_checksum(uint8_t *p_frame, size_t len);
+
+/**
+ * @brief Compare the data bytes of two frames.
+ * @param p_old Previous frame
+ * @param p_new New frame
+ * @param len Frame length
+ * @return Bitmask of the changed bytes (bit n for byte n), signature and checksum bytes excluded
+ * @note Compares four bytes per step, len must not exceed 64.
+ */
+uint64_t mhi_frame_diff(const uint8_t *p_old, const uint8_t *p_new, size_t len);
+
+#endif /* PROJECT_MHI_FRAME_H */
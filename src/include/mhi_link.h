@@ -0,0 +1,104 @@
+/**
+ * @file mhi_link.h
+ * @brief SPI link between the SPIS interrupt and the main loop
+ *
+ * The SPIS interrupt validates each received frame and pushes it into a small ring, and
+ * copies the staged TX frame into the DMA buffer for the next transfer. The main loop pops
+ * the frames and stages new TX frames. Both directions are lock free, with a single producer
+ * and a single consumer each.
+ *
+ * The statistics are incremented atomically by the interrupt and can be read at any time, the
+ * ZCL Diagnostics cluster points its attributes straight at them.
+ */
+
+#ifndef PROJECT_MHI_LINK_H
+#define PROJECT_MHI_LINK_H 1
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#include "mhi_frame.h"
+
+#define MHI_LINK_RING_SIZE 4            /**< Number of received frames that can be queued, power of 2. */
+#define MHI_LINK_FRAME_INTERVAL_MS 40   /**< Time between two frames of the AC. */
+#define MHI_LINK_TICKS_MASK 0x00FFFFFFUL /**< Transfer timestamps wrap at 24 bits, like the RTC. */
+
+/** @brief Link statistics. */
+typedef struct
+{
+    volatile uint32_t frames;           /**< Valid frames received. */
+    volatile uint32_t length_errors;    /**< Frames that were too short. */
+    volatile uint32_t signature_errors; /**< Frames with a wrong signature. */
+    volatile uint32_t checksum_errors;  /**< Frames with a wrong checksum. */
+    volatile uint32_t overruns;         /**< Valid frames dropped because the ring was full. */
+    volatile uint32_t resyncs;          /**< Valid frames following invalid ones. */
+    volatile uint32_t missing;          /**< Frames that never arrived, from the gaps between transfers. */
+} mhi_link_stats_t;
+
+/** @brief Received frame. */
+typedef struct
+{
+    uint8_t len;
+    uint8_t data[MHI_FRAME_SIZE_EXT];
+} mhi_link_frame_t;
+
+/** @brief Link state. */
+typedef struct
+{
+    mhi_link_frame_t rx[MHI_LINK_RING_SIZE];
+    volatile uint32_t rx_head; /**< Written by the interrupt. */
+    volatile uint32_t rx_tail; /**< Written by the main loop. */
+    uint8_t tx[2][MHI_FRAME_SIZE_EXT];
+    volatile uint8_t tx_active; /**< TX frame used by the interrupt. */
+    volatile uint32_t tx_taken; /**< Number of TX frames taken by the interrupt. */
+    uint32_t interval_ticks;    /**< Expected time between transfers, 0 disables missing frame detection. */
+    uint32_t last_xfer_ticks;   /**< Timestamp of the last transfer. */
+    bool in_error;              /**< The last transfer was invalid. */
+    bool timed;                 /**< last_xfer_ticks is valid. */
+    mhi_link_stats_t stats;
+} mhi_link_t;
+
+/**
+ * @brief Initialize the link.
+ */
+void mhi_link_init(mhi_link_t *p_link);
+
+/**
+ * @brief Handle a completed transfer. Interrupt context.
+ * @param p_link Link
+ * @param p_rx Received bytes
+ * @param rx_len Number of received bytes
+ * @param ticks Timestamp of the transfer, same unit as interval_ticks
+ * @return Validation result
+ */
+MHI_RAMFUNC mhi_frame_status_t mhi_link_rx_push(mhi_link_t *p_link, const uint8_t *p_rx, size_t rx_len, uint32_t ticks);
+
+/**
+ * @brief Copy the staged TX frame for the next transfer. Interrupt context.
+ * @param p_link Link
+ * @param p_tx TX DMA buffer of MHI_FRAME_SIZE_EXT bytes
+ */
+MHI_RAMFUNC void mhi_link_tx_get(mhi_link_t *p_link, uint8_t *p_tx);
+
+/**
+ * @brief Oldest received frame, or NULL when there is none. Main loop.
+ */
+const mhi_link_frame_t *mhi_link_rx_peek(mhi_link_t *p_link);
+
+/**
+ * @brief Release the frame returned by mhi_link_rx_peek. Main loop.
+ */
+void mhi_link_rx_pop(mhi_link_t *p_link);
+
+/**
+ * @brief Buffer to build the next TX frame in. Main loop.
+ */
+uint8_t *mhi_link_tx_stage(mhi_link_t *p_link);
+
+/**
+ * @brief Publish the frame built in the buffer from mhi_link_tx_stage. Main loop.
+ */
+void mhi_link_tx_commit(mhi_link_t *p_link);
+
+#endif /* PROJECT_MHI_LINK_H */
@@ -0,0 +1,153 @@
+/**
+ * @file mhi_log.h
+ * @brief Application logging, either through nrf_log or as compact binary frames
+ *
+ * When MHI_LOG_BINARY_ENABLED is set, a log call does not format anything on the device. It
+ * stores the offset of its format string within the mhi_log_fmt section and the raw 32-bit
+ * arguments (or the raw bytes for a hexdump) in a ring buffer, which is drained to the log
+ * UART as binary frames:
+ *
+ *   [MHI_LOG_SYNC] [format id, 16-bit LE] [payload length] [payload]
+ *
+ * The mhi_log_fmt section is not loaded on the device, it only lives in the ELF file. Use
+ * tools/mhi_log_decode.py with the ELF file to turn the frames back into readable output.
+ *
+ * Without MHI_LOG_BINARY_ENABLED the macros map directly to nrf_log.
+ */
+
+#ifndef PROJECT_MHI_LOG_H
+#define PROJECT_MHI_LOG_H 1
+
+#include <stddef.h>
+#include <stdint.h>
+
+#ifndef MHI_LOG_BINARY_ENABLED
+#define MHI_LOG_BINARY_ENABLED 0 /**< Set to 1 to enable the binary log mode. */
+#endif
+
+#ifndef MHI_LOG_LEVEL
+#define MHI_LOG_LEVEL 3 /**< Binary mode severity level: 1 error, 2 warning, 3 info, 4 debug. */
+#endif
+
+#define MHI_LOG_BUFSIZE 1024      /**< Size of the binary log ring buffer, must be a power of 2. */
+#define MHI_LOG_SYNC 0xA5         /**< First byte of every binary log frame. */
+#define MHI_LOG_HEADER_SIZE 4     /**< Sync byte, format id and payload length. */
+#define MHI_LOG_MAX_PAYLOAD 64    /**< Larger hexdumps are truncated to this size. */
+#define MHI_LOG_ID_DROPPED 0xFFFF /**< Format id of the frame reporting dropped frames, payload is the count. */
+
+#if MHI_LOG_BINARY_ENABLED
+
+/**
+ * @brief Place a format string in the (not loaded) format string section.
+ *
+ * The first character is the severity (E, W, I or D), the second one the payload kind: 'a' for
+ * 32-bit arguments and 'x' for raw bytes.
+ */
+#define MHI_LOG_FMT_ATTR __attribute__((section("mhi_log_fmt"), aligned(1)))
+
+#define MHI_LOG_NARGS_(...) MHI_LOG_NARGS_IMPL_(_0, ##__VA_ARGS__, 6, 5, 4, 3, 2, 1, 0)
+#define MHI_LOG_NARGS_IMPL_(_0, _1, _2, _3, _4, _5, _6, N, ...) N
+#define MHI_LOG_ARGS_(N, ...) MHI_LOG_ARGS_IMPL_(N, __VA_ARGS__)
+#define MHI_LOG_ARGS_IMPL_(N, ...) MHI_LOG_ARGS_##N(__VA_ARGS__)
+#define MHI_LOG_ARGS_0()
+#define MHI_LOG_ARGS_1(a) (uint32_t)(a)
+#define MHI_LOG_ARGS_2(a, b) (uint32_t)(a), (uint32_t)(b)
+#define MHI_LOG_ARGS_3(a, b, c) (uint32_t)(a), (uint32_t)(b), (uint32_t)(c)
+#define MHI_LOG_ARGS_4(a, b, c, d) MHI_LOG_ARGS_3(a, b, c), (uint32_t)(d)
+#define MHI_LOG_ARGS_5(a, b, c, d, e) MHI_LOG_ARGS_4(a, b, c, d), (uint32_t)(e)
+#define MHI_LOG_ARGS_6(a, b, c, d, e, f) MHI_LOG_ARGS_5(a, b, c, d, e), (uint32_t)(f)
+
+#define MHI_LOG_BIN_(level, fmt, ...)                                                      \
+    do                                                                                     \
+    {                                                                                      \
+        static const char _mhi_log_fmt[] MHI_LOG_FMT_ATTR = level "a" fmt;                 \
+        const uint32_t _mhi_log_args[] = {0, MHI_LOG_ARGS_(MHI_LOG_NARGS_(__VA_ARGS__),    \
+                                                           ##__VA_ARGS__)};                \
+        mhi_log_write(_mhi_log_fmt, &_mhi_log_args[1], MHI_LOG_NARGS_(__VA_ARGS__));      \
+    } while (0)
+
+#define MHI_LOG_BIN_HEXDUMP_(level, p_data, len)                                           \
+    do                                                                                     \
+    {                                                                                      \
+        static const char _mhi_log_fmt[] MHI_LOG_FMT_ATTR = level "x" __FILE__;            \
+        mhi_log_write_raw(_mhi_log_fmt, (p_data), (len));                                  \
+    } while (0)
+
+#define MHI_LOG_NONE_(...) \
+    do                     \
+    {                      \
+    } while (0)
+
+#if MHI_LOG_LEVEL >= 1
+#define MHI_LOG_ERROR(...) MHI_LOG_BIN_("E", __VA_ARGS__)
+#else
+#define MHI_LOG_ERROR(...) MHI_LOG_NONE_()
+#endif
+#if MHI_LOG_LEVEL >= 2
+#define MHI_LOG_WARNING(...) MHI_LOG_BIN_("W", __VA_ARGS__)
+#else
+#define MHI_LOG_WARNING(...) MHI_LOG_NONE_()
+#endif
+#if MHI_LOG_LEVEL >= 3
+#define MHI_LOG_INFO(...) MHI_LOG_BIN_("I", __VA_ARGS__)
+#define MHI_LOG_HEXDUMP_INFO(p_data, len) MHI_LOG_BIN_HEXDUMP_("I", p_data, len)
+#else
+#define MHI_LOG_INFO(...) MHI_LOG_NONE_()
+#define MHI_LOG_HEXDUMP_INFO(p_data, len) MHI_LOG_NONE_()
+#endif
+#if MHI_LOG_LEVEL >= 4
+#define MHI_LOG_DEBUG(...) MHI_LOG_BIN_("D", __VA_ARGS__)
+#define MHI_LOG_HEXDUMP_DEBUG(p_data, len) MHI_LOG_BIN_HEXDUMP_("D", p_data, len)
+#else
+#define MHI_LOG_DEBUG(...) MHI_LOG_NONE_()
+#define MHI_LOG_HEXDUMP_DEBUG(p_data, len) MHI_LOG_NONE_()
+#endif
+
+#else /* MHI_LOG_BINARY_ENABLED */
+
+#include "nrf_log.h"
+
+#define MHI_LOG_ERROR NRF_LOG_ERROR
+#define MHI_LOG_WARNING NRF_LOG_WARNING
+#define MHI_LOG_INFO NRF_LOG_INFO
+#define MHI_LOG_DEBUG NRF_LOG_DEBUG
+#define MHI_LOG_HEXDUMP_INFO NRF_LOG_HEXDUMP_INFO
+#define MHI_LOG_HEXDUMP_DEBUG NRF_LOG_HEXDUMP_DEBUG
+
+#endif /* MHI_LOG_BINARY_ENABLED */
+
+/**
+ * @brief Store a log frame with 32-bit arguments.
+ * @param p_fmt Format string, placed in the mhi_log_fmt section
+ * @param p_args Arguments
+ * @param nargs Number of arguments
+ */
+void mhi_log_write(const char *p_fmt, const uint32_t *p_args, uint8_t nargs);
+
+/**
+ * @brief Store a log frame with raw bytes, truncated to MHI_LOG_MAX_PAYLOAD bytes.
+ * @param p_fmt Format string, placed in the mhi_log_fmt section
+ * @param p_data Data to dump
+ * @param len Length of the data
+ */
+void mhi_log_write_raw(const char *p_fmt, const void *p_data, size_t len);
+
+/**
+ * @brief Get the oldest contiguous block of pending log bytes.
+ * @param pp_data Set to the start of the block
+ * @return Number of bytes in the block, 0 when the ring is empty
+ */
+size_t mhi_log_claim(const uint8_t **pp_data);
+
+/**
+ * @brief Release bytes previously returned by mhi_log_claim, once they have been sent.
+ * @param len Number of bytes to release
+ */
+void mhi_log_release(size_t len);
+
+/**
+ * @brief Number of frames that did not fit in the ring buffer since boot.
+ */
+uint32_t mhi_log_dropped(void);
+
+#endif /* PROJECT_MHI_LOG_H */
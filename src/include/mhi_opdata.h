@@ -0,0 +1,110 @@
+/**
+ * @file mhi_opdata.h
+ * @brief MHI operating data polling
+ *
+ * Operating data (outdoor temperature, current, ...) is not part of the regular frame. It is
+ * requested by setting DB6 bit 7 and the opdata code in DB9 of the TX frame; the AC answers
+ * with the code in DB9 and the value in DB10-DB12 of a later RX frame. The poller cycles
+ * through all known codes, holding each request for a few frames.
+ *
+ * The AC keeps an opdata snapshot of its last error. It is requested with code 0x45, the AC
+ * answers with DB9 0x45 and DB10 0x11 for the error number in DB11, and DB10 0x12 for the
+ * number of snapshot frames in DB11. The snapshot frames follow, four more than announced,
+ * with an opdata code and value each like regular answers, one per frame answering the error
+ * request. While a fetch runs the error request takes every other request slot, before and
+ * after the count is announced, so the regular polling continues at half rate and the snapshot
+ * frames arrive in between. The AC answers the request of the TX frame before the current one,
+ * so only frames answering the error request are taken into the snapshot and counted against
+ * the announced frames; the regular answers update the live values as usual.
+ */
+
+#ifndef PROJECT_MHI_OPDATA_H
+#define PROJECT_MHI_OPDATA_H 1
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#define MHI_OPDATA_HOLD_FRAMES 2            /**< Number of frames each request is sent. */
+#define MHI_OPDATA_ERROR_TIMEOUT_FRAMES 250 /**< Frames before an unanswered error snapshot request is given up. */
+
+/** @brief Polled operating data. */
+typedef enum
+{
+    MHI_OPDATA_RETURN_AIR_TEMP, /**< Return air temperature, raw. */
+    MHI_OPDATA_OUTDOOR_TEMP,    /**< Outdoor air temperature, raw. */
+    MHI_OPDATA_HEAT_EXCH_TEMP,  /**< Indoor heat exchanger temperature, raw. */
+    MHI_OPDATA_CURRENT,         /**< Outdoor unit current, raw. */
+    MHI_OPDATA_COMP_FREQ,       /**< Compressor frequency, raw. */
+    MHI_OPDATA_ENERGY,          /**< Energy counter, 16-bit raw. */
+    MHI_OPDATA_COUNT
+} mhi_opdata_t;
+
+/** @brief Error snapshot fetch state. */
+typedef enum
+{
+    MHI_OPDATA_ERROR_IDLE,       /**< No fetch running. */
+    MHI_OPDATA_ERROR_REQUESTING, /**< Requesting, waiting for the announcement. */
+    MHI_OPDATA_ERROR_RECEIVING,  /**< Receiving the snapshot frames. */
+} mhi_opdata_error_state_t;
+
+/** @brief Opdata snapshot of the last AC error. */
+typedef struct
+{
+    uint8_t code;                     /**< Error number. */
+    uint32_t valid;                   /**< Opdata present in the snapshot (bit per mhi_opdata_t). */
+    uint32_t value[MHI_OPDATA_COUNT]; /**< Snapshot values. */
+    uint16_t frames;                  /**< Duration of the fetch, in frames. */
+} mhi_opdata_error_t;
+
+/** @brief Opdata poller state and value cache. */
+typedef struct
+{
+    uint8_t index;                      /**< Opdata currently requested. */
+    uint8_t hold;                       /**< Frames left for the current request. */
+    uint32_t valid;                     /**< Opdata received at least once (bit per mhi_opdata_t). */
+    uint32_t value[MHI_OPDATA_COUNT];   /**< Last received values. */
+    uint32_t updated[MHI_OPDATA_COUNT]; /**< Frame count at which each value was received. */
+    uint8_t error_state;                /**< mhi_opdata_error_state_t. */
+    bool error_slot;                    /**< The current request is the error snapshot request. */
+    uint8_t error_sent;                 /**< TX frames that carried the error request, bit 0 the last one. */
+    uint8_t error_remaining;            /**< Snapshot frames still to receive. */
+    uint32_t error_start;               /**< Frame count at which the fetch started. */
+    mhi_opdata_error_t error;           /**< Last fetched snapshot, valid once error_fetched is set. */
+    bool error_fetched;                 /**< A fetch completed since the flag was last cleared. */
+} mhi_opdata_poller_t;
+
+/**
+ * @brief Initialize the poller.
+ */
+void mhi_opdata_init(mhi_opdata_poller_t *p_poller);
+
+/**
+ * @brief Add the current opdata request to a TX frame.
+ * @param p_poller Poller
+ * @param p_frame TX frame
+ */
+void mhi_opdata_build(const mhi_opdata_poller_t *p_poller, uint8_t *p_frame);
+
+/**
+ * @brief Process the opdata answer, if any, from a validated RX frame and advance the
+ * request schedule.
+ * @param p_poller Poller
+ * @param p_frame RX frame
+ * @param frame_count Current frame count
+ * @return The opdata that was updated, or MHI_OPDATA_COUNT when the frame had none
+ */
+mhi_opdata_t mhi_opdata_on_rx(mhi_opdata_poller_t *p_poller, const uint8_t *p_frame, uint32_t frame_count);
+
+/**
+ * @brief Start fetching the error snapshot, unless a fetch is already running.
+ * @param p_poller Poller
+ * @param frame_count Current frame count
+ */
+void mhi_opdata_error_fetch(mhi_opdata_poller_t *p_poller, uint32_t frame_count);
+
+/**
+ * @brief MHI opdata code of an opdata.
+ */
+uint8_t mhi_opdata_code(mhi_opdata_t opdata);
+
+#endif /* PROJECT_MHI_OPDATA_H */
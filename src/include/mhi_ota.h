@@ -0,0 +1,114 @@
+/**
+ * @file mhi_ota.h
+ * @brief Zigbee OTA Upgrade image pipeline
+ *
+ * Parses a Zigbee OTA upgrade file block by block as the OTA Upgrade client receives it, and
+ * streams the upgrade image sub-element straight into a secondary flash slot through the
+ * platform flash operations. Nothing but one write chunk is buffered, so the block size only
+ * determines the number of round trips.
+ *
+ * Verification reads the slot back and checks its CRC-32 against the CRC of the received
+ * data and, when the file has one, the MHI_OTA_TAG_CRC sub-element. Swapping the verified
+ * image into place is left to the platform.
+ */
+
+#ifndef PROJECT_MHI_OTA_H
+#define PROJECT_MHI_OTA_H 1
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#define MHI_OTA_FILE_ID 0x0BEEF11EUL  /**< OTA upgrade file identifier. */
+#define MHI_OTA_HEADER_SIZE 56        /**< Size of the mandatory OTA header fields. */
+#define MHI_OTA_ELEMENT_HEADER_SIZE 6 /**< Tag id and length of a sub-element. */
+#define MHI_OTA_TAG_UPGRADE_IMAGE 0x0000 /**< Sub-element with the firmware image. */
+#define MHI_OTA_TAG_CRC 0xF000        /**< Manufacturer specific sub-element: CRC-32 of the image. */
+#define MHI_OTA_WRITE_SIZE 256        /**< Flash write chunk, divides the page size. */
+
+/** @brief Pipeline status. */
+typedef enum
+{
+    MHI_OTA_OK,
+    MHI_OTA_ERR_STATE,  /**< Not started, or already failed. */
+    MHI_OTA_ERR_HEADER, /**< Invalid OTA header. */
+    MHI_OTA_ERR_SIZE,   /**< Image does not fit in the slot, or sizes are inconsistent. */
+    MHI_OTA_ERR_OFFSET, /**< Block does not continue at the expected file offset. */
+    MHI_OTA_ERR_FLASH,  /**< Flash erase, write or read failed. */
+    MHI_OTA_ERR_CRC,    /**< Image CRC does not match. */
+} mhi_ota_status_t;
+
+/** @brief Flash operations on the secondary slot, offsets are relative to the slot. */
+typedef struct
+{
+    uint32_t page_size;                                               /**< Erase unit. */
+    uint32_t slot_size;                                               /**< Size of the slot. */
+    bool (*p_erase)(uint32_t offset);                                 /**< Erase the page at offset. */
+    bool (*p_write)(uint32_t offset, const void *p_data, uint32_t len); /**< Write words, len is a multiple of 4. */
+    bool (*p_read)(uint32_t offset, void *p_data, uint32_t len);      /**< Read back. */
+} mhi_ota_flash_t;
+
+/** @brief Upgrade file header fields. */
+typedef struct
+{
+    uint16_t manufacturer; /**< Manufacturer code. */
+    uint16_t image_type;   /**< Image type. */
+    uint32_t file_version; /**< File version. */
+    uint32_t file_size;    /**< Total file size, including the header. */
+} mhi_ota_header_t;
+
+/** @brief Pipeline context. */
+typedef struct
+{
+    const mhi_ota_flash_t *p_flash;           /**< Slot flash operations. */
+    mhi_ota_status_t status;                  /**< First error, or MHI_OTA_OK. */
+    bool started;                             /**< mhi_ota_start was called. */
+    mhi_ota_header_t header;                  /**< Parsed header. */
+    uint32_t file_offset;                     /**< Next expected file offset. */
+    uint32_t skip;                            /**< Bytes left of the optional header fields or an ignored element. */
+    uint8_t field[MHI_OTA_HEADER_SIZE];       /**< Header or sub-element header being collected. */
+    uint32_t field_len;                       /**< Bytes collected in field. */
+    bool header_done;                         /**< The OTA header has been parsed. */
+    uint16_t element_tag;                     /**< Tag of the current sub-element. */
+    uint32_t element_left;                    /**< Bytes left in the current sub-element, 0 between elements. */
+    uint32_t image_size;                      /**< Size of the upgrade image sub-element. */
+    uint32_t image_crc;                       /**< CRC-32 of the received image bytes. */
+    uint32_t expected_crc;                    /**< CRC from the MHI_OTA_TAG_CRC sub-element. */
+    bool has_crc;                             /**< The file has a MHI_OTA_TAG_CRC sub-element. */
+    uint32_t written;                         /**< Image bytes flushed to the slot. */
+    uint32_t chunk_len;                       /**< Bytes in chunk. */
+    uint8_t chunk[MHI_OTA_WRITE_SIZE];        /**< Write chunk. */
+} mhi_ota_t;
+
+/**
+ * @brief Start receiving a new file.
+ * @param p_ota Pipeline
+ * @param p_flash Slot flash operations
+ * @param file_size Size of the file, as announced by the server
+ */
+mhi_ota_status_t mhi_ota_start(mhi_ota_t *p_ota, const mhi_ota_flash_t *p_flash, uint32_t file_size);
+
+/**
+ * @brief Process a received block. Blocks must arrive in order.
+ * @param p_ota Pipeline
+ * @param file_offset File offset of the block
+ * @param p_data Block data
+ * @param len Block length
+ */
+mhi_ota_status_t mhi_ota_block(mhi_ota_t *p_ota, uint32_t file_offset, const uint8_t *p_data, uint32_t len);
+
+/**
+ * @brief Verify the complete image in the slot.
+ */
+mhi_ota_status_t mhi_ota_verify(mhi_ota_t *p_ota);
+
+/**
+ * @brief Abort the transfer. The slot content is left as is.
+ */
+void mhi_ota_abort(mhi_ota_t *p_ota);
+
+/**
+ * @brief Update a CRC-32 (IEEE 802.3) with more data, start with 0.
+ */
+uint32_t mhi_ota_crc32(uint32_t crc, const uint8_t *p_data, uint32_t len);
+
+#endif /* PROJECT_MHI_OTA_H */
@@ -0,0 +1,42 @@
+/**
+ * @file mhi_ota_nrf.h
+ * @brief OTA Upgrade client glue for the nRF52840: secondary flash slot and image swap
+ *
+ * The OTA_SLOT region of the linker script receives the image while the application keeps
+ * running. Once the OTA Upgrade client reports the download finished and the image passed
+ * verification, a routine running from RAM copies the slot over the application and resets.
+ *
+ * A page erase stalls the CPU for 85 ms, interrupts included, long enough to lose SPI frames.
+ * When a download starts, a scheduler job erases the pages the file needs ahead of it, in
+ * partial erases of MHI_OTA_NRF_ERASE_STEP_MS that fit between two frames. The block writes
+ * stay synchronous, each takes a few milliseconds at most. A page the download reaches before
+ * the job is erased at once and counted.
+ */
+
+#ifndef PROJECT_MHI_OTA_NRF_H
+#define PROJECT_MHI_OTA_NRF_H 1
+
+#include "zboss_api.h"
+
+#include "include/mhi_sched.h"
+
+#ifndef MHI_OTA_NRF_ERASE_STEP_MS
+#define MHI_OTA_NRF_ERASE_STEP_MS 10 /**< Duration of one partial erase, ERASEPAGEPARTIALCFG. */
+#endif
+#define MHI_OTA_NRF_ERASE_SLACK_US 500 /**< Scheduling margin of a partial erase beyond its duration. */
+
+/**
+ * @brief Initialize the flash slot.
+ * @param file_version Version of the running firmware, older or equal images are refused
+ * @param p_sched Scheduler of the erase job
+ */
+void mhi_ota_nrf_init(zb_uint32_t file_version, mhi_sched_t *p_sched);
+
+/**
+ * @brief Handle a ZB_ZCL_OTA_UPGRADE_VALUE_CB_ID device callback.
+ * @param p_param OTA Upgrade callback parameters
+ * @return New upgrade status (ZB_ZCL_OTA_UPGRADE_STATUS_*)
+ */
+zb_uint8_t mhi_ota_nrf_handle(zb_zcl_ota_upgrade_value_param_t *p_param);
+
+#endif /* PROJECT_MHI_OTA_NRF_H */
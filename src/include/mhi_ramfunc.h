@@ -0,0 +1,50 @@
+/**
+ * @file mhi_ramfunc.h
+ * @brief Hot code run from RAM
+ *
+ * The SPIS interrupt validates and queues every frame. Run from flash, this code waits for
+ * the flash wait states on every cache miss and shares the flash bus with the radio driver,
+ * so its duration varies with what ran before. Functions marked MHI_RAMFUNC are linked into
+ * the .ramfunc section instead: it runs from RAM, its load image follows the initialized data
+ * in flash and mhi_ramfunc_init copies it at startup, before any of them is called.
+ *
+ * The marked functions are never inlined, so that flash code calls the RAM copy, and are
+ * called as long calls, RAM being out of reach of a BL from flash. Calls from RAM back into
+ * flash would go through veneers the linker adds and fetch from flash again, so the transfer
+ * handling reads the timer captures and the RTC through the inline HAL instead of the drivers.
+ * What is left in flash are the libc memcpy of the frame ring and the nrfx SPIS driver: its IRQ
+ * entry, which reads the events and calls the handler, and its buffers_set, which re-arms the
+ * next transfer. The driver tracks the semaphore in its own state, so the handler must go
+ * through it rather than set the buffers with the HAL. The SDK's nrf_common.ld gives every
+ * .text input section to .text before the sections this project's linker script inserts, so
+ * the driver object cannot be moved here without editing the SDK.
+ * Functions that run while the flash is erased, such as the OTA swap, need their own
+ * section, they must not call into flash at all.
+ *
+ * MHI_RAMFUNC_ENABLED 0 leaves everything in flash, to compare the cycle counts of the
+ * transfer handling (see the README). Off target the macro marks nothing.
+ */
+
+#ifndef PROJECT_MHI_RAMFUNC_H
+#define PROJECT_MHI_RAMFUNC_H 1
+
+#ifndef MHI_RAMFUNC_ENABLED
+#if defined(__arm__)
+#define MHI_RAMFUNC_ENABLED 1 /**< Link the marked functions into RAM. */
+#else
+#define MHI_RAMFUNC_ENABLED 0
+#endif
+#endif
+
+#if MHI_RAMFUNC_ENABLED
+#define MHI_RAMFUNC __attribute__((noinline, long_call, section(".ramfunc")))
+#else
+#define MHI_RAMFUNC
+#endif
+
+/**
+ * @brief Copy the .ramfunc section from flash to RAM. Call first in main.
+ */
+void mhi_ramfunc_init(void);
+
+#endif /* PROJECT_MHI_RAMFUNC_H */
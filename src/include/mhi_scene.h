@@ -0,0 +1,168 @@
+/**
+ * @file mhi_scene.h
+ * @brief Scenes of one MHI indoor unit: table, ZCL Scenes commands and NVRAM layout
+ *
+ * A scene holds the writable fields of the AC state (power, mode, fan, setpoint and vanes)
+ * packed with the bit widths of the MHI field table, 3 bytes for all of them. Store Scene
+ * takes the current state, Add Scene the current state overridden by its extension field
+ * sets (see mhi_zcl_scene_ext_parse). Recall Scene requests every field that differs from the
+ * current state at once, so the whole scene goes to the AC in one TX frame. Fields outside
+ * their range, like the left/right vanes of a unit with standard frames, are left alone.
+ *
+ * The transition time is ignored, the AC has no fades, and scene names are not supported.
+ *
+ * The tables of all units are saved as one block: version, number of units, then per unit
+ * the number of scenes and MHI_SCENE_RECORD_SIZE bytes per scene (group id little endian,
+ * scene id, packed fields), padded with zeros to a multiple of MHI_SCENE_SAVE_ALIGN bytes as
+ * the Zigbee NVRAM writes whole flash words.
+ */
+
+#ifndef PROJECT_MHI_SCENE_H
+#define PROJECT_MHI_SCENE_H 1
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#include "zboss_api.h"
+
+#include "mhi_cmd.h"
+#include "mhi_state.h"
+
+#ifndef MHI_SCENE_MAX
+#define MHI_SCENE_MAX 16 /**< Scenes per unit. */
+#endif
+
+#define MHI_SCENE_PACKED_SIZE 3    /**< Bytes of the packed fields of a scene. */
+#define MHI_SCENE_RECORD_SIZE 6    /**< Bytes of a saved scene. */
+#define MHI_SCENE_SAVE_VERSION 1   /**< Version of the saved layout. */
+#define MHI_SCENE_SAVE_ALIGN 4     /**< The saved layout is padded to a multiple of these bytes. */
+#define MHI_SCENE_GROUP_ALL 0xFFFF /**< Every group for mhi_scene_remove_group, not a valid group id. */
+
+/** @brief Bytes needed to save the scene tables of the given number of units. */
+#define MHI_SCENE_SAVE_SIZE(units)                                                                \
+    ((2 + (units) * (1 + MHI_SCENE_MAX * MHI_SCENE_RECORD_SIZE) + MHI_SCENE_SAVE_ALIGN - 1) /   \
+     MHI_SCENE_SAVE_ALIGN * MHI_SCENE_SAVE_ALIGN)
+
+/** @brief Bytes of the longest response: View Scene with all extension field sets, or Get
+ * Scene Membership with a full table. */
+#define MHI_SCENE_RESP_SIZE (5 + MHI_SCENE_MAX > 28 ? 5 + MHI_SCENE_MAX : 28)
+
+/** @brief Scene. */
+typedef struct
+{
+    uint16_t group_id;                      /**< Group of the scene, 0 for none. */
+    uint8_t scene_id;                       /**< Scene within the group. */
+    uint8_t packed[MHI_SCENE_PACKED_SIZE];  /**< Writable fields, see mhi_scene_pack. */
+} mhi_scene_t;
+
+/** @brief Scene table of a unit. */
+typedef struct
+{
+    uint8_t count;                          /**< Scenes in use, at the start of scene[]. */
+    bool dirty;                             /**< Scenes were added or removed since the last save. */
+    bool valid;                             /**< The AC state is the one of the current scene. */
+    uint16_t current_group;                 /**< Group of the last stored or recalled scene. */
+    uint8_t current_scene;                  /**< Last stored or recalled scene. */
+    mhi_scene_t scene[MHI_SCENE_MAX];
+} mhi_scene_table_t;
+
+/** @brief Outcome of a ZCL Scenes command. */
+typedef struct
+{
+    zb_uint8_t status;                      /**< ZCL status, also in data[0] when specific. */
+    bool specific;                          /**< The command has a response of its own, in data. */
+    size_t len;                             /**< Bytes of the response payload. */
+    uint8_t data[MHI_SCENE_RESP_SIZE];      /**< Response payload. */
+} mhi_scene_resp_t;
+
+/**
+ * @brief Initialize an empty scene table.
+ */
+void mhi_scene_table_init(mhi_scene_table_t *p_table);
+
+/**
+ * @brief Pack the writable fields of a state.
+ * @param p_state State
+ * @param p_packed MHI_SCENE_PACKED_SIZE bytes
+ */
+void mhi_scene_pack(const mhi_state_t *p_state, uint8_t *p_packed);
+
+/**
+ * @brief Unpack the writable fields of a scene, the other fields are set to 0.
+ * @param p_packed MHI_SCENE_PACKED_SIZE bytes
+ * @param p_state State
+ */
+void mhi_scene_unpack(const uint8_t *p_packed, mhi_state_t *p_state);
+
+/**
+ * @brief Find a scene.
+ * @return The scene, NULL when it is not in the table
+ */
+mhi_scene_t *mhi_scene_find(mhi_scene_table_t *p_table, uint16_t group_id, uint8_t scene_id);
+
+/**
+ * @brief Add a scene or replace the fields of an existing one.
+ * @return false when the table is full
+ */
+bool mhi_scene_store(mhi_scene_table_t *p_table, uint16_t group_id, uint8_t scene_id, const mhi_state_t *p_state);
+
+/**
+ * @brief Remove the scenes of a group, when the group is removed or for Remove All Scenes.
+ * @param p_table Scene table
+ * @param group_id Group, MHI_SCENE_GROUP_ALL for the scenes of every group
+ */
+void mhi_scene_remove_group(mhi_scene_table_t *p_table, uint16_t group_id);
+
+/**
+ * @brief Request the fields of a scene that differ from the current state.
+ * @param p_scene Scene
+ * @param p_state Current AC state
+ * @param p_cmd Commands of the unit
+ * @return Mask of the fields (MHI_FIELD_BIT) requested
+ */
+uint32_t mhi_scene_recall(const mhi_scene_t *p_scene, const mhi_state_t *p_state, mhi_cmd_t *p_cmd);
+
+/**
+ * @brief Handle a ZCL Scenes command addressed to the unit.
+ * @param p_table Scene table of the unit
+ * @param p_state Current AC state
+ * @param p_cmd Commands of the unit, for Recall Scene
+ * @param cmd_id ZCL command
+ * @param p_req Command payload
+ * @param req_len Bytes of the payload
+ * @param in_group The group of the command is 0 or has the endpoint of the unit as member
+ * @param p_resp Response
+ * @return false when the command is not supported
+ */
+bool mhi_scene_command(mhi_scene_table_t *p_table, const mhi_state_t *p_state, mhi_cmd_t *p_cmd, zb_uint8_t cmd_id,
+                       const uint8_t *p_req, size_t req_len, bool in_group, mhi_scene_resp_t *p_resp);
+
+/**
+ * @brief Bytes mhi_scene_save writes for scene tables as they are now.
+ * @param pp_tables Tables, one per unit
+ * @param count Number of tables
+ */
+size_t mhi_scene_save_size(mhi_scene_table_t *const *pp_tables, uint8_t count);
+
+/**
+ * @brief Save scene tables and clear their dirty flag.
+ * @param pp_tables Tables, one per unit
+ * @param count Number of tables
+ * @param p_buf Buffer of at least MHI_SCENE_SAVE_SIZE(count) bytes
+ * @return Bytes written
+ */
+size_t mhi_scene_save(mhi_scene_table_t *const *pp_tables, uint8_t count, uint8_t *p_buf);
+
+/**
+ * @brief Load saved scene tables.
+ * @param pp_tables Tables, one per unit
+ * @param count Number of tables
+ * @param p_buf Saved tables
+ * @param len Bytes saved
+ * @return false when the saved layout is of another version or number of units, or truncated;
+ * the tables are then left empty
+ */
+bool mhi_scene_load(mhi_scene_table_t *const *pp_tables, uint8_t count, const uint8_t *p_buf, size_t len);
+
+#endif /* PROJECT_MHI_SCENE_H */
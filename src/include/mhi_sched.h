@@ -0,0 +1,141 @@
+/**
+ * @file mhi_sched.h
+ * @brief Background work in the idle gaps between the SPI frames
+ *
+ * Flash erases and writes stall the CPU, interrupts included. One that runs across the CSN
+ * fall of the next frame can keep the SPIS interrupt from setting up the buffers in time, and
+ * the frame is lost. The scheduler runs such work only where no frame is expected.
+ *
+ * The SPIS interrupt reports every transfer with mhi_sched_on_xfer. From these timestamps the
+ * scheduler learns the frame period of every unit: intervals within a quarter of the period
+ * refine it, a clearly shorter one starts over from it, longer ones (missed frames, silence)
+ * are ignored. The next transfer of a unit is expected one period after the last, its CSN
+ * falls a transfer time before that. Until the platform sets a measured transfer time with
+ * mhi_sched_xfer_set, MHI_SCHED_XFER_US is assumed. A unit that has been silent for
+ * MHI_SCHED_STALE_PERIODS periods does not restrict the scheduling.
+ *
+ * A job is a series of resumable steps of a bounded duration. mhi_sched_run, called from the
+ * main loop, runs one step of every job in turn as long as the step still ends
+ * MHI_SCHED_GUARD_US before the next expected CSN fall of any unit, and leaves the rest for the
+ * next gap. A step must be shorter than the gap between two frames, or it never runs. One call
+ * runs steps for at most MHI_SCHED_SLICE_MS, also when no frame is expected, so the Zigbee
+ * stack keeps its share of the main loop.
+ */
+
+#ifndef PROJECT_MHI_SCHED_H
+#define PROJECT_MHI_SCHED_H 1
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#include "app_timer.h"
+
+#include "mhi_ramfunc.h"
+
+#ifndef MHI_SCHED_GUARD_US
+#define MHI_SCHED_GUARD_US 2000 /**< Margin between the end of a step and the next CSN fall. */
+#endif
+#ifndef MHI_SCHED_XFER_US
+#define MHI_SCHED_XFER_US 10000 /**< Transfer time until a measured one is set, an extended frame takes 8.5 ms. */
+#endif
+
+#ifndef MHI_SCHED_SLICE_MS
+#define MHI_SCHED_SLICE_MS 40 /**< Longest time one mhi_sched_run call runs steps. */
+#endif
+
+#define MHI_SCHED_UNITS_MAX 3        /**< Units whose frames are protected. */
+#define MHI_SCHED_JOBS_MAX 4         /**< Jobs that can be queued. */
+#define MHI_SCHED_PERIOD_MIN_MS 10   /**< Shortest frame period learned. */
+#define MHI_SCHED_PERIOD_MAX_MS 200  /**< Longest frame period learned. */
+#define MHI_SCHED_STALE_PERIODS 4    /**< Periods without transfer after which a unit is ignored. */
+
+/** @brief Microseconds in app_timer ticks, rounded up. */
+#define MHI_SCHED_US_TO_TICKS(us) ((uint32_t)(((uint64_t)(us) * APP_TIMER_TICKS(1000) + 999999) / 1000000))
+
+/**
+ * @brief Step of a job.
+ * @param p_context Context given to mhi_sched_submit
+ * @return true when the job is done
+ */
+typedef bool (*mhi_sched_step_t)(void *p_context);
+
+/** @brief Queued job. */
+typedef struct
+{
+    mhi_sched_step_t p_step; /**< Runs one step. */
+    void *p_context;         /**< Context of p_step. */
+    uint32_t step_ticks;     /**< Longest duration of a step. */
+} mhi_sched_job_t;
+
+/** @brief Learned frame cadence of a unit. */
+typedef struct
+{
+    volatile uint32_t last_ticks; /**< app_timer counter at the last transfer. */
+    volatile uint32_t xfers;      /**< Transfers reported. */
+    volatile uint32_t period_q4;  /**< Frame period in 1/16 ticks, 0 while unknown. */
+    uint32_t xfer_ticks;          /**< Time from the CSN fall to the end of a transfer. */
+} mhi_sched_cadence_t;
+
+/** @brief Scheduler. */
+typedef struct
+{
+    mhi_sched_cadence_t unit[MHI_SCHED_UNITS_MAX];
+    uint8_t unit_count;
+    mhi_sched_job_t jobs[MHI_SCHED_JOBS_MAX];
+    uint8_t job_count;
+    uint32_t steps; /**< Steps run. */
+} mhi_sched_t;
+
+/**
+ * @brief Initialize a scheduler without jobs or known cadence.
+ * @param p_sched Scheduler
+ * @param units Number of units, at most MHI_SCHED_UNITS_MAX
+ */
+void mhi_sched_init(mhi_sched_t *p_sched, uint8_t units);
+
+/**
+ * @brief Learn from a completed transfer. Interrupt context.
+ * @param p_sched Scheduler
+ * @param unit Index of the unit
+ * @param ticks app_timer counter at the end of the transfer
+ */
+MHI_RAMFUNC void mhi_sched_on_xfer(mhi_sched_t *p_sched, uint8_t unit, uint32_t ticks);
+
+/**
+ * @brief Set the measured transfer time of a unit.
+ * @param p_sched Scheduler
+ * @param unit Index of the unit
+ * @param xfer_us Longest time from the CSN fall to the end of a transfer, 0 for the default
+ */
+void mhi_sched_xfer_set(mhi_sched_t *p_sched, uint8_t unit, uint32_t xfer_us);
+
+/**
+ * @brief Queue a job, unless the same step and context are queued already.
+ * @param p_sched Scheduler
+ * @param p_step Step function, called until it returns true
+ * @param p_context Context of the step function
+ * @param step_us Longest duration of a step
+ * @return false when the queue is full
+ */
+bool mhi_sched_submit(mhi_sched_t *p_sched, mhi_sched_step_t p_step, void *p_context, uint32_t step_us);
+
+/**
+ * @brief Remove a queued job.
+ */
+void mhi_sched_cancel(mhi_sched_t *p_sched, mhi_sched_step_t p_step, void *p_context);
+
+/**
+ * @brief Time a step may take now.
+ * @param p_sched Scheduler
+ * @param now_ticks app_timer counter
+ * @return Ticks until MHI_SCHED_GUARD_US before the next expected CSN fall, UINT32_MAX when
+ * no frame is expected
+ */
+uint32_t mhi_sched_budget(const mhi_sched_t *p_sched, uint32_t now_ticks);
+
+/**
+ * @brief Run the steps that fit in the current gap. Main loop.
+ */
+void mhi_sched_run(mhi_sched_t *p_sched);
+
+#endif /* PROJECT_MHI_SCHED_H */
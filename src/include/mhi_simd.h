@@ -0,0 +1,81 @@
+/**
+ * @file mhi_simd.h
+ * @brief Byte-parallel operations on 32-bit words
+ *
+ * The frame kernels handle four bytes per step. On a Cortex-M4 with the DSP extension every
+ * operation is one to three SIMD instructions (USADA8, USUB8, SEL). Elsewhere, on the host
+ * and on cores without the extension, a portable C version computes the same result from
+ * plain 32-bit arithmetic. MHI_SIMD_DSP selects the version at compile time; the host
+ * benchmark checks that the kernels built on either one match a byte-wise reference.
+ *
+ * Words are loaded little endian: bit n of a lane mask belongs to the byte at offset n.
+ */
+
+#ifndef PROJECT_MHI_SIMD_H
+#define PROJECT_MHI_SIMD_H 1
+
+#include <stdint.h>
+
+#ifndef MHI_SIMD_DSP
+#if defined(__ARM_FEATURE_DSP) && __ARM_FEATURE_DSP
+#define MHI_SIMD_DSP 1 /**< Use the Cortex-M4 SIMD instructions. */
+#else
+#define MHI_SIMD_DSP 0
+#endif
+#endif
+
+#if defined(__BYTE_ORDER__) && __BYTE_ORDER__ != __ORDER_LITTLE_ENDIAN__
+#error The byte lanes of mhi_simd.h assume a little endian target.
+#endif
+
+#if MHI_SIMD_DSP
+#include "cmsis_compiler.h"
+#endif
+
+/**
+ * @brief Load four bytes as a word, at any alignment.
+ */
+static inline uint32_t mhi_simd_load(const uint8_t *p_data)
+{
+    uint32_t word;
+
+    /* A single LDR on the Cortex-M4, which allows unaligned word loads. The builtin is
+     * expanded also under -fno-builtin, a memcpy call would run from flash. */
+    __builtin_memcpy(&word, p_data, sizeof(word));
+
+    return word;
+}
+
+/**
+ * @brief Add the four bytes of a word to an accumulator.
+ */
+static inline uint32_t mhi_simd_sum4(uint32_t word, uint32_t acc)
+{
+#if MHI_SIMD_DSP
+    return __USADA8(word, 0, acc);
+#else
+    /* Pairs of bytes into 16-bit lanes, then the two lanes */
+    word = (word & 0x00FF00FFUL) + ((word >> 8) & 0x00FF00FFUL);
+    return acc + ((word + (word >> 16)) & 0xFFFFUL);
+#endif
+}
+
+/**
+ * @brief Mask of the non-zero bytes of a word.
+ * @return Bit n set when byte n is not zero
+ */
+static inline uint32_t mhi_simd_nonzero4(uint32_t word)
+{
+#if MHI_SIMD_DSP
+    /* GE flag n is set when byte n >= 1; select its bit value and sum the four lanes */
+    (void)__USUB8(word, 0x01010101UL);
+    return __USADA8(__SEL(0x08040201UL, 0), 0, 0);
+#else
+    /* Top bit of each byte set when the byte is non-zero, without carries between bytes */
+    word = (((word & 0x7F7F7F7FUL) + 0x7F7F7F7FUL) | word) & 0x80808080UL;
+    /* Gather bits 7, 15, 23 and 31 into bits 21 to 24 */
+    return ((word >> 7) * 0x00204081UL) >> 21 & 0xFUL;
+#endif
+}
+
+#endif /* PROJECT_MHI_SIMD_H */
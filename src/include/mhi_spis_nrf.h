@@ -0,0 +1,68 @@
+/**
+ * @file mhi_spis_nrf.h
+ * @brief SPIS re-arming without the CPU for the nRF52840
+ *
+ * After every transfer the SPIS driver takes the semaphore back through the END_ACQUIRE
+ * shortcut, and the SPIS ignores the next transfer until the interrupt has set the buffers
+ * and released it. When the radio driver or a flash operation keeps the CPU busy past the next
+ * CSN fall, that transfer is lost and the AC gets no answer.
+ *
+ * With MHI_SPIS_NRF_REARM, a PPI channel triggers RELEASE on the ACQUIRED event, so the SPIS
+ * gets the semaphore back in hardware right after every transfer and serves the next one
+ * whatever the CPU does. The SPIS has no list mode, so the buffers cannot rotate without the
+ * CPU: the same RX buffer is used for every transfer. The SPIS interrupt no longer hands over
+ * the frames; the main loop polls the timestamps of mhi_timing_nrf for a completed transfer
+ * and copies it out while no transfer runs. A frame overwritten before the main loop got to it
+ * is lost, and counted as missing by the link; the AC got the previous TX frame once more.
+ * Re-arming therefore does not lose fewer frames than the SPIS interrupt does, it keeps the AC
+ * answered: no transfer is ignored, which the transfer counters of mhi_timing_nrf show.
+ *
+ * The TX buffer is doubled, so the DMA never reads a frame being written: the main loop stages
+ * the next frame in the idle buffer, then takes the semaphore with mhi_spis_nrf_acquire, points
+ * the SPIS at that buffer and gives the semaphore back with mhi_spis_nrf_release.
+ */
+
+#ifndef PROJECT_MHI_SPIS_NRF_H
+#define PROJECT_MHI_SPIS_NRF_H 1
+
+#include <stdint.h>
+
+#include "nrf.h"
+
+#ifndef MHI_SPIS_NRF_REARM
+#define MHI_SPIS_NRF_REARM 0 /**< Re-arm the SPIS instances through PPI, the AC is always answered. */
+#endif
+
+#define MHI_SPIS_NRF_UNITS_MAX 3 /**< Units that can be re-armed. */
+
+/**
+ * @brief Connect the ACQUIRED event of a unit to its RELEASE task, disabled. Call after the
+ * SPIS instance is initialized and before it has buffers.
+ * @param unit Index of the unit, below MHI_SPIS_NRF_UNITS_MAX
+ * @param p_spis SPIS instance of the unit
+ */
+void mhi_spis_nrf_rearm_init(uint8_t unit, NRF_SPIS_Type *p_spis);
+
+/**
+ * @brief Start re-arming a unit. Call once its first buffers are set, on
+ * NRF_DRV_SPIS_BUFFERS_SET_DONE, the buffers are not set again.
+ * @param unit Index of the unit
+ */
+void mhi_spis_nrf_rearm_start(uint8_t unit);
+
+/**
+ * @brief Stop re-arming a unit and take the semaphore from its SPIS, so its buffers can be
+ * changed. Waits for the end of a transfer that has started. Main loop.
+ * @param unit Index of the unit
+ * @param p_spis SPIS instance of the unit
+ */
+void mhi_spis_nrf_acquire(uint8_t unit, NRF_SPIS_Type *p_spis);
+
+/**
+ * @brief Give the semaphore back to the SPIS of a unit and re-arm it again. Main loop.
+ * @param unit Index of the unit
+ * @param p_spis SPIS instance of the unit
+ */
+void mhi_spis_nrf_release(uint8_t unit, NRF_SPIS_Type *p_spis);
+
+#endif /* PROJECT_MHI_SPIS_NRF_H */
@@ -0,0 +1,35 @@
+/**
+ * @file mhi_stack.h
+ * @brief Stack high-water mark for the nRF52840
+ *
+ * The free part of the stack is filled with a known pattern at boot. The lowest word that no
+ * longer holds the pattern is the deepest the stack has been, which gives the number of bytes
+ * of the __STACK_SIZE configured in the Makefile that were never used.
+ */
+
+#ifndef PROJECT_MHI_STACK_H
+#define PROJECT_MHI_STACK_H 1
+
+#include <stdint.h>
+
+#define MHI_STACK_PAINT 0xDEADBEEFUL /**< Pattern of the unused stack words. */
+#define MHI_STACK_PAINT_MARGIN 64    /**< Bytes below the stack pointer left untouched while painting. */
+
+/**
+ * @brief Paint the free part of the stack. Call first thing in main.
+ */
+void mhi_stack_paint(void);
+
+/**
+ * @brief Size of the stack region.
+ * @return Size in bytes
+ */
+uint32_t mhi_stack_size(void);
+
+/**
+ * @brief Scan the stack for the high-water mark.
+ * @return Bytes of the stack that were never used since mhi_stack_paint
+ */
+uint32_t mhi_stack_unused(void);
+
+#endif /* PROJECT_MHI_STACK_H */
@@ -0,0 +1,114 @@
+/**
+ * @file mhi_state.h
+ * @brief Decoded MHI AC state
+ */
+
+#ifndef PROJECT_MHI_STATE_H
+#define PROJECT_MHI_STATE_H 1
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include "mhi_frame.h"
+
+/**
+ * @brief MHI field descriptor table, the single description of the fields of the AC state.
+ *
+ * X(name, byte, mask, shift, offset, set_byte, set_bit, min, max):
+ * - name: field MHI_FIELD_<name>
+ * - byte, mask, shift: location of the field in RX and TX frames, (frame[byte] >> shift) & mask
+ * - offset: added to the frame bits to get the value (fan speeds 1-4 are sent as 0-3)
+ * - set_byte, set_bit: TX bit making the AC apply the field, 0 for read only fields
+ * - min, max: range of values accepted by mhi_cmd_request
+ *
+ * Values are kept in their raw MHI encoding: power 0 off / 1 on, mode mhi_mode_t, fan speed
+ * 1-4, setpoint in 0.5 degrees Celsius, vertical vane position 1 (up) to 4 (down), left/right
+ * vane position 1 (left) to 7 (right), swing and 3D auto 0 off / 1 on, room temperature
+ * (raw - 61) / 4 degrees Celsius and error code, 0 when there is no error. The decoder, TX
+ * frame encoder, range check and writable field mask are generated from this table.
+ *
+ * The left/right vanes and 3D auto are only in extended frames (bytes after DB14), they read
+ * 0 from standard frames.
+ */
+#define MHI_FIELDS(X)                                                                       \
+    X(POWER, MHI_DB0, 0x01, 0, 0, MHI_DB0, 0x02, 0, 1)                                      \
+    X(MODE, MHI_DB0, 0x07, 2, 0, MHI_DB0, 0x20, MHI_MODE_AUTO, MHI_MODE_HEAT)               \
+    X(FAN, MHI_DB1, 0x03, 0, 1, MHI_DB1, 0x08, MHI_FAN_MIN, MHI_FAN_MAX)                    \
+    X(SETPOINT, MHI_DB2, 0x7F, 0, 0, MHI_DB2, 0x80, MHI_SETPOINT_MIN, MHI_SETPOINT_MAX)     \
+    X(VANE, MHI_DB1, 0x03, 4, 1, MHI_DB1, 0x80, MHI_VANE_MIN, MHI_VANE_MAX)                 \
+    X(VANE_SWING, MHI_DB0, 0x01, 6, 0, MHI_DB0, 0x80, 0, 1)                                 \
+    X(VANE_LR, MHI_DB16, 0x07, 0, 1, MHI_DB16, 0x10, MHI_VANE_LR_MIN, MHI_VANE_LR_MAX)      \
+    X(VANE_LR_SWING, MHI_DB17, 0x01, 0, 0, MHI_DB17, 0x10, 0, 1)                            \
+    X(VANE_3D_AUTO, MHI_DB17, 0x01, 2, 0, MHI_DB17, 0x08, 0, 1)                             \
+    X(ROOM_TEMP, MHI_DB3, 0xFF, 0, 0, 0, 0, 0, 0)                                           \
+    X(ERROR_CODE, MHI_DB4, 0xFF, 0, 0, 0, 0, 0, 0)
+
+/** @brief Value of a field in a frame. */
+#define MHI_FIELD_GET(p_frame, byte, mask, shift, offset) \
+    ((uint8_t)((((p_frame)[byte] >> (shift)) & (mask)) + (offset)))
+
+/** @brief Frame bits of a field value, to be or'ed into its byte. */
+#define MHI_FIELD_PUT(value, mask, shift, offset) \
+    ((uint8_t)((((value) - (offset)) & (mask)) << (shift)))
+
+/** @brief AC state fields. */
+typedef enum
+{
+#define MHI_FIELD_ENUM(name, ...) MHI_FIELD_##name,
+    MHI_FIELDS(MHI_FIELD_ENUM)
+#undef MHI_FIELD_ENUM
+    MHI_FIELD_COUNT
+} mhi_field_t;
+
+#define MHI_FIELD_BIT(field) (1UL << (field)) /**< Bit of a field in a field mask. */
+#define MHI_FIELDS_ALL ((1UL << MHI_FIELD_COUNT) - 1)
+
+#define MHI_FIELD_WRITABLE_BIT(name, byte, mask, shift, offset, set_byte, set_bit, min, max) \
+    | ((set_bit) ? MHI_FIELD_BIT(MHI_FIELD_##name) : 0)
+#define MHI_FIELDS_WRITABLE (0 MHI_FIELDS(MHI_FIELD_WRITABLE_BIT)) /**< Fields with a set bit. */
+
+#define MHI_FIELD_EXT_BIT(name, byte, mask, shift, offset, set_byte, set_bit, min, max) \
+    | ((byte) > MHI_DB14 ? MHI_FIELD_BIT(MHI_FIELD_##name) : 0)
+#define MHI_FIELDS_EXT (0 MHI_FIELDS(MHI_FIELD_EXT_BIT)) /**< Fields only in extended frames. */
+
+/** @brief MHI operating modes. */
+typedef enum
+{
+    MHI_MODE_AUTO = 0,
+    MHI_MODE_DRY = 1,
+    MHI_MODE_COOL = 2,
+    MHI_MODE_FAN = 3,
+    MHI_MODE_HEAT = 4,
+} mhi_mode_t;
+
+#define MHI_FAN_MIN 1          /**< Lowest fan speed. */
+#define MHI_FAN_MAX 4          /**< Highest fan speed. */
+#define MHI_SETPOINT_MIN 36    /**< Lowest setpoint, 18 degrees Celsius. */
+#define MHI_SETPOINT_MAX 60    /**< Highest setpoint, 30 degrees Celsius. */
+#define MHI_VANE_MIN 1         /**< Vertical vanes up. */
+#define MHI_VANE_MAX 4         /**< Vertical vanes down. */
+#define MHI_VANE_LR_MIN 1      /**< Left/right vanes left. */
+#define MHI_VANE_LR_MAX 7      /**< Left/right vanes right. */
+#define MHI_ROOM_TEMP_OFFSET 61 /**< Raw room temperature value for 0 degrees Celsius. */
+
+/** @brief Decoded AC state. */
+typedef struct
+{
+    uint8_t value[MHI_FIELD_COUNT];
+} mhi_state_t;
+
+/**
+ * @brief Decode the AC state from a validated RX frame.
+ * @param p_frame Frame data
+ * @param len Frame length, MHI_FRAME_SIZE or MHI_FRAME_SIZE_EXT
+ * @param p_state Decoded state
+ */
+void mhi_state_decode(const uint8_t *p_frame, size_t len, mhi_state_t *p_state);
+
+/**
+ * @brief Compare two states.
+ * @return Mask of the fields (MHI_FIELD_BIT) that differ
+ */
+uint32_t mhi_state_diff(const mhi_state_t *p_old, const mhi_state_t *p_new);
+
+#endif /* PROJECT_MHI_STATE_H */
@@ -0,0 +1,50 @@
+/**
+ * @file mhi_temp.h
+ * @brief Conversion of MHI temperature encodings to ZCL temperatures
+ *
+ * Every encoding has a 256 entry table in flash, generated at compile time, mapping the raw
+ * byte directly to hundredths of degrees Celsius. A per-unit calibration offset is added
+ * afterwards, so the conversion is a table load and a saturating add.
+ *
+ * Room temperatures also go the other way, for the room temperature supplied to the AC in
+ * the TX frames.
+ */
+
+#ifndef PROJECT_MHI_TEMP_H
+#define PROJECT_MHI_TEMP_H 1
+
+#include <stdint.h>
+
+#define MHI_TEMP_MIN (-27315) /**< Lowest ZCL temperature, absolute zero. */
+#define MHI_TEMP_MAX 32766    /**< Highest ZCL temperature, 0x7FFF is reserved. */
+#define MHI_TEMP_ROOM_RAW_MAX 0xFE /**< Highest room temperature byte, 0xFF stands for none in TX frames. */
+
+/** @brief MHI temperature encodings. */
+typedef enum
+{
+    MHI_TEMP_ROOM,       /**< Room temperature byte, (raw - 61) / 4 degrees. */
+    MHI_TEMP_SETPOINT,   /**< Setpoint byte, raw / 2 degrees. */
+    MHI_TEMP_RETURN_AIR, /**< Return air opdata, raw / 4 - 15 degrees. */
+    MHI_TEMP_OUTDOOR,    /**< Outdoor air opdata, piecewise linear. */
+    MHI_TEMP_HEAT_EXCH,  /**< Indoor heat exchanger opdata, 0.327 * raw - 11.4 degrees. */
+    MHI_TEMP_TABLE_COUNT
+} mhi_temp_table_t;
+
+/**
+ * @brief Convert a raw temperature byte.
+ * @param table Encoding of the byte
+ * @param raw Raw byte
+ * @param offset Calibration offset in hundredths of degrees
+ * @return Temperature in hundredths of degrees Celsius, within MHI_TEMP_MIN and MHI_TEMP_MAX
+ */
+int16_t mhi_temp_convert(mhi_temp_table_t table, uint8_t raw, int16_t offset);
+
+/**
+ * @brief Convert a temperature to the room temperature encoding, rounded to the nearest
+ * 0.25 degrees.
+ * @param temperature Temperature in hundredths of degrees Celsius
+ * @return Raw room temperature byte, at most MHI_TEMP_ROOM_RAW_MAX
+ */
+uint8_t mhi_temp_room_raw(int16_t temperature);
+
+#endif /* PROJECT_MHI_TEMP_H */
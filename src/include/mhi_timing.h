@@ -0,0 +1,136 @@
+/**
+ * @file mhi_timing.h
+ * @brief Timing of the SPI frames of the AC: period, transfer duration and gap
+ *
+ * Each transfer is timestamped twice on a free running 1 MHz counter, when CSN falls and when
+ * the transfer ends. On the device both are hardware captures (see mhi_timing_nrf.h); the SPIS
+ * interrupt only pushes them into a small ring with mhi_timing_capture, and the main loop
+ * folds them into three histograms with mhi_timing_process:
+ *
+ *   period    CSN fall to the next CSN fall
+ *   transfer  CSN fall to the end of the same transfer
+ *   gap       end of a transfer to the next CSN fall, the idle time between frames
+ *
+ * The histograms are log-linear: values below MHI_TIMING_SUB are exact, above that every
+ * power of two is split into MHI_TIMING_SUB buckets, so a bucket is at most 1/MHI_TIMING_SUB
+ * of its value wide. Next to the buckets every histogram keeps the exact minimum, maximum,
+ * mean and standard deviation. When a bucket would overflow, all counts and sums are halved,
+ * so the histograms keep following the link without losing their shape.
+ *
+ * A period longer than MHI_TIMING_MAX_US (the AC was silent) restarts the measurement without
+ * a period or gap sample. A transfer whose end capture lies before its start capture, because
+ * the interrupt ran after the next CSN fall already overwrote the start, is counted as late.
+ */
+
+#ifndef PROJECT_MHI_TIMING_H
+#define PROJECT_MHI_TIMING_H 1
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#include "mhi_ramfunc.h"
+
+#define MHI_TIMING_RING_SIZE 4   /**< Captures that can be queued, power of 2. */
+#define MHI_TIMING_SUB_BITS 3    /**< log2 of the buckets per power of two. */
+#define MHI_TIMING_SUB (1U << MHI_TIMING_SUB_BITS)
+#define MHI_TIMING_BUCKETS 128   /**< Buckets per histogram, up to MHI_TIMING_MAX_US. */
+#define MHI_TIMING_MAX_US ((1UL << (MHI_TIMING_BUCKETS / MHI_TIMING_SUB + MHI_TIMING_SUB_BITS - 1)) - 1)
+
+/** @brief Histogram of durations in microseconds. */
+typedef struct
+{
+    uint16_t count[MHI_TIMING_BUCKETS]; /**< Samples per bucket. */
+    uint32_t samples;                   /**< Samples in the buckets. */
+    uint32_t min;                       /**< Shortest sample. */
+    uint32_t max;                       /**< Longest sample. */
+    uint32_t origin;                    /**< First sample, the sums are relative to it. */
+    int64_t sum;                        /**< Sum of the samples minus origin. */
+    uint64_t sum_sq;                    /**< Sum of the squares of the samples minus origin. */
+} mhi_timing_hist_t;
+
+/** @brief Timestamps of one transfer. */
+typedef struct
+{
+    uint32_t start_us; /**< CSN fall. */
+    uint32_t end_us;   /**< End of the transfer. */
+} mhi_timing_capture_t;
+
+/** @brief Frame timing of a unit. */
+typedef struct
+{
+    mhi_timing_capture_t ring[MHI_TIMING_RING_SIZE];
+    volatile uint32_t head;       /**< Written by the interrupt. */
+    volatile uint32_t tail;       /**< Written by the main loop. */
+    volatile uint32_t overruns;   /**< Captures dropped because the ring was full. */
+    bool timed;                   /**< last holds the previous transfer. */
+    mhi_timing_capture_t last;    /**< Previous transfer. */
+    uint32_t late;                /**< Transfers with an overwritten start capture. */
+    uint32_t restarts;            /**< Periods longer than MHI_TIMING_MAX_US. */
+    mhi_timing_hist_t period;     /**< CSN fall to CSN fall. */
+    mhi_timing_hist_t xfer;       /**< CSN fall to the end of the transfer. */
+    mhi_timing_hist_t gap;        /**< End of a transfer to the next CSN fall. */
+} mhi_timing_t;
+
+/**
+ * @brief Initialize the timing with empty histograms.
+ */
+void mhi_timing_init(mhi_timing_t *p_timing);
+
+/**
+ * @brief Queue the timestamps of a transfer. Interrupt context.
+ * @param p_timing Timing
+ * @param start_us CSN fall, 1 MHz counter wrapping at 32 bits
+ * @param end_us End of the transfer, same counter
+ */
+MHI_RAMFUNC void mhi_timing_capture(mhi_timing_t *p_timing, uint32_t start_us, uint32_t end_us);
+
+/**
+ * @brief Fold the queued timestamps into the histograms. Main loop.
+ */
+void mhi_timing_process(mhi_timing_t *p_timing);
+
+/**
+ * @brief Log the histogram summaries of a unit.
+ * @param p_timing Timing
+ * @param unit Index of the unit, for the log
+ */
+void mhi_timing_log(const mhi_timing_t *p_timing, uint8_t unit);
+
+/**
+ * @brief Add a sample to a histogram.
+ * @param p_hist Histogram
+ * @param value_us Sample, at most MHI_TIMING_MAX_US
+ */
+void mhi_timing_hist_add(mhi_timing_hist_t *p_hist, uint32_t value_us);
+
+/**
+ * @brief Bucket of a value.
+ */
+uint32_t mhi_timing_bucket(uint32_t value_us);
+
+/**
+ * @brief Smallest value of a bucket.
+ */
+uint32_t mhi_timing_bucket_low(uint32_t bucket);
+
+/**
+ * @brief Mean of a histogram.
+ * @return Mean in microseconds, 0 without samples
+ */
+uint32_t mhi_timing_hist_mean(const mhi_timing_hist_t *p_hist);
+
+/**
+ * @brief Standard deviation of a histogram, the jitter.
+ * @return Standard deviation in microseconds, 0 without samples
+ */
+uint32_t mhi_timing_hist_stddev(const mhi_timing_hist_t *p_hist);
+
+/**
+ * @brief Percentile of a histogram.
+ * @param p_hist Histogram
+ * @param permille Fraction of the samples at or below the result, per 1000
+ * @return Upper end of the bucket holding the percentile, within min and max; 0 without samples
+ */
+uint32_t mhi_timing_hist_percentile(const mhi_timing_hist_t *p_hist, uint32_t permille);
+
+#endif /* PROJECT_MHI_TIMING_H */
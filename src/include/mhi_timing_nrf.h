@@ -0,0 +1,66 @@
+/**
+ * @file mhi_timing_nrf.h
+ * @brief Hardware timestamps of the SPIS transfers for the nRF52840
+ *
+ * TIMER4 runs freely at 1 MHz over 32 bits. For every unit a GPIOTE channel senses the falling
+ * edge of its CSN pin and the SPIS END event marks the end of a transfer; both trigger a
+ * capture task of the timer through PPI, unit n uses CC[2n] and CC[2n + 1]. Nothing runs on
+ * the CPU until the SPIS interrupt reads the two captures of the transfer it handles.
+ *
+ * Through the fork of the same PPI channels, the CSN falls of all units count TIMER0 up and
+ * their END events TIMER2. The SPIS only raises END for a transfer it was granted, so the
+ * difference is the number of transfers it ignored because the CPU held its buffers.
+ */
+
+#ifndef PROJECT_MHI_TIMING_NRF_H
+#define PROJECT_MHI_TIMING_NRF_H 1
+
+#include <stdint.h>
+
+#include "nrf.h"
+#include "nrf_timer.h"
+#include "nrfx_common.h"
+
+#define MHI_TIMING_NRF_TIMER 4       /**< TIMER instance, TIMER1 and TIMER3 belong to the radio and ZBOSS. */
+#define MHI_TIMING_NRF_CSN_COUNTER 0 /**< TIMER instance counting the CSN falls. */
+#define MHI_TIMING_NRF_END_COUNTER 2 /**< TIMER instance counting the completed transfers. */
+#define MHI_TIMING_NRF_UNITS_MAX 3   /**< Units the six capture registers of TIMER4 serve. */
+
+/**
+ * @brief Start the timer, the transfer counters and the GPIOTE and PPI drivers. Call before mhi_timing_nrf_unit_init.
+ */
+void mhi_timing_nrf_init(void);
+
+/**
+ * @brief Connect the CSN pin and SPIS instance of a unit to its capture registers. Call after
+ * the SPIS instance is initialized, the CSN pin keeps its SPIS pull configuration.
+ * @param unit Index of the unit, below MHI_TIMING_NRF_UNITS_MAX
+ * @param csn_pin CSN pin of the unit
+ * @param p_spis SPIS instance of the unit
+ */
+void mhi_timing_nrf_unit_init(uint8_t unit, uint32_t csn_pin, NRF_SPIS_Type *p_spis);
+
+/**
+ * @brief Read the timestamps of the last transfer of a unit. SPIS interrupt, or main loop when
+ * the SPIS re-arms itself (mhi_spis_nrf.h). Inline, the SPIS interrupt runs from RAM and
+ * calls nothing in flash.
+ * @param unit Index of the unit
+ * @param p_start_us Set to the last CSN fall
+ * @param p_end_us Set to the last transfer end
+ */
+static inline void mhi_timing_nrf_read(uint8_t unit, uint32_t *p_start_us, uint32_t *p_end_us)
+{
+    NRF_TIMER_Type *p_timer = NRFX_CONCAT_2(NRF_TIMER, MHI_TIMING_NRF_TIMER);
+
+    *p_start_us = nrf_timer_cc_read(p_timer, (nrf_timer_cc_channel_t)(2U * unit));
+    *p_end_us = nrf_timer_cc_read(p_timer, (nrf_timer_cc_channel_t)(2U * unit + 1));
+}
+
+/**
+ * @brief Read the transfer counters of all units. Main loop.
+ * @param p_csn Set to the CSN falls
+ * @param p_end Set to the transfers the SPIS completed
+ */
+void mhi_timing_nrf_counts(uint32_t *p_csn, uint32_t *p_end);
+
+#endif /* PROJECT_MHI_TIMING_NRF_H */
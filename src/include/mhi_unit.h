@@ -0,0 +1,189 @@
+/**
+ * @file mhi_unit.h
+ * @brief One MHI indoor unit: SPI link, decoding, commands and ZCL mapping
+ *
+ * This is the portable core of the application, it only depends on the ZBOSS ZCL attribute
+ * API. The platform layer calls mhi_unit_on_xfer_done from the SPIS interrupt and
+ * mhi_unit_process from the main loop.
+ *
+ * A repeated app_timer watches the frame arrival. When no valid frame arrived for the offline
+ * timeout the unit is marked unavailable and stops publishing, the first valid frame after
+ * that republishes the complete state.
+ *
+ * Commands are tracked by mhi_cmd until the AC applied them or they are given up. Either way
+ * the field is republished, so a write the AC did not apply does not linger in the ZCL
+ * attributes, and reported in cmd_applied or cmd_failed.
+ *
+ * When the AC reports a new error the opdata snapshot it stored with the error is fetched and
+ * published, it stays readable until the next error.
+ *
+ * A room temperature from a remote sensor replaces the one of the AC sensor: it is sent to the
+ * AC in every TX frame until no new one arrived for the remote temperature timeout, the AC
+ * then falls back to its own sensor. The published room temperature is the one the AC
+ * reports, so it follows the remote sensor.
+ *
+ * The current opdata is integrated into the energy used by the unit, reconciled with the energy
+ * counter opdata of units that have one, see mhi_energy.h. The total and the power of the last
+ * current sample are published whenever they change, so nothing has to poll the current.
+ *
+ * The platform layer can timestamp the transfers into the frame timing of the unit with
+ * mhi_timing_capture, mhi_unit_process folds them into its histograms, see mhi_timing.h.
+ *
+ * Every unit has its own scene table. A recalled scene stays valid until a field of the AC
+ * state differs from it once no command is pending, for instance after a change made with the
+ * IR remote.
+ */
+
+#ifndef PROJECT_MHI_UNIT_H
+#define PROJECT_MHI_UNIT_H 1
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#include "app_timer.h"
+#include "zboss_api.h"
+
+#include "mhi_cmd.h"
+#include "mhi_energy.h"
+#include "mhi_filter.h"
+#include "mhi_frame.h"
+#include "mhi_link.h"
+#include "mhi_opdata.h"
+#include "mhi_scene.h"
+#include "mhi_state.h"
+#include "mhi_timing.h"
+
+#define MHI_WATCHDOG_CHECKS 4 /**< Watchdog timer periods per offline timeout. */
+
+#ifndef MHI_OFFLINE_TIMEOUT_MS
+#define MHI_OFFLINE_TIMEOUT_MS 2000 /**< Time without valid frames before the AC is unavailable. */
+#endif
+#ifndef MHI_ROOM_TEMP_FILTER_WINDOW
+#define MHI_ROOM_TEMP_FILTER_WINDOW 5 /**< Room temperature median window, in frames. */
+#endif
+#ifndef MHI_REMOTE_TEMP_TIMEOUT_MS
+#define MHI_REMOTE_TEMP_TIMEOUT_MS (30UL * 60 * 1000) /**< Time without remote temperature before the AC sensor is used again. */
+#endif
+#ifndef MHI_ROOM_TEMP_FILTER_BAND
+#define MHI_ROOM_TEMP_FILTER_BAND 1 /**< Room temperature hysteresis band, in raw units (0.25 degrees). */
+#endif
+
+/** @brief Unit context. */
+typedef struct
+{
+    zb_uint8_t endpoint;                       /**< Zigbee endpoint of the unit. */
+    mhi_link_t link;                           /**< SPI link. */
+    mhi_timing_t timing;                       /**< Frame timing of the SPI link. */
+    bool synced;                               /**< At least one frame has been decoded. */
+    uint32_t frame_count;                      /**< Frames processed. */
+    uint8_t last_frame[MHI_FRAME_SIZE_EXT];    /**< Last processed frame, for change detection. */
+    mhi_state_t state;                         /**< Current AC state, with the filtered room temperature. */
+    uint8_t room_temp_raw;                     /**< Unfiltered room temperature of the last frame. */
+    mhi_filter_t room_filter;                  /**< Room temperature filter. */
+    mhi_cmd_t cmd;                             /**< Pending commands. */
+    mhi_opdata_poller_t opdata;                /**< Opdata poller and cache. */
+    mhi_energy_t energy;                       /**< Energy used. */
+    bool energy_changed;                       /**< The energy total or power changed since the last publish. */
+    uint32_t cmd_applied;                      /**< Fields whose command was applied in the last mhi_unit_process. */
+    uint32_t cmd_failed;                       /**< Fields whose command was given up in the last mhi_unit_process. */
+    uint32_t resync_fields;                    /**< Fields to republish with the next frame. */
+    int16_t temp_offset;                       /**< Room temperature calibration, hundredths of degrees. */
+    bool remote_active;                        /**< A remote room temperature is sent to the AC. */
+    uint32_t remote_frames;                    /**< Frames since the last remote room temperature. */
+    uint32_t remote_timeout_frames;            /**< Frames without remote room temperature before it is dropped. */
+    mhi_scene_table_t scenes;                  /**< Scenes of the unit. */
+    bool scene_check;                          /**< Compare the state with the current scene once no command is pending. */
+    bool available;                            /**< Valid frames arrive within the offline timeout. */
+    app_timer_t watchdog_timer;                /**< Frame arrival watchdog. */
+    app_timer_id_t watchdog_id;                /**< Points at watchdog_timer. */
+    volatile uint32_t watchdog_frames;         /**< Valid frames at the last watchdog period, timer context. */
+    volatile uint8_t watchdog_idle;            /**< Watchdog periods without valid frames, timer context. */
+} mhi_unit_t;
+
+/**
+ * @brief Initialize a unit, stage its first TX frame and start the frame watchdog with
+ * MHI_OFFLINE_TIMEOUT_MS. The app_timer module must be initialized.
+ * @param p_unit Unit
+ * @param endpoint Zigbee endpoint of the unit
+ */
+void mhi_unit_init(mhi_unit_t *p_unit, zb_uint8_t endpoint);
+
+/**
+ * @brief Handle a completed SPI transfer. Interrupt context.
+ * @param p_unit Unit
+ * @param p_rx Received bytes
+ * @param rx_len Number of received bytes
+ * @param ticks app_timer ticks of the transfer, read by the caller so no flash code runs here
+ * @param p_tx TX DMA buffer for the next transfer, MHI_FRAME_SIZE_EXT bytes
+ */
+MHI_RAMFUNC void mhi_unit_on_xfer_done(mhi_unit_t *p_unit, const uint8_t *p_rx, size_t rx_len, uint32_t ticks,
+                                       uint8_t *p_tx);
+
+/**
+ * @brief Process received frames: decode, update the ZCL attributes and stage the next TX
+ * frame. Main loop.
+ * @param p_unit Unit
+ * @return Mask of the fields (MHI_FIELD_BIT) that changed or were republished
+ */
+uint32_t mhi_unit_process(mhi_unit_t *p_unit);
+
+/**
+ * @brief Request a new value for a field, sent with the next TX frame. Main loop.
+ * @return false when the field is read only or the value out of range
+ */
+bool mhi_unit_request(mhi_unit_t *p_unit, mhi_field_t field, uint8_t value);
+
+/**
+ * @brief Set the room temperature calibration offset, the temperature attributes are updated
+ * with the next frame. Main loop.
+ * @param p_unit Unit
+ * @param offset Offset in hundredths of degrees
+ */
+void mhi_unit_calibrate(mhi_unit_t *p_unit, int16_t offset);
+
+/**
+ * @brief Change the time without valid frames before the AC is marked unavailable. Main loop.
+ * @param p_unit Unit
+ * @param timeout_ms Offline timeout, at least MHI_WATCHDOG_CHECKS frame intervals
+ */
+void mhi_unit_offline_timeout_set(mhi_unit_t *p_unit, uint32_t timeout_ms);
+
+/**
+ * @brief Supply the room temperature of a remote sensor, sent to the AC with the next TX
+ * frame. Main loop.
+ * @param p_unit Unit
+ * @param temperature Temperature in hundredths of degrees, ZB_ZCL_TEMP_MEASUREMENT_VALUE_UNKNOWN
+ * is ignored
+ */
+void mhi_unit_remote_temp(mhi_unit_t *p_unit, int16_t temperature);
+
+/**
+ * @brief Change the time without remote room temperature before the AC sensor is used again.
+ * Main loop.
+ * @param p_unit Unit
+ * @param timeout_ms Remote temperature timeout
+ */
+void mhi_unit_remote_timeout_set(mhi_unit_t *p_unit, uint32_t timeout_ms);
+
+/**
+ * @brief Handle a ZCL attribute write on the endpoint of the unit. Main loop.
+ * @return false when the write is not supported
+ */
+bool mhi_unit_zcl_write(mhi_unit_t *p_unit, zb_uint16_t cluster_id, zb_uint16_t attr_id, uint32_t value);
+
+/**
+ * @brief Handle a ZCL Scenes command on the endpoint of the unit, a recalled scene is sent with
+ * the next TX frame. The scene table must be saved when its dirty flag is set. Main loop.
+ * @param p_unit Unit
+ * @param cmd_id ZCL command
+ * @param p_req Command payload
+ * @param req_len Bytes of the payload
+ * @param in_group The group of the command is 0 or has the endpoint of the unit as member
+ * @param p_resp Response
+ * @return false when the command is not supported
+ */
+bool mhi_unit_scene_command(mhi_unit_t *p_unit, zb_uint8_t cmd_id, const uint8_t *p_req, size_t req_len,
+                            bool in_group, mhi_scene_resp_t *p_resp);
+
+#endif /* PROJECT_MHI_UNIT_H */
@@ -0,0 +1,163 @@
+/**
+ * @file mhi_zcl.h
+ * @brief Mapping between the MHI AC state and the ZCL attributes of the MHI endpoint
+ *
+ * | MHI field | ZCL attribute |
+ * |---|---|
+ * | Power | On/Off on_off, Thermostat system_mode (Off) |
+ * | Mode | Thermostat system_mode |
+ * | Fan | Fan Control fan_mode |
+ * | Setpoint | Thermostat occupied cooling and heating setpoints |
+ * | Room temperature | Temperature Measurement measured_value, Thermostat local_temperature |
+ * | Vanes | Fan Control manufacturer specific attributes 0x4000-0x4004 |
+ *
+ * Writing a vane position also stops the swing of the same vanes, like the IR remote does.
+ * Left/right vane and 3D auto attributes read 0 on units that only send standard frames.
+ *
+ * The SPI link quality, the opdata snapshot of the last AC error and whether a remote room
+ * temperature is in use are exposed as manufacturer specific attributes of the Diagnostics
+ * cluster. While the AC is unavailable
+ * both room temperature attributes read as invalid.
+ *
+ * The energy used by the unit is the Metering current_summation_delivered, in Wh (multiplier 1,
+ * divisor 1000, unit kWh), and the power of the last current sample its instantaneous_demand,
+ * in W.
+ *
+ * The Scenes cluster attributes follow the scene table of the unit. Scene extension field sets
+ * use the attributes of the table above: On/Off on_off; Thermostat occupied cooling setpoint,
+ * occupied heating setpoint and system mode; Fan Control fan mode and the vane attributes
+ * 0x4000-0x4004, in this order.
+ *
+ * Temperatures are converted with the tables of mhi_temp.h. The Thermostat
+ * local_temperature_calibration attribute is handled by mhi_unit, it offsets the room
+ * temperature of both attributes.
+ */
+
+#ifndef PROJECT_MHI_ZCL_H
+#define PROJECT_MHI_ZCL_H 1
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#include "zboss_api.h"
+
+#include "mhi_cmd.h"
+#include "mhi_energy.h"
+#include "mhi_opdata.h"
+#include "mhi_scene.h"
+#include "mhi_state.h"
+
+/* Manufacturer specific Fan Control cluster attributes, vanes */
+#define MHI_ATTR_FAN_VANE_ID 0x4000          /**< Vertical vane position, 1 (up) to 4 (down) (uint8). */
+#define MHI_ATTR_FAN_VANE_SWING_ID 0x4001    /**< Vertical vane swing (bool). */
+#define MHI_ATTR_FAN_VANE_LR_ID 0x4002       /**< Left/right vane position, 1 (left) to 7 (right) (uint8). */
+#define MHI_ATTR_FAN_VANE_LR_SWING_ID 0x4003 /**< Left/right vane swing (bool). */
+#define MHI_ATTR_FAN_VANE_3D_AUTO_ID 0x4004  /**< 3D auto airflow (bool). */
+
+/* Manufacturer specific Diagnostics cluster attributes, SPI link quality */
+#define MHI_ATTR_DIAG_FRAMES_ID 0x4000           /**< Valid frames received (uint32). */
+#define MHI_ATTR_DIAG_LENGTH_ERRORS_ID 0x4001    /**< Frames that were too short (uint32). */
+#define MHI_ATTR_DIAG_SIGNATURE_ERRORS_ID 0x4002 /**< Frames with a wrong signature (uint32). */
+#define MHI_ATTR_DIAG_CHECKSUM_ERRORS_ID 0x4003  /**< Frames with a wrong checksum (uint32). */
+#define MHI_ATTR_DIAG_OVERRUNS_ID 0x4004         /**< Valid frames dropped by the main loop (uint32). */
+#define MHI_ATTR_DIAG_RESYNCS_ID 0x4005          /**< Valid frames following invalid ones (uint32). */
+#define MHI_ATTR_DIAG_MISSING_ID 0x4006          /**< Frames that never arrived (uint32). */
+#define MHI_ATTR_DIAG_LAST_FRAME_AGE_ID 0x4007   /**< Seconds since the last valid frame (uint32). */
+#define MHI_ATTR_DIAG_AVAILABLE_ID 0x4008        /**< The AC sends frames (bool). */
+#define MHI_ATTR_DIAG_CMD_APPLIED_ID 0x4009      /**< Commands confirmed by the AC (uint32). */
+#define MHI_ATTR_DIAG_CMD_FAILED_ID 0x400A       /**< Commands given up (uint32). */
+#define MHI_ATTR_DIAG_CMD_RETRIES_ID 0x400B      /**< Command retransmissions (uint32). */
+#define MHI_ATTR_DIAG_CMD_LATENCY_MAX_ID 0x400C  /**< Highest command latency, in frames (uint16). */
+#define MHI_ATTR_DIAG_ERROR_CODE_ID 0x4010       /**< Number of the last AC error (uint8). */
+#define MHI_ATTR_DIAG_ERROR_RETURN_AIR_ID 0x4011 /**< Return air temperature at the error, 0.01 degrees (int16). */
+#define MHI_ATTR_DIAG_ERROR_OUTDOOR_ID 0x4012    /**< Outdoor temperature at the error, 0.01 degrees (int16). */
+#define MHI_ATTR_DIAG_ERROR_HEAT_EXCH_ID 0x4013  /**< Heat exchanger temperature at the error, 0.01 degrees (int16). */
+#define MHI_ATTR_DIAG_ERROR_CURRENT_ID 0x4014    /**< Outdoor unit current at the error, raw (uint16). */
+#define MHI_ATTR_DIAG_ERROR_COMP_FREQ_ID 0x4015  /**< Compressor frequency at the error, raw (uint16). */
+#define MHI_ATTR_DIAG_ERROR_FETCH_ID 0x4016      /**< Duration of the snapshot fetch, in frames (uint16). */
+#define MHI_ATTR_DIAG_ERROR_RAW_NONE 0xFFFF      /**< Raw snapshot value that was not received. */
+#define MHI_ATTR_DIAG_REMOTE_TEMP_ID 0x4017      /**< The AC uses the room temperature of a remote sensor (bool). */
+#define MHI_ATTR_DIAG_FRAME_PERIOD_ID 0x4018     /**< Mean time between two frames, in us (uint32). */
+#define MHI_ATTR_DIAG_FRAME_JITTER_ID 0x4019     /**< Standard deviation of that time, in us (uint32). */
+#define MHI_ATTR_DIAG_XFER_TIME_ID 0x401A        /**< Longest transfer, CSN fall to end, in us (uint32). */
+#define MHI_ATTR_DIAG_GAP_MIN_ID 0x401B          /**< Shortest idle time between two frames, in us (uint32). */
+#define MHI_ATTR_DIAG_XFER_CYCLES_ID 0x401C      /**< Longest handling of a transfer in the last timing log interval, in CPU cycles (uint32). */
+
+#define MHI_ZCL_SCENE_EXT_SIZE 21 /**< Bytes of the extension field sets of a scene. */
+
+/**
+ * @brief Update the ZCL attributes of the given fields.
+ * @param endpoint Endpoint of the unit
+ * @param p_state Current AC state
+ * @param fields Fields (MHI_FIELD_BIT) to update
+ * @param temp_offset Calibration offset of the room temperature, in hundredths of degrees
+ */
+void mhi_zcl_publish(zb_uint8_t endpoint, const mhi_state_t *p_state, uint32_t fields, zb_int16_t temp_offset);
+
+/**
+ * @brief Update the availability attribute. An unavailable AC also invalidates the room
+ * temperature attributes, the others keep their last value.
+ * @param endpoint Endpoint of the unit
+ * @param available The AC sends frames
+ */
+void mhi_zcl_publish_available(zb_uint8_t endpoint, bool available);
+
+/**
+ * @brief Update the error snapshot attributes. Values missing from the snapshot read as
+ * invalid.
+ * @param endpoint Endpoint of the unit
+ * @param p_error Fetched error snapshot
+ */
+void mhi_zcl_publish_error(zb_uint8_t endpoint, const mhi_opdata_error_t *p_error);
+
+/**
+ * @brief Update the attribute telling whether the remote room temperature is in use.
+ * @param endpoint Endpoint of the unit
+ * @param active The AC uses the remote room temperature
+ */
+void mhi_zcl_publish_remote_temp(zb_uint8_t endpoint, bool active);
+
+/**
+ * @brief Update the Metering cluster attributes: energy used and power.
+ * @param endpoint Endpoint of the unit
+ * @param p_energy Energy accumulator of the unit
+ */
+void mhi_zcl_publish_energy(zb_uint8_t endpoint, const mhi_energy_t *p_energy);
+
+/**
+ * @brief Update the Scenes cluster attributes: scene count, current scene and group, scene valid.
+ * @param endpoint Endpoint of the unit
+ * @param p_table Scene table of the unit
+ */
+void mhi_zcl_publish_scenes(zb_uint8_t endpoint, const mhi_scene_table_t *p_table);
+
+/**
+ * @brief Translate a ZCL attribute write into AC commands.
+ * @param p_cmd Command state of the unit
+ * @param cluster_id Cluster of the written attribute
+ * @param attr_id Written attribute
+ * @param value New attribute value
+ * @return false when the attribute is not handled or the value is not supported
+ */
+bool mhi_zcl_write(mhi_cmd_t *p_cmd, zb_uint16_t cluster_id, zb_uint16_t attr_id, uint32_t value);
+
+/**
+ * @brief Apply the extension field sets of an Add Scene command to a state. Sets of other
+ * clusters are skipped, a set may end before its last field.
+ * @param p_state State to modify
+ * @param p_data Extension field sets
+ * @param len Bytes of the sets
+ * @return false when a set runs past the end or holds an unsupported value
+ */
+bool mhi_zcl_scene_ext_parse(mhi_state_t *p_state, const uint8_t *p_data, size_t len);
+
+/**
+ * @brief Build the extension field sets of a scene.
+ * @param p_state State of the scene
+ * @param p_buf Buffer of MHI_ZCL_SCENE_EXT_SIZE bytes
+ * @return Bytes written
+ */
+size_t mhi_zcl_scene_ext_build(const mhi_state_t *p_state, uint8_t *p_buf);
+
+#endif /* PROJECT_MHI_ZCL_H */
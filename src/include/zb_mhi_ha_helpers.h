@@ -8,27 +8,45 @@
 
 #include "zboss_api.h"
 
-#define ZB_HA_MHI_IN_CLUSTER_NUM 5      /* MHI IN cluster number */
-#define ZB_HA_MHI_OUT_CLUSTER_NUM 0     /* MHI output OUT cluster number */
+#define ZB_HA_MHI_IN_CLUSTER_NUM 10     /* MHI IN cluster number */
+#define ZB_HA_MHI_OUT_CLUSTER_NUM 2     /* MHI output OUT cluster number */
+#define ZB_HA_MHI_UNIT_IN_CLUSTER_NUM 9 /* IN cluster number of the endpoints of the other units */
+#define ZB_HA_MHI_UNIT_OUT_CLUSTER_NUM 1 /* OUT cluster number of the endpoints of the other units */
 #define ZB_HA_DEVICE_VER_HMI 0          /* MHI Output device version */
-#define ZB_ZCL_MHI_REPORT_ATTR_COUNT 10 /* Number of attributes mandatory for reporting */
+#define ZB_ZCL_MHI_REPORT_ATTR_COUNT 19 /* Number of reportable attributes, with availability, vanes, remote temperature and energy */
 
 /**
  * @brief Declare cluster list for MHI device
  * @param cluster_list_name cluster list variable name
  * @param identify_attr_list attribute list for Identify cluster
+ * @param groups_attr_list attribute list for Groups cluster
+ * @param scenes_attr_list attribute list for Scenes cluster
  * @param basic_attr_list attribute list for Basic cluster
  * @param on_off_attr_list attribute list for On/Off cluster
  * @param fan_control_attr_list attribute list for Fan Control cluster
  * @param temp_measurement_attr_list attribute list for Temp Measurement cluster
+ * @param thermostat_attr_list attribute list for Thermostat cluster
+ * @param metering_attr_list attribute list for Metering cluster
+ * @param diagnostics_attr_list attribute list for Diagnostics cluster
+ * @param ota_upgrade_attr_list attribute list for OTA Upgrade client cluster
+ *
+ * The Temperature Measurement client cluster receives the reports of a bound remote sensor, the
+ * Groups cluster lets one groupcast reach the endpoints of several devices, and the Scenes
+ * cluster lets one recall a stored AC state.
  */
 #define ZB_HA_DECLARE_MHI_CLUSTER_LIST(                                  \
     cluster_list_name,                                                   \
     identify_attr_list,                                                  \
+    groups_attr_list,                                                    \
+    scenes_attr_list,                                                    \
     basic_attr_list,                                                     \
     on_off_attr_list,                                                    \
     fan_control_attr_list,                                               \
-    temp_measurement_list)                                               \
+    temp_measurement_list,                                               \
+    thermostat_attr_list,                                                \
+    metering_attr_list,                                                  \
+    diagnostics_attr_list,                                               \
+    ota_upgrade_attr_list)                                               \
     zb_zcl_cluster_desc_t cluster_list_name[] =                          \
         {                                                                \
             ZB_ZCL_CLUSTER_DESC(                                         \
@@ -37,6 +55,18 @@
                 (identify_attr_list),                                    \
                 ZB_ZCL_CLUSTER_SERVER_ROLE,                              \
                 ZB_ZCL_MANUF_CODE_INVALID),                              \
+            ZB_ZCL_CLUSTER_DESC(                                         \
+                ZB_ZCL_CLUSTER_ID_GROUPS,                                \
+                ZB_ZCL_ARRAY_SIZE(groups_attr_list, zb_zcl_attr_t),      \
+                (groups_attr_list),                                      \
+                ZB_ZCL_CLUSTER_SERVER_ROLE,                              \
+                ZB_ZCL_MANUF_CODE_INVALID),                              \
+            ZB_ZCL_CLUSTER_DESC(                                         \
+                ZB_ZCL_CLUSTER_ID_SCENES,                                \
+                ZB_ZCL_ARRAY_SIZE(scenes_attr_list, zb_zcl_attr_t),      \
+                (scenes_attr_list),                                      \
+                ZB_ZCL_CLUSTER_SERVER_ROLE,                              \
+                ZB_ZCL_MANUF_CODE_INVALID),                              \
             ZB_ZCL_CLUSTER_DESC(                                         \
                 ZB_ZCL_CLUSTER_ID_BASIC,                                 \
                 ZB_ZCL_ARRAY_SIZE(basic_attr_list, zb_zcl_attr_t),       \
@@ -54,12 +84,131 @@
                 ZB_ZCL_ARRAY_SIZE(fan_control_attr_list, zb_zcl_attr_t), \
                 (fan_control_attr_list),                                 \
                 ZB_ZCL_CLUSTER_SERVER_ROLE,                              \
+                MHI_MANUF_CODE),                                         \
+            ZB_ZCL_CLUSTER_DESC(                                         \
+                ZB_ZCL_CLUSTER_ID_TEMP_MEASUREMENT,                      \
+                ZB_ZCL_ARRAY_SIZE(temp_measurement_list, zb_zcl_attr_t), \
+                (temp_measurement_list),                                 \
+                ZB_ZCL_CLUSTER_SERVER_ROLE,                              \
+                ZB_ZCL_MANUF_CODE_INVALID),                              \
+            ZB_ZCL_CLUSTER_DESC(                                         \
+                ZB_ZCL_CLUSTER_ID_THERMOSTAT,                            \
+                ZB_ZCL_ARRAY_SIZE(thermostat_attr_list, zb_zcl_attr_t),  \
+                (thermostat_attr_list),                                  \
+                ZB_ZCL_CLUSTER_SERVER_ROLE,                              \
+                ZB_ZCL_MANUF_CODE_INVALID),                              \
+            ZB_ZCL_CLUSTER_DESC(                                         \
+                ZB_ZCL_CLUSTER_ID_METERING,                              \
+                ZB_ZCL_ARRAY_SIZE(metering_attr_list, zb_zcl_attr_t),    \
+                (metering_attr_list),                                    \
+                ZB_ZCL_CLUSTER_SERVER_ROLE,                              \
+                ZB_ZCL_MANUF_CODE_INVALID),                              \
+            ZB_ZCL_CLUSTER_DESC(                                         \
+                ZB_ZCL_CLUSTER_ID_DIAGNOSTICS,                           \
+                ZB_ZCL_ARRAY_SIZE(diagnostics_attr_list, zb_zcl_attr_t), \
+                (diagnostics_attr_list),                                 \
+                ZB_ZCL_CLUSTER_SERVER_ROLE,                              \
+                MHI_MANUF_CODE),                                         \
+            ZB_ZCL_CLUSTER_DESC(                                         \
+                ZB_ZCL_CLUSTER_ID_OTA_UPGRADE,                           \
+                ZB_ZCL_ARRAY_SIZE(ota_upgrade_attr_list, zb_zcl_attr_t), \
+                (ota_upgrade_attr_list),                                 \
+                ZB_ZCL_CLUSTER_CLIENT_ROLE,                              \
+                ZB_ZCL_MANUF_CODE_INVALID),                              \
+            ZB_ZCL_CLUSTER_DESC(                                         \
+                ZB_ZCL_CLUSTER_ID_TEMP_MEASUREMENT,                      \
+                0,                                                       \
+                NULL,                                                    \
+                ZB_ZCL_CLUSTER_CLIENT_ROLE,                              \
+                ZB_ZCL_MANUF_CODE_INVALID)}
+
+/**
+ * @brief Declare cluster list for the endpoint of an additional unit, the Basic and OTA Upgrade
+ * clusters are device wide and only on the endpoint of the first unit, the Temperature
+ * Measurement client cluster receives the reports of a bound remote sensor
+ * @param cluster_list_name cluster list variable name
+ * @param identify_attr_list attribute list for Identify cluster
+ * @param groups_attr_list attribute list for Groups cluster
+ * @param scenes_attr_list attribute list for Scenes cluster
+ * @param on_off_attr_list attribute list for On/Off cluster
+ * @param fan_control_attr_list attribute list for Fan Control cluster
+ * @param temp_measurement_attr_list attribute list for Temp Measurement cluster
+ * @param thermostat_attr_list attribute list for Thermostat cluster
+ * @param metering_attr_list attribute list for Metering cluster
+ * @param diagnostics_attr_list attribute list for Diagnostics cluster
+ */
+#define ZB_HA_DECLARE_MHI_UNIT_CLUSTER_LIST(                             \
+    cluster_list_name,                                                   \
+    identify_attr_list,                                                  \
+    groups_attr_list,                                                    \
+    scenes_attr_list,                                                    \
+    on_off_attr_list,                                                    \
+    fan_control_attr_list,                                               \
+    temp_measurement_list,                                               \
+    thermostat_attr_list,                                                \
+    metering_attr_list,                                                  \
+    diagnostics_attr_list)                                               \
+    zb_zcl_cluster_desc_t cluster_list_name[] =                          \
+        {                                                                \
+            ZB_ZCL_CLUSTER_DESC(                                         \
+                ZB_ZCL_CLUSTER_ID_IDENTIFY,                              \
+                ZB_ZCL_ARRAY_SIZE(identify_attr_list, zb_zcl_attr_t),    \
+                (identify_attr_list),                                    \
+                ZB_ZCL_CLUSTER_SERVER_ROLE,                              \
                 ZB_ZCL_MANUF_CODE_INVALID),                              \
+            ZB_ZCL_CLUSTER_DESC(                                         \
+                ZB_ZCL_CLUSTER_ID_GROUPS,                                \
+                ZB_ZCL_ARRAY_SIZE(groups_attr_list, zb_zcl_attr_t),      \
+                (groups_attr_list),                                      \
+                ZB_ZCL_CLUSTER_SERVER_ROLE,                              \
+                ZB_ZCL_MANUF_CODE_INVALID),                              \
+            ZB_ZCL_CLUSTER_DESC(                                         \
+                ZB_ZCL_CLUSTER_ID_SCENES,                                \
+                ZB_ZCL_ARRAY_SIZE(scenes_attr_list, zb_zcl_attr_t),      \
+                (scenes_attr_list),                                      \
+                ZB_ZCL_CLUSTER_SERVER_ROLE,                              \
+                ZB_ZCL_MANUF_CODE_INVALID),                              \
+            ZB_ZCL_CLUSTER_DESC(                                         \
+                ZB_ZCL_CLUSTER_ID_ON_OFF,                                \
+                ZB_ZCL_ARRAY_SIZE(on_off_attr_list, zb_zcl_attr_t),      \
+                (on_off_attr_list),                                      \
+                ZB_ZCL_CLUSTER_SERVER_ROLE,                              \
+                ZB_ZCL_MANUF_CODE_INVALID),                              \
+            ZB_ZCL_CLUSTER_DESC(                                         \
+                ZB_ZCL_CLUSTER_ID_FAN_CONTROL,                           \
+                ZB_ZCL_ARRAY_SIZE(fan_control_attr_list, zb_zcl_attr_t), \
+                (fan_control_attr_list),                                 \
+                ZB_ZCL_CLUSTER_SERVER_ROLE,                              \
+                MHI_MANUF_CODE),                                         \
             ZB_ZCL_CLUSTER_DESC(                                         \
                 ZB_ZCL_CLUSTER_ID_TEMP_MEASUREMENT,                      \
                 ZB_ZCL_ARRAY_SIZE(temp_measurement_list, zb_zcl_attr_t), \
                 (temp_measurement_list),                                 \
                 ZB_ZCL_CLUSTER_SERVER_ROLE,                              \
+                ZB_ZCL_MANUF_CODE_INVALID),                              \
+            ZB_ZCL_CLUSTER_DESC(                                         \
+                ZB_ZCL_CLUSTER_ID_THERMOSTAT,                            \
+                ZB_ZCL_ARRAY_SIZE(thermostat_attr_list, zb_zcl_attr_t),  \
+                (thermostat_attr_list),                                  \
+                ZB_ZCL_CLUSTER_SERVER_ROLE,                              \
+                ZB_ZCL_MANUF_CODE_INVALID),                              \
+            ZB_ZCL_CLUSTER_DESC(                                         \
+                ZB_ZCL_CLUSTER_ID_METERING,                              \
+                ZB_ZCL_ARRAY_SIZE(metering_attr_list, zb_zcl_attr_t),    \
+                (metering_attr_list),                                    \
+                ZB_ZCL_CLUSTER_SERVER_ROLE,                              \
+                ZB_ZCL_MANUF_CODE_INVALID),                              \
+            ZB_ZCL_CLUSTER_DESC(                                         \
+                ZB_ZCL_CLUSTER_ID_DIAGNOSTICS,                           \
+                ZB_ZCL_ARRAY_SIZE(diagnostics_attr_list, zb_zcl_attr_t), \
+                (diagnostics_attr_list),                                 \
+                ZB_ZCL_CLUSTER_SERVER_ROLE,                              \
+                MHI_MANUF_CODE),                                         \
+            ZB_ZCL_CLUSTER_DESC(                                         \
+                ZB_ZCL_CLUSTER_ID_TEMP_MEASUREMENT,                      \
+                0,                                                       \
+                NULL,                                                    \
+                ZB_ZCL_CLUSTER_CLIENT_ROLE,                              \
                 ZB_ZCL_MANUF_CODE_INVALID)}
 
 /** @brief Declare simple descriptor for MHI device
@@ -84,8 +233,52 @@
             out_clust_num,                                                          \
             {ZB_ZCL_CLUSTER_ID_BASIC,                                               \
              ZB_ZCL_CLUSTER_ID_IDENTIFY,                                            \
+             ZB_ZCL_CLUSTER_ID_GROUPS,                                              \
+             ZB_ZCL_CLUSTER_ID_SCENES,                                              \
              ZB_ZCL_CLUSTER_ID_ON_OFF,                                              \
              ZB_ZCL_CLUSTER_ID_FAN_CONTROL,                                         \
+             ZB_ZCL_CLUSTER_ID_TEMP_MEASUREMENT,                                    \
+             ZB_ZCL_CLUSTER_ID_THERMOSTAT,                                          \
+             ZB_ZCL_CLUSTER_ID_METERING,                                            \
+             ZB_ZCL_CLUSTER_ID_DIAGNOSTICS,                                         \
+             ZB_ZCL_CLUSTER_ID_OTA_UPGRADE,                                         \
+             ZB_ZCL_CLUSTER_ID_TEMP_MEASUREMENT}}
+
+/** @brief Declare the simple descriptor type of the endpoints of the additional units, once
+ * for all of them
+ * @param in_clust_num number of supported input clusters
+ * @param out_clust_num number of supported output clusters
+ */
+#define ZB_ZCL_DECLARE_MHI_UNIT_SIMPLE_DESC_TYPE(in_clust_num, out_clust_num) \
+    ZB_DECLARE_SIMPLE_DESC(in_clust_num, out_clust_num)
+
+/** @brief Declare simple descriptor for the endpoint of an additional unit, its type is
+ * declared by ZB_HA_DECLARE_MHI_UNIT_EP_TYPE
+ * @param ep_name endpoint variable name
+ * @param ep_id endpoint ID
+ * @param in_clust_num number of supported input clusters
+ * @param out_clust_num number of supported output clusters
+ */
+#define ZB_ZCL_DECLARE_MHI_UNIT_SIMPLE_DESC(ep_name, ep_id, in_clust_num, out_clust_num) \
+    ZB_AF_SIMPLE_DESC_TYPE(in_clust_num, out_clust_num)                                  \
+    simple_desc_##ep_name =                                                              \
+        {                                                                                \
+            ep_id,                                                                       \
+            ZB_AF_HA_PROFILE_ID,                                                         \
+            ZB_HA_HEATING_COOLING_UNIT_DEVICE_ID,                                        \
+            ZB_HA_DEVICE_VER_HMI,                                                        \
+            0,                                                                           \
+            in_clust_num,                                                                \
+            out_clust_num,                                                               \
+            {ZB_ZCL_CLUSTER_ID_IDENTIFY,                                                 \
+             ZB_ZCL_CLUSTER_ID_GROUPS,                                                   \
+             ZB_ZCL_CLUSTER_ID_SCENES,                                                   \
+             ZB_ZCL_CLUSTER_ID_ON_OFF,                                                   \
+             ZB_ZCL_CLUSTER_ID_FAN_CONTROL,                                              \
+             ZB_ZCL_CLUSTER_ID_TEMP_MEASUREMENT,                                         \
+             ZB_ZCL_CLUSTER_ID_THERMOSTAT,                                               \
+             ZB_ZCL_CLUSTER_ID_METERING,                                                 \
+             ZB_ZCL_CLUSTER_ID_DIAGNOSTICS,                                              \
              ZB_ZCL_CLUSTER_ID_TEMP_MEASUREMENT}}
 
 /**
@@ -101,7 +294,45 @@
         ZB_HA_MHI_IN_CLUSTER_NUM,                               \
         ZB_HA_MHI_OUT_CLUSTER_NUM);                             \
     ZBOSS_DEVICE_DECLARE_REPORTING_CTX(                         \
-        reporting_info##device_ctx_name,                        \
+        reporting_info##ep_name,                                \
+        ZB_ZCL_MHI_REPORT_ATTR_COUNT);                          \
+    ZB_AF_DECLARE_ENDPOINT_DESC(                                \
+        ep_name,                                                \
+        ep_id,                                                  \
+        ZB_AF_HA_PROFILE_ID,                                    \
+        0,                                                      \
+        NULL,                                                   \
+        ZB_ZCL_ARRAY_SIZE(cluster_list, zb_zcl_cluster_desc_t), \
+        cluster_list,                                           \
+        (zb_af_simple_desc_1_1_t *)&simple_desc_##ep_name,      \
+        ZB_ZCL_MHI_REPORT_ATTR_COUNT,                           \
+        reporting_info##ep_name,                                \
+        0,                                                      \
+        NULL)
+
+/**
+ * @brief Declare the simple descriptor type of the endpoints of the additional units, once
+ * before ZB_HA_DECLARE_MHI_UNIT_EP
+ */
+#define ZB_HA_DECLARE_MHI_UNIT_EP_TYPE()             \
+    ZB_ZCL_DECLARE_MHI_UNIT_SIMPLE_DESC_TYPE(        \
+        ZB_HA_MHI_UNIT_IN_CLUSTER_NUM,               \
+        ZB_HA_MHI_UNIT_OUT_CLUSTER_NUM)
+
+/**
+ * @brief Declare endpoint for an additional unit of the MHI device
+ * @param ep_name endpoint variable name
+ * @param ep_id endpoint ID
+ * @param cluster_list endpoint cluster list
+ */
+#define ZB_HA_DECLARE_MHI_UNIT_EP(ep_name, ep_id, cluster_list) \
+    ZB_ZCL_DECLARE_MHI_UNIT_SIMPLE_DESC(                        \
+        ep_name,                                                \
+        ep_id,                                                  \
+        ZB_HA_MHI_UNIT_IN_CLUSTER_NUM,                          \
+        ZB_HA_MHI_UNIT_OUT_CLUSTER_NUM);                        \
+    ZBOSS_DEVICE_DECLARE_REPORTING_CTX(                         \
+        reporting_info##ep_name,                                \
         ZB_ZCL_MHI_REPORT_ATTR_COUNT);                          \
     ZB_AF_DECLARE_ENDPOINT_DESC(                                \
         ep_name,                                                \
@@ -113,7 +344,7 @@
         cluster_list,                                           \
         (zb_af_simple_desc_1_1_t *)&simple_desc_##ep_name,      \
         ZB_ZCL_MHI_REPORT_ATTR_COUNT,                           \
-        reporting_info##device_ctx_name,                        \
+        reporting_info##ep_name,                                \
         0,                                                      \
         NULL)
 
@@ -125,4 +356,23 @@
 #define ZB_HA_DECLARE_MHI_CTX(device_ctx, ep_name) \
     ZBOSS_DECLARE_DEVICE_CTX_1_EP(device_ctx, ep_name)
 
+/**
+ * @brief Declare MHI device context with two units
+ * @param device_ctx device context variable name
+ * @param ep1_name endpoint variable name of the first unit
+ * @param ep2_name endpoint variable name of the second unit
+ */
+#define ZB_HA_DECLARE_MHI_CTX_2_EP(device_ctx, ep1_name, ep2_name) \
+    ZBOSS_DECLARE_DEVICE_CTX_2_EP(device_ctx, ep1_name, ep2_name)
+
+/**
+ * @brief Declare MHI device context with three units
+ * @param device_ctx device context variable name
+ * @param ep1_name endpoint variable name of the first unit
+ * @param ep2_name endpoint variable name of the second unit
+ * @param ep3_name endpoint variable name of the third unit
+ */
+#define ZB_HA_DECLARE_MHI_CTX_3_EP(device_ctx, ep1_name, ep2_name, ep3_name) \
+    ZBOSS_DECLARE_DEVICE_CTX_3_EP(device_ctx, ep1_name, ep2_name, ep3_name)
+
 #endif /* PROJECT_ZIGBEE_MHI_H */
\ No newline at end of file
@@ -16,7 +16,7 @@
 /* Custom includes */
 #include "zb_mhi_ha_helpers.h"
 
-#define MHI_ENDPOINT 1                                                  /**< Device endpoint, used to receive controlling commands. */
+#define MHI_ENDPOINT 1                                                  /**< Endpoint of the first unit, unit n uses MHI_ENDPOINT + n. */
 #define MHI_INIT_BASIC_APP_VERSION 01                                   /**< Version of the application software (1 byte). */
 #define MHI_INIT_BASIC_STACK_VERSION 10                                 /**< Version of the implementation of the Zigbee stack (1 byte). */
 #define MHI_INIT_BASIC_HW_VERSION 11                                    /**< Version of the hardware of the device (1 byte). */
@@ -25,8 +25,29 @@
 #define MHI_INIT_BASIC_DATE_CODE "20211229"                             /**< First 8 bytes specify the date of manufacturer of the device in ISO 8601 format (YYYYMMDD). The rest (8 bytes) are manufacturer specific. */
 #define MHI_INIT_BASIC_POWER_SOURCE ZB_ZCL_BASIC_POWER_SOURCE_DC_SOURCE /**< Type of power sources available for the device. For possible values see section 3.2.2.2.8 of ZCL specification. */
 #define MHI_INIT_BASIC_PH_ENV ZB_ZCL_BASIC_ENV_UNSPECIFIED              /**< Describes the type of physical environment. For possible values see section 3.2.2.2.10 of ZCL specification. */
+#define MHI_INIT_TEMP_MIN_MEASURED_VALUE -1525                          /**< Lowest room temperature the AC reports, in 0.01 degrees Celsius. */
+#define MHI_INIT_TEMP_MAX_MEASURED_VALUE 4850                           /**< Highest room temperature the AC reports, in 0.01 degrees Celsius. */
+#define MHI_INIT_TEMP_TOLERANCE 25                                      /**< Room temperature resolution, in 0.01 degrees Celsius. */
+#define MHI_MANUF_CODE 0x1234                                           /**< Manufacturer code, for OTA images and manufacturer specific attributes. */
+#define MHI_OTA_IMAGE_TYPE 0x0001                                       /**< OTA image type of this firmware. */
+#define MHI_OTA_FILE_VERSION 0x01000000                                 /**< OTA file version of this firmware, must increase with every release. */
+#define MHI_OTA_HW_VERSION MHI_INIT_BASIC_HW_VERSION                    /**< Hardware version reported to the OTA server. */
+#define MHI_OTA_BLOCK_SIZE 64                                           /**< Requested image block size, the largest that fits in one APS frame. */
+#define MHI_OTA_BLOCK_DELAY_MS 0                                        /**< Minimum time between block requests, raise it to reduce the network load. */
+#define MHI_METERING_FORMATTING 0x33                                    /**< Metering summation and demand formatting: 6 digits, 3 decimals. */
+#define MHI_DIAG_INTERVAL_MS 1000                                       /**< Update interval of the last frame age and frame timing attributes. */
+#define MHI_TIMING_LOG_INTERVAL 60                                      /**< Diagnostics updates between two frame timing logs. */
+#define MHI_NVRAM_SAVE_US 5000                                          /**< Longest dataset write, scheduled between two SPI frames. */
 #define ZIGBEE_NETWORK_STATE_LED BSP_BOARD_LED_0                        /**< LED indicating that light switch successfully joind Zigbee network. */
 
+#ifndef MHI_UNIT_COUNT
+#define MHI_UNIT_COUNT 1 /**< Indoor units, each on its own SPIS instance and endpoint. */
+#endif
+
+#if MHI_UNIT_COUNT < 1 || MHI_UNIT_COUNT > 3
+#error MHI_UNIT_COUNT must be 1 to 3, one unit per SPIS instance.
+#endif
+
 #if !defined ZB_ED_ROLE
 #error Define ZB_ED_ROLE to compile light switch (End Device) source code.
 #endif
@@ -36,16 +57,96 @@ typedef struct zb_zcl_fan_control_attrs_s
 {
     zb_uint8_t fan_mode;
     zb_uint8_t fan_mode_sequence;
+    zb_uint8_t vane;
+    zb_bool_t vane_swing;
+    zb_uint8_t vane_lr;
+    zb_bool_t vane_lr_swing;
+    zb_bool_t vane_3d_auto;
 } zb_zcl_fan_control_attrs_t;
 
-/* Main application customizable context. Stores all settings and static values. */
+/* Not defined by zboss */
+typedef struct zb_zcl_thermostat_attrs_s
+{
+    zb_int16_t local_temperature;
+    zb_int8_t local_temperature_calibration;
+    zb_int16_t occupied_cooling_setpoint;
+    zb_int16_t occupied_heating_setpoint;
+    zb_uint8_t control_seq_of_operation;
+    zb_uint8_t system_mode;
+} zb_zcl_thermostat_attrs_t;
+
+/* OTA Upgrade client attributes */
+typedef struct
+{
+    zb_ieee_addr_t upgrade_server;
+    zb_uint32_t file_offset;
+    zb_uint32_t file_version;
+    zb_uint16_t stack_version;
+    zb_uint32_t downloaded_file_ver;
+    zb_uint16_t downloaded_stack_ver;
+    zb_uint8_t image_status;
+    zb_uint16_t manufacturer;
+    zb_uint16_t image_type;
+    zb_uint16_t min_block_reque;
+    zb_uint16_t image_stamp;
+    zb_uint16_t server_addr;
+    zb_uint8_t server_ep;
+} mhi_ota_attrs_t;
+
+/* Diagnostics attributes that are not link counters */
+typedef struct
+{
+    zb_uint32_t last_frame_age;
+    zb_bool_t available;
+    zb_uint8_t error_code;
+    zb_int16_t error_return_air_temp;
+    zb_int16_t error_outdoor_temp;
+    zb_int16_t error_heat_exch_temp;
+    zb_uint16_t error_current;
+    zb_uint16_t error_comp_freq;
+    zb_uint16_t error_fetch_frames;
+    zb_bool_t remote_temp;
+    zb_uint32_t frame_period;
+    zb_uint32_t frame_jitter;
+    zb_uint32_t xfer_time;
+    zb_uint32_t gap_min;
+    zb_uint32_t xfer_cycles;
+} mhi_diag_attrs_t;
+
+/* Metering attributes, energy in Wh shown as kWh */
+typedef struct
+{
+    zb_uint48_t curr_summ_delivered;
+    zb_uint8_t status;
+    zb_uint8_t unit_of_measure;
+    zb_uint24_t multiplier;
+    zb_uint24_t divisor;
+    zb_uint8_t summation_formatting;
+    zb_uint8_t metering_device_type;
+    zb_int24_t instantaneous_demand;
+    zb_uint8_t demand_formatting;
+} mhi_metering_attrs_t;
+
+/* Attributes of the endpoint of one unit */
 typedef struct
 {
-    zb_zcl_basic_attrs_ext_t basic_attr;
     zb_zcl_identify_attrs_t identify_attr;
+    zb_zcl_groups_attrs_t groups_attr;
+    zb_zcl_scenes_attrs_t scenes_attr;
     zb_zcl_on_off_attrs_t on_off_attr;
     zb_zcl_fan_control_attrs_t fan_control_attr;
     zb_zcl_temp_measurement_attrs_t temp_measurement_attr;
+    zb_zcl_thermostat_attrs_t thermostat_attr;
+    mhi_diag_attrs_t diag_attr;
+    mhi_metering_attrs_t metering_attr;
+} mhi_unit_ctx_t;
+
+/* Main application customizable context. Stores all settings and static values. */
+typedef struct
+{
+    zb_zcl_basic_attrs_ext_t basic_attr;
+    mhi_ota_attrs_t ota_attr;
+    mhi_unit_ctx_t unit[MHI_UNIT_COUNT];
 } mhi_device_ctx_t;
 
 #endif /* PROJECT_ZIGBEE_H */
\ No newline at end of file
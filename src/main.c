@@ -1,9 +1,19 @@
 /* SDK includes */
 #include "app_timer.h"
+#include "app_util_platform.h"
 #include "bsp.h"
 #include "boards.h"
 
 /* Custom includes */
+#include "include/mhi_cli.h"
+#include "include/mhi_ota_nrf.h"
+#include "include/mhi_ramfunc.h"
+#include "include/mhi_sched.h"
+#include "include/mhi_spis_nrf.h"
+#include "include/mhi_stack.h"
+#include "include/mhi_timing_nrf.h"
+#include "include/mhi_unit.h"
+#include "include/mhi_zcl.h"
 #include "include/zigbee.h"
 
 /* SDK includes */
@@ -11,15 +21,38 @@
 
 /* SPI */
 #include "nrf_drv_spis.h"
+#include "nrf_rtc.h"
+#include "nrf_spis.h"
 
 /* Logging */
 #include "nrf_log.h"
 #include "nrf_log_ctrl.h"
 #include "nrf_log_default_backends.h"
+#include "include/mhi_log.h"
+#if MHI_LOG_BINARY_ENABLED || MHI_CLI_ENABLED
+#include "nrf_drv_uart.h"
+#endif
+
+/* Diagnostic CLI */
+#if MHI_CLI_ENABLED
+#include "nrf_cli.h"
+#include "nrf_cli_uart.h"
+#include "nrf_gpio.h"
+
+#if MHI_LOG_BINARY_ENABLED
+#error The diagnostic CLI and the binary log mode both drive the log UART
+#endif
+#endif
 
 /* Zigbee device context */
 static mhi_device_ctx_t m_dev_ctx;
 
+/* MHI unit contexts, the Diagnostics attributes point at their link and command counters */
+static mhi_unit_t m_units[MHI_UNIT_COUNT];
+
+/* Flash work between the SPI frames of the units */
+static mhi_sched_t m_sched;
+
 /* Declare the Zigbee cluster definitions */
 ZB_ZCL_DECLARE_BASIC_ATTRIB_LIST_EXT(
     basic_attr_list,
@@ -34,40 +67,335 @@ ZB_ZCL_DECLARE_BASIC_ATTRIB_LIST_EXT(
     m_dev_ctx.basic_attr.location_id,
     &m_dev_ctx.basic_attr.ph_env,
     m_dev_ctx.basic_attr.sw_ver);
-ZB_ZCL_DECLARE_IDENTIFY_ATTRIB_LIST(
-    identify_attr_list,
-    &m_dev_ctx.identify_attr.identify_time);
-ZB_ZCL_DECLARE_ON_OFF_ATTRIB_LIST(
-    on_off_attr_list,
-    &m_dev_ctx.on_off_attr.on_off);
-ZB_ZCL_DECLARE_FAN_CONTROL_ATTRIB_LIST(
-    fan_control_attr_list,
-    &m_dev_ctx.fan_control_attr.fan_mode,
-    &m_dev_ctx.fan_control_attr.fan_mode_sequence);
-ZB_ZCL_DECLARE_TEMP_MEASUREMENT_ATTRIB_LIST(
-    temp_measurement_attr_list,
-    &m_dev_ctx.temp_measurement_attr.measure_value,
-    &m_dev_ctx.temp_measurement_attr.min_measure_value,
-    &m_dev_ctx.temp_measurement_attr.max_measure_value,
-    &m_dev_ctx.temp_measurement_attr.tolerance);
-
-/* Declare the HA definitions */
+ZB_ZCL_DECLARE_OTA_UPGRADE_ATTRIB_LIST(
+    ota_upgrade_attr_list,
+    m_dev_ctx.ota_attr.upgrade_server,
+    &m_dev_ctx.ota_attr.file_offset,
+    &m_dev_ctx.ota_attr.file_version,
+    &m_dev_ctx.ota_attr.stack_version,
+    &m_dev_ctx.ota_attr.downloaded_file_ver,
+    &m_dev_ctx.ota_attr.downloaded_stack_ver,
+    &m_dev_ctx.ota_attr.image_status,
+    &m_dev_ctx.ota_attr.manufacturer,
+    &m_dev_ctx.ota_attr.image_type,
+    &m_dev_ctx.ota_attr.min_block_reque,
+    &m_dev_ctx.ota_attr.image_stamp,
+    &m_dev_ctx.ota_attr.server_addr,
+    &m_dev_ctx.ota_attr.server_ep,
+    MHI_OTA_HW_VERSION,
+    MHI_OTA_BLOCK_SIZE,
+    ZB_ZCL_OTA_UPGRADE_QUERY_TIMER_COUNT_DEF);
+
+/* Attribute lists of the endpoint of unit n. The Fan Control cluster has the manufacturer
+ * specific vane attributes, the Metering cluster the energy used by the unit and its power, the
+ * Diagnostics cluster the read only manufacturer specific link
+ * quality, availability, command, error and frame timing attributes. */
+#define MHI_UNIT_ATTR_LISTS_DECLARE(n)                                                                          \
+    ZB_ZCL_DECLARE_IDENTIFY_ATTRIB_LIST(                                                                        \
+        identify_attr_list_##n,                                                                                 \
+        &m_dev_ctx.unit[n].identify_attr.identify_time);                                                        \
+    ZB_ZCL_DECLARE_GROUPS_ATTRIB_LIST(                                                                          \
+        groups_attr_list_##n,                                                                                   \
+        &m_dev_ctx.unit[n].groups_attr.name_support);                                                           \
+    ZB_ZCL_DECLARE_SCENES_ATTRIB_LIST(                                                                          \
+        scenes_attr_list_##n,                                                                                   \
+        &m_dev_ctx.unit[n].scenes_attr.scene_count,                                                             \
+        &m_dev_ctx.unit[n].scenes_attr.current_scene,                                                           \
+        &m_dev_ctx.unit[n].scenes_attr.current_group,                                                           \
+        &m_dev_ctx.unit[n].scenes_attr.scene_valid,                                                             \
+        &m_dev_ctx.unit[n].scenes_attr.name_support);                                                           \
+    ZB_ZCL_DECLARE_ON_OFF_ATTRIB_LIST(                                                                          \
+        on_off_attr_list_##n,                                                                                   \
+        &m_dev_ctx.unit[n].on_off_attr.on_off);                                                                 \
+    ZB_ZCL_START_DECLARE_ATTRIB_LIST(fan_control_attr_list_##n)                                                 \
+    ZB_ZCL_SET_ATTR_DESC(ZB_ZCL_ATTR_FAN_CONTROL_FAN_MODE_ID, (&m_dev_ctx.unit[n].fan_control_attr.fan_mode))   \
+    ZB_ZCL_SET_ATTR_DESC(ZB_ZCL_ATTR_FAN_CONTROL_FAN_MODE_SEQUENCE_ID,                                          \
+                         (&m_dev_ctx.unit[n].fan_control_attr.fan_mode_sequence))                               \
+    ZB_ZCL_SET_MANUF_SPEC_ATTR_DESC(MHI_ATTR_FAN_VANE_ID, ZB_ZCL_ATTR_TYPE_U8,                                  \
+                                    ZB_ZCL_ATTR_ACCESS_READ_WRITE | ZB_ZCL_ATTR_ACCESS_REPORTING,               \
+                                    &m_dev_ctx.unit[n].fan_control_attr.vane)                                   \
+    ZB_ZCL_SET_MANUF_SPEC_ATTR_DESC(MHI_ATTR_FAN_VANE_SWING_ID, ZB_ZCL_ATTR_TYPE_BOOL,                          \
+                                    ZB_ZCL_ATTR_ACCESS_READ_WRITE | ZB_ZCL_ATTR_ACCESS_REPORTING,               \
+                                    &m_dev_ctx.unit[n].fan_control_attr.vane_swing)                             \
+    ZB_ZCL_SET_MANUF_SPEC_ATTR_DESC(MHI_ATTR_FAN_VANE_LR_ID, ZB_ZCL_ATTR_TYPE_U8,                               \
+                                    ZB_ZCL_ATTR_ACCESS_READ_WRITE | ZB_ZCL_ATTR_ACCESS_REPORTING,               \
+                                    &m_dev_ctx.unit[n].fan_control_attr.vane_lr)                                \
+    ZB_ZCL_SET_MANUF_SPEC_ATTR_DESC(MHI_ATTR_FAN_VANE_LR_SWING_ID, ZB_ZCL_ATTR_TYPE_BOOL,                       \
+                                    ZB_ZCL_ATTR_ACCESS_READ_WRITE | ZB_ZCL_ATTR_ACCESS_REPORTING,               \
+                                    &m_dev_ctx.unit[n].fan_control_attr.vane_lr_swing)                          \
+    ZB_ZCL_SET_MANUF_SPEC_ATTR_DESC(MHI_ATTR_FAN_VANE_3D_AUTO_ID, ZB_ZCL_ATTR_TYPE_BOOL,                        \
+                                    ZB_ZCL_ATTR_ACCESS_READ_WRITE | ZB_ZCL_ATTR_ACCESS_REPORTING,               \
+                                    &m_dev_ctx.unit[n].fan_control_attr.vane_3d_auto)                           \
+    ZB_ZCL_FINISH_DECLARE_ATTRIB_LIST;                                                                          \
+    ZB_ZCL_DECLARE_TEMP_MEASUREMENT_ATTRIB_LIST(                                                                \
+        temp_measurement_attr_list_##n,                                                                         \
+        &m_dev_ctx.unit[n].temp_measurement_attr.measure_value,                                                 \
+        &m_dev_ctx.unit[n].temp_measurement_attr.min_measure_value,                                             \
+        &m_dev_ctx.unit[n].temp_measurement_attr.max_measure_value,                                             \
+        &m_dev_ctx.unit[n].temp_measurement_attr.tolerance);                                                    \
+    ZB_ZCL_DECLARE_THERMOSTAT_ATTRIB_LIST(                                                                      \
+        thermostat_attr_list_##n,                                                                               \
+        &m_dev_ctx.unit[n].thermostat_attr.local_temperature,                                                   \
+        &m_dev_ctx.unit[n].thermostat_attr.local_temperature_calibration,                                       \
+        &m_dev_ctx.unit[n].thermostat_attr.occupied_cooling_setpoint,                                           \
+        &m_dev_ctx.unit[n].thermostat_attr.occupied_heating_setpoint,                                           \
+        &m_dev_ctx.unit[n].thermostat_attr.control_seq_of_operation,                                            \
+        &m_dev_ctx.unit[n].thermostat_attr.system_mode);                                                        \
+    ZB_ZCL_START_DECLARE_ATTRIB_LIST(metering_attr_list_##n)                                                    \
+    ZB_ZCL_SET_ATTR_DESC(ZB_ZCL_ATTR_METERING_CURRENT_SUMMATION_DELIVERED_ID,                                   \
+                         (&m_dev_ctx.unit[n].metering_attr.curr_summ_delivered))                                \
+    ZB_ZCL_SET_ATTR_DESC(ZB_ZCL_ATTR_METERING_STATUS_ID, (&m_dev_ctx.unit[n].metering_attr.status))            \
+    ZB_ZCL_SET_ATTR_DESC(ZB_ZCL_ATTR_METERING_UNIT_OF_MEASURE_ID,                                               \
+                         (&m_dev_ctx.unit[n].metering_attr.unit_of_measure))                                    \
+    ZB_ZCL_SET_ATTR_DESC(ZB_ZCL_ATTR_METERING_MULTIPLIER_ID, (&m_dev_ctx.unit[n].metering_attr.multiplier))    \
+    ZB_ZCL_SET_ATTR_DESC(ZB_ZCL_ATTR_METERING_DIVISOR_ID, (&m_dev_ctx.unit[n].metering_attr.divisor))          \
+    ZB_ZCL_SET_ATTR_DESC(ZB_ZCL_ATTR_METERING_SUMMATION_FORMATTING_ID,                                          \
+                         (&m_dev_ctx.unit[n].metering_attr.summation_formatting))                               \
+    ZB_ZCL_SET_ATTR_DESC(ZB_ZCL_ATTR_METERING_METERING_DEVICE_TYPE_ID,                                          \
+                         (&m_dev_ctx.unit[n].metering_attr.metering_device_type))                               \
+    ZB_ZCL_SET_ATTR_DESC(ZB_ZCL_ATTR_METERING_INSTANTANEOUS_DEMAND_ID,                                          \
+                         (&m_dev_ctx.unit[n].metering_attr.instantaneous_demand))                               \
+    ZB_ZCL_SET_ATTR_DESC(ZB_ZCL_ATTR_METERING_DEMAND_FORMATTING_ID,                                             \
+                         (&m_dev_ctx.unit[n].metering_attr.demand_formatting))                                  \
+    ZB_ZCL_FINISH_DECLARE_ATTRIB_LIST;                                                                          \
+    ZB_ZCL_START_DECLARE_ATTRIB_LIST(diagnostics_attr_list_##n)                                                 \
+    ZB_ZCL_SET_MANUF_SPEC_ATTR_DESC(MHI_ATTR_DIAG_FRAMES_ID, ZB_ZCL_ATTR_TYPE_U32, ZB_ZCL_ATTR_ACCESS_READ_ONLY, \
+                                    &m_units[n].link.stats.frames)                                              \
+    ZB_ZCL_SET_MANUF_SPEC_ATTR_DESC(MHI_ATTR_DIAG_LENGTH_ERRORS_ID, ZB_ZCL_ATTR_TYPE_U32,                       \
+                                    ZB_ZCL_ATTR_ACCESS_READ_ONLY, &m_units[n].link.stats.length_errors)         \
+    ZB_ZCL_SET_MANUF_SPEC_ATTR_DESC(MHI_ATTR_DIAG_SIGNATURE_ERRORS_ID, ZB_ZCL_ATTR_TYPE_U32,                    \
+                                    ZB_ZCL_ATTR_ACCESS_READ_ONLY, &m_units[n].link.stats.signature_errors)      \
+    ZB_ZCL_SET_MANUF_SPEC_ATTR_DESC(MHI_ATTR_DIAG_CHECKSUM_ERRORS_ID, ZB_ZCL_ATTR_TYPE_U32,                     \
+                                    ZB_ZCL_ATTR_ACCESS_READ_ONLY, &m_units[n].link.stats.checksum_errors)       \
+    ZB_ZCL_SET_MANUF_SPEC_ATTR_DESC(MHI_ATTR_DIAG_OVERRUNS_ID, ZB_ZCL_ATTR_TYPE_U32,                            \
+                                    ZB_ZCL_ATTR_ACCESS_READ_ONLY, &m_units[n].link.stats.overruns)              \
+    ZB_ZCL_SET_MANUF_SPEC_ATTR_DESC(MHI_ATTR_DIAG_RESYNCS_ID, ZB_ZCL_ATTR_TYPE_U32,                             \
+                                    ZB_ZCL_ATTR_ACCESS_READ_ONLY, &m_units[n].link.stats.resyncs)               \
+    ZB_ZCL_SET_MANUF_SPEC_ATTR_DESC(MHI_ATTR_DIAG_MISSING_ID, ZB_ZCL_ATTR_TYPE_U32,                             \
+                                    ZB_ZCL_ATTR_ACCESS_READ_ONLY, &m_units[n].link.stats.missing)               \
+    ZB_ZCL_SET_MANUF_SPEC_ATTR_DESC(MHI_ATTR_DIAG_LAST_FRAME_AGE_ID, ZB_ZCL_ATTR_TYPE_U32,                      \
+                                    ZB_ZCL_ATTR_ACCESS_READ_ONLY, &m_dev_ctx.unit[n].diag_attr.last_frame_age)  \
+    ZB_ZCL_SET_MANUF_SPEC_ATTR_DESC(MHI_ATTR_DIAG_AVAILABLE_ID, ZB_ZCL_ATTR_TYPE_BOOL,                          \
+                                    ZB_ZCL_ATTR_ACCESS_READ_ONLY | ZB_ZCL_ATTR_ACCESS_REPORTING,                \
+                                    &m_dev_ctx.unit[n].diag_attr.available)                                     \
+    ZB_ZCL_SET_MANUF_SPEC_ATTR_DESC(MHI_ATTR_DIAG_CMD_APPLIED_ID, ZB_ZCL_ATTR_TYPE_U32,                         \
+                                    ZB_ZCL_ATTR_ACCESS_READ_ONLY, &m_units[n].cmd.stats.applied)                \
+    ZB_ZCL_SET_MANUF_SPEC_ATTR_DESC(MHI_ATTR_DIAG_CMD_FAILED_ID, ZB_ZCL_ATTR_TYPE_U32,                          \
+                                    ZB_ZCL_ATTR_ACCESS_READ_ONLY, &m_units[n].cmd.stats.failed)                 \
+    ZB_ZCL_SET_MANUF_SPEC_ATTR_DESC(MHI_ATTR_DIAG_CMD_RETRIES_ID, ZB_ZCL_ATTR_TYPE_U32,                         \
+                                    ZB_ZCL_ATTR_ACCESS_READ_ONLY, &m_units[n].cmd.stats.retries)                \
+    ZB_ZCL_SET_MANUF_SPEC_ATTR_DESC(MHI_ATTR_DIAG_CMD_LATENCY_MAX_ID, ZB_ZCL_ATTR_TYPE_U16,                     \
+                                    ZB_ZCL_ATTR_ACCESS_READ_ONLY, &m_units[n].cmd.stats.latency_max)            \
+    ZB_ZCL_SET_MANUF_SPEC_ATTR_DESC(MHI_ATTR_DIAG_ERROR_CODE_ID, ZB_ZCL_ATTR_TYPE_U8,                           \
+                                    ZB_ZCL_ATTR_ACCESS_READ_ONLY, &m_dev_ctx.unit[n].diag_attr.error_code)      \
+    ZB_ZCL_SET_MANUF_SPEC_ATTR_DESC(MHI_ATTR_DIAG_ERROR_RETURN_AIR_ID, ZB_ZCL_ATTR_TYPE_S16,                    \
+                                    ZB_ZCL_ATTR_ACCESS_READ_ONLY,                                               \
+                                    &m_dev_ctx.unit[n].diag_attr.error_return_air_temp)                         \
+    ZB_ZCL_SET_MANUF_SPEC_ATTR_DESC(MHI_ATTR_DIAG_ERROR_OUTDOOR_ID, ZB_ZCL_ATTR_TYPE_S16,                       \
+                                    ZB_ZCL_ATTR_ACCESS_READ_ONLY,                                               \
+                                    &m_dev_ctx.unit[n].diag_attr.error_outdoor_temp)                            \
+    ZB_ZCL_SET_MANUF_SPEC_ATTR_DESC(MHI_ATTR_DIAG_ERROR_HEAT_EXCH_ID, ZB_ZCL_ATTR_TYPE_S16,                     \
+                                    ZB_ZCL_ATTR_ACCESS_READ_ONLY,                                               \
+                                    &m_dev_ctx.unit[n].diag_attr.error_heat_exch_temp)                          \
+    ZB_ZCL_SET_MANUF_SPEC_ATTR_DESC(MHI_ATTR_DIAG_ERROR_CURRENT_ID, ZB_ZCL_ATTR_TYPE_U16,                       \
+                                    ZB_ZCL_ATTR_ACCESS_READ_ONLY, &m_dev_ctx.unit[n].diag_attr.error_current)   \
+    ZB_ZCL_SET_MANUF_SPEC_ATTR_DESC(MHI_ATTR_DIAG_ERROR_COMP_FREQ_ID, ZB_ZCL_ATTR_TYPE_U16,                     \
+                                    ZB_ZCL_ATTR_ACCESS_READ_ONLY, &m_dev_ctx.unit[n].diag_attr.error_comp_freq) \
+    ZB_ZCL_SET_MANUF_SPEC_ATTR_DESC(MHI_ATTR_DIAG_ERROR_FETCH_ID, ZB_ZCL_ATTR_TYPE_U16,                         \
+                                    ZB_ZCL_ATTR_ACCESS_READ_ONLY,                                               \
+                                    &m_dev_ctx.unit[n].diag_attr.error_fetch_frames)                            \
+    ZB_ZCL_SET_MANUF_SPEC_ATTR_DESC(MHI_ATTR_DIAG_REMOTE_TEMP_ID, ZB_ZCL_ATTR_TYPE_BOOL,                        \
+                                    ZB_ZCL_ATTR_ACCESS_READ_ONLY | ZB_ZCL_ATTR_ACCESS_REPORTING,                \
+                                    &m_dev_ctx.unit[n].diag_attr.remote_temp)                                   \
+    ZB_ZCL_SET_MANUF_SPEC_ATTR_DESC(MHI_ATTR_DIAG_FRAME_PERIOD_ID, ZB_ZCL_ATTR_TYPE_U32,                        \
+                                    ZB_ZCL_ATTR_ACCESS_READ_ONLY, &m_dev_ctx.unit[n].diag_attr.frame_period)    \
+    ZB_ZCL_SET_MANUF_SPEC_ATTR_DESC(MHI_ATTR_DIAG_FRAME_JITTER_ID, ZB_ZCL_ATTR_TYPE_U32,                        \
+                                    ZB_ZCL_ATTR_ACCESS_READ_ONLY, &m_dev_ctx.unit[n].diag_attr.frame_jitter)    \
+    ZB_ZCL_SET_MANUF_SPEC_ATTR_DESC(MHI_ATTR_DIAG_XFER_TIME_ID, ZB_ZCL_ATTR_TYPE_U32,                           \
+                                    ZB_ZCL_ATTR_ACCESS_READ_ONLY, &m_dev_ctx.unit[n].diag_attr.xfer_time)       \
+    ZB_ZCL_SET_MANUF_SPEC_ATTR_DESC(MHI_ATTR_DIAG_GAP_MIN_ID, ZB_ZCL_ATTR_TYPE_U32,                             \
+                                    ZB_ZCL_ATTR_ACCESS_READ_ONLY, &m_dev_ctx.unit[n].diag_attr.gap_min)         \
+    ZB_ZCL_SET_MANUF_SPEC_ATTR_DESC(MHI_ATTR_DIAG_XFER_CYCLES_ID, ZB_ZCL_ATTR_TYPE_U32,                         \
+                                    ZB_ZCL_ATTR_ACCESS_READ_ONLY, &m_dev_ctx.unit[n].diag_attr.xfer_cycles)     \
+    ZB_ZCL_FINISH_DECLARE_ATTRIB_LIST
+
+/* Declare the HA definitions, the first unit also carries the device wide Basic and OTA
+ * Upgrade clusters */
+MHI_UNIT_ATTR_LISTS_DECLARE(0);
 ZB_HA_DECLARE_MHI_CLUSTER_LIST(
-    mhi_clusters,
-    identify_attr_list,
+    mhi_clusters_0,
+    identify_attr_list_0,
+    groups_attr_list_0,
+    scenes_attr_list_0,
     basic_attr_list,
-    on_off_attr_list,
-    fan_control_attr_list,
-    temp_measurement_attr_list);
-ZB_HA_DECLARE_MHI_EP(mhi_ep, MHI_ENDPOINT, mhi_clusters);
-ZB_HA_DECLARE_MHI_CTX(mhi_ctx, mhi_ep);
+    on_off_attr_list_0,
+    fan_control_attr_list_0,
+    temp_measurement_attr_list_0,
+    thermostat_attr_list_0,
+    metering_attr_list_0,
+    diagnostics_attr_list_0,
+    ota_upgrade_attr_list);
+ZB_HA_DECLARE_MHI_EP(mhi_ep_0, MHI_ENDPOINT, mhi_clusters_0);
+
+#if MHI_UNIT_COUNT > 1
+ZB_HA_DECLARE_MHI_UNIT_EP_TYPE();
+
+MHI_UNIT_ATTR_LISTS_DECLARE(1);
+ZB_HA_DECLARE_MHI_UNIT_CLUSTER_LIST(
+    mhi_clusters_1,
+    identify_attr_list_1,
+    groups_attr_list_1,
+    scenes_attr_list_1,
+    on_off_attr_list_1,
+    fan_control_attr_list_1,
+    temp_measurement_attr_list_1,
+    thermostat_attr_list_1,
+    metering_attr_list_1,
+    diagnostics_attr_list_1);
+ZB_HA_DECLARE_MHI_UNIT_EP(mhi_ep_1, MHI_ENDPOINT + 1, mhi_clusters_1);
+#endif
+
+#if MHI_UNIT_COUNT > 2
+MHI_UNIT_ATTR_LISTS_DECLARE(2);
+ZB_HA_DECLARE_MHI_UNIT_CLUSTER_LIST(
+    mhi_clusters_2,
+    identify_attr_list_2,
+    groups_attr_list_2,
+    scenes_attr_list_2,
+    on_off_attr_list_2,
+    fan_control_attr_list_2,
+    temp_measurement_attr_list_2,
+    thermostat_attr_list_2,
+    metering_attr_list_2,
+    diagnostics_attr_list_2);
+ZB_HA_DECLARE_MHI_UNIT_EP(mhi_ep_2, MHI_ENDPOINT + 2, mhi_clusters_2);
+#endif
+
+#if MHI_UNIT_COUNT == 1
+ZB_HA_DECLARE_MHI_CTX(mhi_ctx, mhi_ep_0);
+#elif MHI_UNIT_COUNT == 2
+ZB_HA_DECLARE_MHI_CTX_2_EP(mhi_ctx, mhi_ep_0, mhi_ep_1);
+#else
+ZB_HA_DECLARE_MHI_CTX_3_EP(mhi_ctx, mhi_ep_0, mhi_ep_1, mhi_ep_2);
+#endif
+
+/* Declare SPI, one SPIS instance per unit: the first unit keeps SPIS1, the others use SPIS0
+ * and SPIS2. The nrf_drv_spis handlers get no context, every instance has its own. */
+static void spis_event_handler_0(nrf_drv_spis_event_t event);
+#if MHI_UNIT_COUNT > 1
+static void spis_event_handler_1(nrf_drv_spis_event_t event);
+#endif
+#if MHI_UNIT_COUNT > 2
+static void spis_event_handler_2(nrf_drv_spis_event_t event);
+#endif
+
+typedef struct
+{
+    nrf_drv_spis_t spis;                  /* SPIS instance */
+    nrf_drv_spis_event_handler_t handler; /* Event handler of the instance */
+    uint8_t sck_pin;                      /* SCK pin */
+    uint8_t mosi_pin;                     /* MOSI pin */
+    uint8_t miso_pin;                     /* MISO pin */
+    uint8_t csn_pin;                      /* CSN pin */
+} unit_spis_t;
+static const unit_spis_t m_unit_spis[MHI_UNIT_COUNT] = {
+    {NRF_DRV_SPIS_INSTANCE(1), spis_event_handler_0,
+     APP_SPIS_SCK_PIN, APP_SPIS_MOSI_PIN, APP_SPIS_MISO_PIN, APP_SPIS_CSN_PIN},
+#if MHI_UNIT_COUNT > 1
+    {NRF_DRV_SPIS_INSTANCE(0), spis_event_handler_1,
+     APP_SPIS_UNIT1_SCK_PIN, APP_SPIS_UNIT1_MOSI_PIN, APP_SPIS_UNIT1_MISO_PIN, APP_SPIS_UNIT1_CSN_PIN},
+#endif
+#if MHI_UNIT_COUNT > 2
+    {NRF_DRV_SPIS_INSTANCE(2), spis_event_handler_2,
+     APP_SPIS_UNIT2_SCK_PIN, APP_SPIS_UNIT2_MOSI_PIN, APP_SPIS_UNIT2_MISO_PIN, APP_SPIS_UNIT2_CSN_PIN},
+#endif
+};
+static uint8_t m_tx_buf[MHI_UNIT_COUNT][MHI_FRAME_SIZE_EXT];                /* TX buffer per unit */
+static uint8_t m_rx_buf[MHI_UNIT_COUNT][MHI_FRAME_SIZE_EXT];                /* RX buffer per unit */
+#if MHI_SPIS_NRF_REARM
+static uint8_t m_tx_spare[MHI_UNIT_COUNT][MHI_FRAME_SIZE_EXT];              /* Second TX buffer per unit, staged while the SPIS sends the other */
+static uint8_t *m_p_tx_idle[MHI_UNIT_COUNT];                                /* TX buffer the SPIS does not point at */
+static uint32_t m_spis_end_us[MHI_UNIT_COUNT];                              /* End capture of the last transfer handed over */
+static uint32_t m_tx_late[MHI_UNIT_COUNT];                                  /* Transfers that sent the previous TX frame again, waiting for the swap */
+#endif
+
+#if MHI_LOG_BINARY_ENABLED
+/* Binary log transport, uses the UART instance otherwise used by the nrf_log UART backend */
+#define LOG_UART_MAX_CHUNK 255                                              /* nrf_drv_uart_tx length is 8-bit */
+static const nrf_drv_uart_t m_log_uart = NRF_DRV_UART_INSTANCE(0);          /* Log UART instance */
+static volatile bool m_log_uart_busy;                                       /* Transfer in progress */
+#endif
+
+#if MHI_CLI_ENABLED
+/* Diagnostic CLI on the log UART, nrf_cli is the log backend as well */
+NRF_CLI_UART_DEF(m_cli_uart_transport, 0, 64, 16);                          /* UART transport, TX and RX buffer sizes */
+NRF_CLI_DEF(m_cli_uart, "mhi> ", &m_cli_uart_transport.transport, '\r', 4); /* Shell, with 4 queued log entries */
+static mhi_cli_t m_cli;                                                     /* Diagnostic commands */
+#endif
+
+/* Stack high-water mark */
+#define STACK_CHECK_INTERVAL_MS 10000                                       /* Stack scan interval */
+APP_TIMER_DEF(m_stack_timer);                                               /* Stack scan timer */
+static volatile bool m_stack_check;                                         /* Stack scan due */
+static uint32_t m_stack_unused;                                             /* Unused stack last reported */
+
+/* Default responses of the On/Off commands, sent once the AC applied the command */
+typedef struct
+{
+    zb_bufid_t bufid;                /* Buffer of the command, reused for the response, 0 when none */
+    zb_uint16_t addr;                /* Short address of the sender */
+    zb_uint8_t src_ep;               /* Endpoint of the sender */
+    zb_uint16_t profile_id;          /* Profile of the command */
+    zb_uint16_t cluster_id;          /* Cluster of the command */
+    zb_uint8_t seq_number;           /* ZCL sequence number of the command */
+    zb_uint8_t cmd_id;               /* Command */
+    zb_bool_t disable_default_resp;  /* No response is wanted on success */
+} cmd_resp_t;
+static cmd_resp_t m_cmd_resp[MHI_UNIT_COUNT][MHI_FIELD_COUNT];              /* Waiting response per unit and field */
+
+/* Scene tables of all units, saved in the application dataset of the Zigbee NVRAM */
+static uint8_t m_scene_nvram[MHI_SCENE_SAVE_SIZE(MHI_UNIT_COUNT)];          /* Serialized tables */
+
+/* Energy totals of all units, saved in the second application dataset of the Zigbee NVRAM */
+static uint8_t m_energy_nvram[MHI_ENERGY_SAVE_SIZE(MHI_UNIT_COUNT)];        /* Serialized totals */
+
+/* Link diagnostics */
+APP_TIMER_DEF(m_diag_timer);                                                /* Last frame age timer */
+static volatile bool m_diag_tick;                                           /* A second has passed */
+static uint32_t m_diag_frames[MHI_UNIT_COUNT];                              /* Valid frames per unit at the last tick */
+static uint32_t m_diag_ticks;                                               /* Ticks since the last frame timing log */
+
+/* CPU cycles of the transfer handling, from the DWT cycle counter */
+typedef struct
+{
+    uint32_t max;   /* Longest handling since the last frame timing log */
+    uint32_t sum;   /* Cycles of all handlings since then */
+    uint32_t count; /* Handlings since then */
+} xfer_cycles_t;
+static xfer_cycles_t m_xfer_cycles[MHI_UNIT_COUNT];                         /* Per unit, updated where the transfers are handled */
+#if MHI_RAMFUNC_ENABLED
+#define XFER_CODE_PLACE "RAM"                                               /* Where the transfer handling runs */
+#else
+#define XFER_CODE_PLACE "flash"
+#endif
+
+/**
+ * @brief Stack timer handler, the scan itself runs in the main loop.
+ */
+static void stack_timer_handler(void *p_context)
+{
+    UNUSED_PARAMETER(p_context);
+    m_stack_check = true;
+}
 
-/* Declare SPI */
-#define SPIS_INSTANCE 1                                                  /* SPIS instance index */
-#define MHI_SPI_MSG_SIZE 20                                              /* SPI dataframe size */
-static const nrf_drv_spis_t spis = NRF_DRV_SPIS_INSTANCE(SPIS_INSTANCE); /* SPIS instance */
-static uint8_t m_tx_buf[20];                                             /* TX buffer */
-static uint8_t m_rx_buf[20];                                             /* RX buffer */
+/**
+ * @brief Diagnostics timer handler, the age is updated in the main loop.
+ */
+static void diag_timer_handler(void *p_context)
+{
+    UNUSED_PARAMETER(p_context);
+    m_diag_tick = true;
+}
 
 /**
  * @brief Function for the Timer initialization.
@@ -80,42 +408,561 @@ static void timers_init(void)
     // Initialize timer module.
     err_code = app_timer_init();
     APP_ERROR_CHECK(err_code);
+
+    err_code = app_timer_create(&m_stack_timer, APP_TIMER_MODE_REPEATED, stack_timer_handler);
+    APP_ERROR_CHECK(err_code);
+    err_code = app_timer_start(m_stack_timer, APP_TIMER_TICKS(STACK_CHECK_INTERVAL_MS), NULL);
+    APP_ERROR_CHECK(err_code);
+
+    err_code = app_timer_create(&m_diag_timer, APP_TIMER_MODE_REPEATED, diag_timer_handler);
+    APP_ERROR_CHECK(err_code);
+    err_code = app_timer_start(m_diag_timer, APP_TIMER_TICKS(MHI_DIAG_INTERVAL_MS), NULL);
+    APP_ERROR_CHECK(err_code);
+}
+
+/**
+ * @brief Log the stack high-water mark whenever the stack went deeper than before.
+ */
+static void stack_process(void)
+{
+    uint32_t unused;
+
+    if (!m_stack_check)
+    {
+        return;
+    }
+    m_stack_check = false;
+
+    unused = mhi_stack_unused();
+    if (unused < m_stack_unused)
+    {
+        MHI_LOG_INFO("Stack high-water mark: %u of %u bytes used", mhi_stack_size() - unused, mhi_stack_size());
+        m_stack_unused = unused;
+    }
+}
+
+/**
+ * @brief Write an application dataset, one step of a scheduled job.
+ * @param p_context Dataset (zb_nvram_dataset_types_t)
+ * @return true, a dataset is written in one step
+ */
+static bool nvram_save_step(void *p_context)
+{
+    ZB_ERROR_CHECK(zb_nvram_write_dataset((zb_nvram_dataset_types_t)(uintptr_t)p_context));
+    return true;
+}
+
+/**
+ * @brief Write an application dataset in the next gap between the SPI frames.
+ * @param dataset Dataset to write
+ */
+static void nvram_save(zb_nvram_dataset_types_t dataset)
+{
+    if (!mhi_sched_submit(&m_sched, nvram_save_step, (void *)(uintptr_t)dataset, MHI_NVRAM_SAVE_US))
+    {
+        (void)nvram_save_step((void *)(uintptr_t)dataset);
+    }
+}
+
+/**
+ * @brief Update the age of the last valid frame and the frame timing of every unit, and log
+ * the frame timing, the SPIS transfer counters and the cycles of the transfer handling every
+ * MHI_TIMING_LOG_INTERVAL updates. The link counters need no update, the Diagnostics attributes
+ * point straight at them.
+ */
+static void diag_process(void)
+{
+    bool timing_log;
+
+    if (!m_diag_tick)
+    {
+        return;
+    }
+    m_diag_tick = false;
+
+    timing_log = ++m_diag_ticks >= MHI_TIMING_LOG_INTERVAL;
+    if (timing_log)
+    {
+        uint32_t csn;
+        uint32_t end;
+
+        m_diag_ticks = 0;
+        mhi_timing_nrf_counts(&csn, &end);
+        MHI_LOG_INFO("SPIS transfers %u, left without an answer %u", end, csn - end);
+    }
+
+    for (uint8_t i = 0; i < MHI_UNIT_COUNT; i++)
+    {
+        uint32_t frames = m_units[i].link.stats.frames;
+        mhi_diag_attrs_t *p_diag = &m_dev_ctx.unit[i].diag_attr;
+        const mhi_timing_t *p_timing = &m_units[i].timing;
+
+        if (frames != m_diag_frames[i])
+        {
+            p_diag->last_frame_age = 0;
+            m_diag_frames[i] = frames;
+        }
+        else if (p_diag->last_frame_age < UINT32_MAX)
+        {
+            p_diag->last_frame_age++;
+        }
+
+        p_diag->frame_period = mhi_timing_hist_mean(&p_timing->period);
+        p_diag->frame_jitter = mhi_timing_hist_stddev(&p_timing->period);
+        p_diag->xfer_time = p_timing->xfer.max;
+        p_diag->gap_min = p_timing->gap.min;
+        mhi_sched_xfer_set(&m_sched, i, p_timing->xfer.max);
+        if (timing_log)
+        {
+            xfer_cycles_t cycles;
+
+            CRITICAL_REGION_ENTER();
+            cycles = m_xfer_cycles[i];
+            memset(&m_xfer_cycles[i], 0, sizeof(m_xfer_cycles[i]));
+            CRITICAL_REGION_EXIT();
+
+            p_diag->xfer_cycles = cycles.max;
+            mhi_timing_log(p_timing, i);
+            MHI_LOG_INFO("Unit %u transfer handling %u cycles mean, %u max, from " XFER_CODE_PLACE, i,
+                         cycles.count ? cycles.sum / cycles.count : 0, cycles.max);
+#if MHI_SPIS_NRF_REARM
+            MHI_LOG_INFO("Unit %u TX frames sent again: %u while swapping, %u for lost frames", i, m_tx_late[i],
+                         m_units[i].link.stats.missing);
+#endif
+        }
+    }
+}
+
+#if MHI_LOG_BINARY_ENABLED
+/**
+ * @brief Binary log UART event handler, releases the sent bytes from the log ring.
+ * @param p_event UART event
+ * @param p_context Unused
+ */
+static void log_uart_event_handler(nrf_drv_uart_event_t *p_event, void *p_context)
+{
+    if (p_event->type == NRF_DRV_UART_EVT_TX_DONE)
+    {
+        mhi_log_release(p_event->data.rxtx.bytes);
+        m_log_uart_busy = false;
+    }
+}
+#endif
+
+#if MHI_CLI_ENABLED
+/**
+ * @brief Diagnostic command output, on the log UART.
+ * @param p_context Unused
+ * @param p_fmt Format
+ * @param p_args Arguments
+ */
+static void cli_print(void *p_context, const char *p_fmt, va_list *p_args)
+{
+    UNUSED_PARAMETER(p_context);
+    nrf_fprintf_fmt(m_cli_uart.p_fprintf_ctx, p_fmt, p_args);
+}
+
+/**
+ * @brief nrf_cli handler of all diagnostic commands, called from nrf_cli_process in the main
+ * loop.
+ * @param p_cli Shell
+ * @param argc Number of arguments, the command word included
+ * @param argv Arguments
+ */
+static void cli_cmd_handler(nrf_cli_t const *p_cli, size_t argc, char **argv)
+{
+    if (nrf_cli_help_requested(p_cli))
+    {
+        nrf_cli_help_print(p_cli, NULL, 0);
+        return;
+    }
+
+    UNUSED_RETURN_VALUE(mhi_cli_exec(&m_cli, argc, argv));
 }
 
+#define CLI_CMD_REGISTER(name, args, help) NRF_CLI_CMD_REGISTER(name, NULL, help, cli_cmd_handler);
+MHI_CLI_COMMANDS(CLI_CMD_REGISTER)
+#undef CLI_CMD_REGISTER
+#endif
+
 /**
  * @brief Function for initializing the nrf log module.
+ * @details In binary mode the log UART is driven by the application instead of the nrf_log
+ * backend, nrf_log then only serves the SDK modules without output. With the diagnostic CLI,
+ * nrf_cli drives the log UART, receives the commands on RX_PIN_NUMBER and is the log backend.
  */
 static void log_init(void)
 {
     ret_code_t err_code = NRF_LOG_INIT(NULL);
     APP_ERROR_CHECK(err_code);
 
+#if MHI_LOG_BINARY_ENABLED
+    nrf_drv_uart_config_t uart_config = NRF_DRV_UART_DEFAULT_CONFIG;
+    uart_config.pseltxd = NRF_LOG_BACKEND_UART_TX_PIN;
+    uart_config.pselrxd = NRF_UART_PSEL_DISCONNECTED;
+    uart_config.pselcts = NRF_UART_PSEL_DISCONNECTED;
+    uart_config.pselrts = NRF_UART_PSEL_DISCONNECTED;
+    uart_config.baudrate = (nrf_uart_baudrate_t)NRF_LOG_BACKEND_UART_BAUDRATE;
+    err_code = nrf_drv_uart_init(&m_log_uart, &uart_config, log_uart_event_handler);
+    APP_ERROR_CHECK(err_code);
+#elif MHI_CLI_ENABLED
+    nrf_drv_uart_config_t uart_config = NRF_DRV_UART_DEFAULT_CONFIG;
+    uart_config.pseltxd = NRF_LOG_BACKEND_UART_TX_PIN;
+    uart_config.pselrxd = RX_PIN_NUMBER;
+    uart_config.hwfc = NRF_UART_HWFC_DISABLED;
+    uart_config.baudrate = (nrf_uart_baudrate_t)NRF_LOG_BACKEND_UART_BAUDRATE;
+    err_code = nrf_cli_init(&m_cli_uart, &uart_config, true, true, NRF_LOG_SEVERITY_INFO);
+    APP_ERROR_CHECK(err_code);
+
+    /* Without a cable the RX line floats, the pull-up keeps it idle */
+    nrf_gpio_cfg_input(RX_PIN_NUMBER, NRF_GPIO_PIN_PULLUP);
+
+    mhi_cli_init(&m_cli, m_units, MHI_UNIT_COUNT, cli_print, NULL);
+    err_code = nrf_cli_start(&m_cli_uart);
+    APP_ERROR_CHECK(err_code);
+#else
     NRF_LOG_DEFAULT_BACKENDS_INIT();
+#endif
+}
+
+/**
+ * @brief Process pending log entries, should be called from the main loop.
+ * @return true when there may be more entries to process
+ */
+static bool log_process(void)
+{
+#if MHI_LOG_BINARY_ENABLED
+    const uint8_t *p_data;
+    size_t len;
+
+    UNUSED_RETURN_VALUE(NRF_LOG_PROCESS());
+
+    if (m_log_uart_busy)
+    {
+        return true;
+    }
+
+    len = mhi_log_claim(&p_data);
+    if (len == 0)
+    {
+        return false;
+    }
+
+    m_log_uart_busy = true;
+    if (nrf_drv_uart_tx(&m_log_uart, p_data, (uint8_t)MIN(len, LOG_UART_MAX_CHUNK)) != NRF_SUCCESS)
+    {
+        m_log_uart_busy = false;
+    }
+
+    return true;
+#else
+    return NRF_LOG_PROCESS();
+#endif
+}
+
+/**
+ * @brief Process all pending log entries before returning.
+ */
+static void log_flush(void)
+{
+#if MHI_LOG_BINARY_ENABLED
+    while (log_process())
+    {
+    }
+#else
+    NRF_LOG_FLUSH();
+#endif
 }
 
 /**
- * @brief Function for turning ON/OFF the light bulb.
- * @param[in]   on   Boolean light bulb state.
+ * @brief Find the unit served on an endpoint.
+ * @param endpoint Zigbee endpoint
+ * @return Index of the unit, MHI_UNIT_COUNT when the endpoint has none
  */
-static void on_off_set_value(zb_bool_t on)
+static uint8_t unit_index(zb_uint8_t endpoint)
 {
-    NRF_LOG_INFO("Set ON/OFF value: %i", on);
+    if (endpoint < MHI_ENDPOINT || endpoint >= MHI_ENDPOINT + MHI_UNIT_COUNT)
+    {
+        return MHI_UNIT_COUNT;
+    }
 
-    ZB_ZCL_SET_ATTRIBUTE(
-        MHI_ENDPOINT,
-        ZB_ZCL_CLUSTER_ID_ON_OFF,
-        ZB_ZCL_CLUSTER_SERVER_ROLE,
-        ZB_ZCL_ATTR_ON_OFF_ON_OFF_ID,
-        (zb_uint8_t *)&on,
-        ZB_TRUE);
+    return (uint8_t)(endpoint - MHI_ENDPOINT);
+}
 
-    if (on)
+/**
+ * @brief Send the waiting default response of a field, or drop it when none is wanted.
+ * @param unit Index of the unit
+ * @param field Field of the command
+ * @param status ZCL status of the response
+ */
+static void cmd_resp_send(uint8_t unit, mhi_field_t field, zb_uint8_t status)
+{
+    cmd_resp_t *p_resp = &m_cmd_resp[unit][field];
+
+    if (p_resp->bufid == 0)
     {
-        bsp_board_led_on(BSP_BOARD_LED_1);
+        return;
+    }
+
+    if (status == ZB_ZCL_STATUS_SUCCESS && p_resp->disable_default_resp)
+    {
+        zb_buf_free(p_resp->bufid);
     }
     else
     {
-        bsp_board_led_off(BSP_BOARD_LED_1);
+        ZB_ZCL_SEND_DEFAULT_RESP(p_resp->bufid,
+                                 p_resp->addr,
+                                 ZB_APS_ADDR_MODE_16_ENDP_PRESENT,
+                                 p_resp->src_ep,
+                                 m_units[unit].endpoint,
+                                 p_resp->profile_id,
+                                 p_resp->cluster_id,
+                                 p_resp->seq_number,
+                                 p_resp->cmd_id,
+                                 status);
+    }
+
+    p_resp->bufid = 0;
+}
+
+/**
+ * @brief Handle a Scenes command of a unit and send its response. Groupcast and broadcast
+ * commands get none.
+ * @param bufid Buffer of the ZCL command, reused for the response
+ * @param p_cmd_info Parsed header of the command
+ * @param unit Index of the unit
+ * @return ZB_TRUE when the command was handled, the buffer is then owned by the application
+ */
+static zb_uint8_t scene_handler(zb_bufid_t bufid, const zb_zcl_parsed_hdr_t *p_cmd_info, uint8_t unit)
+{
+    mhi_unit_t *p_unit = &m_units[unit];
+    const uint8_t *p_req = zb_buf_begin(bufid);
+    size_t req_len = zb_buf_len(bufid);
+    zb_uint16_t addr = ZB_ZCL_PARSED_HDR_SHORT_DATA(p_cmd_info).source.u.short_addr;
+    zb_uint8_t src_ep = ZB_ZCL_PARSED_HDR_SHORT_DATA(p_cmd_info).src_endpoint;
+    zb_uint16_t profile_id = p_cmd_info->profile_id;
+    zb_uint8_t seq_number = p_cmd_info->seq_number;
+    zb_uint8_t cmd_id = p_cmd_info->cmd_id;
+    bool unicast = ZB_APS_FC_GET_DELIVERY_MODE(ZB_ZCL_PARSED_HDR_SHORT_DATA(p_cmd_info).fc) == ZB_APS_DELIVERY_UNICAST;
+    bool disable_default_resp = p_cmd_info->disable_default_response;
+    bool in_group = true;
+    mhi_scene_resp_t resp;
+    zb_uint8_t *p_data;
+
+    /* Every Scenes command starts with its group, the unit only keeps scenes of the groups
+     * its endpoint is a member of */
+    if (req_len >= 2)
+    {
+        zb_uint16_t group_id = (zb_uint16_t)(p_req[0] | (p_req[1] << 8));
+
+        in_group = group_id == 0 || zb_aps_is_endpoint_in_group(group_id, p_unit->endpoint);
+    }
+
+    if (!mhi_unit_scene_command(p_unit, cmd_id, p_req, req_len, in_group, &resp))
+    {
+        return ZB_FALSE;
+    }
+    MHI_LOG_INFO("Scenes command %d for unit %d: status 0x%02x", cmd_id, unit, resp.status);
+
+    if (p_unit->scenes.dirty)
+    {
+        nvram_save(ZB_NVRAM_APP_DATA1);
+    }
+
+    if (!unicast || (!resp.specific && resp.status == ZB_ZCL_STATUS_SUCCESS && disable_default_resp))
+    {
+        zb_buf_free(bufid);
+    }
+    else if (resp.specific)
+    {
+        /* Add, View, Remove, Remove All, Store and Get Membership answer with a response of
+         * the same command identifier */
+        p_data = ZB_ZCL_START_PACKET(bufid);
+        ZB_ZCL_CONSTRUCT_SPECIFIC_COMMAND_RES_FRAME_CONTROL(p_data);
+        ZB_ZCL_CONSTRUCT_COMMAND_HEADER(p_data, seq_number, cmd_id);
+        ZB_ZCL_PACKET_PUT_DATA_N(p_data, resp.data, resp.len);
+        ZB_ZCL_FINISH_PACKET(bufid, p_data)
+        ZB_ZCL_SEND_COMMAND_SHORT(bufid, addr, ZB_APS_ADDR_MODE_16_ENDP_PRESENT, src_ep, p_unit->endpoint,
+                                  profile_id, ZB_ZCL_CLUSTER_ID_SCENES, NULL);
+    }
+    else
+    {
+        ZB_ZCL_SEND_DEFAULT_RESP(bufid,
+                                 addr,
+                                 ZB_APS_ADDR_MODE_16_ENDP_PRESENT,
+                                 src_ep,
+                                 p_unit->endpoint,
+                                 profile_id,
+                                 ZB_ZCL_CLUSTER_ID_SCENES,
+                                 seq_number,
+                                 cmd_id,
+                                 resp.status);
+    }
+
+    return ZB_TRUE;
+}
+
+/**
+ * @brief Drop the scenes of the groups a Remove Group or Remove All Groups command takes the
+ * endpoint of a unit out of, the Groups cluster itself is left to the stack.
+ * @param bufid Buffer of the ZCL command
+ * @param p_cmd_info Parsed header of the command
+ * @param unit Index of the unit
+ */
+static void groups_handler(zb_bufid_t bufid, const zb_zcl_parsed_hdr_t *p_cmd_info, uint8_t unit)
+{
+    mhi_unit_t *p_unit = &m_units[unit];
+    const uint8_t *p_req = zb_buf_begin(bufid);
+
+    if (p_cmd_info->cmd_id == ZB_ZCL_CMD_GROUPS_REMOVE_GROUP && zb_buf_len(bufid) >= 2)
+    {
+        mhi_scene_remove_group(&p_unit->scenes, (zb_uint16_t)(p_req[0] | (p_req[1] << 8)));
+    }
+    else if (p_cmd_info->cmd_id == ZB_ZCL_CMD_GROUPS_REMOVE_ALL_GROUPS)
+    {
+        mhi_scene_remove_group(&p_unit->scenes, MHI_SCENE_GROUP_ALL);
+    }
+
+    if (p_unit->scenes.dirty)
+    {
+        MHI_LOG_INFO("Groups command %d removed scenes of unit %d", p_cmd_info->cmd_id, unit);
+        nvram_save(ZB_NVRAM_APP_DATA1);
+    }
+}
+
+/**
+ * @brief Endpoint handler, takes over the On/Off commands so their default response waits
+ * for the AC, and the Scenes commands, whose scenes hold the whole AC state. Groupcast and
+ * broadcast commands get no default response, every unit in the group applies them on its
+ * own. Removed groups take their scenes with them.
+ * @param bufid Buffer of the ZCL command
+ * @return ZB_TRUE when the command was handled, the buffer is then owned by the application
+ */
+static zb_uint8_t ep_handler(zb_bufid_t bufid)
+{
+    zb_zcl_parsed_hdr_t *p_cmd_info = ZB_BUF_GET_PARAM(bufid, zb_zcl_parsed_hdr_t);
+    uint8_t unit = unit_index(ZB_ZCL_PARSED_HDR_SHORT_DATA(p_cmd_info).dst_endpoint);
+    cmd_resp_t *p_resp;
+    uint8_t power;
+
+    if (unit == MHI_UNIT_COUNT || p_cmd_info->is_common_command)
+    {
+        return ZB_FALSE;
+    }
+    if (p_cmd_info->cluster_id == ZB_ZCL_CLUSTER_ID_SCENES)
+    {
+        return scene_handler(bufid, p_cmd_info, unit);
+    }
+    if (p_cmd_info->cluster_id == ZB_ZCL_CLUSTER_ID_GROUPS)
+    {
+        groups_handler(bufid, p_cmd_info, unit);
+        return ZB_FALSE;
+    }
+    if (p_cmd_info->cluster_id != ZB_ZCL_CLUSTER_ID_ON_OFF)
+    {
+        return ZB_FALSE;
+    }
+    p_resp = &m_cmd_resp[unit][MHI_FIELD_POWER];
+
+    switch (p_cmd_info->cmd_id)
+    {
+    case ZB_ZCL_CMD_ON_OFF_OFF_ID:
+        power = 0;
+        break;
+    case ZB_ZCL_CMD_ON_OFF_ON_ID:
+        power = 1;
+        break;
+    case ZB_ZCL_CMD_ON_OFF_TOGGLE_ID:
+        power = !m_units[unit].state.value[MHI_FIELD_POWER];
+        break;
+    default:
+        return ZB_FALSE;
+    }
+
+    /* A newer command replaces the one still waiting for the AC */
+    cmd_resp_send(unit, MHI_FIELD_POWER, ZB_ZCL_STATUS_ABORT);
+
+    if (ZB_APS_FC_GET_DELIVERY_MODE(ZB_ZCL_PARSED_HDR_SHORT_DATA(p_cmd_info).fc) != ZB_APS_DELIVERY_UNICAST)
+    {
+        MHI_LOG_INFO("On/Off groupcast %d for unit %d", p_cmd_info->cmd_id, unit);
+        zb_buf_free(bufid);
+        (void)mhi_unit_request(&m_units[unit], MHI_FIELD_POWER, power);
+        return ZB_TRUE;
+    }
+
+    /* The response overwrites the buffer, keep what it needs first */
+    p_resp->addr = ZB_ZCL_PARSED_HDR_SHORT_DATA(p_cmd_info).source.u.short_addr;
+    p_resp->src_ep = ZB_ZCL_PARSED_HDR_SHORT_DATA(p_cmd_info).src_endpoint;
+    p_resp->profile_id = p_cmd_info->profile_id;
+    p_resp->cluster_id = p_cmd_info->cluster_id;
+    p_resp->seq_number = p_cmd_info->seq_number;
+    p_resp->cmd_id = p_cmd_info->cmd_id;
+    p_resp->disable_default_resp = p_cmd_info->disable_default_response;
+    p_resp->bufid = bufid;
+
+    MHI_LOG_INFO("On/Off command %d for unit %d", p_cmd_info->cmd_id, unit);
+    if (!mhi_unit_request(&m_units[unit], MHI_FIELD_POWER, power))
+    {
+        cmd_resp_send(unit, MHI_FIELD_POWER, ZB_ZCL_STATUS_FAIL);
+    }
+
+    return ZB_TRUE;
+}
+
+/**
+ * @brief Process the frames received from the ACs, answer the commands they applied or that
+ * were given up, save the energy totals when due, and reflect their power state on the helper
+ * LED: on while any unit is on.
+ */
+static void unit_process(void)
+{
+    bool power_changed = false;
+    bool powered = false;
+    bool energy_save = false;
+
+    for (uint8_t i = 0; i < MHI_UNIT_COUNT; i++)
+    {
+        mhi_unit_t *p_unit = &m_units[i];
+        uint32_t changed = mhi_unit_process(p_unit);
+
+        for (uint32_t field = 0; (p_unit->cmd_applied | p_unit->cmd_failed) >> field; field++)
+        {
+            if (p_unit->cmd_applied & MHI_FIELD_BIT(field))
+            {
+                cmd_resp_send(i, (mhi_field_t)field, ZB_ZCL_STATUS_SUCCESS);
+            }
+            else if (p_unit->cmd_failed & MHI_FIELD_BIT(field))
+            {
+                MHI_LOG_WARNING("Command for field %d not applied by AC %d", field, i);
+                cmd_resp_send(i, (mhi_field_t)field, ZB_ZCL_STATUS_FAIL);
+            }
+        }
+
+        if (changed & MHI_FIELD_BIT(MHI_FIELD_POWER))
+        {
+            MHI_LOG_INFO("AC %d power: %d", i, p_unit->state.value[MHI_FIELD_POWER]);
+            power_changed = true;
+        }
+        powered |= p_unit->state.value[MHI_FIELD_POWER] != 0;
+        energy_save |= mhi_energy_save_due(&p_unit->energy);
+    }
+
+    /* The dataset holds the totals of all units, one save restarts the interval of each */
+    if (energy_save)
+    {
+        nvram_save(ZB_NVRAM_APP_DATA2);
+    }
+
+    if (power_changed)
+    {
+        if (powered)
+        {
+            bsp_board_led_on(BSP_BOARD_LED_1);
+        }
+        else
+        {
+            bsp_board_led_off(BSP_BOARD_LED_1);
+        }
     }
 }
 
@@ -131,21 +978,14 @@ static void buttons_handler(bsp_event_t event)
     switch (event)
     {
     case BSP_EVENT_KEY_0:
-        NRF_LOG_INFO("Button pressed");
-        if (m_dev_ctx.on_off_attr.on_off)
-        {
-            on_off_set_value(ZB_FALSE);
-        }
-        else
-        {
-            on_off_set_value(ZB_TRUE);
-        }
+        MHI_LOG_INFO("Button pressed");
+        UNUSED_RETURN_VALUE(mhi_unit_request(&m_units[0], MHI_FIELD_POWER, !m_units[0].state.value[MHI_FIELD_POWER]));
         break;
     case BSP_EVENT_KEY_1:
-        NRF_LOG_INFO("Keep this button pressed while resetting the device to clear the Zigbee configuration!");
+        MHI_LOG_INFO("Keep this button pressed while resetting the device to clear the Zigbee configuration!");
         return;
     default:
-        NRF_LOG_INFO("Unhandled BSP Event received: %d", event);
+        MHI_LOG_INFO("Unhandled BSP Event received: %d", event);
         return;
     }
 }
@@ -173,6 +1013,7 @@ void zboss_signal_handler(zb_bufid_t bufid)
 {
     zb_zdo_app_signal_hdr_t *p_sg_p = NULL;
     zb_zdo_app_signal_type_t sig = zb_get_app_signal(bufid, &p_sg_p);
+    zb_ret_t status = ZB_GET_APP_SIGNAL_STATUS(bufid);
 
     /* Update network status LED */
     zigbee_led_status_update(bufid, ZIGBEE_NETWORK_STATE_LED);
@@ -184,6 +1025,12 @@ void zboss_signal_handler(zb_bufid_t bufid)
     case ZB_BDB_SIGNAL_STEERING:
         /* Call default signal handler. */
         ZB_ERROR_CHECK(zigbee_default_signal_handler(bufid));
+
+        if (status == RET_OK)
+        {
+            /* Discover the OTA server and start querying it for new images */
+            ZB_ERROR_CHECK(zb_buf_get_out_delayed(zb_zcl_ota_upgrade_init_client));
+        }
         break;
 
     default:
@@ -232,19 +1079,83 @@ static void mhi_clusters_attr_init(void)
         MHI_INIT_BASIC_DATE_CODE,
         ZB_ZCL_STRING_CONST_SIZE(MHI_INIT_BASIC_DATE_CODE));
 
-    /* Identify cluster attributes data */
-    m_dev_ctx.identify_attr.identify_time = ZB_ZCL_IDENTIFY_IDENTIFY_TIME_DEFAULT_VALUE;
+    /* OTA Upgrade client cluster attributes data */
+    ZB_MEMSET(m_dev_ctx.ota_attr.upgrade_server, 0xFF, sizeof(m_dev_ctx.ota_attr.upgrade_server));
+    m_dev_ctx.ota_attr.file_offset = ZB_ZCL_OTA_UPGRADE_FILE_OFFSET_DEF_VALUE;
+    m_dev_ctx.ota_attr.file_version = MHI_OTA_FILE_VERSION;
+    m_dev_ctx.ota_attr.stack_version = ZB_ZCL_OTA_UPGRADE_FILE_HEADER_STACK_PRO;
+    m_dev_ctx.ota_attr.downloaded_file_ver = ZB_ZCL_OTA_UPGRADE_DOWNLOADED_FILE_VERSION_DEF_VALUE;
+    m_dev_ctx.ota_attr.downloaded_stack_ver = ZB_ZCL_OTA_UPGRADE_DOWNLOADED_STACK_DEF_VALUE;
+    m_dev_ctx.ota_attr.image_status = ZB_ZCL_OTA_UPGRADE_IMAGE_STATUS_DEF_VALUE;
+    m_dev_ctx.ota_attr.manufacturer = MHI_MANUF_CODE;
+    m_dev_ctx.ota_attr.image_type = MHI_OTA_IMAGE_TYPE;
+    m_dev_ctx.ota_attr.min_block_reque = MHI_OTA_BLOCK_DELAY_MS;
+    m_dev_ctx.ota_attr.image_stamp = ZB_ZCL_OTA_UPGRADE_IMAGE_STAMP_MIN_VALUE;
+
+    /* Cluster attributes data of every unit */
+    for (uint8_t i = 0; i < MHI_UNIT_COUNT; i++)
+    {
+        mhi_unit_ctx_t *p_ctx = &m_dev_ctx.unit[i];
+
+        /* Identify cluster attributes data */
+        p_ctx->identify_attr.identify_time = ZB_ZCL_IDENTIFY_IDENTIFY_TIME_DEFAULT_VALUE;
+
+        /* Groups cluster attributes data */
+        p_ctx->groups_attr.name_support = ZB_ZCL_ATTR_GROUPS_NAME_NOT_SUPPORTED;
+
+        /* Scenes cluster attributes data, the scene table is loaded from NVRAM later */
+        p_ctx->scenes_attr.scene_count = ZB_ZCL_SCENES_SCENE_COUNT_DEFAULT_VALUE;
+        p_ctx->scenes_attr.current_scene = ZB_ZCL_SCENES_CURRENT_SCENE_DEFAULT_VALUE;
+        p_ctx->scenes_attr.current_group = ZB_ZCL_SCENES_CURRENT_GROUP_DEFAULT_VALUE;
+        p_ctx->scenes_attr.scene_valid = ZB_ZCL_SCENES_SCENE_VALID_DEFAULT_VALUE;
+        p_ctx->scenes_attr.name_support = ZB_ZCL_SCENES_NAME_SUPPORT_DEFAULT_VALUE;
 
-    /* On/Off cluster attributes data */
-    m_dev_ctx.on_off_attr.on_off = (zb_bool_t)ZB_ZCL_ON_OFF_IS_OFF;
+        /* On/Off cluster attributes data */
+        p_ctx->on_off_attr.on_off = (zb_bool_t)ZB_ZCL_ON_OFF_IS_OFF;
 
-    ZB_ZCL_SET_ATTRIBUTE(
-        MHI_ENDPOINT,
-        ZB_ZCL_CLUSTER_ID_ON_OFF,
-        ZB_ZCL_CLUSTER_SERVER_ROLE,
-        ZB_ZCL_ATTR_ON_OFF_ON_OFF_ID,
-        (zb_uint8_t *)&m_dev_ctx.on_off_attr.on_off,
-        ZB_TRUE);
+        ZB_ZCL_SET_ATTRIBUTE(
+            MHI_ENDPOINT + i,
+            ZB_ZCL_CLUSTER_ID_ON_OFF,
+            ZB_ZCL_CLUSTER_SERVER_ROLE,
+            ZB_ZCL_ATTR_ON_OFF_ON_OFF_ID,
+            (zb_uint8_t *)&p_ctx->on_off_attr.on_off,
+            ZB_TRUE);
+
+        /* Fan Control cluster attributes data */
+        p_ctx->fan_control_attr.fan_mode = ZB_ZCL_FAN_CONTROL_FAN_MODE_LOW;
+        p_ctx->fan_control_attr.fan_mode_sequence = ZB_ZCL_FAN_CONTROL_FAN_MODE_SEQUENCE_LOW_MED_HIGH;
+        p_ctx->fan_control_attr.vane = MHI_VANE_MIN;
+
+        /* Temperature Measurement cluster attributes data */
+        p_ctx->temp_measurement_attr.measure_value = ZB_ZCL_TEMP_MEASUREMENT_VALUE_UNKNOWN;
+        p_ctx->temp_measurement_attr.min_measure_value = MHI_INIT_TEMP_MIN_MEASURED_VALUE;
+        p_ctx->temp_measurement_attr.max_measure_value = MHI_INIT_TEMP_MAX_MEASURED_VALUE;
+        p_ctx->temp_measurement_attr.tolerance = MHI_INIT_TEMP_TOLERANCE;
+
+        /* Thermostat cluster attributes data */
+        p_ctx->thermostat_attr.local_temperature = ZB_ZCL_TEMP_MEASUREMENT_VALUE_UNKNOWN;
+        p_ctx->thermostat_attr.local_temperature_calibration = 0;
+        p_ctx->thermostat_attr.occupied_cooling_setpoint = ZB_ZCL_THERMOSTAT_OCCUPIED_COOLING_SETPOINT_DEFAULT_VALUE;
+        p_ctx->thermostat_attr.occupied_heating_setpoint = ZB_ZCL_THERMOSTAT_OCCUPIED_HEATING_SETPOINT_DEFAULT_VALUE;
+        p_ctx->thermostat_attr.control_seq_of_operation = ZB_ZCL_THERMOSTAT_CONTROL_SEQ_OF_OPERATION_COOLING_AND_HEATING_4PIPES;
+        p_ctx->thermostat_attr.system_mode = ZB_ZCL_THERMOSTAT_SYSTEM_MODE_OFF;
+
+        /* Diagnostics cluster attributes data, no error snapshot until the AC reports an error */
+        p_ctx->diag_attr.error_return_air_temp = ZB_ZCL_TEMP_MEASUREMENT_VALUE_UNKNOWN;
+        p_ctx->diag_attr.error_outdoor_temp = ZB_ZCL_TEMP_MEASUREMENT_VALUE_UNKNOWN;
+        p_ctx->diag_attr.error_heat_exch_temp = ZB_ZCL_TEMP_MEASUREMENT_VALUE_UNKNOWN;
+        p_ctx->diag_attr.error_current = MHI_ATTR_DIAG_ERROR_RAW_NONE;
+        p_ctx->diag_attr.error_comp_freq = MHI_ATTR_DIAG_ERROR_RAW_NONE;
+
+        /* Metering cluster attributes data, Wh and W shown as kWh and kW with 3 decimals; the
+         * total is loaded from NVRAM later */
+        p_ctx->metering_attr.unit_of_measure = ZB_ZCL_METERING_UNIT_KW_KWH_BINARY;
+        p_ctx->metering_attr.multiplier.low = 1;
+        p_ctx->metering_attr.divisor.low = 1000;
+        p_ctx->metering_attr.summation_formatting = MHI_METERING_FORMATTING;
+        p_ctx->metering_attr.metering_device_type = ZB_ZCL_METERING_ELECTRIC_METERING;
+        p_ctx->metering_attr.demand_formatting = MHI_METERING_FORMATTING;
+    }
 }
 
 /**
@@ -253,11 +1164,13 @@ static void mhi_clusters_attr_init(void)
  */
 static zb_void_t zcl_device_cb(zb_bufid_t bufid)
 {
-    zb_uint8_t cluster_id;
-    zb_uint8_t attr_id;
+    zb_uint16_t cluster_id;
+    zb_uint16_t attr_id;
+    uint32_t value;
+    uint8_t unit;
     zb_zcl_device_callback_param_t *p_device_cb_param = ZB_BUF_GET_PARAM(bufid, zb_zcl_device_callback_param_t);
 
-    NRF_LOG_INFO("zcl_device_cb id %hd", p_device_cb_param->device_cb_id);
+    MHI_LOG_INFO("zcl_device_cb id %hd", p_device_cb_param->device_cb_id);
 
     /* Set default response value. */
     p_device_cb_param->status = RET_OK;
@@ -268,21 +1181,29 @@ static zb_void_t zcl_device_cb(zb_bufid_t bufid)
         cluster_id = p_device_cb_param->cb_param.set_attr_value_param.cluster_id;
         attr_id = p_device_cb_param->cb_param.set_attr_value_param.attr_id;
 
-        if (cluster_id == ZB_ZCL_CLUSTER_ID_ON_OFF)
+        /* The setpoints are the only 16-bit attributes that can be written */
+        if (cluster_id == ZB_ZCL_CLUSTER_ID_THERMOSTAT &&
+            (attr_id == ZB_ZCL_ATTR_THERMOSTAT_OCCUPIED_COOLING_SETPOINT_ID ||
+             attr_id == ZB_ZCL_ATTR_THERMOSTAT_OCCUPIED_HEATING_SETPOINT_ID))
         {
-            uint8_t value = p_device_cb_param->cb_param.set_attr_value_param.values.data8;
-
-            NRF_LOG_INFO("on/off attribute setting to %hd", value);
-            if (attr_id == ZB_ZCL_ATTR_ON_OFF_ON_OFF_ID)
-            {
-                on_off_set_value((zb_bool_t)value);
-            }
+            value = (zb_uint16_t)p_device_cb_param->cb_param.set_attr_value_param.values.data16;
         }
         else
         {
-            /* Other clusters can be processed here */
-            NRF_LOG_INFO("Unhandled cluster (%d) attribute (%d)", cluster_id, attr_id);
+            value = p_device_cb_param->cb_param.set_attr_value_param.values.data8;
         }
+
+        unit = unit_index(p_device_cb_param->endpoint);
+        MHI_LOG_INFO("Attribute write unit %d cluster (%d) attribute (%d) value %d", unit, cluster_id, attr_id, value);
+        if (unit == MHI_UNIT_COUNT || !mhi_unit_zcl_write(&m_units[unit], cluster_id, attr_id, value))
+        {
+            p_device_cb_param->status = RET_ERROR;
+        }
+        break;
+
+    case ZB_ZCL_OTA_UPGRADE_VALUE_CB_ID:
+        p_device_cb_param->cb_param.ota_value_param.upgrade_status =
+            mhi_ota_nrf_handle(&p_device_cb_param->cb_param.ota_value_param);
         break;
 
     default:
@@ -290,20 +1211,338 @@ static zb_void_t zcl_device_cb(zb_bufid_t bufid)
         break;
     }
 
-    NRF_LOG_INFO("zcl_device_cb status: %hd", p_device_cb_param->status);
+    MHI_LOG_INFO("zcl_device_cb status: %hd", p_device_cb_param->status);
 }
 
 /**
- * @brief SPIS user event handler.
- *
- * @param event
+ * @brief Attribute report callback, takes the measured value of a bound remote temperature
+ * sensor as the room temperature of the unit on the receiving endpoint.
+ * @param p_addr Address of the reporting device
+ * @param ep Receiving endpoint
+ * @param cluster_id Cluster of the reported attribute
+ * @param attr_id Reported attribute
+ * @param attr_type Type of the reported attribute
+ * @param p_value Reported value
  */
-void spis_event_handler(nrf_drv_spis_event_t event)
+static void report_attr_cb(zb_zcl_addr_t *p_addr, zb_uint8_t ep, zb_uint16_t cluster_id, zb_uint16_t attr_id,
+                           zb_uint8_t attr_type, zb_uint8_t *p_value)
 {
+    uint8_t unit = unit_index(ep);
+    zb_int16_t temperature;
+
+    UNUSED_PARAMETER(p_addr);
+
+    if (unit == MHI_UNIT_COUNT || cluster_id != ZB_ZCL_CLUSTER_ID_TEMP_MEASUREMENT ||
+        attr_id != ZB_ZCL_ATTR_TEMP_MEASUREMENT_VALUE_ID || attr_type != ZB_ZCL_ATTR_TYPE_S16)
+    {
+        return;
+    }
+
+    ZB_MEMCPY(&temperature, p_value, sizeof(temperature));
+    MHI_LOG_INFO("Remote temperature %d for unit %d", temperature, unit);
+    mhi_unit_remote_temp(&m_units[unit], temperature);
+}
+
+/**
+ * @brief Start the DWT cycle counter that times the transfer handling.
+ */
+static void cycle_counter_init(void)
+{
+    CoreDebug->DEMCR |= CoreDebug_DEMCR_TRCENA_Msk;
+    DWT->CYCCNT = 0;
+    DWT->CTRL |= DWT_CTRL_CYCCNTENA_Msk;
+}
+
+/**
+ * @brief app_timer ticks of a transfer, app_timer_cnt_get without the call into flash:
+ * app_timer2 counts on RTC1.
+ */
+static inline uint32_t xfer_ticks(void)
+{
+    return nrf_rtc_counter_get(NRF_RTC1);
+}
+
+/**
+ * @brief Account a transfer handling of a unit.
+ * @param unit Index of the unit
+ * @param start DWT cycle counter at the start of the handling
+ */
+static inline void xfer_cycles_add(uint8_t unit, uint32_t start)
+{
+    xfer_cycles_t *p_cycles = &m_xfer_cycles[unit];
+    uint32_t cycles = DWT->CYCCNT - start;
+
+    p_cycles->max = cycles > p_cycles->max ? cycles : p_cycles->max;
+    p_cycles->sum += cycles;
+    p_cycles->count++;
+}
+
+/**
+ * @brief SPIS user event handling of a unit. Runs from RAM, see mhi_ramfunc.h.
+ * @param unit Index of the unit
+ * @param event SPIS event
+ */
+static MHI_RAMFUNC void spis_event_handle(uint8_t unit, nrf_drv_spis_event_t event)
+{
+#if MHI_SPIS_NRF_REARM
+    /* The transfers are polled, see spis_poll */
+    if (event.evt_type == NRF_DRV_SPIS_BUFFERS_SET_DONE)
+    {
+        mhi_spis_nrf_rearm_start(unit);
+    }
+#else
     if (event.evt_type == NRF_DRV_SPIS_XFER_DONE)
     {
-        NRF_LOG_INFO("SPI data received!");
-        NRF_LOG_HEXDUMP_INFO(m_rx_buf, MHI_SPI_MSG_SIZE);
+        uint32_t cycles = DWT->CYCCNT;
+        uint32_t ticks = xfer_ticks();
+        uint32_t start_us;
+        uint32_t end_us;
+
+        /* Captured by the hardware, before the next CSN fall overwrites them */
+        mhi_timing_nrf_read(unit, &start_us, &end_us);
+        mhi_timing_capture(&m_units[unit].timing, start_us, end_us);
+        mhi_sched_on_xfer(&m_sched, unit, ticks);
+        mhi_unit_on_xfer_done(&m_units[unit], m_rx_buf[unit], event.rx_amount, ticks, m_tx_buf[unit]);
+        APP_ERROR_CHECK(nrf_drv_spis_buffers_set(&m_unit_spis[unit].spis, m_tx_buf[unit], sizeof(m_tx_buf[unit]),
+                                                 m_rx_buf[unit], sizeof(m_rx_buf[unit])));
+        xfer_cycles_add(unit, cycles);
+    }
+#endif
+}
+
+#if MHI_SPIS_NRF_REARM
+/**
+ * @brief Hand over the last transfer of a unit whose SPIS re-arms itself, unless the next
+ * transfer has started and is overwriting the buffers.
+ * @param unit Index of the unit
+ */
+static void spis_poll(uint8_t unit)
+{
+    NRF_SPIS_Type *p_reg = m_unit_spis[unit].spis.p_reg;
+    uint8_t rx_buf[MHI_FRAME_SIZE_EXT];
+    uint8_t *p_tx = m_p_tx_idle[unit];
+    size_t rx_len;
+    uint32_t start_us;
+    uint32_t end_us;
+    uint32_t check_start_us;
+    uint32_t check_end_us;
+    uint32_t cycles;
+    uint32_t ticks;
+
+    /* Nothing new, or CSN fell after the last end */
+    mhi_timing_nrf_read(unit, &start_us, &end_us);
+    if (end_us == m_spis_end_us[unit] || (int32_t)(start_us - end_us) > 0)
+    {
+        return;
+    }
+
+    rx_len = nrf_spis_rx_amount_get(p_reg);
+    memcpy(rx_buf, m_rx_buf[unit], sizeof(rx_buf));
+    mhi_timing_nrf_read(unit, &check_start_us, &check_end_us);
+    if (check_start_us != start_us)
+    {
+        /* Overwritten while copying, the next poll takes the new transfer */
+        return;
+    }
+    m_spis_end_us[unit] = end_us;
+
+    cycles = DWT->CYCCNT;
+    ticks = xfer_ticks();
+    mhi_timing_capture(&m_units[unit].timing, start_us, end_us);
+    mhi_sched_on_xfer(&m_sched, unit, ticks);
+    mhi_unit_on_xfer_done(&m_units[unit], rx_buf, rx_len, ticks, p_tx);
+
+    /* The next frame is staged in the buffer the DMA does not read, then swapped in while the
+     * CPU holds the semaphore. A transfer that ended meanwhile sent the previous frame. */
+    mhi_spis_nrf_acquire(unit, p_reg);
+    nrf_spis_tx_buffer_set(p_reg, p_tx, MHI_FRAME_SIZE_EXT);
+    mhi_timing_nrf_read(unit, &check_start_us, &check_end_us);
+    mhi_spis_nrf_release(unit, p_reg);
+    m_p_tx_idle[unit] = p_tx == m_tx_buf[unit] ? m_tx_spare[unit] : m_tx_buf[unit];
+    if (check_end_us != end_us)
+    {
+        m_tx_late[unit]++;
+    }
+    xfer_cycles_add(unit, cycles);
+}
+#endif
+
+/**
+ * @brief SPIS user event handler of the first unit.
+ * @param event SPIS event
+ */
+static void spis_event_handler_0(nrf_drv_spis_event_t event)
+{
+    spis_event_handle(0, event);
+}
+
+#if MHI_UNIT_COUNT > 1
+/**
+ * @brief SPIS user event handler of the second unit.
+ * @param event SPIS event
+ */
+static void spis_event_handler_1(nrf_drv_spis_event_t event)
+{
+    spis_event_handle(1, event);
+}
+#endif
+
+#if MHI_UNIT_COUNT > 2
+/**
+ * @brief SPIS user event handler of the third unit.
+ * @param event SPIS event
+ */
+static void spis_event_handler_2(nrf_drv_spis_event_t event)
+{
+    spis_event_handle(2, event);
+}
+#endif
+
+/**
+ * @brief Initialize a unit and its SPIS instance, the first transfer sends its staged TX frame.
+ * @param unit Index of the unit
+ */
+static void unit_spis_init(uint8_t unit)
+{
+    const unit_spis_t *p_spis = &m_unit_spis[unit];
+    nrf_drv_spis_config_t spis_config = NRF_DRV_SPIS_DEFAULT_CONFIG;
+
+    mhi_unit_init(&m_units[unit], MHI_ENDPOINT + unit);
+    spis_config.miso_pin = p_spis->miso_pin;
+    spis_config.mosi_pin = p_spis->mosi_pin;
+    spis_config.sck_pin = p_spis->sck_pin;
+    spis_config.csn_pin = p_spis->csn_pin;
+    spis_config.mode = NRF_SPIS_MODE_3;
+    APP_ERROR_CHECK(nrf_drv_spis_init(&p_spis->spis, &spis_config, p_spis->handler));
+    mhi_timing_nrf_unit_init(unit, p_spis->csn_pin, p_spis->spis.p_reg);
+#if MHI_SPIS_NRF_REARM
+    mhi_spis_nrf_rearm_init(unit, p_spis->spis.p_reg);
+    m_p_tx_idle[unit] = m_tx_spare[unit];
+#endif
+    memset(m_rx_buf[unit], 0, sizeof(m_rx_buf[unit]));
+    mhi_link_tx_get(&m_units[unit].link, m_tx_buf[unit]);
+    APP_ERROR_CHECK(nrf_drv_spis_buffers_set(&p_spis->spis, m_tx_buf[unit], sizeof(m_tx_buf[unit]),
+                                             m_rx_buf[unit], sizeof(m_rx_buf[unit])));
+}
+
+/**
+ * @brief Collect the scene tables of all units.
+ * @param pp_tables MHI_UNIT_COUNT table pointers
+ */
+static void scene_tables_get(mhi_scene_table_t **pp_tables)
+{
+    for (uint8_t i = 0; i < MHI_UNIT_COUNT; i++)
+    {
+        pp_tables[i] = &m_units[i].scenes;
+    }
+}
+
+/**
+ * @brief Size of the application dataset, the scene tables as they are now.
+ */
+static zb_uint16_t scenes_nvram_size(void)
+{
+    mhi_scene_table_t *p_tables[MHI_UNIT_COUNT];
+
+    scene_tables_get(p_tables);
+
+    return (zb_uint16_t)mhi_scene_save_size(p_tables, MHI_UNIT_COUNT);
+}
+
+/**
+ * @brief Write the application dataset, called by the stack when it saves it.
+ */
+static zb_ret_t scenes_nvram_write(zb_uint8_t page, zb_uint32_t pos)
+{
+    mhi_scene_table_t *p_tables[MHI_UNIT_COUNT];
+    size_t len;
+
+    scene_tables_get(p_tables);
+    len = mhi_scene_save(p_tables, MHI_UNIT_COUNT, m_scene_nvram);
+
+    return zb_nvram_write_data(page, pos, m_scene_nvram, (zb_uint16_t)len);
+}
+
+/**
+ * @brief Read the application dataset, called by the stack when it starts.
+ */
+static zb_void_t scenes_nvram_read(zb_uint8_t page, zb_uint32_t pos, zb_uint16_t payload_length)
+{
+    mhi_scene_table_t *p_tables[MHI_UNIT_COUNT];
+
+    if (payload_length > sizeof(m_scene_nvram) ||
+        zb_nvram_read_data(page, pos, m_scene_nvram, payload_length) != RET_OK)
+    {
+        MHI_LOG_WARNING("Scene tables not read, %d bytes", payload_length);
+        return;
+    }
+
+    scene_tables_get(p_tables);
+    if (!mhi_scene_load(p_tables, MHI_UNIT_COUNT, m_scene_nvram, payload_length))
+    {
+        MHI_LOG_WARNING("Scene tables of another layout dropped");
+    }
+    for (uint8_t i = 0; i < MHI_UNIT_COUNT; i++)
+    {
+        mhi_zcl_publish_scenes(m_units[i].endpoint, p_tables[i]);
+    }
+}
+
+/**
+ * @brief Collect the energy accumulators of all units.
+ * @param pp_energy MHI_UNIT_COUNT accumulator pointers
+ */
+static void energy_get(mhi_energy_t **pp_energy)
+{
+    for (uint8_t i = 0; i < MHI_UNIT_COUNT; i++)
+    {
+        pp_energy[i] = &m_units[i].energy;
+    }
+}
+
+/**
+ * @brief Size of the second application dataset.
+ */
+static zb_uint16_t energy_nvram_size(void)
+{
+    return sizeof(m_energy_nvram);
+}
+
+/**
+ * @brief Write the second application dataset, called by the stack when it saves it.
+ */
+static zb_ret_t energy_nvram_write(zb_uint8_t page, zb_uint32_t pos)
+{
+    mhi_energy_t *p_energy[MHI_UNIT_COUNT];
+
+    energy_get(p_energy);
+    (void)mhi_energy_save(p_energy, MHI_UNIT_COUNT, m_energy_nvram);
+
+    return zb_nvram_write_data(page, pos, m_energy_nvram, sizeof(m_energy_nvram));
+}
+
+/**
+ * @brief Read the second application dataset, called by the stack when it starts.
+ */
+static zb_void_t energy_nvram_read(zb_uint8_t page, zb_uint32_t pos, zb_uint16_t payload_length)
+{
+    mhi_energy_t *p_energy[MHI_UNIT_COUNT];
+
+    if (payload_length > sizeof(m_energy_nvram) ||
+        zb_nvram_read_data(page, pos, m_energy_nvram, payload_length) != RET_OK)
+    {
+        MHI_LOG_WARNING("Energy totals not read, %d bytes", payload_length);
+        return;
+    }
+
+    energy_get(p_energy);
+    if (!mhi_energy_load(p_energy, MHI_UNIT_COUNT, m_energy_nvram, payload_length))
+    {
+        MHI_LOG_WARNING("Energy totals of another layout dropped");
+    }
+    for (uint8_t i = 0; i < MHI_UNIT_COUNT; i++)
+    {
+        mhi_zcl_publish_energy(m_units[i].endpoint, p_energy[i]);
     }
 }
 
@@ -320,25 +1559,31 @@ int main(void)
     // (when the CPU is in sleep mode).
     NRF_POWER->TASKS_CONSTLAT = 1;
 
+    /* The transfer handling runs from RAM */
+    mhi_ramfunc_init();
+    cycle_counter_init();
+
+    /* Paint the free stack for the high-water mark */
+    mhi_stack_paint();
+    m_stack_unused = mhi_stack_size();
+
     /* Initialize timers, loging system and GPIOs. */
     timers_init();
     log_init();
     leds_buttons_init();
 
     /* Log booting message */
-    NRF_LOG_INFO("Booting...");
-    NRF_LOG_FLUSH();
+    MHI_LOG_INFO("Booting...");
+    log_flush();
     bsp_board_leds_on();
 
-    // Setup SPI
-    nrf_drv_spis_config_t spis_config = NRF_DRV_SPIS_DEFAULT_CONFIG;
-    spis_config.miso_pin = APP_SPIS_MISO_PIN;
-    spis_config.mosi_pin = APP_SPIS_MOSI_PIN;
-    spis_config.sck_pin = APP_SPIS_SCK_PIN;
-    spis_config.mode = NRF_SPIS_MODE_3;
-    APP_ERROR_CHECK(nrf_drv_spis_init(&spis, &spis_config, spis_event_handler));
-    memset(m_tx_buf, 0, sizeof(m_tx_buf));
-    memset(m_rx_buf, 0, sizeof(m_tx_buf));
+    // Setup SPI, one SPIS instance per unit, with hardware timestamps of the transfers
+    mhi_sched_init(&m_sched, MHI_UNIT_COUNT);
+    mhi_timing_nrf_init();
+    for (uint8_t i = 0; i < MHI_UNIT_COUNT; i++)
+    {
+        unit_spis_init(i);
+    }
 
     // Wait and disable LEDs
     nrf_delay_ms(500);
@@ -361,8 +1606,8 @@ int main(void)
 
     if (bsp_button_is_pressed(BSP_BOARD_BUTTON_1))
     {
-        NRF_LOG_INFO("Resetting ZIGBEE persistent storage...");
-        NRF_LOG_FLUSH();
+        MHI_LOG_INFO("Resetting ZIGBEE persistent storage...");
+        log_flush();
 
         /** Erase NVRAM to clear the network parameters */
         zigbee_erase_persistent_storage(ZB_TRUE);
@@ -379,17 +1624,46 @@ int main(void)
 
     /* Register dimmer switch device context (endpoints). */
     ZB_AF_REGISTER_DEVICE_CTX(&mhi_ctx);
+    for (uint8_t i = 0; i < MHI_UNIT_COUNT; i++)
+    {
+        ZB_AF_SET_ENDPOINT_HANDLER(MHI_ENDPOINT + i, ep_handler);
+    }
+
+    /* Register callback for the reports of a bound remote temperature sensor. */
+    ZB_ZCL_SET_REPORT_ATTR_CB(report_attr_cb);
 
     mhi_clusters_attr_init();
+    mhi_ota_nrf_init(MHI_OTA_FILE_VERSION, &m_sched);
+
+    /* Register the scene tables and energy totals as application datasets, the stack reads them
+     * when it starts. */
+    zb_nvram_register_app1_read_cb(scenes_nvram_read);
+    zb_nvram_register_app1_write_cb(scenes_nvram_write, scenes_nvram_size);
+    zb_nvram_register_app2_read_cb(energy_nvram_read);
+    zb_nvram_register_app2_write_cb(energy_nvram_write, energy_nvram_size);
 
     /** Start Zigbee Stack. */
     zb_err_code = zboss_start_no_autostart();
     ZB_ERROR_CHECK(zb_err_code);
-    NRF_LOG_FLUSH();
+    log_flush();
 
     while (1)
     {
         zboss_main_loop_iteration();
-        UNUSED_RETURN_VALUE(NRF_LOG_PROCESS());
+#if MHI_SPIS_NRF_REARM
+        for (uint8_t i = 0; i < MHI_UNIT_COUNT; i++)
+        {
+            spis_poll(i);
+        }
+#endif
+        unit_process();
+        stack_process();
+        diag_process();
+        mhi_sched_run(&m_sched);
+        UNUSED_RETURN_VALUE(log_process());
+#if MHI_CLI_ENABLED
+        /* The commands run here, outside the SPIS interrupt */
+        nrf_cli_process(&m_cli_uart);
+#endif
     }
 }
@@ -0,0 +1,266 @@
+/**
+ * @file mhi_ota_nrf.c
+ * @brief OTA Upgrade client glue for the nRF52840: secondary flash slot and image swap
+ */
+
+#include "app_util_platform.h"
+#include "nrf.h"
+#include "nrf_fstorage.h"
+#include "nrf_fstorage_nvmc.h"
+#include "nrf_log_ctrl.h"
+
+#include "include/mhi_log.h"
+#include "include/mhi_ota.h"
+#include "include/mhi_ota_nrf.h"
+
+#define FLASH_PAGE_SIZE 4096
+#define FLASH_ERASE_MS 85 /**< Page erase time, tERASEPAGE. */
+#define ERASE_PULSES ((FLASH_ERASE_MS + MHI_OTA_NRF_ERASE_STEP_MS - 1) / MHI_OTA_NRF_ERASE_STEP_MS)
+
+/* Provided by the linker script */
+extern uint32_t __mhi_app_start[];
+extern uint32_t __mhi_ota_slot_start[];
+extern uint32_t __mhi_ota_slot_end[];
+
+static void fstorage_evt_handler(nrf_fstorage_evt_t *p_evt);
+
+NRF_FSTORAGE_DEF(nrf_fstorage_t m_fstorage) = {
+    .evt_handler = fstorage_evt_handler,
+};
+
+static bool flash_erase(uint32_t offset);
+static bool flash_write(uint32_t offset, const void *p_data, uint32_t len);
+static bool flash_read(uint32_t offset, void *p_data, uint32_t len);
+
+static mhi_ota_flash_t m_flash = {
+    .page_size = FLASH_PAGE_SIZE,
+    .p_erase = flash_erase,
+    .p_write = flash_write,
+    .p_read = flash_read,
+};
+
+static mhi_ota_t m_ota;
+static zb_uint32_t m_file_version;
+static volatile ret_code_t m_flash_result;
+
+/* Erase of the slot ahead of the download, in partial erases between the SPI frames */
+static mhi_sched_t *mp_sched;
+static uint32_t m_erased;        /* Slot offset below which the pages are erased */
+static uint32_t m_erase_end;     /* Slot offset up to which the download needs erased pages */
+static uint32_t m_erase_pulses;  /* Partial erases of the page at m_erased */
+static uint32_t m_erase_misses;  /* Pages the download reached before they were erased */
+
+static void fstorage_evt_handler(nrf_fstorage_evt_t *p_evt)
+{
+    m_flash_result = p_evt->result;
+}
+
+/**
+ * @brief Wait for the flash operation started with the given result code.
+ */
+static bool flash_wait(ret_code_t err_code)
+{
+    if (err_code != NRF_SUCCESS)
+    {
+        return false;
+    }
+
+    /* The NVMC backend completes synchronously, this only matters with a SoftDevice */
+    while (nrf_fstorage_is_busy(&m_fstorage))
+    {
+    }
+
+    return m_flash_result == NRF_SUCCESS;
+}
+
+/**
+ * @brief Erase the next page of the slot for part of the page erase time, one step of the erase
+ * job. The CPU stalls for MHI_OTA_NRF_ERASE_STEP_MS.
+ * @return true when the slot is erased up to m_erase_end
+ */
+static bool erase_step(void *p_context)
+{
+    UNUSED_PARAMETER(p_context);
+
+    if (m_erased >= m_erase_end)
+    {
+        return true;
+    }
+
+    NRF_NVMC->CONFIG = NVMC_CONFIG_WEN_Een << NVMC_CONFIG_WEN_Pos;
+    NRF_NVMC->ERASEPAGEPARTIALCFG = MHI_OTA_NRF_ERASE_STEP_MS;
+    NRF_NVMC->ERASEPAGEPARTIAL = m_fstorage.start_addr + m_erased;
+    while (NRF_NVMC->READY == NVMC_READY_READY_Busy)
+    {
+    }
+    NRF_NVMC->CONFIG = NVMC_CONFIG_WEN_Ren << NVMC_CONFIG_WEN_Pos;
+
+    if (++m_erase_pulses == ERASE_PULSES)
+    {
+        m_erased += FLASH_PAGE_SIZE;
+        m_erase_pulses = 0;
+    }
+
+    return m_erased >= m_erase_end;
+}
+
+/**
+ * @brief Erase a page of the slot, nothing to do when the erase job got there first.
+ */
+static bool flash_erase(uint32_t offset)
+{
+    if (offset < m_erased)
+    {
+        return true;
+    }
+
+    /* The download caught up with the erase job, erase at once and let the job skip the page */
+    m_erase_misses++;
+    if (!flash_wait(nrf_fstorage_erase(&m_fstorage, m_fstorage.start_addr + offset, 1, NULL)))
+    {
+        return false;
+    }
+    if (offset == m_erased)
+    {
+        m_erased += FLASH_PAGE_SIZE;
+        m_erase_pulses = 0;
+    }
+
+    return true;
+}
+
+static bool flash_write(uint32_t offset, const void *p_data, uint32_t len)
+{
+    return flash_wait(nrf_fstorage_write(&m_fstorage, m_fstorage.start_addr + offset, p_data, len, NULL));
+}
+
+static bool flash_read(uint32_t offset, void *p_data, uint32_t len)
+{
+    return nrf_fstorage_read(&m_fstorage, m_fstorage.start_addr + offset, p_data, len) == NRF_SUCCESS;
+}
+
+/**
+ * @brief Copy the slot over the application and reset.
+ *
+ * Placed in .data so that it is copied to RAM at startup: the flash it runs from is erased
+ * while it runs. It must not call any function.
+ */
+__attribute__((noinline, noreturn, long_call, section(".data.mhi_ota_swap")))
+static void swap(volatile uint32_t *p_dst, const uint32_t *p_src, uint32_t words)
+{
+    for (uint32_t i = 0; i < words; i++)
+    {
+        if (((uint32_t)&p_dst[i] & (FLASH_PAGE_SIZE - 1)) == 0)
+        {
+            NRF_NVMC->CONFIG = NVMC_CONFIG_WEN_Een << NVMC_CONFIG_WEN_Pos;
+            NRF_NVMC->ERASEPAGE = (uint32_t)&p_dst[i];
+            while (NRF_NVMC->READY == NVMC_READY_READY_Busy)
+            {
+            }
+        }
+
+        NRF_NVMC->CONFIG = NVMC_CONFIG_WEN_Wen << NVMC_CONFIG_WEN_Pos;
+        p_dst[i] = p_src[i];
+        while (NRF_NVMC->READY == NVMC_READY_READY_Busy)
+        {
+        }
+    }
+
+    NRF_NVMC->CONFIG = NVMC_CONFIG_WEN_Ren << NVMC_CONFIG_WEN_Pos;
+    SCB->AIRCR = (0x5FAUL << SCB_AIRCR_VECTKEY_Pos) | SCB_AIRCR_SYSRESETREQ_Msk;
+
+    for (;;)
+    {
+    }
+}
+
+/**
+ * @brief Queue the erase of the slot pages a file of the given length needs.
+ */
+static void erase_start(uint32_t file_length)
+{
+    uint32_t end = (file_length + FLASH_PAGE_SIZE - 1) & ~(FLASH_PAGE_SIZE - 1UL);
+
+    m_erased = 0;
+    m_erase_pulses = 0;
+    m_erase_misses = 0;
+    m_erase_end = end < m_flash.slot_size ? end : m_flash.slot_size;
+    if (!mhi_sched_submit(mp_sched, erase_step, NULL, MHI_OTA_NRF_ERASE_STEP_MS * 1000 + MHI_OTA_NRF_ERASE_SLACK_US))
+    {
+        /* Every page is erased as the download enters it */
+        m_erase_end = 0;
+    }
+}
+
+void mhi_ota_nrf_init(zb_uint32_t file_version, mhi_sched_t *p_sched)
+{
+    m_file_version = file_version;
+    mp_sched = p_sched;
+
+    m_fstorage.start_addr = (uint32_t)__mhi_ota_slot_start;
+    m_fstorage.end_addr = (uint32_t)__mhi_ota_slot_end;
+    m_flash.slot_size = m_fstorage.end_addr - m_fstorage.start_addr;
+
+    APP_ERROR_CHECK(nrf_fstorage_init(&m_fstorage, &nrf_fstorage_nvmc, NULL));
+}
+
+zb_uint8_t mhi_ota_nrf_handle(zb_zcl_ota_upgrade_value_param_t *p_param)
+{
+    switch (p_param->upgrade_status)
+    {
+    case ZB_ZCL_OTA_UPGRADE_STATUS_START:
+        /* Downgrades are refused */
+        if (p_param->upgrade.start.file_version <= m_file_version ||
+            mhi_ota_start(&m_ota, &m_flash, p_param->upgrade.start.file_length) != MHI_OTA_OK)
+        {
+            return ZB_ZCL_OTA_UPGRADE_STATUS_ABORT;
+        }
+        erase_start(p_param->upgrade.start.file_length);
+        return ZB_ZCL_OTA_UPGRADE_STATUS_OK;
+
+    case ZB_ZCL_OTA_UPGRADE_STATUS_RECEIVE:
+        switch (mhi_ota_block(&m_ota,
+                              p_param->upgrade.receive.file_offset,
+                              p_param->upgrade.receive.block_data,
+                              p_param->upgrade.receive.data_length))
+        {
+        case MHI_OTA_OK:
+            return ZB_ZCL_OTA_UPGRADE_STATUS_OK;
+        case MHI_OTA_ERR_OFFSET:
+            return ZB_ZCL_OTA_UPGRADE_STATUS_ERROR;
+        default:
+            return ZB_ZCL_OTA_UPGRADE_STATUS_ABORT;
+        }
+
+    case ZB_ZCL_OTA_UPGRADE_STATUS_CHECK:
+        return mhi_ota_verify(&m_ota) == MHI_OTA_OK ? ZB_ZCL_OTA_UPGRADE_STATUS_OK : ZB_ZCL_OTA_UPGRADE_STATUS_ERROR;
+
+    case ZB_ZCL_OTA_UPGRADE_STATUS_APPLY:
+        return ZB_ZCL_OTA_UPGRADE_STATUS_OK;
+
+    case ZB_ZCL_OTA_UPGRADE_STATUS_FINISH:
+        if (mhi_ota_verify(&m_ota) != MHI_OTA_OK)
+        {
+            return ZB_ZCL_OTA_UPGRADE_STATUS_ERROR;
+        }
+
+        MHI_LOG_INFO("Pages erased during the download: %d", m_erase_misses);
+        MHI_LOG_INFO("Installing the new firmware...");
+        NRF_LOG_FINAL_FLUSH();
+
+        CRITICAL_REGION_ENTER();
+        swap(__mhi_app_start, (const uint32_t *)m_fstorage.start_addr, (m_ota.image_size + 3) / 4);
+        CRITICAL_REGION_EXIT();
+        return ZB_ZCL_OTA_UPGRADE_STATUS_OK;
+
+    case ZB_ZCL_OTA_UPGRADE_STATUS_ABORT:
+        MHI_LOG_WARNING("OTA upgrade aborted");
+        mhi_sched_cancel(mp_sched, erase_step, NULL);
+        m_erase_end = 0;
+        mhi_ota_abort(&m_ota);
+        return ZB_ZCL_OTA_UPGRADE_STATUS_OK;
+
+    default:
+        return ZB_ZCL_OTA_UPGRADE_STATUS_OK;
+    }
+}
@@ -0,0 +1,28 @@
+/**
+ * @file mhi_ramfunc.c
+ * @brief Hot code run from RAM for the nRF52840
+ */
+
+#include <stdint.h>
+#include <string.h>
+
+#include "nrf.h"
+
+#include "include/mhi_ramfunc.h"
+
+/* Provided by the linker script */
+extern uint8_t __start_ramfunc[];
+extern uint8_t __stop_ramfunc[];
+extern const uint8_t __load_ramfunc[];
+
+void mhi_ramfunc_init(void)
+{
+    /* The startup code only copies .data, from __etext to __data_start__, symbols the SDK's
+     * nrf_common.ld defines inside .data itself, so an inserted section cannot join that copy.
+     * Naming the code .data.* instead would give it write flags, so it is copied here. */
+    memcpy(__start_ramfunc, __load_ramfunc, (size_t)(__stop_ramfunc - __start_ramfunc));
+
+    /* The copy is complete before the first instruction is fetched from it */
+    __DSB();
+    __ISB();
+}
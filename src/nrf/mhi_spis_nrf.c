@@ -0,0 +1,55 @@
+/**
+ * @file mhi_spis_nrf.c
+ * @brief SPIS re-arming without the CPU for the nRF52840
+ */
+
+#include "app_error.h"
+#include "nrf_drv_ppi.h"
+#include "nrf_ppi.h"
+#include "nrf_spis.h"
+
+#include "include/mhi_spis_nrf.h"
+
+static nrf_ppi_channel_t m_channels[MHI_SPIS_NRF_UNITS_MAX];
+
+void mhi_spis_nrf_rearm_init(uint8_t unit, NRF_SPIS_Type *p_spis)
+{
+    ret_code_t err_code;
+
+    ASSERT(unit < MHI_SPIS_NRF_UNITS_MAX);
+
+    err_code = nrf_drv_ppi_init();
+    if (err_code != NRF_ERROR_MODULE_ALREADY_INITIALIZED)
+    {
+        APP_ERROR_CHECK(err_code);
+    }
+
+    APP_ERROR_CHECK(nrf_drv_ppi_channel_alloc(&m_channels[unit]));
+    APP_ERROR_CHECK(nrf_drv_ppi_channel_assign(m_channels[unit],
+                                               nrf_spis_event_address_get(p_spis, NRF_SPIS_EVENT_ACQUIRED),
+                                               nrf_spis_task_address_get(p_spis, NRF_SPIS_TASK_RELEASE)));
+}
+
+void mhi_spis_nrf_rearm_start(uint8_t unit)
+{
+    /* Interrupt context, only sets the channel bit */
+    nrf_ppi_channel_enable(m_channels[unit]);
+}
+
+void mhi_spis_nrf_acquire(uint8_t unit, NRF_SPIS_Type *p_spis)
+{
+    /* Without the channel ACQUIRED no longer hands the semaphore straight back. SEMSTAT is
+     * polled rather than the event, which the driver interrupt clears. */
+    nrf_ppi_channel_disable(m_channels[unit]);
+    nrf_spis_task_trigger(p_spis, NRF_SPIS_TASK_ACQUIRE);
+    while (nrf_spis_semaphore_status_get(p_spis) != NRF_SPIS_SEMSTAT_CPU)
+    {
+        /* A transfer that started keeps the semaphore until its END */
+    }
+}
+
+void mhi_spis_nrf_release(uint8_t unit, NRF_SPIS_Type *p_spis)
+{
+    nrf_spis_task_trigger(p_spis, NRF_SPIS_TASK_RELEASE);
+    nrf_ppi_channel_enable(m_channels[unit]);
+}
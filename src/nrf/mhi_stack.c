@@ -0,0 +1,41 @@
+/**
+ * @file mhi_stack.c
+ * @brief Stack high-water mark for the nRF52840
+ */
+
+#include "nrf.h"
+
+#include "include/mhi_stack.h"
+
+/* Provided by nrf_common.ld */
+extern uint32_t __StackLimit[];
+extern uint32_t __StackTop[];
+
+void mhi_stack_paint(void)
+{
+    uint32_t *p_word = __StackLimit;
+    uint32_t *p_end = (uint32_t *)(uintptr_t)(__get_MSP() - MHI_STACK_PAINT_MARGIN);
+
+    while (p_word < p_end)
+    {
+        *p_word++ = MHI_STACK_PAINT;
+    }
+}
+
+uint32_t mhi_stack_size(void)
+{
+    return (uint32_t)((uintptr_t)__StackTop - (uintptr_t)__StackLimit);
+}
+
+uint32_t mhi_stack_unused(void)
+{
+    const uint32_t *p_word = __StackLimit;
+
+    /* The stack grows down, the untouched words are at the bottom */
+    while (p_word < __StackTop && *p_word == MHI_STACK_PAINT)
+    {
+        p_word++;
+    }
+
+    return (uint32_t)((uintptr_t)p_word - (uintptr_t)__StackLimit);
+}
@@ -0,0 +1,96 @@
+/**
+ * @file mhi_timing_nrf.c
+ * @brief Hardware timestamps of the SPIS transfers for the nRF52840
+ */
+
+#include "app_error.h"
+#include "nrf_drv_gpiote.h"
+#include "nrf_drv_ppi.h"
+#include "nrf_drv_spis.h"
+#include "nrf_drv_timer.h"
+#include "nrf_spis.h"
+
+#include "include/mhi_timing_nrf.h"
+
+static const nrf_drv_timer_t m_timer = NRF_DRV_TIMER_INSTANCE(MHI_TIMING_NRF_TIMER);
+static const nrf_drv_timer_t m_csn_counter = NRF_DRV_TIMER_INSTANCE(MHI_TIMING_NRF_CSN_COUNTER);
+static const nrf_drv_timer_t m_end_counter = NRF_DRV_TIMER_INSTANCE(MHI_TIMING_NRF_END_COUNTER);
+
+/**
+ * @brief Timer event handler, the timer raises no events.
+ */
+static void timer_event_handler(nrf_timer_event_t event_type, void *p_context)
+{
+    UNUSED_PARAMETER(event_type);
+    UNUSED_PARAMETER(p_context);
+}
+
+/**
+ * @brief Make an event trigger a capture task of the timer, and optionally a second task.
+ * @param event_address Event
+ * @param cc_channel Capture register of the timer
+ * @param fork_address Second task, 0 for none
+ */
+static void capture_connect(uint32_t event_address, uint32_t cc_channel, uint32_t fork_address)
+{
+    nrf_ppi_channel_t channel;
+
+    APP_ERROR_CHECK(nrf_drv_ppi_channel_alloc(&channel));
+    APP_ERROR_CHECK(nrf_drv_ppi_channel_assign(
+        channel, event_address, nrf_drv_timer_capture_task_address_get(&m_timer, (nrf_timer_cc_channel_t)cc_channel)));
+    if (fork_address != 0)
+    {
+        APP_ERROR_CHECK(nrf_drv_ppi_channel_fork_assign(channel, fork_address));
+    }
+    APP_ERROR_CHECK(nrf_drv_ppi_channel_enable(channel));
+}
+
+void mhi_timing_nrf_init(void)
+{
+    nrf_drv_timer_config_t timer_config = NRF_DRV_TIMER_DEFAULT_CONFIG;
+    ret_code_t err_code;
+
+    timer_config.frequency = NRF_TIMER_FREQ_1MHz;
+    timer_config.bit_width = NRF_TIMER_BIT_WIDTH_32;
+    APP_ERROR_CHECK(nrf_drv_timer_init(&m_timer, &timer_config, timer_event_handler));
+    timer_config.mode = NRF_TIMER_MODE_COUNTER;
+    APP_ERROR_CHECK(nrf_drv_timer_init(&m_csn_counter, &timer_config, timer_event_handler));
+    APP_ERROR_CHECK(nrf_drv_timer_init(&m_end_counter, &timer_config, timer_event_handler));
+
+    if (!nrf_drv_gpiote_is_init())
+    {
+        APP_ERROR_CHECK(nrf_drv_gpiote_init());
+    }
+    err_code = nrf_drv_ppi_init();
+    if (err_code != NRF_ERROR_MODULE_ALREADY_INITIALIZED)
+    {
+        APP_ERROR_CHECK(err_code);
+    }
+
+    nrf_drv_timer_enable(&m_timer);
+    nrf_drv_timer_enable(&m_csn_counter);
+    nrf_drv_timer_enable(&m_end_counter);
+}
+
+void mhi_timing_nrf_unit_init(uint8_t unit, uint32_t csn_pin, NRF_SPIS_Type *p_spis)
+{
+    nrf_drv_gpiote_in_config_t csn_config = GPIOTE_CONFIG_IN_SENSE_HITOLO(true);
+
+    ASSERT(unit < MHI_TIMING_NRF_UNITS_MAX);
+
+    /* Event only, no interrupt */
+    csn_config.pull = NRF_DRV_SPIS_DEFAULT_CSN_PULLUP;
+    APP_ERROR_CHECK(nrf_drv_gpiote_in_init(csn_pin, &csn_config, NULL));
+    nrf_drv_gpiote_in_event_enable(csn_pin, false);
+
+    capture_connect(nrf_drv_gpiote_in_event_addr_get(csn_pin), 2U * unit,
+                    nrf_drv_timer_task_address_get(&m_csn_counter, NRF_TIMER_TASK_COUNT));
+    capture_connect(nrf_spis_event_address_get(p_spis, NRF_SPIS_EVENT_END), 2U * unit + 1,
+                    nrf_drv_timer_task_address_get(&m_end_counter, NRF_TIMER_TASK_COUNT));
+}
+
+void mhi_timing_nrf_counts(uint32_t *p_csn, uint32_t *p_end)
+{
+    *p_csn = nrf_drv_timer_capture(&m_csn_counter, NRF_TIMER_CC_CHANNEL0);
+    *p_end = nrf_drv_timer_capture(&m_end_counter, NRF_TIMER_CC_CHANNEL0);
+}
@@ -0,0 +1,187 @@
+#!/usr/bin/env python3
+"""Complete and compare the results of the MHI pipeline benchmarks.
+
+mhi_bench (src/host/bench) measures the time per frame and the heap allocations of every
+stage. This tool merges several runs of it, keeping the best time of every stage, adds the
+code size of every stage, taken from the symbol sizes in the object files of the core, and
+optionally compares the result against a baseline:
+
+    python3 tools/bench_report.py -o bench.json bench_raw.json build/mhi_*.o
+    python3 tools/bench_report.py --compare src/host/bench/baseline.json -o bench.json \\
+        bench_raw.json build/mhi_*.o
+
+The comparison fails when a stage allocates, is more than --time-tolerance slower, or
+grew more than --size-tolerance in code size. Use --nm arm-none-eabi-nm with the objects
+of the firmware build to get target code sizes.
+
+The baseline is only replaced on purpose, with the reason for the new numbers, which is kept in
+its history next to the earlier ones:
+
+    python3 tools/bench_report.py --compare src/host/bench/baseline.json \\
+        --record "zcl publishes the vane attributes" -o src/host/bench/baseline.json \\
+        bench_raw.json build/mhi_*.o
+
+The comparison is printed but does not fail then, its deltas go into the commit message.
+"""
+
+import argparse
+import json
+import subprocess
+import sys
+
+# Functions making up every stage. The end to end stage is the whole core.
+STAGE_SYMBOLS = {
+    "validate": ["mhi_frame_validate", "mhi_frame_sum"],
+    "decode": ["mhi_state_decode"],
+    "diff": ["mhi_frame_diff", "mhi_state_diff"],
+    "tx_build": ["mhi_cmd_build", "mhi_opdata_build", "mhi_frame_set_checksum"],
+    "opdata": ["mhi_opdata_on_rx"],
+    "zcl": ["mhi_zcl_publish", "set_attribute"],
+    "temp": ["mhi_temp_convert"],
+    "ota": ["mhi_ota_start", "mhi_ota_block", "mhi_ota_verify", "mhi_ota_crc32", "chunk_flush",
+            "header_parse", "element_start", "element_data", "fail"],
+}
+E2E_STAGE = "e2e"
+# Stages that are not part of the frame pipeline, their code does not count for the end to end stage
+STAGE_SYMBOLS_OUTSIDE_E2E = [STAGE_SYMBOLS["ota"]]
+
+
+def symbol_sizes(nm, objects):
+    """Return the size of every function defined in the given objects."""
+    output = subprocess.run([nm, "--size-sort", "-S", "--defined-only"] + objects,
+                            check=True, capture_output=True, text=True).stdout
+    sizes = {}
+    for line in output.splitlines():
+        fields = line.split()
+        if len(fields) != 4 or fields[2] not in "tTwW":
+            continue
+        # Local symbols may be renamed by the compiler (set_attribute.constprop.0)
+        name = fields[3].split(".")[0]
+        sizes[name] = sizes.get(name, 0) + int(fields[1], 16)
+    return sizes
+
+
+def add_code_size(results, sizes):
+    for stage, data in results["stages"].items():
+        if stage == E2E_STAGE:
+            data["code_size"] = sum(size for name, size in sizes.items()
+                                    if not any(name in symbols for symbols in STAGE_SYMBOLS_OUTSIDE_E2E))
+        else:
+            data["code_size"] = sum(sizes.get(name, 0) for name in STAGE_SYMBOLS.get(stage, []))
+
+
+def merge(runs):
+    """Merge several runs of mhi_bench, keeping the best time of every stage and kernel."""
+    results = runs[0]
+    for run in runs[1:]:
+        for stage, data in run["stages"].items():
+            best = results["stages"][stage]
+            best["ns_per_frame"] = min(best["ns_per_frame"], data["ns_per_frame"])
+            best["allocs"] = max(best["allocs"], data["allocs"])
+        for kernel, data in run.get("kernels", {}).items():
+            for key in ("ns_per_frame", "reference_ns_per_frame"):
+                results["kernels"][kernel][key] = min(results["kernels"][kernel][key], data[key])
+    return results
+
+
+def compare(results, baseline, time_tolerance, size_tolerance):
+    """Print a comparison table, return False on regressions."""
+    ok = True
+    print("%-10s %12s %12s %8s %10s %10s %7s" % ("stage", "ns/frame", "baseline", "delta",
+                                                  "size", "baseline", "allocs"))
+    for stage, data in results["stages"].items():
+        base = baseline["stages"].get(stage)
+        problems = []
+
+        if data["allocs"]:
+            problems.append("allocates")
+        if base is None:
+            print("%-10s %12.2f %12s %8s %10d %10s %7d" % (stage, data["ns_per_frame"], "-", "-",
+                                                           data.get("code_size", 0), "-", data["allocs"]))
+            continue
+
+        delta = data["ns_per_frame"] / base["ns_per_frame"] - 1 if base["ns_per_frame"] else 0
+        if delta > time_tolerance:
+            problems.append("slower")
+        if base.get("code_size") and data.get("code_size", 0) > base["code_size"] * (1 + size_tolerance):
+            problems.append("larger")
+
+        print("%-10s %12.2f %12.2f %+7.1f%% %10d %10d %7d %s" % (
+            stage, data["ns_per_frame"], base["ns_per_frame"], delta * 100, data.get("code_size", 0),
+            base.get("code_size", 0), data["allocs"], " ".join(problems)))
+        ok = ok and not problems
+
+    for kernel, data in results.get("kernels", {}).items():
+        print("%s kernel: %.2f ns/frame, byte-wise reference %.2f ns/frame" % (
+            kernel, data["ns_per_frame"], data["reference_ns_per_frame"]))
+
+    reports = results.get("reports")
+    if reports:
+        per_hour = reports["room_temp_per_hour"]
+        print("room temperature reports per hour: %.0f unfiltered, %.0f filtered (%d suppressed)" % (
+            per_hour["unfiltered"], per_hour["filtered"], reports["suppressed"]))
+
+    for mode, data in results.get("sched", {}).items():
+        print("OTA download %s: AC answered %d of %d transfers, %d frames lost (%d ignored by the SPIS, "
+              "%d overwritten before read), longest stall %d us, %d late erases, %d steps" % (
+                  mode, data["frames"], data["frames"] + data["missed"], data["missed"] + data["overwritten"],
+                  data["missed"], data["overwritten"], data["stall_max_us"], data["late_erases"], data["steps"]))
+
+    return ok
+
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__, formatter_class=argparse.RawDescriptionHelpFormatter)
+    parser.add_argument("results", nargs="+",
+                        help="JSON output of mhi_bench, several runs are merged keeping the best times, "
+                             "followed by the object files of the core for the code size")
+    parser.add_argument("--nm", default="nm", help="nm executable (default: nm)")
+    parser.add_argument("-o", "--output", help="write the completed results here")
+    parser.add_argument("--compare", metavar="BASELINE", help="baseline results to compare against")
+    parser.add_argument("--time-tolerance", type=float, default=0.25,
+                        help="allowed relative slowdown (default: 0.25)")
+    parser.add_argument("--size-tolerance", type=float, default=0.10,
+                        help="allowed relative code size growth (default: 0.10)")
+    parser.add_argument("--record", metavar="REASON",
+                        help="the output replaces the baseline for this reason, the comparison does not fail")
+    args = parser.parse_args()
+
+    runs = []
+    objects = []
+    for path in args.results:
+        if path.endswith(".json"):
+            with open(path) as f:
+                runs.append(json.load(f))
+        else:
+            objects.append(path)
+    results = merge(runs)
+
+    baseline = None
+    if args.compare:
+        with open(args.compare) as f:
+            baseline = json.load(f)
+
+    if objects:
+        add_code_size(results, symbol_sizes(args.nm, objects))
+
+    if args.record:
+        results["history"] = (baseline or {}).get("history", []) + [args.record]
+
+    if args.output:
+        with open(args.output, "w") as f:
+            json.dump(results, f, indent=2)
+            f.write("\n")
+
+    if baseline is not None:
+        if not compare(results, baseline, args.time_tolerance, args.size_tolerance) and not args.record:
+            print("benchmark regression against %s" % args.compare, file=sys.stderr)
+            return 1
+    elif not args.output:
+        json.dump(results, sys.stdout, indent=2)
+        print()
+
+    return 0
+
+
+if __name__ == "__main__":
+    sys.exit(main())
@@ -0,0 +1,222 @@
+#!/usr/bin/env python3
+"""Report the flash and RAM usage per module from the GNU ld map file of the firmware.
+
+Every input section placed in the FLASH or RAM region is attributed to a module by the
+object it comes from. Initialised data counts for both regions (it is copied from flash at
+boot). Budgets are given as region=bytes or region.module=bytes, the report fails when one
+is exceeded:
+
+    python3 tools/mem_report.py _build/nrf52840_xxaa.map
+    python3 tools/mem_report.py --budget flash=368640 --budget ram.app=16384 \\
+        --json mem.json _build/nrf52840_xxaa.map
+
+Modules:
+    zboss    ZBOSS stack, radio driver, osif layer and the ZBOSS memory pools
+    nrf_log  nrf_log frontend, backends and formatter, log sections
+    app      Objects of this project (main.c, core/, nrf/)
+    buffers  Stack, heap and the static frame and log buffers of the application
+    sdk      Everything else: SDK drivers and libraries, libc, libgcc
+"""
+
+import argparse
+import json
+import os
+import re
+import sys
+
+MODULES = ["zboss", "nrf_log", "app", "buffers", "sdk"]
+
+# Application objects, by file name without the .c.o suffix
+APP_OBJECT = re.compile(r"^(main|mhi_\w+)$")
+# Static application buffers, by section (symbol) name
+APP_BUFFER = re.compile(r"^\.(bss|data)\.(m_(\w*_)?(buf|ring|rx|tx)\w*|m_units|m_chunk\w*)$")
+# ZBOSS memory pools defined by zb_mem_config_context.h in an application object, by section name
+ZBOSS_POOL_SECTION = re.compile(r"^\.(bss|data|rodata)\.(gc|zb)_\w+$")
+ZBOSS_OBJECT = re.compile(r"(libzboss|nrf_radio_driver|nrf_802154|^zb_|^zigbee_)")
+NRF_LOG_OBJECT = re.compile(r"^(nrf_log_|nrf_fprintf)")
+NRF_LOG_SECTION = re.compile(r"^\.log_")
+STACK_HEAP_SECTION = re.compile(r"^\.(stack|heap)")
+
+OUTPUT_SECTION = re.compile(r"^(\.?[\w.$]+)(?:\s+(0x[0-9a-f]+)\s+(0x[0-9a-f]+)(?:\s+load address\s+(0x[0-9a-f]+))?)?\s*$")
+INPUT_SECTION = re.compile(r"^ (\.[\w.$]+|COMMON)(?:\s+(0x[0-9a-f]+)\s+(0x[0-9a-f]+)\s+(\S.*))?\s*$")
+INPUT_CONTINUATION = re.compile(r"^\s+(0x[0-9a-f]+)\s+(0x[0-9a-f]+)\s+(\S.*)$")
+OUTPUT_CONTINUATION = re.compile(r"^\s+(0x[0-9a-f]+)\s+(0x[0-9a-f]+)(?:\s+load address\s+(0x[0-9a-f]+))?\s*$")
+REGION = re.compile(r"^(\w+)\s+(0x[0-9a-f]+)\s+(0x[0-9a-f]+)")
+
+
+def object_name(path):
+    """Return the object name of an input: member of an archive or object file name."""
+    member = re.search(r"\(([^)]+)\)$", path)
+    name = os.path.basename(member.group(1) if member else path)
+    for suffix in (".c.o", ".S.o", ".o"):
+        if name.endswith(suffix):
+            return name[:-len(suffix)]
+    return name
+
+
+def classify(path, section):
+    name = object_name(path)
+    if STACK_HEAP_SECTION.match(section):
+        return "buffers"
+    if NRF_LOG_SECTION.match(section):
+        return "nrf_log"
+    if APP_OBJECT.match(name):
+        if APP_BUFFER.match(section):
+            return "buffers"
+        # The ZBOSS memory pools and their sizes are instantiated in main.c by
+        # zb_mem_config_context.h, under the gc_ and zb_ names of the stack
+        if ZBOSS_POOL_SECTION.match(section):
+            return "zboss"
+        return "app"
+    if ZBOSS_OBJECT.search(path) or ZBOSS_OBJECT.search(name):
+        return "zboss"
+    if NRF_LOG_OBJECT.match(name):
+        return "nrf_log"
+    return "sdk"
+
+
+def parse_map(lines):
+    """Return the FLASH and RAM regions and the usage per region and module."""
+    regions = {}
+    usage = {region: {module: 0 for module in MODULES} for region in ("flash", "ram")}
+    state = None
+    in_ram = in_flash = loaded = False
+    header = pending = None
+
+    def add(section, size, path):
+        if size == 0:
+            return
+        module = classify(path, section)
+        if in_flash:
+            usage["flash"][module] += size
+        if in_ram:
+            usage["ram"][module] += size
+            if loaded:
+                usage["flash"][module] += size
+
+    def place(address, load_address):
+        region = regions["FLASH"]
+        in_flash = region[0] <= address < region[0] + region[1]
+        region = regions["RAM"]
+        in_ram = region[0] <= address < region[0] + region[1]
+        loaded = in_ram and load_address is not None and not in_flash and \
+            regions["FLASH"][0] <= int(load_address, 16) < regions["FLASH"][0] + regions["FLASH"][1]
+        return in_flash, in_ram, loaded
+
+    for line in lines:
+        line = line.rstrip("\n")
+        if line.startswith("Memory Configuration"):
+            state = "memory"
+            continue
+        if line.startswith("Linker script and memory map"):
+            if "FLASH" not in regions or "RAM" not in regions:
+                break
+            state = "map"
+            continue
+        if state == "memory":
+            match = REGION.match(line)
+            if match:
+                regions[match.group(1)] = (int(match.group(2), 16), int(match.group(3), 16))
+            continue
+        if state != "map" or not line:
+            continue
+
+        if not line.startswith(" "):
+            # Output section, or anything else that ends the current one (/DISCARD/, OUTPUT())
+            in_flash = in_ram = loaded = False
+            header = pending = None
+            match = OUTPUT_SECTION.match(line)
+            if match and match.group(2) is not None:
+                in_flash, in_ram, loaded = place(int(match.group(2), 16), match.group(4))
+            elif match:
+                # Long output section names continue on the next line
+                header = match.group(1)
+            continue
+
+        if header is not None:
+            match = OUTPUT_CONTINUATION.match(line)
+            if match:
+                in_flash, in_ram, loaded = place(int(match.group(1), 16), match.group(3))
+            header = None
+            continue
+
+        if pending is not None:
+            match = INPUT_CONTINUATION.match(line)
+            if match:
+                add(pending, int(match.group(2), 16), match.group(3))
+            pending = None
+            continue
+
+        match = INPUT_SECTION.match(line)
+        if match and (in_flash or in_ram):
+            if match.group(2) is None:
+                # Long input section names continue on the next line
+                pending = match.group(1)
+            else:
+                add(match.group(1), int(match.group(3), 16), match.group(4))
+
+    if "FLASH" not in regions or "RAM" not in regions:
+        raise ValueError("no FLASH or RAM region in the memory configuration of the map file")
+
+    return {"flash": regions["FLASH"][1], "ram": regions["RAM"][1]}, usage
+
+
+def parse_budgets(specs):
+    budgets = {}
+    for spec in specs:
+        key, _, value = spec.partition("=")
+        region, _, module = key.partition(".")
+        if region not in ("flash", "ram") or (module and module not in MODULES) or not value:
+            raise ValueError("invalid budget '%s', expected region[.module]=bytes" % spec)
+        budgets[(region, module or None)] = int(value, 0)
+    return budgets
+
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__, formatter_class=argparse.RawDescriptionHelpFormatter)
+    parser.add_argument("map", help="map file written by the linker (-Wl,-Map)")
+    parser.add_argument("--budget", action="append", default=[], metavar="REGION[.MODULE]=BYTES",
+                        help="maximum usage of a region or of a module in a region")
+    parser.add_argument("--json", metavar="FILE", help="also write the report as JSON")
+    args = parser.parse_args()
+
+    try:
+        budgets = parse_budgets(args.budget)
+        with open(args.map) as f:
+            sizes, usage = parse_map(f)
+    except (OSError, ValueError) as e:
+        print("mem_report: %s" % e, file=sys.stderr)
+        return 2
+
+    failures = []
+    print("%-10s %10s %10s" % ("module", "flash", "ram"))
+    for module in MODULES:
+        print("%-10s %10d %10d" % (module, usage["flash"][module], usage["ram"][module]))
+        for region in ("flash", "ram"):
+            budget = budgets.get((region, module))
+            if budget is not None and usage[region][module] > budget:
+                failures.append("%s %s uses %d bytes, budget %d" % (module, region, usage[region][module], budget))
+
+    totals = {region: sum(usage[region].values()) for region in ("flash", "ram")}
+    print("%-10s %10d %10d" % ("total", totals["flash"], totals["ram"]))
+    print("%-10s %10d %10d" % ("free", sizes["flash"] - totals["flash"], sizes["ram"] - totals["ram"]))
+    for region in ("flash", "ram"):
+        budget = budgets.get((region, None))
+        if budget is not None and totals[region] > budget:
+            failures.append("%s uses %d bytes, budget %d" % (region, totals[region], budget))
+
+    if args.json:
+        report = {region: {"size": sizes[region], "used": totals[region], "modules": usage[region]}
+                  for region in ("flash", "ram")}
+        with open(args.json, "w") as f:
+            json.dump(report, f, indent=2)
+            f.write("\n")
+
+    for failure in failures:
+        print("mem_report: budget exceeded: %s" % failure, file=sys.stderr)
+
+    return 1 if failures else 0
+
+
+if __name__ == "__main__":
+    sys.exit(main())
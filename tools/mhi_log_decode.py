@@ -0,0 +1,150 @@
+#!/usr/bin/env python3
+"""Decode the binary log stream of the MHI firmware.
+
+The firmware (built with MHI_LOG_BINARY_ENABLED=1) sends frames of the form
+
+    0xA5 | format id (16-bit LE) | payload length | payload
+
+where the format id is the offset of the format string in the ``mhi_log_fmt`` section
+of the ELF file. This tool reads that section and turns the frames back into text.
+
+Usage:
+    stty -F /dev/ttyUSB0 115200 raw
+    python3 tools/mhi_log_decode.py _build/nrf52840_xxaa.out /dev/ttyUSB0
+
+Use ``-`` as input to read a captured stream from stdin.
+"""
+
+import argparse
+import re
+import struct
+import sys
+
+SYNC = 0xA5
+HEADER_SIZE = 4
+ID_DROPPED = 0xFFFF
+SECTION = "mhi_log_fmt"
+LEVELS = {"E": "error", "W": "warning", "I": "info", "D": "debug"}
+
+FORMAT_RE = re.compile(r"%([-+ #0]*)(\d*)(?:\.(\d+))?(hh|h|ll|l|z|j|t)?([diouxXcsp%])")
+
+
+def read_section(path, name):
+    """Return the raw contents of an ELF section (ELF32/ELF64, little endian)."""
+    with open(path, "rb") as f:
+        elf = f.read()
+
+    if elf[:4] != b"\x7fELF":
+        raise ValueError("%s is not an ELF file" % path)
+    is64 = elf[4] == 2
+    if is64:
+        shoff, = struct.unpack_from("<Q", elf, 0x28)
+        shentsize, shnum, shstrndx = struct.unpack_from("<HHH", elf, 0x3A)
+        header = "<IIQQQQIIQQ"
+    else:
+        shoff, = struct.unpack_from("<I", elf, 0x20)
+        shentsize, shnum, shstrndx = struct.unpack_from("<HHH", elf, 0x2E)
+        header = "<IIIIIIIIII"
+
+    sections = [struct.unpack_from(header, elf, shoff + i * shentsize) for i in range(shnum)]
+    strtab = sections[shstrndx]
+    names = elf[strtab[4]:strtab[4] + strtab[5]]
+    for sh in sections:
+        sh_name = names[sh[0]:names.index(b"\0", sh[0])].decode()
+        if sh_name == name:
+            return elf[sh[4]:sh[4] + sh[5]]
+
+    raise ValueError("%s has no %s section, was it built with MHI_LOG_BINARY_ENABLED=1?" % (path, name))
+
+
+def format_string(table, fmt_id):
+    end = table.find(b"\0", fmt_id)
+    if fmt_id >= len(table) or end < 0:
+        return None
+    return table[fmt_id:end].decode(errors="replace")
+
+
+def c_format(fmt, args):
+    """Apply a C printf format to the raw 32-bit arguments."""
+    args = list(args)
+
+    def convert(match):
+        flags, width, precision, _, conv = match.groups()
+        if conv == "%":
+            return "%"
+        value = args.pop(0) if args else 0
+        if conv in "di":
+            value = value - (1 << 32) if value & 0x80000000 else value
+        elif conv == "c":
+            value = chr(value & 0xFF)
+        elif conv == "s":
+            return "<str@0x%08x>" % value
+        elif conv == "p":
+            return "0x%08x" % value
+        spec = "%" + flags + width + ("." + precision if precision else "")
+        return (spec + {"i": "d", "u": "d"}.get(conv, conv)) % value
+
+    return FORMAT_RE.sub(convert, fmt)
+
+
+def decode_frame(table, fmt_id, payload):
+    if fmt_id == ID_DROPPED:
+        count, = struct.unpack_from("<I", payload)
+        return "<warning> %d log frames dropped" % count
+
+    entry = format_string(table, fmt_id)
+    if entry is None or len(entry) < 2:
+        return "<unknown format id 0x%04x> %s" % (fmt_id, payload.hex(" "))
+
+    level = LEVELS.get(entry[0], "?")
+    if entry[1] == "x":
+        return "<%s> %s" % (level, payload.hex(" ").upper())
+
+    args = struct.unpack("<%dI" % (len(payload) // 4), payload[:len(payload) & ~3])
+    return "<%s> %s" % (level, c_format(entry[2:], args))
+
+
+def decode_stream(table, stream, out):
+    buf = bytearray()
+    while True:
+        chunk = stream.read(1) if stream.isatty() else stream.read(256)
+        if not chunk:
+            break
+        buf += chunk
+        while True:
+            start = buf.find(bytes([SYNC]))
+            if start < 0:
+                buf.clear()
+                break
+            del buf[:start]
+            if len(buf) < HEADER_SIZE:
+                break
+            fmt_id, length = struct.unpack_from("<HB", buf, 1)
+            if len(buf) < HEADER_SIZE + length:
+                break
+            payload = bytes(buf[HEADER_SIZE:HEADER_SIZE + length])
+            if fmt_id != ID_DROPPED and format_string(table, fmt_id) is None:
+                # Not a frame start, resynchronise on the next sync byte
+                del buf[:1]
+                continue
+            out.write(decode_frame(table, fmt_id, payload) + "\n")
+            out.flush()
+            del buf[:HEADER_SIZE + length]
+
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__.splitlines()[0])
+    parser.add_argument("elf", help="firmware ELF file (_build/nrf52840_xxaa.out)")
+    parser.add_argument("input", help="serial device or captured stream, - for stdin")
+    args = parser.parse_args()
+
+    table = read_section(args.elf, SECTION)
+    if args.input == "-":
+        decode_stream(table, sys.stdin.buffer, sys.stdout)
+    else:
+        with open(args.input, "rb", buffering=0) as stream:
+            decode_stream(table, stream, sys.stdout)
+
+
+if __name__ == "__main__":
+    main()
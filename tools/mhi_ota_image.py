@@ -0,0 +1,58 @@
+#!/usr/bin/env python3
+"""Wrap a firmware binary into a Zigbee OTA upgrade file for the MHI firmware.
+
+The file contains the mandatory OTA header, the firmware as upgrade image sub-element and
+a manufacturer specific sub-element (tag 0xF000) with the CRC-32 of the firmware, which the
+device checks before installing the image. Serve the file with any Zigbee OTA server
+(zigbee2mqtt, ZHA, deCONZ).
+
+Usage:
+    python3 tools/mhi_ota_image.py --version 0x01000001 _build/nrf52840_xxaa.bin mhi.zigbee
+"""
+
+import argparse
+import struct
+import sys
+import zlib
+
+FILE_ID = 0x0BEEF11E
+HEADER_VERSION = 0x0100
+HEADER_SIZE = 56
+STACK_PRO = 0x0002
+TAG_UPGRADE_IMAGE = 0x0000
+TAG_CRC = 0xF000
+
+
+def build(image, manufacturer, image_type, version, header_string):
+    elements = struct.pack("<HI", TAG_UPGRADE_IMAGE, len(image)) + image
+    elements += struct.pack("<HII", TAG_CRC, 4, zlib.crc32(image) & 0xFFFFFFFF)
+    header = struct.pack("<IHHHHHIH32sI", FILE_ID, HEADER_VERSION, HEADER_SIZE, 0, manufacturer,
+                         image_type, version, STACK_PRO, header_string.encode()[:32],
+                         HEADER_SIZE + len(elements))
+    return header + elements
+
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__, formatter_class=argparse.RawDescriptionHelpFormatter)
+    parser.add_argument("image", help="firmware binary")
+    parser.add_argument("output", help="OTA upgrade file to write")
+    parser.add_argument("--version", type=lambda v: int(v, 0), required=True,
+                        help="file version, must be higher than MHI_OTA_FILE_VERSION of the running firmware")
+    parser.add_argument("--manufacturer", type=lambda v: int(v, 0), default=0x1234,
+                        help="manufacturer code (default: 0x1234, MHI_MANUF_CODE)")
+    parser.add_argument("--image-type", type=lambda v: int(v, 0), default=0x0001,
+                        help="image type (default: 0x0001, MHI_OTA_IMAGE_TYPE)")
+    parser.add_argument("--header-string", default="mhi-ac-control", help="OTA header string")
+    args = parser.parse_args()
+
+    with open(args.image, "rb") as f:
+        image = f.read()
+
+    with open(args.output, "wb") as f:
+        f.write(build(image, args.manufacturer, args.image_type, args.version, args.header_string))
+
+    return 0
+
+
+if __name__ == "__main__":
+    sys.exit(main())